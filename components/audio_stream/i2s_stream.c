@@ -34,16 +34,22 @@
 #include "driver/dac.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 
 #include "audio_common.h"
 #include "audio_mem.h"
 #include "audio_element.h"
 #include "i2s_stream.h"
+#include "i2s_stream_pcm.h"
 #include "esp_alc.h"
 #include "board_pins_config.h"
 #include "led_strip/led_strip.h"
+#include "led_strip/led_effect.h"
 
 extern struct led_strip_t led_strip;
+#ifdef CONFIG_LED_EFFECT_ENGINE
+extern struct led_effect_t led_effect;
+#endif
 static const char *TAG = "I2S_STREAM";
 
 typedef struct i2s_stream {
@@ -54,78 +60,59 @@ typedef struct i2s_stream {
     void                *volume_handle;
     int                 volume;
     bool                uninstall_drv;
+    uint8_t             *silence_buf;       /*!< Preallocated DMA flush buffer, `silence_len` bytes */
+    int                 silence_len;
+    i2s_pcm_t           pcm;                /*!< Concealment, gain and VU meter state */
+    i2s_stream_process_cb_t process_cb[I2S_STREAM_MAX_PROCESS_CB];
+    void                *process_ctx[I2S_STREAM_MAX_PROCESS_CB];
+    int                 process_cb_num;
+    i2s_stream_chain_stats_t chain_stats;
+    i2s_stream_underrun_stats_t underrun_stats; /*!< Copy of pcm.stats for other tasks */
+    bool                underrun_reset;     /*!< Reset posted to the i2s task */
 } i2s_stream_t;
 
-static esp_err_t i2s_mono_fix(int bits, uint8_t *sbuff, uint32_t len)
+/* Guards the statistics shared with other tasks, the 64-bit counters are not written atomically */
+static portMUX_TYPE i2s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void i2s_stream_run_chain(i2s_stream_t *i2s, audio_element_info_t *info, uint8_t *buf, int len)
 {
-    if (bits == 16) {
-        int16_t *temp_buf = (int16_t *)sbuff;
-        int16_t temp_box;
-        int k = len >> 1;
-        for (int i = 0; i < k; i += 2) {
-            temp_box = temp_buf[i];
-            temp_buf[i] = temp_buf[i + 1];
-            temp_buf[i + 1] = temp_box;
-        }
-    } else if (bits == 32) {
-        int32_t *temp_buf = (int32_t *)sbuff;
-        int32_t temp_box;
-        int k = len >> 2;
-        for (int i = 0; i < k; i += 4) {
-            temp_box = temp_buf[i];
-            temp_buf[i] = temp_buf[i + 1];
-            temp_buf[i + 1] = temp_box;
-        }
-    } else {
-        ESP_LOGE(TAG, "%s %dbits is not supported", __func__, bits);
-        return ESP_FAIL;
+    if (i2s->process_cb_num == 0) {
+        return;
     }
-    return ESP_OK;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < i2s->process_cb_num; i++) {
+        i2s->process_cb[i](buf, len, info, i2s->process_ctx[i]);
+    }
+    int64_t time_us = esp_timer_get_time() - start;
+    portENTER_CRITICAL(&i2s_stats_lock);
+    i2s->chain_stats.time_us += time_us;
+    i2s->chain_stats.buffers++;
+    i2s->chain_stats.bytes += len;
+    portEXIT_CRITICAL(&i2s_stats_lock);
 }
 
-/**
- * @brief Scale data to 16bit/32bit for I2S DMA output.
- *        DAC can only output 8bit data value.
- *        I2S DMA will still send 16bit or 32bit data, the highest 8bit contains DAC data.
+/*
+ * pcm.stats is only written by the i2s task. Publish the copy read by
+ * i2s_stream_get_underrun_stats and apply a posted reset.
  */
-static int i2s_dac_data_scale(int bits, uint8_t *sBuff, uint32_t len)
+static void i2s_stream_sync_underrun_stats(i2s_stream_t *i2s)
 {
-    if (bits == 16) {
-        short *buf16 = (short *)sBuff;
-        int k = len >> 1;
-        for (int i = 0; i < k; i++) {
-            buf16[i] &= 0xff00;
-            buf16[i] += 0x8000;//turn signed value into unsigned, expand negative value into positive range
-        }
-    } else if (bits == 32) {
-        int *buf32 = (int *)sBuff;
-        int k = len >> 2;
-        for (int i = 0; i < k; i++) {
-            buf32[i] &= 0xff000000;
-            buf32[i] += 0x80000000;//turn signed value into unsigned
-        }
-    } else {
-        ESP_LOGE(TAG, "in %s %dbits is not supported", __func__, bits);
-        return -1;
+    portENTER_CRITICAL(&i2s_stats_lock);
+    if (i2s->underrun_reset) {
+        i2s->underrun_reset = false;
+        memset(&i2s->pcm.stats, 0, sizeof(i2s_stream_underrun_stats_t));
+        i2s->pcm.gap_frames = 0;
     }
-
-    return 0;
+    memcpy(&i2s->underrun_stats, &i2s->pcm.stats, sizeof(i2s_stream_underrun_stats_t));
+    portEXIT_CRITICAL(&i2s_stats_lock);
 }
 
 static int i2s_stream_clear_dma_buffer(audio_element_handle_t self)
 {
     i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(self);
     int index = i2s->config.i2s_config.dma_buf_count;
-    uint8_t *buf = audio_calloc(1, i2s->config.i2s_config.dma_buf_len * 4);
-    AUDIO_MEM_CHECK(TAG, buf, return ESP_ERR_NO_MEM);
-    if ((i2s->config.i2s_config.mode & I2S_MODE_DAC_BUILT_IN) != 0) {
-        memset(buf, 0x80, i2s->config.i2s_config.dma_buf_len * 4);
-    }
     while (index--) {
-        audio_element_output(self, (char *)buf, i2s->config.i2s_config.dma_buf_len * 4);
-    }
-    if (buf) {
-        free(buf);
+        audio_element_output(self, (char *)i2s->silence_buf, i2s->silence_len);
     }
     return ESP_OK;
 }
@@ -169,6 +156,7 @@ static esp_err_t _i2s_destroy(audio_element_handle_t self)
     if (i2s->uninstall_drv) {
         i2s_driver_uninstall(i2s->config.i2s_port);
     }
+    audio_free(i2s->silence_buf);
     audio_free(i2s);
     return ESP_OK;
 }
@@ -181,6 +169,9 @@ static esp_err_t _i2s_close(audio_element_handle_t self)
         return ret;
     }
     i2s->is_open = false;
+    i2s->pcm.has_played = false;
+    i2s->pcm.in_underrun = true;
+    i2s->pcm.clock.valid = false;
     if (AEL_STATE_PAUSED != audio_element_get_state(self)) {
         audio_element_report_pos(self);
         audio_element_info_t info = {0};
@@ -205,7 +196,9 @@ static int _i2s_read(audio_element_handle_t self, char *buffer, int len, TickTyp
     audio_element_getinfo(self, &info);
     if (bytes_read > 0) {
         if (info.channels == 1) {
-            i2s_mono_fix(info.bits, (uint8_t *)buffer, bytes_read);
+            if (i2s_pcm_mono_fix(info.bits, (uint8_t *)buffer, bytes_read) != 0) {
+                ESP_LOGE(TAG, "%s %dbits is not supported", __func__, info.bits);
+            }
         }
         info.byte_pos += bytes_read;
         audio_element_setinfo(self, &info);
@@ -221,150 +214,61 @@ static int _i2s_write(audio_element_handle_t self, char *buffer, int len, TickTy
     return bytes_written;
 }
 
+static void i2s_stream_show_vu(i2s_stream_t *i2s, const char *buf, int len, const audio_element_info_t *info)
+{
+    i2s_pcm_vu_frame_t frame;
+    i2s_pcm_vu_analyze(&i2s->pcm.vu, (const uint8_t *)buf, len, &frame);
+    if (frame.beat) {
+        gpio_set_level(get_green_led_gpio(), 1);
+        // beatit(); TODO: Call to sync beat counter
+    }
+#ifdef CONFIG_LED_EFFECT_ENGINE
+    /*
+     * The effect task owns the strip, it only needs the features. They are shown
+     * when this buffer is heard, after the frames still queued in DMA.
+     */
+    int depth_frames = i2s->config.i2s_config.dma_buf_count * i2s->config.i2s_config.dma_buf_len;
+    int64_t playout_us = i2s_pcm_playout_us(&i2s->pcm.clock, esp_timer_get_time(), info->byte_pos,
+                                            info->bits / 8 * info->channels, info->sample_rates, depth_frames);
+    led_effect_queue_audio(&led_effect, frame.level, frame.beat, playout_us);
+#else
+    for (int i = 0; i < I2S_PCM_VU_LEDS; i++) {
+        if (frame.set_mask & (1 << i)) {
+            led_strip_set_pixel_rgb(&led_strip, i, frame.rgb[i][0], frame.rgb[i][1], frame.rgb[i][2]);
+        }
+    }
+    led_strip_show(&led_strip);
+#endif
+}
+
 static int _i2s_process(audio_element_handle_t self, char *in_buffer, int in_len)
 {
+    i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(self);
     int r_size = audio_element_input(self, in_buffer, in_len);
     int w_size = 0;
+    audio_element_info_t info = {0};
+    audio_element_getinfo(self, &info);
     if (r_size == AEL_IO_TIMEOUT) {
-        i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(self);
-        if ((i2s->config.i2s_config.mode & I2S_MODE_DAC_BUILT_IN) != 0) {
-            memset(in_buffer, 0x80, in_len);
-        } else  {
-            memset(in_buffer, 0x00, in_len);
-        }
+        // Signed silence, the built-in DAC offset is added by i2s_pcm_convert below
+        i2s_pcm_conceal(&i2s->pcm, info.bits, info.channels, (uint8_t *)in_buffer, in_len);
         r_size = in_len;
+    } else if (r_size > 0) {
+        i2s_pcm_fade_in(&i2s->pcm, info.bits, info.channels, (uint8_t *)in_buffer, r_size);
     }
+    i2s_stream_sync_underrun_stats(i2s);
     if ((r_size > 0)) {
-        i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(self);
+        i2s_stream_run_chain(i2s, &info, (uint8_t *)in_buffer, r_size);
         if (i2s->use_alc) {
-            audio_element_info_t i2s_info = {0};
-            audio_element_getinfo(self, &i2s_info);
-            alc_volume_setup_process(in_buffer, r_size, i2s_info.channels, i2s->volume_handle, i2s->volume);
+            alc_volume_setup_process(in_buffer, r_size, info.channels, i2s->volume_handle, i2s->volume);
         }
-        
-// Feed the led strip  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
-#if CONFIG_SIMPLE_VU == 1
-#define SIMPLE_VU
-#endif
+        // Feed the led strip
+        i2s_stream_show_vu(i2s, in_buffer, in_len, &info);
 
-#if CONFIG_VU_TERMINAL == 1
-#define VU_TERMINAL  
-#endif
-static int reise;       
-static int maxvolume;
-static int peak = 0;
-int i = 1;
-int volumel = 0;
-int volumer = 0;
-
-   while (i < in_len)
-   {
-   uint8_t datal = in_buffer[i] ;
-
-	     i+=128;
-	 
-	   if (datal < 128)
-	   {    
-	   if (datal > volumel) volumel = datal;
-	   else volumel--;
-	   }
-	
-   } 
-   
-#ifdef VU_TERMINAL   
-   printf("\r\n\033[92m");
-#endif   
-   if (volumel > maxvolume) {
-	   reise = 1;
-	   peak = 0;
-	   maxvolume = volumel;
-   }
-   else {
-	   if (reise) {
-		   gpio_set_level(get_green_led_gpio(), 1);
-		  // beatit(); TODO: Call to sync beat counter
-		  peak = 96;
-	   }
-	   reise = 0;
-	   maxvolume = maxvolume - 1;
-   }
-   int momvol = maxvolume;
-   peak--;
-    for (int i = 0;i<8;i++)
-   {
-#ifdef SIMPLE_VU
-		peak = 0;
-#endif	   
-	 if (peak > 0)  {
-		 peak--;
-		 if (maxvolume > 113)
-		 {
-			 led_strip_set_pixel_rgb(&led_strip, i, 255, 255,255);
-			 peak -= 2;
-		 }
-		 else
-		 {
-		 if (peak & 1)
-		 led_strip_set_pixel_rgb(&led_strip, i, 0, peak * 2 , maxvolume * 2);
-		 else
-		 led_strip_set_pixel_rgb(&led_strip, i,  0, maxvolume * 2, peak * 2);//255 - peak * 2
-		 }
-	  }
-	 else
-	 {
-	   
-	   
-#ifdef VU_TERMINAL 	   
-	   if (i == 6) printf("\033[91m");
-#endif	   
-     if (volumel > (i*16)) {
-#ifdef SIMPLE_VU	
-			 if (i > 5)
-#else		 
-		 if (i > 2)
-#endif		 
-		 {
-#ifdef SIMPLE_VU		 
-			led_strip_set_pixel_rgb(&led_strip, i, 0, 200, 0);
-		
-#else			
-			led_strip_set_pixel_rgb(&led_strip, i, 200, 0, 0);
-			led_strip_set_pixel_rgb(&led_strip, 7-i, 200, 0, 0);
-#endif
-	}
-#ifdef SIMPLE_VU	
-		 else
-		 			led_strip_set_pixel_rgb(&led_strip, i, 200, 0, 0);
-#endif
-#ifdef VU_TERMINAL 			
-		 printf("===");
-#endif		 
-	}
-     else if ((momvol/16 + 1) == i ){
-#ifdef VU_TERMINAL 		 
-		  printf("\033[93m |||");
-#endif		  
-		  //led_strip_set_pixel_rgb(&led_strip, i, 0, 0, 64);
-	  }
-     else {
-		 
-#ifdef VU_TERMINAL 		 
-		 printf("   ");
-#endif		 
-	 }
-   }
-}
-//==================================================================================================================================== 
         audio_element_multi_output(self, in_buffer, r_size, 0);
         // Fix output by I2S only
-        audio_element_info_t info;
-        audio_element_getinfo(self, &info);
-        if (info.channels == 1) {
-            i2s_mono_fix(info.bits, (uint8_t *)in_buffer, r_size);
-        }
-        if ((i2s->config.i2s_config.mode & I2S_MODE_DAC_BUILT_IN) != 0) {
-            i2s_dac_data_scale(info.bits, (uint8_t *)in_buffer, r_size);
-        }
+        i2s_pcm_convert(&i2s->pcm, info.bits, info.channels,
+                        (i2s->config.i2s_config.mode & I2S_MODE_DAC_BUILT_IN) != 0,
+                        (uint8_t *)in_buffer, r_size);
         w_size = audio_element_output(self, in_buffer, r_size);
 
         audio_element_getinfo(self, &info);
@@ -417,6 +321,74 @@ int i2s_alc_volume_set(audio_element_handle_t i2s_stream, int volume)
     }
 }
 
+esp_err_t i2s_stream_set_gain_db(audio_element_handle_t i2s_stream, float gain_db)
+{
+    i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(i2s_stream);
+    if (i2s == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2s_pcm_set_gain_db(&i2s->pcm, gain_db);
+    return ESP_OK;
+}
+
+esp_err_t i2s_stream_add_process_cb(audio_element_handle_t i2s_stream, i2s_stream_process_cb_t cb, void *ctx)
+{
+    i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(i2s_stream);
+    if (i2s == NULL || cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (i2s->is_open) {
+        ESP_LOGE(TAG, "Process callbacks must be added before the stream is running");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (i2s->process_cb_num >= I2S_STREAM_MAX_PROCESS_CB) {
+        ESP_LOGE(TAG, "No room for another process callback, max %d", I2S_STREAM_MAX_PROCESS_CB);
+        return ESP_ERR_NO_MEM;
+    }
+    i2s->process_cb[i2s->process_cb_num] = cb;
+    i2s->process_ctx[i2s->process_cb_num] = ctx;
+    i2s->process_cb_num++;
+    return ESP_OK;
+}
+
+esp_err_t i2s_stream_get_chain_stats(audio_element_handle_t i2s_stream, i2s_stream_chain_stats_t *stats)
+{
+    i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(i2s_stream);
+    if (i2s == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&i2s_stats_lock);
+    memcpy(stats, &i2s->chain_stats, sizeof(i2s_stream_chain_stats_t));
+    portEXIT_CRITICAL(&i2s_stats_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2s_stream_get_underrun_stats(audio_element_handle_t i2s_stream, i2s_stream_underrun_stats_t *stats)
+{
+    i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(i2s_stream);
+    if (i2s == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&i2s_stats_lock);
+    memcpy(stats, &i2s->underrun_stats, sizeof(i2s_stream_underrun_stats_t));
+    portEXIT_CRITICAL(&i2s_stats_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2s_stream_reset_underrun_stats(audio_element_handle_t i2s_stream)
+{
+    i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(i2s_stream);
+    if (i2s == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The i2s task owns pcm.stats, it clears them before its next buffer
+    portENTER_CRITICAL(&i2s_stats_lock);
+    i2s->underrun_reset = true;
+    memset(&i2s->underrun_stats, 0, sizeof(i2s_stream_underrun_stats_t));
+    portEXIT_CRITICAL(&i2s_stats_lock);
+    return ESP_OK;
+}
+
 int i2s_alc_volume_get(audio_element_handle_t i2s_stream, int *volume)
 {
     i2s_stream_t *i2s = (i2s_stream_t *)audio_element_getdata(i2s_stream);
@@ -454,18 +426,37 @@ audio_element_handle_t i2s_stream_init(i2s_stream_cfg_t *config)
     i2s->volume = config->volume;
     i2s->uninstall_drv = config->uninstall_drv;
 
+#if CONFIG_SIMPLE_VU == 1
+    i2s->pcm.vu.simple = true;
+#endif
+#if CONFIG_VU_TERMINAL == 1
+    i2s->pcm.vu.terminal = true;
+#endif
+    i2s_pcm_init(&i2s->pcm);
+    i2s->silence_len = config->i2s_config.dma_buf_len * 4;
+    i2s->silence_buf = audio_calloc(1, i2s->silence_len);
+    AUDIO_MEM_CHECK(TAG, i2s->silence_buf, {
+        audio_free(i2s);
+        return NULL;
+    });
+    if ((config->i2s_config.mode & I2S_MODE_DAC_BUILT_IN) != 0) {
+        memset(i2s->silence_buf, 0x80, i2s->silence_len);
+    }
+
     if (config->type == AUDIO_STREAM_READER) {
         cfg.read = _i2s_read;
     } else if (config->type == AUDIO_STREAM_WRITER) {
         cfg.write = _i2s_write;
     }
     if (i2s_driver_install(i2s->config.i2s_port, &i2s->config.i2s_config, 0, NULL) != ESP_OK) {
+        audio_free(i2s->silence_buf);
         audio_free(i2s);
         return NULL;
     }
 
     el = audio_element_init(&cfg);
     AUDIO_MEM_CHECK(TAG, el, {
+        audio_free(i2s->silence_buf);
         audio_free(i2s);
         return NULL;
     });
@@ -0,0 +1,328 @@
+/*
+ * Per-buffer PCM processing of the I2S writer stream, see i2s_stream_pcm.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "i2s_stream_pcm.h"
+
+void i2s_pcm_init(i2s_pcm_t *pcm)
+{
+    i2s_pcm_vu_t vu = pcm->vu;
+    memset(pcm, 0, sizeof(i2s_pcm_t));
+    pcm->vu.simple = vu.simple;
+    pcm->vu.terminal = vu.terminal;
+    pcm->in_underrun = true;
+    pcm->gain_target = I2S_PCM_GAIN_UNITY;
+    pcm->gain_ramp_to = I2S_PCM_GAIN_UNITY;
+    pcm->gain_cur = I2S_PCM_GAIN_UNITY;
+}
+
+int i2s_pcm_mono_fix(int bits, uint8_t *sbuff, uint32_t len)
+{
+    if (bits == 16) {
+        int16_t *temp_buf = (int16_t *)sbuff;
+        int16_t temp_box;
+        int k = len >> 1;
+        for (int i = 0; i < k; i += 2) {
+            temp_box = temp_buf[i];
+            temp_buf[i] = temp_buf[i + 1];
+            temp_buf[i + 1] = temp_box;
+        }
+    } else if (bits == 32) {
+        int32_t *temp_buf = (int32_t *)sbuff;
+        int32_t temp_box;
+        int k = len >> 2;
+        for (int i = 0; i < k; i += 4) {
+            temp_box = temp_buf[i];
+            temp_buf[i] = temp_buf[i + 1];
+            temp_buf[i + 1] = temp_box;
+        }
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int i2s_pcm_dac_scale(int bits, uint8_t *sBuff, uint32_t len)
+{
+    if (bits == 16) {
+        short *buf16 = (short *)sBuff;
+        int k = len >> 1;
+        for (int i = 0; i < k; i++) {
+            buf16[i] &= 0xff00;
+            buf16[i] += 0x8000;//turn signed value into unsigned, expand negative value into positive range
+        }
+    } else if (bits == 32) {
+        int *buf32 = (int *)sBuff;
+        int k = len >> 2;
+        for (int i = 0; i < k; i++) {
+            buf32[i] &= 0xff000000;
+            buf32[i] += 0x80000000;//turn signed value into unsigned
+        }
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static void i2s_pcm_account_gap(i2s_pcm_t *pcm, int frames)
+{
+    if (!pcm->in_underrun) {
+        pcm->stats.underrun_count++;
+        pcm->gap_frames = 0;
+    }
+    pcm->gap_frames += frames;
+    pcm->stats.silent_frames += frames;
+    if (pcm->gap_frames > pcm->stats.longest_gap_frames) {
+        pcm->stats.longest_gap_frames = pcm->gap_frames;
+    }
+}
+
+void i2s_pcm_conceal(i2s_pcm_t *pcm, int bits, int channels, uint8_t *buf, int len)
+{
+    int frame_bytes = (bits >> 3) * channels;
+    if (pcm->has_played) {
+        i2s_pcm_account_gap(pcm, len / (frame_bytes > 0 ? frame_bytes : 4));
+    }
+    memset(buf, 0, len);
+    if (pcm->in_underrun || bits != 16) {
+        pcm->in_underrun = true;
+        return;
+    }
+    pcm->in_underrun = true;
+    int16_t *buf16 = (int16_t *)buf;
+    int ch = channels == 1 ? 1 : 2;
+    int frames = (len >> 1) / ch;
+    if (frames > I2S_PCM_FADE_FRAMES) {
+        frames = I2S_PCM_FADE_FRAMES;
+    }
+    for (int n = 0; n < frames; n++) {
+        int gain = I2S_PCM_FADE_FRAMES - n;
+        for (int c = 0; c < ch; c++) {
+            buf16[n * ch + c] = (pcm->last_frame[c] * gain) / I2S_PCM_FADE_FRAMES;
+        }
+    }
+}
+
+void i2s_pcm_fade_in(i2s_pcm_t *pcm, int bits, int channels, uint8_t *buf, int len)
+{
+    bool in_underrun = pcm->in_underrun;
+    pcm->in_underrun = false;
+    pcm->has_played = true;
+    if (bits != 16) {
+        return;
+    }
+    int16_t *buf16 = (int16_t *)buf;
+    int ch = channels == 1 ? 1 : 2;
+    int frames = (len >> 1) / ch;
+    if (frames == 0) {
+        return;
+    }
+    if (in_underrun) {
+        int fade = frames < I2S_PCM_FADE_FRAMES ? frames : I2S_PCM_FADE_FRAMES;
+        for (int n = 0; n < fade; n++) {
+            for (int c = 0; c < ch; c++) {
+                buf16[n * ch + c] = (buf16[n * ch + c] * n) / I2S_PCM_FADE_FRAMES;
+            }
+        }
+    }
+    for (int c = 0; c < ch; c++) {
+        pcm->last_frame[c] = buf16[(frames - 1) * ch + c];
+    }
+}
+
+void i2s_pcm_set_gain_db(i2s_pcm_t *pcm, float gain_db)
+{
+    if (gain_db > 0) {
+        gain_db = 0;
+    }
+    if (gain_db <= I2S_PCM_GAIN_MIN_DB) {
+        pcm->gain_target = 0;
+    } else {
+        pcm->gain_target = (int32_t)(powf(10.0f, gain_db / 20.0f) * I2S_PCM_GAIN_UNITY);
+    }
+}
+
+static inline int32_t i2s_pcm_gain_next(i2s_pcm_t *pcm)
+{
+    if (pcm->gain_cur != pcm->gain_ramp_to) {
+        pcm->gain_cur += pcm->gain_step;
+        if ((pcm->gain_step > 0 && pcm->gain_cur > pcm->gain_ramp_to)
+            || (pcm->gain_step < 0 && pcm->gain_cur < pcm->gain_ramp_to)) {
+            pcm->gain_cur = pcm->gain_ramp_to;
+        }
+    }
+    return pcm->gain_cur >> 15;
+}
+
+void i2s_pcm_convert(i2s_pcm_t *pcm, int bits, int channels, bool dac, uint8_t *buf, uint32_t len)
+{
+    int32_t target = pcm->gain_target;
+    if (target != pcm->gain_ramp_to) {
+        pcm->gain_ramp_to = target;
+        pcm->gain_step = (target - pcm->gain_cur) / I2S_PCM_GAIN_RAMP_FRAMES;
+        if (pcm->gain_step == 0) {
+            pcm->gain_cur = target;
+        }
+    }
+    bool unity = (pcm->gain_cur == I2S_PCM_GAIN_UNITY) && (target == I2S_PCM_GAIN_UNITY);
+
+    if (bits == 16) {
+        if (unity && channels != 1 && !dac) {
+            return;
+        }
+        int16_t *buf16 = (int16_t *)buf;
+        int k = len >> 1;
+        for (int i = 0; i + 1 < k; i += 2) {
+            int32_t g = i2s_pcm_gain_next(pcm);
+            int32_t l = (buf16[i] * g) >> 15;
+            int32_t r = (buf16[i + 1] * g) >> 15;
+            if (channels == 1) {
+                int32_t t = l;
+                l = r;
+                r = t;
+            }
+            if (dac) {
+                //turn signed value into unsigned, expand negative value into positive range
+                l = (l & 0xff00) + 0x8000;
+                r = (r & 0xff00) + 0x8000;
+            }
+            buf16[i] = (int16_t)l;
+            buf16[i + 1] = (int16_t)r;
+        }
+    } else {
+        if (!unity && bits == 32) {
+            int32_t *buf32 = (int32_t *)buf;
+            int k = len >> 2;
+            for (int i = 0; i + 1 < k; i += 2) {
+                int64_t g = i2s_pcm_gain_next(pcm);
+                buf32[i] = (int32_t)((buf32[i] * g) >> 15);
+                buf32[i + 1] = (int32_t)((buf32[i + 1] * g) >> 15);
+            }
+        }
+        if (channels == 1) {
+            i2s_pcm_mono_fix(bits, buf, len);
+        }
+        if (dac) {
+            i2s_pcm_dac_scale(bits, buf, len);
+        }
+    }
+}
+
+static inline void i2s_pcm_vu_set(i2s_pcm_vu_frame_t *frame, int i, int red, int green, int blue)
+{
+    frame->rgb[i][0] = (uint8_t)red;
+    frame->rgb[i][1] = (uint8_t)green;
+    frame->rgb[i][2] = (uint8_t)blue;
+    frame->set_mask |= 1 << i;
+}
+
+void i2s_pcm_vu_analyze(i2s_pcm_vu_t *vu, const uint8_t *buf, int len, i2s_pcm_vu_frame_t *frame)
+{
+    int volumel = 0;
+
+    frame->set_mask = 0;
+    frame->beat = false;
+
+    // Coarse envelope of the high byte of every 64th sample
+    for (int i = 1; i < len; i += 128) {
+        uint8_t datal = buf[i];
+        if (datal < 128) {
+            if (datal > volumel) {
+                volumel = datal;
+            } else {
+                volumel--;
+            }
+        }
+    }
+    frame->level = (uint8_t)(volumel > 0 ? volumel : 0);
+
+    if (vu->terminal) {
+        printf("\r\n\033[92m");
+    }
+    if (volumel > vu->maxvolume) {
+        vu->reise = 1;
+        vu->peak = 0;
+        vu->maxvolume = volumel;
+    } else {
+        if (vu->reise) {
+            frame->beat = true;
+            vu->peak = 96;
+        }
+        vu->reise = 0;
+        vu->maxvolume = vu->maxvolume - 1;
+    }
+    int momvol = vu->maxvolume;
+    vu->peak--;
+    for (int i = 0; i < I2S_PCM_VU_LEDS; i++) {
+        if (vu->simple) {
+            vu->peak = 0;
+        }
+        if (vu->peak > 0) {
+            vu->peak--;
+            if (vu->maxvolume > 113) {
+                i2s_pcm_vu_set(frame, i, 255, 255, 255);
+                vu->peak -= 2;
+            } else if (vu->peak & 1) {
+                i2s_pcm_vu_set(frame, i, 0, vu->peak * 2, vu->maxvolume * 2);
+            } else {
+                i2s_pcm_vu_set(frame, i, 0, vu->maxvolume * 2, vu->peak * 2);
+            }
+        } else {
+            if (vu->terminal && i == 6) {
+                printf("\033[91m");
+            }
+            if (volumel > (i * 16)) {
+                if (vu->simple) {
+                    if (i > 5) {
+                        i2s_pcm_vu_set(frame, i, 0, 200, 0);
+                    } else {
+                        i2s_pcm_vu_set(frame, i, 200, 0, 0);
+                    }
+                } else if (i > 2) {
+                    i2s_pcm_vu_set(frame, i, 200, 0, 0);
+                    i2s_pcm_vu_set(frame, 7 - i, 200, 0, 0);
+                }
+                if (vu->terminal) {
+                    printf("===");
+                }
+            } else if ((momvol / 16 + 1) == i) {
+                if (vu->terminal) {
+                    printf("\033[93m |||");
+                }
+            } else if (vu->terminal) {
+                printf("   ");
+            }
+        }
+    }
+}
+
+int64_t i2s_pcm_playout_us(i2s_pcm_clock_t *clock, int64_t now_us, int64_t byte_pos,
+                           int frame_bytes, int rate, int depth_frames)
+{
+    if (frame_bytes <= 0 || rate <= 0) {
+        return now_us;
+    }
+    int64_t written = byte_pos / frame_bytes;
+    int64_t queued = 0;
+
+    if (clock->valid) {
+        int64_t played = clock->anchor_frame + (now_us - clock->anchor_us) * rate / 1000000;
+        queued = written - played;
+    }
+    if (!clock->valid || queued < 0) {
+        // Nothing queued, the next frame goes out now
+        queued = 0;
+        clock->anchor_frame = written;
+        clock->anchor_us = now_us;
+        clock->valid = true;
+    } else if (queued > depth_frames) {
+        queued = depth_frames;
+        clock->anchor_frame = written - depth_frames;
+        clock->anchor_us = now_us;
+    }
+    return now_us + queued * 1000000 / rate;
+}
@@ -28,6 +28,8 @@
 #include "driver/i2s.h"
 #include "audio_common.h"
 #include "audio_error.h"
+#include "audio_element.h"
+#include "i2s_stream_pcm.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,11 +53,34 @@ typedef struct {
     bool                    uninstall_drv;      /*!< whether uninstall the i2s driver when stream destroyed*/
 } i2s_stream_cfg_t;
 
+/**
+ * @brief      In-place processing callback run by the I2S writer on every buffer
+ *
+ * @param      buf      PCM data as received from the previous element, modified in place
+ * @param      len      Length of the data in bytes
+ * @param      info     Current sample rate, bits and channels of the stream
+ * @param      ctx      The context given to i2s_stream_add_process_cb
+ *
+ * @return     ESP_OK, the return value is currently not used by the stream
+ */
+typedef int (*i2s_stream_process_cb_t)(uint8_t *buf, int len, audio_element_info_t *info, void *ctx);
+
+/**
+ * @brief      Time spent in the process callbacks, see i2s_stream_get_chain_stats
+ */
+typedef struct {
+    uint32_t                buffers;            /*!< Buffers passed through the chain */
+    uint64_t                bytes;              /*!< Bytes passed through the chain */
+    uint64_t                time_us;            /*!< Total time spent in all callbacks */
+} i2s_stream_chain_stats_t;
+
+#define I2S_STREAM_MAX_PROCESS_CB       (4)
 #define I2S_STREAM_TASK_STACK           (3072+512)
 #define I2S_STREAM_BUF_SIZE             (2048)
 #define I2S_STREAM_TASK_PRIO            (23)
 #define I2S_STREAM_TASK_CORE            (0)
 #define I2S_STREAM_RINGBUFFER_SIZE      (8 * 1024)
+#define I2S_STREAM_GAIN_MIN_DB          I2S_PCM_GAIN_MIN_DB
 
 #define I2S_STREAM_CFG_DEFAULT() {                                              \
     .type = AUDIO_STREAM_WRITER,                                                \
@@ -156,6 +181,77 @@ esp_err_t i2s_alc_volume_set(audio_element_handle_t i2s_stream, int volume);
  */
 esp_err_t i2s_alc_volume_get(audio_element_handle_t i2s_stream, int* volume);
 
+/**
+ * @brief      Add an in-place processing callback (equalizer, ALC, metering...) to an I2S writer.
+ *             Callbacks run in the I2S task in the order they were added, on the same buffer,
+ *             so a chain of them costs no extra element task, ringbuffer or copy.
+ *
+ * @note       Callbacks must be added before the pipeline is started.
+ *
+ * @param[in]  i2s_stream   The i2s element handle
+ * @param[in]  cb           The callback
+ * @param[in]  ctx          User context passed to the callback
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_INVALID_STATE if the stream is already open
+ *     - ESP_ERR_NO_MEM if I2S_STREAM_MAX_PROCESS_CB callbacks are already registered
+ */
+esp_err_t i2s_stream_add_process_cb(audio_element_handle_t i2s_stream, i2s_stream_process_cb_t cb, void *ctx);
+
+/**
+ * @brief      Get the time spent in the process callbacks
+ *
+ * @param[in]  i2s_stream   The i2s element handle
+ * @param[out] stats        The statistics
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t i2s_stream_get_chain_stats(audio_element_handle_t i2s_stream, i2s_stream_chain_stats_t *stats);
+
+/**
+ * @brief      Set the digital gain applied while converting data for I2S output
+ *             The gain ramps linearly to the new value over a few milliseconds,
+ *             so it can be changed at any rate without zipper noise.
+ *
+ * @param[in]  i2s_stream   The i2s element handle
+ * @param[in]  gain_db      Gain in dB, 0 is unity. Positive values are clamped to 0,
+ *                          values at or below I2S_STREAM_GAIN_MIN_DB mute the output.
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t i2s_stream_set_gain_db(audio_element_handle_t i2s_stream, float gain_db);
+
+/**
+ * @brief      Get the underrun statistics of an I2S writer stream
+ *
+ * @param[in]  i2s_stream   The i2s element handle
+ * @param[out] stats        The statistics collected since init or the last reset,
+ *                          up to the last buffer the i2s task has taken in
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t i2s_stream_get_underrun_stats(audio_element_handle_t i2s_stream, i2s_stream_underrun_stats_t *stats);
+
+/**
+ * @brief      Reset the underrun statistics of an I2S writer stream.
+ *             The i2s task clears its counters when it takes in the next buffer.
+ *
+ * @param[in]  i2s_stream   The i2s element handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t i2s_stream_reset_underrun_stats(audio_element_handle_t i2s_stream);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,165 @@
+/*
+ * Per-buffer PCM processing of the I2S writer stream: underrun concealment,
+ * digital gain, mono fix, built-in DAC scaling, the LED VU meter analysis
+ * and the playout clock that tells when a buffer will be heard.
+ *
+ * This module has no ESP-IDF or FreeRTOS dependency so that it can be built
+ * and benchmarked on the host, see test/host.
+ */
+
+#ifndef _I2S_STREAM_PCM_H_
+#define _I2S_STREAM_PCM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define I2S_PCM_FADE_FRAMES         (64)
+#define I2S_PCM_GAIN_UNITY          (1 << 30)   // Q30
+#define I2S_PCM_GAIN_RAMP_FRAMES    (256)
+#define I2S_PCM_GAIN_MIN_DB         (-90)
+#define I2S_PCM_VU_LEDS             (8)
+
+/**
+ * @brief      I2S Stream underrun statistics, counted in audio frames
+ */
+typedef struct {
+    uint32_t                underrun_count;     /*!< Number of times the input ran dry while playing */
+    uint64_t                silent_frames;      /*!< Total frames of concealment written to I2S */
+    uint32_t                longest_gap_frames; /*!< Longest single run of concealment */
+} i2s_stream_underrun_stats_t;
+
+/**
+ * @brief      State of the LED VU meter / beat detector
+ */
+typedef struct {
+    bool                    simple;             /*!< Classic VU meter instead of beat lights */
+    bool                    terminal;           /*!< Also draw the meter on stdout */
+    int                     reise;
+    int                     maxvolume;
+    int                     peak;
+} i2s_pcm_vu_t;
+
+/**
+ * @brief      LEDs to update for one analyzed buffer.
+ *             Only the pixels with their bit set in `set_mask` were written by the meter.
+ */
+typedef struct {
+    uint8_t                 rgb[I2S_PCM_VU_LEDS][3];
+    uint8_t                 set_mask;
+    bool                    beat;               /*!< A beat was detected in this buffer */
+    uint8_t                 level;              /*!< Envelope of this buffer, 0..127 */
+} i2s_pcm_vu_frame_t;
+
+/**
+ * @brief      Estimate of what the I2S DMA is playing, anchored on the written byte position
+ */
+typedef struct {
+    bool                    valid;              /*!< Anchored, false after open or an underrun */
+    int64_t                 anchor_us;          /*!< Time at which anchor_frame is played */
+    int64_t                 anchor_frame;       /*!< Frame position of the stream */
+} i2s_pcm_clock_t;
+
+typedef struct {
+    bool                    in_underrun;        /*!< Last buffer was concealment, next real one fades in */
+    bool                    has_played;         /*!< Real data was written since open, gaps before that are not underruns */
+    int16_t                 last_frame[2];      /*!< Tail of the last real buffer, fade-out starts from here */
+    uint32_t                gap_frames;         /*!< Length of the current underrun */
+    i2s_stream_underrun_stats_t stats;
+    volatile int32_t        gain_target;        /*!< Q30, written by i2s_pcm_set_gain_db */
+    int32_t                 gain_ramp_to;       /*!< Q30, target the current ramp was computed for */
+    int32_t                 gain_cur;           /*!< Q30 */
+    int32_t                 gain_step;          /*!< Q30 per frame */
+    i2s_pcm_vu_t            vu;
+    i2s_pcm_clock_t         clock;
+} i2s_pcm_t;
+
+/**
+ * @brief      Reset the state to unity gain, no underrun history
+ */
+void i2s_pcm_init(i2s_pcm_t *pcm);
+
+/**
+ * @brief      Swap the channels of each frame, for mono output through I2S
+ *
+ * @return     0 on success, -1 if `bits` is not 16 or 32
+ */
+int i2s_pcm_mono_fix(int bits, uint8_t *buf, uint32_t len);
+
+/**
+ * @brief      Scale data to 16bit/32bit for I2S DMA output.
+ *             DAC can only output 8bit data value.
+ *             I2S DMA will still send 16bit or 32bit data, the highest 8bit contains DAC data.
+ *
+ * @return     0 on success, -1 if `bits` is not 16 or 32
+ */
+int i2s_pcm_dac_scale(int bits, uint8_t *buf, uint32_t len);
+
+/**
+ * @brief      Fill `len` bytes of signed PCM with underrun concealment.
+ *             The first buffer of a gap ramps the last played frame down to zero
+ *             instead of stepping to silence, everything after it is plain silence.
+ *             Only 16bit data is ramped, other widths get silence straight away.
+ *             The gap is accounted in the statistics once real data has been played.
+ */
+void i2s_pcm_conceal(i2s_pcm_t *pcm, int bits, int channels, uint8_t *buf, int len);
+
+/**
+ * @brief      Ramp the first frames of a buffer up from zero after an underrun,
+ *             and remember the last frame in case the next read underruns.
+ */
+void i2s_pcm_fade_in(i2s_pcm_t *pcm, int bits, int channels, uint8_t *buf, int len);
+
+/**
+ * @brief      Set the target of the digital gain, in dB. Clamped to 0 dB, values
+ *             at or below I2S_PCM_GAIN_MIN_DB mute. Safe to call from another task.
+ */
+void i2s_pcm_set_gain_db(i2s_pcm_t *pcm, float gain_db);
+
+/**
+ * @brief      Convert a buffer to the I2S output format in a single pass.
+ *             Applies the digital gain with a per-frame linear ramp towards the last target,
+ *             then the mono channel swap and the built-in DAC scaling.
+ *             16bit data is handled in one loop, 32bit data falls back to the separate helpers.
+ */
+void i2s_pcm_convert(i2s_pcm_t *pcm, int bits, int channels, bool dac, uint8_t *buf, uint32_t len);
+
+/**
+ * @brief      Run the VU meter / beat detector over a buffer
+ *
+ * @param      vu       Meter state
+ * @param      buf      PCM data
+ * @param      len      Size of the buffer the element was given, in bytes
+ * @param[out] frame    LEDs to update
+ */
+void i2s_pcm_vu_analyze(i2s_pcm_vu_t *vu, const uint8_t *buf, int len, i2s_pcm_vu_frame_t *frame);
+
+/**
+ * @brief      Expected time the next frame written to I2S is heard.
+ *
+ *             The frames between the write position and what the clock says is playing
+ *             are still queued in DMA, at most `depth_frames` of them. With an empty queue
+ *             (start, underrun, position reset) the clock is anchored at `now_us`, with
+ *             more than the depth queued the writer was blocked and the clock is late, so
+ *             it is pulled back to a full queue.
+ *
+ * @param      clock         Playout clock
+ * @param      now_us        Current time
+ * @param      byte_pos      Bytes written to I2S so far
+ * @param      frame_bytes   Bytes per frame, all channels
+ * @param      rate          Sample rate
+ * @param      depth_frames  DMA queue length, dma_buf_count * dma_buf_len
+ *
+ * @return     Playout time of the frame at `byte_pos`, in the time base of `now_us`
+ */
+int64_t i2s_pcm_playout_us(i2s_pcm_clock_t *clock, int64_t now_us, int64_t byte_pos,
+                           int frame_bytes, int rate, int depth_frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "host_element.h"
+
+int host_element_input(host_element_t *el, char *buffer, int len)
+{
+    int n = el->reads++;
+    if (el->underrun_every > 0 && (n % el->underrun_every) >= el->underrun_every - el->underrun_reads) {
+        return HOST_IO_TIMEOUT;
+    }
+    int remain = el->in_len - el->in_pos;
+    if (remain <= 0) {
+        return 0;
+    }
+    if (len > remain) {
+        len = remain;
+    }
+    memcpy(buffer, el->in + el->in_pos, len);
+    el->in_pos += len;
+    return len;
+}
+
+int host_element_output(host_element_t *el, const char *buffer, int len)
+{
+    if (el->out == NULL) {
+        return len;
+    }
+    if (el->out_len + len > el->out_size) {
+        len = el->out_size - el->out_len;
+    }
+    memcpy(el->out + el->out_len, buffer, len);
+    el->out_len += len;
+    return len;
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t rd16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static int host_wav_parse(const uint8_t *file, long size, host_element_info_t *info, uint8_t **data, int *len)
+{
+    if (size < 12 || memcmp(file, "RIFF", 4) || memcmp(file + 8, "WAVE", 4)) {
+        return -1;
+    }
+    long pos = 12;
+    int have_fmt = 0;
+    while (pos + 8 <= size) {
+        uint32_t id_len = rd32(file + pos + 4);
+        const uint8_t *body = file + pos + 8;
+        if (pos + 8 + id_len > size) {
+            id_len = size - pos - 8;
+        }
+        if (!memcmp(file + pos, "fmt ", 4) && id_len >= 16) {
+            if (rd16(body) != 1) {
+                return -1;  // not PCM
+            }
+            info->channels = rd16(body + 2);
+            info->sample_rates = rd32(body + 4);
+            info->bits = rd16(body + 14);
+            have_fmt = 1;
+        } else if (!memcmp(file + pos, "data", 4) && have_fmt) {
+            *data = malloc(id_len);
+            memcpy(*data, body, id_len);
+            *len = id_len;
+            return 0;
+        }
+        pos += 8 + id_len + (id_len & 1);
+    }
+    return -1;
+}
+
+int host_wav_load(const char *path, host_element_info_t *info, uint8_t **data, int *len)
+{
+    if (path == NULL) {
+        // 10 s of 44.1 kHz stereo: two tones with a 120 BPM amplitude envelope plus noise
+        int frames = 44100 * 10;
+        int16_t *pcm = malloc(frames * 2 * sizeof(int16_t));
+        uint32_t seed = 1;
+        for (int n = 0; n < frames; n++) {
+            double t = n / 44100.0;
+            double beat = exp(-8.0 * fmod(t, 0.5));
+            seed = seed * 1664525 + 1013904223;
+            double noise = ((int32_t)seed >> 16) / 32768.0;
+            double l = 0.6 * beat * sin(2 * M_PI * 60 * t) + 0.2 * sin(2 * M_PI * 440 * t) + 0.05 * noise;
+            double r = 0.6 * beat * sin(2 * M_PI * 62 * t) + 0.2 * sin(2 * M_PI * 660 * t) + 0.05 * noise;
+            pcm[2 * n] = (int16_t)(l * 32000);
+            pcm[2 * n + 1] = (int16_t)(r * 32000);
+        }
+        info->sample_rates = 44100;
+        info->channels = 2;
+        info->bits = 16;
+        *data = (uint8_t *)pcm;
+        *len = frames * 2 * sizeof(int16_t);
+        return 0;
+    }
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *file = malloc(size);
+    if (fread(file, 1, size, f) != (size_t)size) {
+        fclose(f);
+        free(file);
+        return -1;
+    }
+    fclose(f);
+    int ret = host_wav_parse(file, size, info, data, len);
+    free(file);
+    if (ret != 0 || info->bits != 16) {
+        fprintf(stderr, "%s: only 16bit PCM WAV files are supported\n", path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * Minimal stand-in for audio_element on the host: feeds PCM from memory in
+ * element-sized reads and can inject input timeouts, collects what is written out.
+ */
+
+#ifndef _HOST_ELEMENT_H_
+#define _HOST_ELEMENT_H_
+
+#include <stdint.h>
+
+#define HOST_IO_TIMEOUT     (-3)    // same value as AEL_IO_TIMEOUT
+
+typedef struct {
+    int             sample_rates;
+    int             channels;
+    int             bits;
+} host_element_info_t;
+
+typedef struct {
+    host_element_info_t info;
+    const uint8_t   *in;
+    int             in_len;
+    int             in_pos;
+    int             underrun_every;     /*!< Inject a timeout every N reads, 0 for none */
+    int             underrun_reads;     /*!< Length of each injected gap, in reads */
+    int             reads;
+    uint8_t         *out;
+    int             out_len;
+    int             out_size;
+} host_element_t;
+
+int host_element_input(host_element_t *el, char *buffer, int len);
+int host_element_output(host_element_t *el, const char *buffer, int len);
+
+/**
+ * @brief      Load a 16bit PCM WAV file, or synthesize a test signal when `path` is NULL
+ *
+ * @return     0 on success
+ */
+int host_wav_load(const char *path, host_element_info_t *info, uint8_t **data, int *len);
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * Host bench for the I2S writer PCM processing.
+ *
+ * Streams WAV files (or a synthetic signal) through i2s_stream_pcm.c the way
+ * _i2s_process() does, checks the output and the VU meter LEDs are bit-exact
+ * against the previous inline implementation, and prints the time per buffer
+ * of each stage.
+ *
+ * Usage: i2s_pcm_bench [file.wav ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "i2s_stream_pcm.h"
+#include "i2s_pcm_reference.h"
+#include "host_element.h"
+
+#define BENCH_BUF_SIZE      (2048)  // I2S_STREAM_BUF_SIZE
+#define BENCH_MIN_NS        (200 * 1000 * 1000LL)
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int check_mode(const host_element_info_t *info, const uint8_t *data, int len, int channels, int dac, int simple)
+{
+    host_element_t mod = { .info = *info, .in = data, .in_len = len };
+    host_element_t ref = { .info = *info, .in = data, .in_len = len };
+    mod.info.channels = ref.info.channels = channels;
+    mod.out = malloc(len);
+    ref.out = malloc(len);
+    mod.out_size = ref.out_size = len;
+
+    i2s_pcm_t pcm = { .vu = { .simple = simple } };
+    i2s_pcm_init(&pcm);
+    pcm.in_underrun = false;    // the stream fades in on open, the old code did not
+    ref_vu_t ref_vu_st = {0};
+    char buf_mod[BENCH_BUF_SIZE], buf_ref[BENCH_BUF_SIZE];
+    int buffers = 0, led_mismatch = 0;
+
+    for (;;) {
+        int r_mod = host_element_input(&mod, buf_mod, BENCH_BUF_SIZE);
+        int r_ref = host_element_input(&ref, buf_ref, BENCH_BUF_SIZE);
+        if (r_mod <= 0 || r_ref <= 0) {
+            break;
+        }
+        i2s_pcm_vu_frame_t f_mod, f_ref;
+
+        i2s_pcm_fade_in(&pcm, mod.info.bits, channels, (uint8_t *)buf_mod, r_mod);
+        i2s_pcm_vu_analyze(&pcm.vu, (uint8_t *)buf_mod, BENCH_BUF_SIZE, &f_mod);
+        i2s_pcm_convert(&pcm, mod.info.bits, channels, dac, (uint8_t *)buf_mod, r_mod);
+        host_element_output(&mod, buf_mod, r_mod);
+
+        ref_vu(&ref_vu_st, simple, buf_ref, BENCH_BUF_SIZE, &f_ref);
+        if (channels == 1) {
+            ref_mono_fix(ref.info.bits, (uint8_t *)buf_ref, r_ref);
+        }
+        if (dac) {
+            ref_dac_data_scale(ref.info.bits, (uint8_t *)buf_ref, r_ref);
+        }
+        host_element_output(&ref, buf_ref, r_ref);
+
+        if (f_mod.set_mask != f_ref.set_mask || f_mod.beat != f_ref.beat) {
+            led_mismatch++;
+        } else {
+            for (int i = 0; i < I2S_PCM_VU_LEDS; i++) {
+                if ((f_mod.set_mask & (1 << i)) && memcmp(f_mod.rgb[i], f_ref.rgb[i], 3)) {
+                    led_mismatch++;
+                    break;
+                }
+            }
+        }
+        buffers++;
+    }
+    int pcm_ok = mod.out_len == ref.out_len && !memcmp(mod.out, ref.out, mod.out_len);
+    printf("  verify ch=%d dac=%d vu=%-6s %5d buffers: pcm %s, leds %s\n",
+           channels, dac, simple ? "simple" : "beat", buffers,
+           pcm_ok ? "exact" : "MISMATCH", led_mismatch ? "MISMATCH" : "exact");
+    free(mod.out);
+    free(ref.out);
+    return pcm_ok && !led_mismatch ? 0 : 1;
+}
+
+static void run_underruns(const host_element_info_t *info, const uint8_t *data, int len)
+{
+    host_element_t el = { .info = *info, .in = data, .in_len = len, .underrun_every = 50, .underrun_reads = 2 };
+    i2s_pcm_t pcm = {0};
+    i2s_pcm_init(&pcm);
+    char buf[BENCH_BUF_SIZE];
+    for (;;) {
+        int r = host_element_input(&el, buf, BENCH_BUF_SIZE);
+        if (r == HOST_IO_TIMEOUT) {
+            i2s_pcm_conceal(&pcm, info->bits, info->channels, (uint8_t *)buf, BENCH_BUF_SIZE);
+        } else if (r > 0) {
+            i2s_pcm_fade_in(&pcm, info->bits, info->channels, (uint8_t *)buf, r);
+        } else {
+            break;
+        }
+    }
+    printf("  underruns injected every 50 reads: count %u, silent frames %llu, longest gap %u frames\n",
+           pcm.stats.underrun_count, (unsigned long long)pcm.stats.silent_frames, pcm.stats.longest_gap_frames);
+}
+
+typedef enum {
+    STAGE_VU,
+    STAGE_REF_VU,
+    STAGE_MONO_FIX,
+    STAGE_DAC_SCALE,
+    STAGE_REF_MONO_DAC,
+    STAGE_CONVERT_UNITY,
+    STAGE_CONVERT_GAIN,
+    STAGE_CONVERT_MONO_DAC,
+    STAGE_CONCEAL,
+    STAGE_FADE_IN,
+    STAGE_MAX,
+} stage_t;
+
+static const char *stage_name[STAGE_MAX] = {
+    "vu meter",
+    "vu meter (old inline)",
+    "mono fix",
+    "dac scale",
+    "mono fix + dac scale (old)",
+    "convert, unity stereo",
+    "convert, ramping gain",
+    "convert, mono + dac (fused)",
+    "conceal",
+    "fade in",
+};
+
+static void run_stage(stage_t stage, i2s_pcm_t *pcm, ref_vu_t *ref_st, const host_element_info_t *info, uint8_t *buf, int len)
+{
+    i2s_pcm_vu_frame_t frame;
+    switch (stage) {
+        case STAGE_VU:
+            i2s_pcm_vu_analyze(&pcm->vu, buf, len, &frame);
+            break;
+        case STAGE_REF_VU:
+            ref_vu(ref_st, 0, (char *)buf, len, &frame);
+            break;
+        case STAGE_MONO_FIX:
+            i2s_pcm_mono_fix(info->bits, buf, len);
+            break;
+        case STAGE_DAC_SCALE:
+            i2s_pcm_dac_scale(info->bits, buf, len);
+            break;
+        case STAGE_REF_MONO_DAC:
+            ref_mono_fix(info->bits, buf, len);
+            ref_dac_data_scale(info->bits, buf, len);
+            break;
+        case STAGE_CONVERT_UNITY:
+            i2s_pcm_convert(pcm, info->bits, 2, false, buf, len);
+            break;
+        case STAGE_CONVERT_GAIN:
+            // Flip the target every buffer so the ramp never settles
+            i2s_pcm_set_gain_db(pcm, pcm->gain_target == I2S_PCM_GAIN_UNITY ? -6.0f : 0.0f);
+            i2s_pcm_convert(pcm, info->bits, 2, false, buf, len);
+            break;
+        case STAGE_CONVERT_MONO_DAC:
+            i2s_pcm_convert(pcm, info->bits, 1, true, buf, len);
+            break;
+        case STAGE_CONCEAL:
+            pcm->in_underrun = false;
+            i2s_pcm_conceal(pcm, info->bits, info->channels, buf, len);
+            break;
+        case STAGE_FADE_IN:
+            pcm->in_underrun = true;
+            i2s_pcm_fade_in(pcm, info->bits, info->channels, buf, len);
+            break;
+        default:
+            break;
+    }
+}
+
+static void run_timing(const host_element_info_t *info, const uint8_t *data, int len)
+{
+    int buffers = len / BENCH_BUF_SIZE;
+    uint8_t buf[BENCH_BUF_SIZE];
+    if (buffers == 0) {
+        return;
+    }
+    for (int stage = 0; stage < STAGE_MAX; stage++) {
+        i2s_pcm_t pcm = {0};
+        i2s_pcm_init(&pcm);
+        ref_vu_t ref_st = {0};
+        int64_t total = 0;
+        long count = 0;
+        while (total < BENCH_MIN_NS) {
+            for (int b = 0; b < buffers; b++) {
+                memcpy(buf, data + b * BENCH_BUF_SIZE, BENCH_BUF_SIZE);
+                int64_t t0 = now_ns();
+                run_stage(stage, &pcm, &ref_st, info, buf, BENCH_BUF_SIZE);
+                total += now_ns() - t0;
+                count++;
+            }
+        }
+        printf("  %-30s %8.1f ns/buffer\n", stage_name[stage], (double)total / count);
+    }
+}
+
+static int bench_one(const char *path)
+{
+    host_element_info_t info;
+    uint8_t *data = NULL;
+    int len = 0;
+    if (host_wav_load(path, &info, &data, &len) != 0) {
+        return 1;
+    }
+    printf("%s: %d Hz, %d ch, %d bits, %d bytes, %d byte buffers\n",
+           path ? path : "synthetic", info.sample_rates, info.channels, info.bits, len, BENCH_BUF_SIZE);
+    int fail = 0;
+    for (int simple = 0; simple < 2; simple++) {
+        for (int ch = 2; ch >= 1; ch--) {
+            for (int dac = 0; dac < 2; dac++) {
+                fail |= check_mode(&info, data, len, ch, dac, simple);
+            }
+        }
+    }
+    run_underruns(&info, data, len);
+    run_timing(&info, data, len);
+    free(data);
+    return fail;
+}
+
+/*
+ * Playout clock of a 44.1 kHz stereo stream with a 900 frame DMA queue:
+ * anchored on the first write, capped at the DMA depth while the writer is
+ * blocked, re-anchored after the DMA ran dry.
+ */
+static int check_playout_clock(void)
+{
+    const int rate = 44100, frame_bytes = 4, depth = 900;
+    i2s_pcm_clock_t clock = {0};
+    int64_t depth_us = (int64_t)depth * 1000000 / rate;
+    int fail = 0;
+
+    // Start: empty DMA, heard now
+    fail |= i2s_pcm_playout_us(&clock, 1000, 0, frame_bytes, rate, depth) != 1000;
+    // The DMA was filled instantly, the next frame waits for all of it
+    fail |= i2s_pcm_playout_us(&clock, 1000, depth * frame_bytes, frame_bytes, rate, depth) != 1000 + depth_us;
+    // Writer running ahead of the clock is capped at a full queue
+    fail |= i2s_pcm_playout_us(&clock, 2000, 10 * depth * frame_bytes, frame_bytes, rate, depth) != 2000 + depth_us;
+    // A second later with nothing written the DMA ran dry, heard straight away again
+    fail |= i2s_pcm_playout_us(&clock, 1002000, 11 * depth * frame_bytes, frame_bytes, rate, depth) != 1002000;
+    // Position reset by a new stream
+    fail |= i2s_pcm_playout_us(&clock, 1003000, 0, frame_bytes, rate, depth) != 1003000;
+
+    printf("playout clock: %s\n", fail ? "FAIL" : "ok");
+    return fail;
+}
+
+int main(int argc, char **argv)
+{
+    int fail = 0;
+    fail |= check_playout_clock();
+    if (argc < 2) {
+        fail |= bench_one(NULL);
+    }
+    for (int i = 1; i < argc; i++) {
+        fail |= bench_one(argv[i]);
+    }
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
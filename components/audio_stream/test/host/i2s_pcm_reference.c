@@ -0,0 +1,118 @@
+/*
+ * The per-buffer processing of _i2s_process() as it was before it moved to
+ * i2s_stream_pcm.c, kept verbatim (LED and GPIO calls recorded into a frame)
+ * so the bench can check the module stays bit-exact.
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#include "i2s_stream_pcm.h"
+#include "i2s_pcm_reference.h"
+
+void ref_mono_fix(int bits, uint8_t *sbuff, uint32_t len)
+{
+    if (bits == 16) {
+        int16_t *temp_buf = (int16_t *)sbuff;
+        int16_t temp_box;
+        int k = len >> 1;
+        for (int i = 0; i < k; i += 2) {
+            temp_box = temp_buf[i];
+            temp_buf[i] = temp_buf[i + 1];
+            temp_buf[i + 1] = temp_box;
+        }
+    }
+}
+
+void ref_dac_data_scale(int bits, uint8_t *sBuff, uint32_t len)
+{
+    if (bits == 16) {
+        short *buf16 = (short *)sBuff;
+        int k = len >> 1;
+        for (int i = 0; i < k; i++) {
+            buf16[i] &= 0xff00;
+            buf16[i] += 0x8000;
+        }
+    }
+}
+
+static void led_strip_set_pixel_rgb(i2s_pcm_vu_frame_t *frame, int i, uint8_t red, uint8_t green, uint8_t blue)
+{
+    frame->rgb[i][0] = red;
+    frame->rgb[i][1] = green;
+    frame->rgb[i][2] = blue;
+    frame->set_mask |= 1 << i;
+}
+
+void ref_vu(ref_vu_t *st, int simple, const char *in_buffer, int in_len, i2s_pcm_vu_frame_t *frame)
+{
+    int i = 1;
+    int volumel = 0;
+
+    frame->set_mask = 0;
+    frame->beat = false;
+
+   while (i < in_len)
+   {
+   uint8_t datal = in_buffer[i] ;
+
+	     i+=128;
+
+	   if (datal < 128)
+	   {
+	   if (datal > volumel) volumel = datal;
+	   else volumel--;
+	   }
+
+   }
+
+   if (volumel > st->maxvolume) {
+	   st->reise = 1;
+	   st->peak = 0;
+	   st->maxvolume = volumel;
+   }
+   else {
+	   if (st->reise) {
+		  frame->beat = true;
+		  st->peak = 96;
+	   }
+	   st->reise = 0;
+	   st->maxvolume = st->maxvolume - 1;
+   }
+   st->peak--;
+    for (int i = 0;i<8;i++)
+   {
+	 if (simple) st->peak = 0;
+	 if (st->peak > 0)  {
+		 st->peak--;
+		 if (st->maxvolume > 113)
+		 {
+			 led_strip_set_pixel_rgb(frame, i, 255, 255,255);
+			 st->peak -= 2;
+		 }
+		 else
+		 {
+		 if (st->peak & 1)
+		 led_strip_set_pixel_rgb(frame, i, 0, st->peak * 2 , st->maxvolume * 2);
+		 else
+		 led_strip_set_pixel_rgb(frame, i,  0, st->maxvolume * 2, st->peak * 2);
+		 }
+	  }
+	 else
+	 {
+     if (volumel > (i*16)) {
+		 if ((simple && i > 5) || (!simple && i > 2))
+		 {
+			if (simple) {
+			led_strip_set_pixel_rgb(frame, i, 0, 200, 0);
+			} else {
+			led_strip_set_pixel_rgb(frame, i, 200, 0, 0);
+			led_strip_set_pixel_rgb(frame, 7-i, 200, 0, 0);
+			}
+		 }
+		 else if (simple)
+		 			led_strip_set_pixel_rgb(frame, i, 200, 0, 0);
+	}
+   }
+}
+}
@@ -0,0 +1,16 @@
+#ifndef _I2S_PCM_REFERENCE_H_
+#define _I2S_PCM_REFERENCE_H_
+
+#include "i2s_stream_pcm.h"
+
+typedef struct {
+    int reise;
+    int maxvolume;
+    int peak;
+} ref_vu_t;
+
+void ref_mono_fix(int bits, uint8_t *sbuff, uint32_t len);
+void ref_dac_data_scale(int bits, uint8_t *sBuff, uint32_t len);
+void ref_vu(ref_vu_t *st, int simple, const char *in_buffer, int in_len, i2s_pcm_vu_frame_t *frame);
+
+#endif
@@ -0,0 +1,141 @@
+/*  ---------------------------------------------------------------------------
+    File: led_effect.h
+
+    Description:
+    Audio driven effects on top of led_strip. Effects render in 8.8 fixed
+    point into a private frame, which goes through one combined gamma and
+    brightness table on its way into the led strip back buffer. The engine
+    runs in its own task at a fixed frame rate and is the only writer of
+    its led strip.
+    ------------------------------------------------------------------------ */
+
+#ifndef LED_EFFECT_H
+#define LED_EFFECT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "led_strip.h"
+
+#define LED_EFFECT_DEFAULT_FPS (50U)
+#define LED_EFFECT_PALETTE_SIZE (16U)
+#define LED_EFFECT_AUDIO_QUEUE_LEN (16U)
+
+/**
+ * 8.8 fixed point, 0x0100 is 1.0
+ */
+typedef uint16_t led_fix8_t;
+
+#define LED_FIX8_ONE ((led_fix8_t)0x0100)
+#define LED_FIX8(x) ((led_fix8_t)((x) * 256))
+
+enum led_effect_mode_t {
+    LED_EFFECT_VU = 0,      // Level bar colored along the palette
+    LED_EFFECT_PALETTE = 1, // Palette scrolling through the strip, brightness follows the level
+    LED_EFFECT_CHASE = 2,   // Dot with a fading tail, speed follows the level
+    LED_EFFECT_PULSE = 3,   // Flash from the center on each beat, next palette color every beat
+
+    LED_EFFECT_MODE_MAX,
+};
+
+/**
+ * Palettes are LED_EFFECT_PALETTE_SIZE colors, blended linearly and wrapping around
+ */
+extern const struct led_color_t led_effect_palette_rainbow[LED_EFFECT_PALETTE_SIZE];
+extern const struct led_color_t led_effect_palette_fire[LED_EFFECT_PALETTE_SIZE];
+extern const struct led_color_t led_effect_palette_ocean[LED_EFFECT_PALETTE_SIZE];
+
+/**
+ * One color channel triple in 8.8 fixed point
+ */
+struct led_effect_pixel_t {
+    led_fix8_t red;
+    led_fix8_t green;
+    led_fix8_t blue;
+};
+
+/**
+ * Features of one audio buffer and the time it is heard
+ */
+struct led_effect_audio_t {
+    int64_t present_us; // esp_timer_get_time() time base
+    uint8_t level;
+    bool beat;
+};
+
+struct led_effect_t {
+    struct led_strip_t *led_strip;
+
+    enum led_effect_mode_t mode;
+    const struct led_color_t *palette; // NULL for led_effect_palette_rainbow
+    uint32_t fps;                      // 0 for LED_EFFECT_DEFAULT_FPS
+    uint8_t brightness;                // Global brightness, 255 is full
+    led_fix8_t fade;                   // Tail kept per frame, 0 for 0.875
+
+    /*
+     * Audio features, written by led_effect_feed_audio from the audio task
+     */
+    volatile uint8_t level;
+    volatile uint32_t beats;
+
+    /*
+     * Features waiting for their playout time, queued by led_effect_queue_audio
+     * from the audio task and taken by the effect task on the frame closest to it.
+     * One writer and one reader, no lock.
+     */
+    struct led_effect_audio_t audio_queue[LED_EFFECT_AUDIO_QUEUE_LEN];
+    volatile uint32_t audio_head;    // Written by the audio task
+    volatile uint32_t audio_tail;    // Written by the effect task
+    volatile uint32_t audio_dropped; // Queued while full
+
+    /*
+     * Engine state, owned by the effect task
+     */
+    struct led_effect_pixel_t *frame;
+    uint8_t lut[256];
+    uint8_t lut_brightness;
+    uint32_t beats_seen;
+    uint16_t phase;        // Palette position, LED_EFFECT_PALETTE_SIZE entries over 0x10000
+    uint32_t position;     // Chase head in pixels, 8.8 (strips can be longer than 255)
+    led_fix8_t pulse;
+    TaskHandle_t task_handle;
+};
+
+/**
+ * Allocates the frame and starts the effect task.
+ * The led strip must be initialized first.
+ */
+bool led_effect_init(struct led_effect_t *led_effect);
+
+/**
+ * Hands the features of one analyzed audio buffer to the engine.
+ * level is 0..127, beat is true if a beat started in this buffer.
+ */
+void led_effect_feed_audio(struct led_effect_t *led_effect, uint8_t level, bool beat);
+
+/**
+ * Like led_effect_feed_audio, but the features take effect on the frame
+ * closest to present_us (esp_timer_get_time() time base), e.g. when the
+ * buffer leaves the I2S DMA. Returns false and drops them if the queue is full.
+ */
+bool led_effect_queue_audio(struct led_effect_t *led_effect, uint8_t level, bool beat, int64_t present_us);
+
+bool led_effect_set_mode(struct led_effect_t *led_effect, enum led_effect_mode_t mode);
+
+/**
+ * Global brightness, takes effect on the next frame
+ */
+void led_effect_set_brightness(struct led_effect_t *led_effect, uint8_t brightness);
+
+/**
+ * Renders the next frame into led_effect->frame and returns the strip colors in out,
+ * gamma and brightness applied. Called by the effect task, exposed for testing.
+ */
+void led_effect_render(struct led_effect_t *led_effect, struct led_color_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LED_EFFECT_H
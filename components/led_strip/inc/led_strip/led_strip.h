@@ -18,9 +18,13 @@ extern "C" {
 #include <driver/rmt.h>
 #include <driver/gpio.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include <stddef.h>
 
+#define LED_STRIP_DEFAULT_MAX_FPS (100U)
+#define LED_STRIP_GROUP_MAX_STRIPS (RMT_CHANNEL_MAX)
+
 enum rgb_led_type_t {
     RGB_LED_TYPE_WS2812 = 0,
     RGB_LED_TYPE_SK6812 = 1,
@@ -57,15 +61,48 @@ struct led_strip_t {
     gpio_num_t gpio; // Must be less than GPIO_NUM_33
 
     // Double buffering elements
-    bool showing_buf_1;
     struct led_color_t *led_strip_buf_1;
     struct led_color_t *led_strip_buf_2; 
 
-    SemaphoreHandle_t access_semaphore;
+    /*
+     * Front buffer index (bit 0, 0 for buf_1) and frame counter, written
+     * atomically by led_strip_show. Pixel writes go to the other buffer.
+     */
+    volatile uint32_t published;
+
+    /*
+     * Frames are only sent after led_strip_show, at most max_fps per second.
+     * Frames shown faster than that replace the pending one and count as skipped.
+     */
+    uint32_t max_fps; // 0 uses LED_STRIP_DEFAULT_MAX_FPS
+    TaskHandle_t task_handle;
+    volatile bool frame_pending;
+    volatile uint32_t frames_sent;
+    volatile uint32_t frames_skipped;
+};
+
+/**
+ * Several strips, each on its own RMT channel, sent from one task.
+ * All strips with a new frame are transmitted in parallel.
+ */
+struct led_strip_group_t {
+    struct led_strip_t **strips;
+    uint32_t strip_count; // At most LED_STRIP_GROUP_MAX_STRIPS
+
+    uint32_t max_fps; // 0 uses LED_STRIP_DEFAULT_MAX_FPS, the strips' own max_fps is ignored
+    TaskHandle_t task_handle;
+    volatile uint32_t frames_sent; // Rounds in which at least one strip was sent
 };
 
 bool led_strip_init(struct led_strip_t *led_strip);
 
+/**
+ * Initializes every strip of the group and starts the shared output task.
+ * The strips must not be passed to led_strip_init as well.
+ * Pixel writes and led_strip_show work per strip as usual.
+ */
+bool led_strip_group_init(struct led_strip_group_t *group);
+
 /**
  * Sets the pixel at pixel_num to color.
  */
@@ -83,9 +120,16 @@ bool led_strip_get_pixel_color(struct led_strip_t *led_strip, uint32_t pixel_num
 
 /**
  * Updates the led buffer to be shown using double buffering.
+ * Lock free: pixel writes and led_strip_show must be called from a single task.
  */
 bool led_strip_show(struct led_strip_t *led_strip);
 
+/**
+ * Gets the number of frames sent to the strip and the number of shown frames
+ * that were replaced before they could be sent.
+ */
+bool led_strip_get_frame_stats(struct led_strip_t *led_strip, uint32_t *frames_sent, uint32_t *frames_skipped);
+
 /**
  * Clears the LED strip.
  */
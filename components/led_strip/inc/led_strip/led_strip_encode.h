@@ -0,0 +1,59 @@
+/*  ---------------------------------------------------------------------------
+    File: led_strip_encode.h
+
+    Description:
+    Conversion of led_color_t pixels into RMT items for the supported led types.
+    The encoder expands every color byte through a 256 entry table built once
+    per led type, so encoding a pixel is three copies of eight RMT items.
+    ------------------------------------------------------------------------ */
+
+#ifndef LED_STRIP_ENCODE_H
+#define LED_STRIP_ENCODE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "led_strip/led_strip.h"
+
+#define LED_STRIP_NUM_RMT_ITEMS_PER_LED (24U) // Assumes 24 bit color for each led
+
+/**
+ * RMT items for every possible value of a color byte, MSB first.
+ * 8 KB, allocate it on the heap.
+ */
+struct led_strip_encoder_t {
+    enum rgb_led_type_t rgb_led_type;
+    uint8_t wire_order[3]; // Offset in led_color_t of each byte, in the order they are sent
+    rmt_item32_t byte_items[256][8];
+};
+
+/**
+ * Builds the byte table for rgb_led_type.
+ */
+void led_strip_encoder_init(struct led_strip_encoder_t *encoder, enum rgb_led_type_t rgb_led_type);
+
+/**
+ * Encodes led_strip_length pixels into LED_STRIP_NUM_RMT_ITEMS_PER_LED items each.
+ */
+void led_strip_encode(const struct led_strip_encoder_t *encoder, const struct led_color_t *led_strip_buf,
+                      rmt_item32_t *rmt_items, uint32_t led_strip_length);
+
+/**
+ * Encodes count bytes of the strip in wire order, starting byte_offset bytes into it.
+ * Writes count * 8 items. Used to feed the RMT translator a few bytes at a time.
+ */
+void led_strip_encode_bytes(const struct led_strip_encoder_t *encoder, const struct led_color_t *led_strip_buf,
+                            uint32_t byte_offset, uint32_t count, rmt_item32_t *rmt_items);
+
+/**
+ * Bit by bit encoder, same output as led_strip_encode without the table.
+ */
+void led_strip_encode_bitwise(enum rgb_led_type_t rgb_led_type, const struct led_color_t *led_strip_buf,
+                              rmt_item32_t *rmt_items, uint32_t led_strip_length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LED_STRIP_ENCODE_H
@@ -0,0 +1,407 @@
+/*  ----------------------------------------------------------------------------
+    File: led_effect.c
+
+    Description: Fixed point, audio driven effects for led_strip.
+
+    Every effect renders into an 8.8 fixed point frame, so fades and
+    partially lit pixels keep their fraction between frames. When the frame
+    is handed to the strip, each channel goes through one 256 entry table
+    that combines gamma correction and the global brightness.
+
+    Audio features can be queued with the time they are heard, the effect
+    task applies them on the frame closest to that time so the lights stay
+    in step with the speaker rather than with the decoder.
+    ------------------------------------------------------------------------- */
+
+#include "led_strip/led_effect.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LED_EFFECT_TASK_SIZE            (2048)
+#define LED_EFFECT_TASK_PRIORITY        (5)
+
+#define LED_EFFECT_DEFAULT_FADE         LED_FIX8(0.875)
+#define LED_EFFECT_LEVEL_MAX            (127U)
+
+// Palette positions, LED_EFFECT_PALETTE_SIZE entries over 16 bits
+#define LED_EFFECT_PALETTE_STEP         (0x10000U / LED_EFFECT_PALETTE_SIZE)
+
+const struct led_color_t led_effect_palette_rainbow[LED_EFFECT_PALETTE_SIZE] = {
+    {255,   0,   0}, {255,  96,   0}, {255, 191,   0}, {223, 255,   0},
+    {128, 255,   0}, { 32, 255,   0}, {  0, 255,  64}, {  0, 255, 159},
+    {  0, 255, 255}, {  0, 159, 255}, {  0,  64, 255}, { 32,   0, 255},
+    {128,   0, 255}, {223,   0, 255}, {255,   0, 191}, {255,   0,  96},
+};
+
+const struct led_color_t led_effect_palette_fire[LED_EFFECT_PALETTE_SIZE] = {
+    {  0,   0,   0}, { 64,   0,   0}, {128,   0,   0}, {192,   0,   0},
+    {255,   0,   0}, {255,  48,   0}, {255,  96,   0}, {255, 144,   0},
+    {255, 192,   0}, {255, 224,  64}, {255, 255, 160}, {255, 224,  64},
+    {255, 144,   0}, {255,  48,   0}, {192,   0,   0}, { 64,   0,   0},
+};
+
+const struct led_color_t led_effect_palette_ocean[LED_EFFECT_PALETTE_SIZE] = {
+    {  0,   0,  64}, {  0,   0, 128}, {  0,   0, 192}, {  0,   0, 255},
+    {  0,  64, 255}, {  0, 128, 255}, {  0, 192, 255}, {  0, 255, 255},
+    { 64, 255, 224}, {  0, 255, 192}, {  0, 192, 160}, {  0, 128, 128},
+    {  0,  96, 160}, {  0,  64, 192}, {  0,  32, 160}, {  0,   0, 112},
+};
+
+// 255 * (i / 255) ^ 2.2
+static const uint8_t led_effect_gamma[256] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+      3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+      6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+     12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+     20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+     30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+     42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+     56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+     73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+     91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+    113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+    137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+    163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+    192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+    223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+
+static void led_effect_build_lut(struct led_effect_t *led_effect)
+{
+    uint32_t brightness = led_effect->brightness;
+    for (uint32_t i = 0; i < 256; i++) {
+        led_effect->lut[i] = (uint8_t)((led_effect_gamma[i] * brightness + 127) / 255);
+    }
+    led_effect->lut_brightness = led_effect->brightness;
+}
+
+static inline led_fix8_t led_fix8_mul(led_fix8_t a, led_fix8_t b)
+{
+    return (led_fix8_t)(((uint32_t)a * b) >> 8);
+}
+
+static inline led_fix8_t led_fix8_max(led_fix8_t a, led_fix8_t b)
+{
+    return a > b ? a : b;
+}
+
+/**
+ * Palette color at position, scaled by intensity (LED_FIX8_ONE is the palette color itself)
+ */
+static void led_effect_palette_pixel(const struct led_color_t *palette, uint16_t position,
+                                     led_fix8_t intensity, struct led_effect_pixel_t *pixel)
+{
+    uint32_t index = position / LED_EFFECT_PALETTE_STEP;
+    int32_t frac = (position % LED_EFFECT_PALETTE_STEP) * 256 / LED_EFFECT_PALETTE_STEP;
+    const struct led_color_t *a = &palette[index];
+    const struct led_color_t *b = &palette[(index + 1) % LED_EFFECT_PALETTE_SIZE];
+
+    int32_t red = a->red + (((b->red - a->red) * frac) >> 8);
+    int32_t green = a->green + (((b->green - a->green) * frac) >> 8);
+    int32_t blue = a->blue + (((b->blue - a->blue) * frac) >> 8);
+
+    pixel->red = (led_fix8_t)(red * intensity);
+    pixel->green = (led_fix8_t)(green * intensity);
+    pixel->blue = (led_fix8_t)(blue * intensity);
+}
+
+/**
+ * Lights a pixel without darkening what the fade left of earlier frames
+ */
+static inline void led_effect_blend_max(struct led_effect_pixel_t *dst, const struct led_effect_pixel_t *src)
+{
+    dst->red = led_fix8_max(dst->red, src->red);
+    dst->green = led_fix8_max(dst->green, src->green);
+    dst->blue = led_fix8_max(dst->blue, src->blue);
+}
+
+static void led_effect_fade(struct led_effect_t *led_effect, uint32_t length)
+{
+    led_fix8_t fade = led_effect->fade ? led_effect->fade : LED_EFFECT_DEFAULT_FADE;
+    for (uint32_t i = 0; i < length; i++) {
+        struct led_effect_pixel_t *pixel = &led_effect->frame[i];
+        pixel->red = led_fix8_mul(pixel->red, fade);
+        pixel->green = led_fix8_mul(pixel->green, fade);
+        pixel->blue = led_fix8_mul(pixel->blue, fade);
+    }
+}
+
+static void led_effect_vu(struct led_effect_t *led_effect, const struct led_color_t *palette,
+                          uint32_t length, uint32_t level)
+{
+    // Bar length in pixels, the last one partially lit
+    uint32_t bar = (level * length * 256) / LED_EFFECT_LEVEL_MAX;
+    struct led_effect_pixel_t lit;
+
+    led_effect_fade(led_effect, length);
+    for (uint32_t i = 0; i < length && (i << 8) < bar; i++) {
+        uint32_t cover = bar - (i << 8);
+        led_fix8_t intensity = cover >= LED_FIX8_ONE ? LED_FIX8_ONE : (led_fix8_t)cover;
+        // Green at the start of the bar, red at the end
+        uint16_t position = (uint16_t)(5 * LED_EFFECT_PALETTE_STEP - (i * 5 * LED_EFFECT_PALETTE_STEP) / length);
+        led_effect_palette_pixel(palette, position, intensity, &lit);
+        led_effect_blend_max(&led_effect->frame[i], &lit);
+    }
+}
+
+static void led_effect_palette(struct led_effect_t *led_effect, const struct led_color_t *palette,
+                               uint32_t length, uint32_t level)
+{
+    led_fix8_t intensity = (led_fix8_t)(0x40 + ((level * 0xC0) / LED_EFFECT_LEVEL_MAX));
+
+    led_effect->phase += 0x40 + level * 4;
+    for (uint32_t i = 0; i < length; i++) {
+        uint16_t position = (uint16_t)(led_effect->phase + (i * 0x10000U) / length);
+        led_effect_palette_pixel(palette, position, intensity, &led_effect->frame[i]);
+    }
+}
+
+static void led_effect_chase(struct led_effect_t *led_effect, const struct led_color_t *palette,
+                             uint32_t length, uint32_t level, uint32_t new_beats)
+{
+    uint32_t wrap = length << 8;
+    struct led_effect_pixel_t lit;
+
+    led_effect->phase += new_beats * LED_EFFECT_PALETTE_STEP;
+    led_effect->position = (led_effect->position + 0x20 + level * 2) % wrap;
+
+    // Head spread over two pixels by its fraction
+    uint32_t head = led_effect->position >> 8;
+    led_fix8_t frac = (led_fix8_t)(led_effect->position & 0xFF);
+
+    led_effect_fade(led_effect, length);
+    led_effect_palette_pixel(palette, led_effect->phase, LED_FIX8_ONE - frac, &lit);
+    led_effect_blend_max(&led_effect->frame[head], &lit);
+    led_effect_palette_pixel(palette, led_effect->phase, frac, &lit);
+    led_effect_blend_max(&led_effect->frame[(head + 1) % length], &lit);
+}
+
+static void led_effect_pulse(struct led_effect_t *led_effect, const struct led_color_t *palette,
+                             uint32_t length, uint32_t new_beats)
+{
+    led_fix8_t fade = led_effect->fade ? led_effect->fade : LED_EFFECT_DEFAULT_FADE;
+    struct led_effect_pixel_t lit;
+
+    if (new_beats) {
+        led_effect->pulse = LED_FIX8_ONE;
+        led_effect->phase += new_beats * LED_EFFECT_PALETTE_STEP;
+    } else {
+        led_effect->pulse = led_fix8_mul(led_effect->pulse, fade);
+    }
+
+    led_effect_fade(led_effect, length);
+    if (!led_effect->pulse) {
+        return;
+    }
+
+    // Lit from the center out to pulse * half the strip, the edge pixel partially
+    uint32_t reach = ((length << 8) / 2 * led_effect->pulse) >> 8;
+    for (uint32_t i = 0; i < length; i++) {
+        // Distance of the pixel center from the strip center, 8.8
+        int32_t distance = (int32_t)((i << 8) + 0x80) - (int32_t)(length << 7);
+        if (distance < 0) {
+            distance = -distance;
+        }
+        if ((uint32_t)distance >= reach) {
+            continue;
+        }
+        uint32_t cover = reach - distance;
+        led_fix8_t edge = cover >= LED_FIX8_ONE ? LED_FIX8_ONE : (led_fix8_t)cover;
+        led_effect_palette_pixel(palette, led_effect->phase, led_fix8_mul(edge, led_effect->pulse), &lit);
+        led_effect_blend_max(&led_effect->frame[i], &lit);
+    }
+}
+
+void led_effect_render(struct led_effect_t *led_effect, struct led_color_t *out)
+{
+    uint32_t length = led_effect->led_strip->led_strip_length;
+    const struct led_color_t *palette = led_effect->palette ? led_effect->palette : led_effect_palette_rainbow;
+    uint32_t level = led_effect->level;
+    uint32_t beats = led_effect->beats;
+    uint32_t new_beats = beats - led_effect->beats_seen;
+    led_effect->beats_seen = beats;
+
+    if (level > LED_EFFECT_LEVEL_MAX) {
+        level = LED_EFFECT_LEVEL_MAX;
+    }
+
+    switch (led_effect->mode) {
+        case LED_EFFECT_VU:
+            led_effect_vu(led_effect, palette, length, level);
+            break;
+        case LED_EFFECT_PALETTE:
+            led_effect_palette(led_effect, palette, length, level);
+            break;
+        case LED_EFFECT_CHASE:
+            led_effect_chase(led_effect, palette, length, level, new_beats);
+            break;
+        case LED_EFFECT_PULSE:
+        default:
+            led_effect_pulse(led_effect, palette, length, new_beats);
+            break;
+    }
+
+    // Gamma and brightness in one lookup per channel
+    if (led_effect->lut_brightness != led_effect->brightness) {
+        led_effect_build_lut(led_effect);
+    }
+    const uint8_t *lut = led_effect->lut;
+    for (uint32_t i = 0; i < length; i++) {
+        const struct led_effect_pixel_t *pixel = &led_effect->frame[i];
+        out[i].red = lut[pixel->red >> 8];
+        out[i].green = lut[pixel->green >> 8];
+        out[i].blue = lut[pixel->blue >> 8];
+    }
+}
+
+/**
+ * Applies the queued features due by due_us, the last level wins, beats add up
+ */
+static void led_effect_present_audio(struct led_effect_t *led_effect, int64_t due_us)
+{
+    uint32_t tail = led_effect->audio_tail;
+    uint32_t head = __atomic_load_n(&led_effect->audio_head, __ATOMIC_ACQUIRE);
+
+    while (tail != head) {
+        const struct led_effect_audio_t *audio = &led_effect->audio_queue[tail % LED_EFFECT_AUDIO_QUEUE_LEN];
+        if (audio->present_us > due_us) {
+            break;
+        }
+        led_effect->level = audio->level;
+        if (audio->beat) {
+            led_effect->beats++;
+        }
+        tail++;
+    }
+    __atomic_store_n(&led_effect->audio_tail, tail, __ATOMIC_RELEASE);
+}
+
+static void led_effect_task(void *arg)
+{
+    struct led_effect_t *led_effect = (struct led_effect_t *)arg;
+    struct led_strip_t *led_strip = led_effect->led_strip;
+    struct led_color_t *out = (struct led_color_t *)malloc(sizeof(struct led_color_t) * led_strip->led_strip_length);
+    if (!out) {
+        vTaskDelete(NULL);
+    }
+
+    uint32_t fps = led_effect->fps ? led_effect->fps : LED_EFFECT_DEFAULT_FPS;
+    TickType_t period = (1000 / fps) / portTICK_PERIOD_MS;
+    if (period == 0) {
+        period = 1;
+    }
+    TickType_t last_wake = xTaskGetTickCount();
+    int64_t half_period_us = (int64_t)period * portTICK_PERIOD_MS * 500;
+
+    for(;;) {
+        led_effect_present_audio(led_effect, esp_timer_get_time() + half_period_us);
+        led_effect_render(led_effect, out);
+        for (uint32_t i = 0; i < led_strip->led_strip_length; i++) {
+            led_strip_set_pixel_color(led_strip, i, &out[i]);
+        }
+        led_strip_show(led_strip);
+        vTaskDelayUntil(&last_wake, period);
+    }
+
+    free(out);
+    vTaskDelete(NULL);
+}
+
+bool led_effect_init(struct led_effect_t *led_effect)
+{
+    if ((!led_effect) ||
+        (!led_effect->led_strip) ||
+        (led_effect->led_strip->led_strip_length == 0) ||
+        (led_effect->mode >= LED_EFFECT_MODE_MAX)) {
+        return false;
+    }
+
+    led_effect->frame = (struct led_effect_pixel_t *)calloc(led_effect->led_strip->led_strip_length,
+                                                            sizeof(struct led_effect_pixel_t));
+    if (!led_effect->frame) {
+        return false;
+    }
+
+    led_effect_build_lut(led_effect);
+    led_effect->level = 0;
+    led_effect->beats = 0;
+    led_effect->audio_head = 0;
+    led_effect->audio_tail = 0;
+    led_effect->audio_dropped = 0;
+    led_effect->beats_seen = 0;
+    led_effect->phase = 0;
+    led_effect->position = 0;
+    led_effect->pulse = 0;
+
+    BaseType_t task_created = xTaskCreate(led_effect_task,
+                                          "led_effect_task",
+                                          LED_EFFECT_TASK_SIZE,
+                                          led_effect,
+                                          LED_EFFECT_TASK_PRIORITY,
+                                          &led_effect->task_handle
+                                         );
+    if (!task_created) {
+        free(led_effect->frame);
+        led_effect->frame = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void led_effect_feed_audio(struct led_effect_t *led_effect, uint8_t level, bool beat)
+{
+    if (!led_effect) {
+        return;
+    }
+
+    led_effect->level = level;
+    if (beat) {
+        led_effect->beats++;
+    }
+}
+
+bool led_effect_queue_audio(struct led_effect_t *led_effect, uint8_t level, bool beat, int64_t present_us)
+{
+    if (!led_effect) {
+        return false;
+    }
+
+    uint32_t head = led_effect->audio_head;
+    if (head - __atomic_load_n(&led_effect->audio_tail, __ATOMIC_ACQUIRE) >= LED_EFFECT_AUDIO_QUEUE_LEN) {
+        led_effect->audio_dropped++;
+        return false;
+    }
+    struct led_effect_audio_t *audio = &led_effect->audio_queue[head % LED_EFFECT_AUDIO_QUEUE_LEN];
+    audio->present_us = present_us;
+    audio->level = level;
+    audio->beat = beat;
+    __atomic_store_n(&led_effect->audio_head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool led_effect_set_mode(struct led_effect_t *led_effect, enum led_effect_mode_t mode)
+{
+    if ((!led_effect) || (mode >= LED_EFFECT_MODE_MAX)) {
+        return false;
+    }
+
+    led_effect->mode = mode;
+
+    return true;
+}
+
+void led_effect_set_brightness(struct led_effect_t *led_effect, uint8_t brightness)
+{
+    if (!led_effect) {
+        return;
+    }
+
+    // The effect task rebuilds its table before the next frame
+    led_effect->brightness = brightness;
+}
@@ -12,263 +12,244 @@
     refers to buffer 1. 
     When led_strip_show is called, it will switch to displaying the pixels
     from buffer 2 and will clear buffer 1. Any writes will now happen on buffer 1 
-    and the task will look at buffer 2 for refreshing the LEDs
+    and the task will look at buffer 2 for refreshing the LEDs.
+    The strip is only written after led_strip_show, the task sleeps otherwise.
+
+    There is no lock: the front buffer index and a frame counter are published
+    in one atomic word by led_strip_show. The output task copies the front
+    buffer and retries if a show happened during the copy, then sends its copy,
+    so pixel writers never wait for the RMT. Pixel writes and led_strip_show
+    must come from one task at a time.
+
+    Several strips on different RMT channels can share one output task as a
+    led_strip_group_t. The group task starts every channel with a new frame
+    before waiting for any, so the strips update in the time of the longest.
     ------------------------------------------------------------------------- */
 
 #include "led_strip/led_strip.h"
+#include "led_strip/led_strip_encode.h"
 #include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
 
 #include <string.h>
 
 #define LED_STRIP_TASK_SIZE             (4096)
 #define LED_STRIP_TASK_PRIORITY         (configMAX_PRIORITIES - 1)
 
-#define LED_STRIP_REFRESH_PERIOD_MS     (10U) // TODO: add as parameter to led_strip_init
 
-#define LED_STRIP_NUM_RMT_ITEMS_PER_LED (24U) // Assumes 24 bit color for each led
+#define LED_STRIP_FRONT(published)      ((published) & 1U)
+#define LED_STRIP_FRAME(published)      ((published) >> 1)
 
 // RMT Clock source is @ 80 MHz. Dividing it by 8 gives us 10 MHz frequency, or 100ns period.
 #define LED_STRIP_RMT_CLK_DIV (8)
 
-/****************************
-        WS2812 Timing
- ****************************/
-#define LED_STRIP_RMT_TICKS_BIT_1_HIGH_WS2812 9 // 900ns (900ns +/- 150ns per datasheet)
-#define LED_STRIP_RMT_TICKS_BIT_1_LOW_WS2812  3 // 300ns (350ns +/- 150ns per datasheet)
-#define LED_STRIP_RMT_TICKS_BIT_0_HIGH_WS2812 3 // 300ns (350ns +/- 150ns per datasheet)
-#define LED_STRIP_RMT_TICKS_BIT_0_LOW_WS2812  9 // 900ns (900ns +/- 150ns per datasheet)
-
-/****************************
-        SK6812 Timing
- ****************************/
-#define LED_STRIP_RMT_TICKS_BIT_1_HIGH_SK6812 6
-#define LED_STRIP_RMT_TICKS_BIT_1_LOW_SK6812  6
-#define LED_STRIP_RMT_TICKS_BIT_0_HIGH_SK6812 3
-#define LED_STRIP_RMT_TICKS_BIT_0_LOW_SK6812  9
-
-/****************************
-        APA106 Timing
- ****************************/
-#define LED_STRIP_RMT_TICKS_BIT_1_HIGH_APA106 14 // 1.36us +/- 150ns per datasheet
-#define LED_STRIP_RMT_TICKS_BIT_1_LOW_APA106   3 // 350ns +/- 150ns per datasheet
-#define LED_STRIP_RMT_TICKS_BIT_0_HIGH_APA106  3 // 350ns +/- 150ns per datasheet
-#define LED_STRIP_RMT_TICKS_BIT_0_LOW_APA106  14 // 1.36us +/- 150ns per datasheet
-
-// Function pointer for generating waveforms based on different LED drivers
-typedef void (*led_fill_rmt_items_fn)(struct led_color_t *led_strip_buf, rmt_item32_t *rmt_items, uint32_t led_strip_length);
-
-static inline void led_strip_fill_item_level(rmt_item32_t* item, int high_ticks, int low_ticks)
-{
-    item->level0 = 1;
-    item->duration0 = high_ticks;
-    item->level1 = 0;
-    item->duration1 = low_ticks;
-}
-
-static inline void led_strip_rmt_bit_1_sk6812(rmt_item32_t* item)
-{
-    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_1_HIGH_SK6812, LED_STRIP_RMT_TICKS_BIT_1_LOW_SK6812);
-}
+/*
+ * The translator callback has no user argument, so the buffer being sent on
+ * each channel is registered here and looked up from the source pointer.
+ */
+struct led_strip_rmt_source_t {
+    const uint8_t *buf;
+    size_t size;
+    const struct led_strip_encoder_t *encoder;
+};
 
-static inline void led_strip_rmt_bit_0_sk6812(rmt_item32_t* item)
-{
-    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_0_HIGH_SK6812, LED_STRIP_RMT_TICKS_BIT_0_LOW_SK6812);
-}
+static struct led_strip_rmt_source_t led_strip_rmt_sources[RMT_CHANNEL_MAX];
 
-static void led_strip_fill_rmt_items_sk6812(struct led_color_t *led_strip_buf, rmt_item32_t *rmt_items, uint32_t led_strip_length)
+/*
+ * Called by the RMT driver (from its interrupt after the first block) whenever
+ * channel memory needs refilling. Encodes whole bytes straight from the led buffer.
+ */
+static void IRAM_ATTR led_strip_rmt_translate(const void *src, rmt_item32_t *dest, size_t src_size,
+                                              size_t wanted_num, size_t *translated_size, size_t *item_num)
 {
-    uint32_t rmt_items_index = 0;
-    for (uint32_t led_index = 0; led_index < led_strip_length; led_index++) {
-        struct led_color_t led_color = led_strip_buf[led_index];
-
-        for (uint8_t bit = 8; bit != 0; bit--) {
-            uint8_t bit_set = (led_color.green >> (bit - 1)) & 1;
-            if(bit_set) {
-                led_strip_rmt_bit_1_sk6812(&(rmt_items[rmt_items_index]));
-            } else {
-                led_strip_rmt_bit_0_sk6812(&(rmt_items[rmt_items_index]));
-            }
-            rmt_items_index++;
-        }
-        for (uint8_t bit = 8; bit != 0; bit--) {
-            uint8_t bit_set = (led_color.red >> (bit - 1)) & 1;
-            if(bit_set) {
-                led_strip_rmt_bit_1_sk6812(&(rmt_items[rmt_items_index]));
-            } else {
-                led_strip_rmt_bit_0_sk6812(&(rmt_items[rmt_items_index]));
+    const uint8_t *src_bytes = (const uint8_t *)src;
+    *translated_size = 0;
+    *item_num = 0;
+
+    for (int channel = 0; channel < RMT_CHANNEL_MAX; channel++) {
+        const struct led_strip_rmt_source_t *source = &led_strip_rmt_sources[channel];
+        if ((source->buf != NULL) && (src_bytes >= source->buf) && (src_bytes < source->buf + source->size)) {
+            size_t count = wanted_num / 8;
+            if (count > src_size) {
+                count = src_size;
             }
-            rmt_items_index++;
-        }
-        for (uint8_t bit = 8; bit != 0; bit--) {
-            uint8_t bit_set = (led_color.blue >> (bit - 1)) & 1;
-            if(bit_set) {
-                led_strip_rmt_bit_1_sk6812(&(rmt_items[rmt_items_index]));
-            } else {
-                led_strip_rmt_bit_0_sk6812(&(rmt_items[rmt_items_index]));
-            }
-            rmt_items_index++;
+            led_strip_encode_bytes(source->encoder, (const struct led_color_t *)source->buf,
+                                   src_bytes - source->buf, count, dest);
+            *translated_size = count;
+            *item_num = count * 8;
+            return;
         }
     }
 }
 
-static inline void led_strip_rmt_bit_1_ws2812(rmt_item32_t* item)
+static inline struct led_color_t *led_strip_buf(struct led_strip_t *led_strip, uint32_t index)
 {
-    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_1_HIGH_WS2812, LED_STRIP_RMT_TICKS_BIT_1_LOW_WS2812);
+    return index ? led_strip->led_strip_buf_2 : led_strip->led_strip_buf_1;
 }
 
-static inline void led_strip_rmt_bit_0_ws2812(rmt_item32_t* item)
+static inline struct led_color_t *led_strip_back_buf(struct led_strip_t *led_strip)
 {
-    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_0_HIGH_WS2812, LED_STRIP_RMT_TICKS_BIT_0_LOW_WS2812);
+    uint32_t published = __atomic_load_n(&led_strip->published, __ATOMIC_RELAXED);
+    return led_strip_buf(led_strip, !LED_STRIP_FRONT(published));
 }
 
-static void led_strip_fill_rmt_items_ws2812(struct led_color_t *led_strip_buf, rmt_item32_t *rmt_items, uint32_t led_strip_length)
+/**
+ * Registers the encoder and a private internal RAM copy of the frame as the
+ * translator source of the strip's channel. Returns the copy.
+ */
+static uint8_t *led_strip_source_alloc(struct led_strip_t *led_strip)
 {
-    uint32_t rmt_items_index = 0;
-    for (uint32_t led_index = 0; led_index < led_strip_length; led_index++) {
-        struct led_color_t led_color = led_strip_buf[led_index];
-
-        for (uint8_t bit = 8; bit != 0; bit--) {
-            uint8_t bit_set = (led_color.green >> (bit - 1)) & 1;
-            if(bit_set) {
-                led_strip_rmt_bit_1_ws2812(&(rmt_items[rmt_items_index]));
-            } else {
-                led_strip_rmt_bit_0_ws2812(&(rmt_items[rmt_items_index]));
-            }
-            rmt_items_index++;
-        }
-        for (uint8_t bit = 8; bit != 0; bit--) {
-            uint8_t bit_set = (led_color.red >> (bit - 1)) & 1;
-            if(bit_set) {
-                led_strip_rmt_bit_1_ws2812(&(rmt_items[rmt_items_index]));
-            } else {
-                led_strip_rmt_bit_0_ws2812(&(rmt_items[rmt_items_index]));
-            }
-            rmt_items_index++;
-        }
-        for (uint8_t bit = 8; bit != 0; bit--) {
-            uint8_t bit_set = (led_color.blue >> (bit - 1)) & 1;
-            if(bit_set) {
-                led_strip_rmt_bit_1_ws2812(&(rmt_items[rmt_items_index]));
-            } else {
-                led_strip_rmt_bit_0_ws2812(&(rmt_items[rmt_items_index]));
-            }
-            rmt_items_index++;
-        }
+    struct led_strip_rmt_source_t *source = &led_strip_rmt_sources[led_strip->rmt_channel];
+    size_t buf_size = sizeof(struct led_color_t) * led_strip->led_strip_length;
+
+    // Read from the RMT interrupt, must not end up in PSRAM
+    struct led_strip_encoder_t *encoder = (struct led_strip_encoder_t*) heap_caps_malloc(sizeof(struct led_strip_encoder_t),
+                                                                                         MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint8_t *sending = (uint8_t*) heap_caps_malloc(buf_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!encoder || !sending) {
+        heap_caps_free(encoder);
+        heap_caps_free(sending);
+        return NULL;
     }
+    led_strip_encoder_init(encoder, led_strip->rgb_led_type);
+    source->encoder = encoder;
+    source->size = buf_size;
+    source->buf = sending;
+
+    return sending;
 }
 
-static inline void led_strip_rmt_bit_1_apa106(rmt_item32_t* item)
+static void led_strip_source_free(struct led_strip_t *led_strip)
 {
-    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_1_HIGH_APA106, LED_STRIP_RMT_TICKS_BIT_1_LOW_APA106);
+    struct led_strip_rmt_source_t *source = &led_strip_rmt_sources[led_strip->rmt_channel];
+    uint8_t *sending = (uint8_t *)source->buf;
+
+    source->buf = NULL;
+    heap_caps_free(sending);
+    heap_caps_free((void *)source->encoder);
+    source->encoder = NULL;
 }
 
-static inline void led_strip_rmt_bit_0_apa106(rmt_item32_t* item)
+/**
+ * Copies the published front buffer. Once a show moves the front buffer to the
+ * back it gets cleared and rewritten, if that happened while copying, copy the
+ * new front instead.
+ */
+static void led_strip_snapshot(struct led_strip_t *led_strip, uint8_t *sending)
 {
-    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_0_HIGH_APA106, LED_STRIP_RMT_TICKS_BIT_0_LOW_APA106);
+    size_t buf_size = sizeof(struct led_color_t) * led_strip->led_strip_length;
+    uint32_t published;
+
+    __atomic_store_n(&led_strip->frame_pending, false, __ATOMIC_SEQ_CST);
+    do {
+        published = __atomic_load_n(&led_strip->published, __ATOMIC_ACQUIRE);
+        memcpy(sending, led_strip_buf(led_strip, LED_STRIP_FRONT(published)), buf_size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&led_strip->published, __ATOMIC_RELAXED) != published);
 }
 
-static void led_strip_fill_rmt_items_apa106(struct led_color_t *led_strip_buf, rmt_item32_t *rmt_items, uint32_t led_strip_length)
+static TickType_t led_strip_min_period(uint32_t max_fps)
 {
-    uint32_t rmt_items_index = 0;
-    for (uint32_t led_index = 0; led_index < led_strip_length; led_index++) {
-        struct led_color_t led_color = led_strip_buf[led_index];
-
-        for (uint8_t bit = 8; bit != 0; bit--) {
-            uint8_t bit_set = (led_color.red >> (bit - 1)) & 1;
-            if(bit_set) {
-                led_strip_rmt_bit_1_apa106(&(rmt_items[rmt_items_index]));
-            } else {
-                led_strip_rmt_bit_0_apa106(&(rmt_items[rmt_items_index]));
-            }
-            rmt_items_index++;
-        }
-        for (uint8_t bit = 8; bit != 0; bit--) {
-            uint8_t bit_set = (led_color.green >> (bit - 1)) & 1;
-            if(bit_set) {
-                led_strip_rmt_bit_1_apa106(&(rmt_items[rmt_items_index]));
-            } else {
-                led_strip_rmt_bit_0_apa106(&(rmt_items[rmt_items_index]));
-            }
-            rmt_items_index++;
-        }
-        for (uint8_t bit = 8; bit != 0; bit--) {
-            uint8_t bit_set = (led_color.blue >> (bit - 1)) & 1;
-            if(bit_set) {
-                led_strip_rmt_bit_1_apa106(&(rmt_items[rmt_items_index]));
-            } else {
-                led_strip_rmt_bit_0_apa106(&(rmt_items[rmt_items_index]));
-            }
-            rmt_items_index++;
-        }
+    if (max_fps == 0) {
+        max_fps = LED_STRIP_DEFAULT_MAX_FPS;
+    }
+    return (1000 / max_fps) / portTICK_PERIOD_MS;
+}
+
+/**
+ * Sleeps until a frame is shown and at least min_period passed since the last one.
+ * Frames shown meanwhile replace the pending one.
+ */
+static void led_strip_wait_frame(TickType_t min_period, TickType_t *last_sent)
+{
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    TickType_t since_sent = xTaskGetTickCount() - *last_sent;
+    if (since_sent < min_period) {
+        vTaskDelay(min_period - since_sent);
     }
+    *last_sent = xTaskGetTickCount();
 }
 
 static void led_strip_task(void *arg)
 {
     struct led_strip_t *led_strip = (struct led_strip_t *)arg;
-    led_fill_rmt_items_fn led_make_waveform = NULL;
-    bool make_new_rmt_items = true;
-    bool prev_showing_buf_1 = !led_strip->showing_buf_1;
+    size_t buf_size = sizeof(struct led_color_t) * led_strip->led_strip_length;
 
-    size_t num_items_malloc = (LED_STRIP_NUM_RMT_ITEMS_PER_LED * led_strip->led_strip_length);
-    rmt_item32_t *rmt_items = (rmt_item32_t*) malloc(sizeof(rmt_item32_t) * num_items_malloc);
-    if (!rmt_items) {
+    uint8_t *sending = led_strip_source_alloc(led_strip);
+    if (!sending) {
         vTaskDelete(NULL);
     }
 
-    switch (led_strip->rgb_led_type) {
-        case RGB_LED_TYPE_WS2812:
-            led_make_waveform = led_strip_fill_rmt_items_ws2812;
-            break;
+    TickType_t min_period = led_strip_min_period(led_strip->max_fps);
+    TickType_t last_sent = xTaskGetTickCount() - min_period;
 
-        case RGB_LED_TYPE_SK6812:
-            led_make_waveform = led_strip_fill_rmt_items_sk6812;
-            break;
+    for(;;) {
+        // Sleep until led_strip_show publishes a new frame
+        led_strip_wait_frame(min_period, &last_sent);
 
-        case RGB_LED_TYPE_APA106:
-            led_make_waveform = led_strip_fill_rmt_items_apa106;
-            break;
+        led_strip_snapshot(led_strip, sending);
+        rmt_write_sample(led_strip->rmt_channel, sending, buf_size, true);
+        led_strip->frames_sent++;
+    }
 
-        default:
-            // Will avoid keeping it point to NULL
-            led_make_waveform = led_strip_fill_rmt_items_ws2812;
-            break;
-    };
+    led_strip_source_free(led_strip);
+    vTaskDelete(NULL);
+}
 
-    for(;;) {
-        rmt_wait_tx_done(led_strip->rmt_channel, 500 / portTICK_PERIOD_MS);
-        xSemaphoreTake(led_strip->access_semaphore, portMAX_DELAY);
-
-        /*
-         * If buf 1 was previously being shown and now buf 2 is being shown,
-         * it should update the new rmt items array. If buf 2 was previous being shown
-         * and now buf 1 is being shown, it should update the new rmt items array.
-         * Otherwise, no need to update the array
-         */
-        if ((prev_showing_buf_1 == true) && (led_strip->showing_buf_1 == false)) {
-            make_new_rmt_items = true;
-        } else if ((prev_showing_buf_1 == false) && (led_strip->showing_buf_1 == true)) {
-            make_new_rmt_items = true;
-        } else {
-            make_new_rmt_items = false;
+/**
+ * Drives all strips of a group. Every channel with a pending frame is started
+ * before waiting on any of them, so the strips encode (in their RMT interrupts)
+ * and transmit at the same time.
+ */
+static void led_strip_group_task(void *arg)
+{
+    struct led_strip_group_t *group = (struct led_strip_group_t *)arg;
+    uint8_t *sending[RMT_CHANNEL_MAX] = { 0 };
+
+    for (uint32_t i = 0; i < group->strip_count; i++) {
+        sending[i] = led_strip_source_alloc(group->strips[i]);
+        if (!sending[i]) {
+            while (i--) {
+                led_strip_source_free(group->strips[i]);
+            }
+            vTaskDelete(NULL);
         }
+    }
+
+    TickType_t min_period = led_strip_min_period(group->max_fps);
+    TickType_t last_sent = xTaskGetTickCount() - min_period;
 
-        if (make_new_rmt_items) {
-            if (led_strip->showing_buf_1) {
-                led_make_waveform(led_strip->led_strip_buf_1, rmt_items, led_strip->led_strip_length);
-            } else {
-                led_make_waveform(led_strip->led_strip_buf_2, rmt_items, led_strip->led_strip_length);
+    for(;;) {
+        // Sleep until led_strip_show publishes a new frame on any strip
+        led_strip_wait_frame(min_period, &last_sent);
+
+        uint32_t started = 0;
+        for (uint32_t i = 0; i < group->strip_count; i++) {
+            struct led_strip_t *led_strip = group->strips[i];
+            if (!__atomic_load_n(&led_strip->frame_pending, __ATOMIC_SEQ_CST)) {
+                continue;
             }
+            led_strip_snapshot(led_strip, sending[i]);
+            rmt_write_sample(led_strip->rmt_channel, sending[i],
+                             sizeof(struct led_color_t) * led_strip->led_strip_length, false);
+            started |= 1U << i;
         }
 
-        rmt_write_items(led_strip->rmt_channel, rmt_items, num_items_malloc, false);
-        prev_showing_buf_1 = led_strip->showing_buf_1;
-        xSemaphoreGive(led_strip->access_semaphore);
-        vTaskDelay(LED_STRIP_REFRESH_PERIOD_MS / portTICK_PERIOD_MS);
+        for (uint32_t i = 0; i < group->strip_count; i++) {
+            if (started & (1U << i)) {
+                rmt_wait_tx_done(group->strips[i]->rmt_channel, portMAX_DELAY);
+                group->strips[i]->frames_sent++;
+            }
+        }
+        if (started) {
+            group->frames_sent++;
+        }
     }
 
-    if (rmt_items) {
-        free(rmt_items);
+    for (uint32_t i = 0; i < group->strip_count; i++) {
+        led_strip_source_free(group->strips[i]);
     }
     vTaskDelete(NULL);
 }
@@ -300,21 +281,25 @@ static bool led_strip_init_rmt(struct led_strip_t *led_strip)
     if (install_ok != ESP_OK) {
         return false;
     }
+    esp_err_t translator_ok = rmt_translator_init(rmt_cfg.channel, led_strip_rmt_translate);
+    if (translator_ok != ESP_OK) {
+        return false;
+    }
 
     return true;
 }
 
-bool led_strip_init(struct led_strip_t *led_strip)
+/**
+ * Checks the strip, clears its buffers and sets up its RMT channel, without the output task
+ */
+static bool led_strip_init_strip(struct led_strip_t *led_strip)
 {
-    TaskHandle_t led_strip_task_handle;
-
     if ((led_strip == NULL) ||
-        (led_strip->rmt_channel == RMT_CHANNEL_MAX) ||
+        (led_strip->rmt_channel >= RMT_CHANNEL_MAX) ||
         (led_strip->gpio > GPIO_NUM_33) ||  // only inputs above 33
         (led_strip->led_strip_buf_1 == NULL) ||
         (led_strip->led_strip_buf_2 == NULL) ||
-        (led_strip->led_strip_length == 0) ||
-        (led_strip->access_semaphore == NULL)) {
+        (led_strip->led_strip_length == 0)) {
         return false;
     }
 
@@ -330,13 +315,27 @@ bool led_strip_init(struct led_strip_t *led_strip)
         return false;
     }
 
-    xSemaphoreGive(led_strip->access_semaphore);
+    led_strip->published = 1; // Showing buffer 2, writes go to buffer 1
+    led_strip->frame_pending = false;
+    led_strip->frames_sent = 0;
+    led_strip->frames_skipped = 0;
+    led_strip->task_handle = NULL;
+
+    return true;
+}
+
+bool led_strip_init(struct led_strip_t *led_strip)
+{
+    if (!led_strip_init_strip(led_strip)) {
+        return false;
+    }
+
     BaseType_t task_created = xTaskCreate(led_strip_task,
                                             "led_strip_task",
                                             LED_STRIP_TASK_SIZE,
                                             led_strip,
                                             LED_STRIP_TASK_PRIORITY,
-                                            &led_strip_task_handle
+                                            &led_strip->task_handle
                                          );
 
     if (!task_created) {
@@ -346,19 +345,61 @@ bool led_strip_init(struct led_strip_t *led_strip)
     return true;
 }
 
+bool led_strip_group_init(struct led_strip_group_t *group)
+{
+    if ((group == NULL) ||
+        (group->strips == NULL) ||
+        (group->strip_count == 0) ||
+        (group->strip_count > LED_STRIP_GROUP_MAX_STRIPS)) {
+        return false;
+    }
+
+    uint32_t channels = 0;
+    for (uint32_t i = 0; i < group->strip_count; i++) {
+        struct led_strip_t *led_strip = group->strips[i];
+        if ((led_strip == NULL) || (led_strip->rmt_channel >= RMT_CHANNEL_MAX) ||
+            (channels & (1U << led_strip->rmt_channel))) {
+            return false;
+        }
+        channels |= 1U << led_strip->rmt_channel;
+    }
+
+    for (uint32_t i = 0; i < group->strip_count; i++) {
+        if (!led_strip_init_strip(group->strips[i])) {
+            return false;
+        }
+    }
+
+    group->frames_sent = 0;
+    BaseType_t task_created = xTaskCreate(led_strip_group_task,
+                                            "led_strip_group",
+                                            LED_STRIP_TASK_SIZE,
+                                            group,
+                                            LED_STRIP_TASK_PRIORITY,
+                                            &group->task_handle
+                                         );
+
+    if (!task_created) {
+        return false;
+    }
+
+    // led_strip_show on any strip of the group wakes the group task
+    for (uint32_t i = 0; i < group->strip_count; i++) {
+        group->strips[i]->task_handle = group->task_handle;
+    }
+
+    return true;
+}
+
 bool led_strip_set_pixel_color(struct led_strip_t *led_strip, uint32_t pixel_num, struct led_color_t *color)
 {
     bool set_led_success = true;
 
-    if ((!led_strip) || (!color) || (pixel_num > led_strip->led_strip_length)) {
+    if ((!led_strip) || (!color) || (pixel_num >= led_strip->led_strip_length)) {
         return false;
     }
 
-    if (led_strip->showing_buf_1) {
-        led_strip->led_strip_buf_2[pixel_num] = *color;
-    } else {
-        led_strip->led_strip_buf_1[pixel_num] = *color;
-    }
+    led_strip_back_buf(led_strip)[pixel_num] = *color;
 
     return set_led_success;
 }
@@ -367,19 +408,14 @@ bool led_strip_set_pixel_rgb(struct led_strip_t *led_strip, uint32_t pixel_num,
 {
     bool set_led_success = true;
 
-    if ((!led_strip) || (pixel_num > led_strip->led_strip_length)) {
+    if ((!led_strip) || (pixel_num >= led_strip->led_strip_length)) {
         return false;
     }
 
-    if (led_strip->showing_buf_1) {
-        led_strip->led_strip_buf_2[pixel_num].red = red;
-        led_strip->led_strip_buf_2[pixel_num].green = green;
-        led_strip->led_strip_buf_2[pixel_num].blue = blue;
-    } else {
-        led_strip->led_strip_buf_1[pixel_num].red = red;
-        led_strip->led_strip_buf_1[pixel_num].green = green;
-        led_strip->led_strip_buf_1[pixel_num].blue = blue;
-    }
+    struct led_color_t *pixel = &led_strip_back_buf(led_strip)[pixel_num];
+    pixel->red = red;
+    pixel->green = green;
+    pixel->blue = blue;
 
     return set_led_success;
 }
@@ -389,17 +425,14 @@ bool led_strip_get_pixel_color(struct led_strip_t *led_strip, uint32_t pixel_num
     bool get_success = true;
 
     if ((!led_strip) ||
-        (pixel_num > led_strip->led_strip_length) ||
+        (pixel_num >= led_strip->led_strip_length) ||
         (!color)) {
         color = NULL;
         return false;
     }
 
-    if (led_strip->showing_buf_1) {
-        *color = led_strip->led_strip_buf_1[pixel_num];
-    } else {
-        *color = led_strip->led_strip_buf_2[pixel_num];
-    }
+    uint32_t published = __atomic_load_n(&led_strip->published, __ATOMIC_ACQUIRE);
+    *color = led_strip_buf(led_strip, LED_STRIP_FRONT(published))[pixel_num];
 
     return get_success;
 }
@@ -415,19 +448,36 @@ bool led_strip_show(struct led_strip_t *led_strip)
         return false;
     }
 
-    xSemaphoreTake(led_strip->access_semaphore, portMAX_DELAY);
-    if (led_strip->showing_buf_1) {
-        led_strip->showing_buf_1 = false;
-        memset(led_strip->led_strip_buf_1, 0, sizeof(struct led_color_t) * led_strip->led_strip_length);
-    } else {
-        led_strip->showing_buf_1 = true;
-        memset(led_strip->led_strip_buf_2, 0, sizeof(struct led_color_t) * led_strip->led_strip_length);
+    // Publish the back buffer, then clear the old front for the next frame
+    uint32_t published = __atomic_load_n(&led_strip->published, __ATOMIC_RELAXED);
+    uint32_t front = !LED_STRIP_FRONT(published);
+    __atomic_store_n(&led_strip->published, ((LED_STRIP_FRAME(published) + 1) << 1) | front, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    memset(led_strip_buf(led_strip, !front), 0, sizeof(struct led_color_t) * led_strip->led_strip_length);
+
+    if (__atomic_exchange_n(&led_strip->frame_pending, true, __ATOMIC_SEQ_CST)) {
+        led_strip->frames_skipped++;
+    }
+
+    if (led_strip->task_handle) {
+        xTaskNotifyGive(led_strip->task_handle);
     }
-    xSemaphoreGive(led_strip->access_semaphore);
 
     return success;
 }
 
+bool led_strip_get_frame_stats(struct led_strip_t *led_strip, uint32_t *frames_sent, uint32_t *frames_skipped)
+{
+    if ((!led_strip) || (!frames_sent) || (!frames_skipped)) {
+        return false;
+    }
+
+    *frames_sent = led_strip->frames_sent;
+    *frames_skipped = led_strip->frames_skipped;
+
+    return true;
+}
+
 /**
  * Clears the LED strip
  */
@@ -439,11 +489,7 @@ bool led_strip_clear(struct led_strip_t *led_strip)
         return false;
     }
 
-    if (led_strip->showing_buf_1) {
-        memset(led_strip->led_strip_buf_2, 0, sizeof(struct led_color_t) * led_strip->led_strip_length);
-    } else {
-        memset(led_strip->led_strip_buf_1, 0, sizeof(struct led_color_t) * led_strip->led_strip_length);
-    }
+    memset(led_strip_back_buf(led_strip), 0, sizeof(struct led_color_t) * led_strip->led_strip_length);
 
     return success;
 }
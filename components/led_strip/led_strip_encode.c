@@ -0,0 +1,277 @@
+/*  ----------------------------------------------------------------------------
+    File: led_strip_encode.c
+
+    Description: RMT waveform encoders for the led types supported by led_strip.
+
+    The bitwise encoders walk every bit of every color byte. led_strip_encode
+    produces the same items from a table of the eight items of each byte value,
+    built once per led type by led_strip_encoder_init.
+    ------------------------------------------------------------------------- */
+
+#include "led_strip/led_strip_encode.h"
+#include "esp_attr.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/****************************
+        WS2812 Timing
+ ****************************/
+#define LED_STRIP_RMT_TICKS_BIT_1_HIGH_WS2812 9 // 900ns (900ns +/- 150ns per datasheet)
+#define LED_STRIP_RMT_TICKS_BIT_1_LOW_WS2812  3 // 300ns (350ns +/- 150ns per datasheet)
+#define LED_STRIP_RMT_TICKS_BIT_0_HIGH_WS2812 3 // 300ns (350ns +/- 150ns per datasheet)
+#define LED_STRIP_RMT_TICKS_BIT_0_LOW_WS2812  9 // 900ns (900ns +/- 150ns per datasheet)
+
+/****************************
+        SK6812 Timing
+ ****************************/
+#define LED_STRIP_RMT_TICKS_BIT_1_HIGH_SK6812 6
+#define LED_STRIP_RMT_TICKS_BIT_1_LOW_SK6812  6
+#define LED_STRIP_RMT_TICKS_BIT_0_HIGH_SK6812 3
+#define LED_STRIP_RMT_TICKS_BIT_0_LOW_SK6812  9
+
+/****************************
+        APA106 Timing
+ ****************************/
+#define LED_STRIP_RMT_TICKS_BIT_1_HIGH_APA106 14 // 1.36us +/- 150ns per datasheet
+#define LED_STRIP_RMT_TICKS_BIT_1_LOW_APA106   3 // 350ns +/- 150ns per datasheet
+#define LED_STRIP_RMT_TICKS_BIT_0_HIGH_APA106  3 // 350ns +/- 150ns per datasheet
+#define LED_STRIP_RMT_TICKS_BIT_0_LOW_APA106  14 // 1.36us +/- 150ns per datasheet
+
+// Function pointer for generating waveforms based on different LED drivers
+typedef void (*led_fill_rmt_items_fn)(const struct led_color_t *led_strip_buf, rmt_item32_t *rmt_items, uint32_t led_strip_length);
+
+static inline void led_strip_fill_item_level(rmt_item32_t* item, int high_ticks, int low_ticks)
+{
+    item->level0 = 1;
+    item->duration0 = high_ticks;
+    item->level1 = 0;
+    item->duration1 = low_ticks;
+}
+
+static inline void led_strip_rmt_bit_1_sk6812(rmt_item32_t* item)
+{
+    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_1_HIGH_SK6812, LED_STRIP_RMT_TICKS_BIT_1_LOW_SK6812);
+}
+
+static inline void led_strip_rmt_bit_0_sk6812(rmt_item32_t* item)
+{
+    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_0_HIGH_SK6812, LED_STRIP_RMT_TICKS_BIT_0_LOW_SK6812);
+}
+
+static void led_strip_fill_rmt_items_sk6812(const struct led_color_t *led_strip_buf, rmt_item32_t *rmt_items, uint32_t led_strip_length)
+{
+    uint32_t rmt_items_index = 0;
+    for (uint32_t led_index = 0; led_index < led_strip_length; led_index++) {
+        struct led_color_t led_color = led_strip_buf[led_index];
+
+        for (uint8_t bit = 8; bit != 0; bit--) {
+            uint8_t bit_set = (led_color.green >> (bit - 1)) & 1;
+            if(bit_set) {
+                led_strip_rmt_bit_1_sk6812(&(rmt_items[rmt_items_index]));
+            } else {
+                led_strip_rmt_bit_0_sk6812(&(rmt_items[rmt_items_index]));
+            }
+            rmt_items_index++;
+        }
+        for (uint8_t bit = 8; bit != 0; bit--) {
+            uint8_t bit_set = (led_color.red >> (bit - 1)) & 1;
+            if(bit_set) {
+                led_strip_rmt_bit_1_sk6812(&(rmt_items[rmt_items_index]));
+            } else {
+                led_strip_rmt_bit_0_sk6812(&(rmt_items[rmt_items_index]));
+            }
+            rmt_items_index++;
+        }
+        for (uint8_t bit = 8; bit != 0; bit--) {
+            uint8_t bit_set = (led_color.blue >> (bit - 1)) & 1;
+            if(bit_set) {
+                led_strip_rmt_bit_1_sk6812(&(rmt_items[rmt_items_index]));
+            } else {
+                led_strip_rmt_bit_0_sk6812(&(rmt_items[rmt_items_index]));
+            }
+            rmt_items_index++;
+        }
+    }
+}
+
+static inline void led_strip_rmt_bit_1_ws2812(rmt_item32_t* item)
+{
+    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_1_HIGH_WS2812, LED_STRIP_RMT_TICKS_BIT_1_LOW_WS2812);
+}
+
+static inline void led_strip_rmt_bit_0_ws2812(rmt_item32_t* item)
+{
+    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_0_HIGH_WS2812, LED_STRIP_RMT_TICKS_BIT_0_LOW_WS2812);
+}
+
+static void led_strip_fill_rmt_items_ws2812(const struct led_color_t *led_strip_buf, rmt_item32_t *rmt_items, uint32_t led_strip_length)
+{
+    uint32_t rmt_items_index = 0;
+    for (uint32_t led_index = 0; led_index < led_strip_length; led_index++) {
+        struct led_color_t led_color = led_strip_buf[led_index];
+
+        for (uint8_t bit = 8; bit != 0; bit--) {
+            uint8_t bit_set = (led_color.green >> (bit - 1)) & 1;
+            if(bit_set) {
+                led_strip_rmt_bit_1_ws2812(&(rmt_items[rmt_items_index]));
+            } else {
+                led_strip_rmt_bit_0_ws2812(&(rmt_items[rmt_items_index]));
+            }
+            rmt_items_index++;
+        }
+        for (uint8_t bit = 8; bit != 0; bit--) {
+            uint8_t bit_set = (led_color.red >> (bit - 1)) & 1;
+            if(bit_set) {
+                led_strip_rmt_bit_1_ws2812(&(rmt_items[rmt_items_index]));
+            } else {
+                led_strip_rmt_bit_0_ws2812(&(rmt_items[rmt_items_index]));
+            }
+            rmt_items_index++;
+        }
+        for (uint8_t bit = 8; bit != 0; bit--) {
+            uint8_t bit_set = (led_color.blue >> (bit - 1)) & 1;
+            if(bit_set) {
+                led_strip_rmt_bit_1_ws2812(&(rmt_items[rmt_items_index]));
+            } else {
+                led_strip_rmt_bit_0_ws2812(&(rmt_items[rmt_items_index]));
+            }
+            rmt_items_index++;
+        }
+    }
+}
+
+static inline void led_strip_rmt_bit_1_apa106(rmt_item32_t* item)
+{
+    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_1_HIGH_APA106, LED_STRIP_RMT_TICKS_BIT_1_LOW_APA106);
+}
+
+static inline void led_strip_rmt_bit_0_apa106(rmt_item32_t* item)
+{
+    led_strip_fill_item_level(item, LED_STRIP_RMT_TICKS_BIT_0_HIGH_APA106, LED_STRIP_RMT_TICKS_BIT_0_LOW_APA106);
+}
+
+static void led_strip_fill_rmt_items_apa106(const struct led_color_t *led_strip_buf, rmt_item32_t *rmt_items, uint32_t led_strip_length)
+{
+    uint32_t rmt_items_index = 0;
+    for (uint32_t led_index = 0; led_index < led_strip_length; led_index++) {
+        struct led_color_t led_color = led_strip_buf[led_index];
+
+        for (uint8_t bit = 8; bit != 0; bit--) {
+            uint8_t bit_set = (led_color.red >> (bit - 1)) & 1;
+            if(bit_set) {
+                led_strip_rmt_bit_1_apa106(&(rmt_items[rmt_items_index]));
+            } else {
+                led_strip_rmt_bit_0_apa106(&(rmt_items[rmt_items_index]));
+            }
+            rmt_items_index++;
+        }
+        for (uint8_t bit = 8; bit != 0; bit--) {
+            uint8_t bit_set = (led_color.green >> (bit - 1)) & 1;
+            if(bit_set) {
+                led_strip_rmt_bit_1_apa106(&(rmt_items[rmt_items_index]));
+            } else {
+                led_strip_rmt_bit_0_apa106(&(rmt_items[rmt_items_index]));
+            }
+            rmt_items_index++;
+        }
+        for (uint8_t bit = 8; bit != 0; bit--) {
+            uint8_t bit_set = (led_color.blue >> (bit - 1)) & 1;
+            if(bit_set) {
+                led_strip_rmt_bit_1_apa106(&(rmt_items[rmt_items_index]));
+            } else {
+                led_strip_rmt_bit_0_apa106(&(rmt_items[rmt_items_index]));
+            }
+            rmt_items_index++;
+        }
+    }
+}
+
+static led_fill_rmt_items_fn led_strip_bitwise_fn(enum rgb_led_type_t rgb_led_type)
+{
+    switch (rgb_led_type) {
+        case RGB_LED_TYPE_SK6812:
+            return led_strip_fill_rmt_items_sk6812;
+
+        case RGB_LED_TYPE_APA106:
+            return led_strip_fill_rmt_items_apa106;
+
+        case RGB_LED_TYPE_WS2812:
+        default:
+            // Will avoid keeping it point to NULL
+            return led_strip_fill_rmt_items_ws2812;
+    };
+}
+
+void led_strip_encode_bitwise(enum rgb_led_type_t rgb_led_type, const struct led_color_t *led_strip_buf,
+                              rmt_item32_t *rmt_items, uint32_t led_strip_length)
+{
+    led_strip_bitwise_fn(rgb_led_type)(led_strip_buf, rmt_items, led_strip_length);
+}
+
+void led_strip_encoder_init(struct led_strip_encoder_t *encoder, enum rgb_led_type_t rgb_led_type)
+{
+    led_fill_rmt_items_fn make_waveform = led_strip_bitwise_fn(rgb_led_type);
+    rmt_item32_t items[LED_STRIP_NUM_RMT_ITEMS_PER_LED];
+
+    encoder->rgb_led_type = rgb_led_type;
+    if (rgb_led_type == RGB_LED_TYPE_APA106) {
+        encoder->wire_order[0] = offsetof(struct led_color_t, red);
+        encoder->wire_order[1] = offsetof(struct led_color_t, green);
+    } else {
+        encoder->wire_order[0] = offsetof(struct led_color_t, green);
+        encoder->wire_order[1] = offsetof(struct led_color_t, red);
+    }
+    encoder->wire_order[2] = offsetof(struct led_color_t, blue);
+    for (uint32_t value = 0; value < 256; value++) {
+        // The first byte on the wire is green or red depending on the type, set both
+        struct led_color_t color = { .red = value, .green = value, .blue = value };
+        make_waveform(&color, items, 1);
+        memcpy(encoder->byte_items[value], items, sizeof(encoder->byte_items[value]));
+    }
+}
+
+void led_strip_encode(const struct led_strip_encoder_t *encoder, const struct led_color_t *led_strip_buf,
+                      rmt_item32_t *rmt_items, uint32_t led_strip_length)
+{
+    const size_t byte_size = sizeof(encoder->byte_items[0]);
+
+    if (encoder->rgb_led_type == RGB_LED_TYPE_APA106) {
+        for (uint32_t led_index = 0; led_index < led_strip_length; led_index++) {
+            struct led_color_t led_color = led_strip_buf[led_index];
+            memcpy(rmt_items, encoder->byte_items[led_color.red], byte_size);
+            memcpy(rmt_items + 8, encoder->byte_items[led_color.green], byte_size);
+            memcpy(rmt_items + 16, encoder->byte_items[led_color.blue], byte_size);
+            rmt_items += LED_STRIP_NUM_RMT_ITEMS_PER_LED;
+        }
+    } else {
+        for (uint32_t led_index = 0; led_index < led_strip_length; led_index++) {
+            struct led_color_t led_color = led_strip_buf[led_index];
+            memcpy(rmt_items, encoder->byte_items[led_color.green], byte_size);
+            memcpy(rmt_items + 8, encoder->byte_items[led_color.red], byte_size);
+            memcpy(rmt_items + 16, encoder->byte_items[led_color.blue], byte_size);
+            rmt_items += LED_STRIP_NUM_RMT_ITEMS_PER_LED;
+        }
+    }
+}
+
+/*
+ * Runs from the RMT interrupt through the translator, keep it in IRAM
+ */
+void IRAM_ATTR led_strip_encode_bytes(const struct led_strip_encoder_t *encoder, const struct led_color_t *led_strip_buf,
+                                      uint32_t byte_offset, uint32_t count, rmt_item32_t *rmt_items)
+{
+    const uint8_t *bytes = (const uint8_t *)led_strip_buf;
+    uint32_t led_index = byte_offset / sizeof(struct led_color_t);
+    uint32_t wire_index = byte_offset % sizeof(struct led_color_t);
+
+    while (count--) {
+        uint8_t value = bytes[led_index * sizeof(struct led_color_t) + encoder->wire_order[wire_index]];
+        memcpy(rmt_items, encoder->byte_items[value], sizeof(encoder->byte_items[value]));
+        rmt_items += 8;
+        if (++wire_index == sizeof(struct led_color_t)) {
+            wire_index = 0;
+            led_index++;
+        }
+    }
+}
@@ -0,0 +1,387 @@
+/*
+ * Fake RMT driver, see fake_rmt.h
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include <errno.h>
+
+#include "fake_rmt.h"
+#include "esp_timer.h"
+
+#define FAKE_RMT_BLOCK_ITEMS    (64)
+#define FAKE_RMT_APB_HZ         (80000000U)
+
+/*
+ * Nominal times and tolerances from the datasheets:
+ * WS2812B rev 5, SK6812 rev 1.2 and APA106 rev 1.0.
+ */
+const struct fake_rmt_chip_t fake_rmt_chips[RGB_LED_TYPE_MAX] = {
+    [RGB_LED_TYPE_WS2812] = {
+        .name = "WS2812", .t0h_ns = 400, .t0l_ns = 850, .t1h_ns = 800, .t1l_ns = 450,
+        .tolerance_ns = 150, .reset_ns = 50000,
+        .wire_order = { offsetof(struct led_color_t, green), offsetof(struct led_color_t, red), offsetof(struct led_color_t, blue) },
+    },
+    [RGB_LED_TYPE_SK6812] = {
+        .name = "SK6812", .t0h_ns = 300, .t0l_ns = 900, .t1h_ns = 600, .t1l_ns = 600,
+        .tolerance_ns = 150, .reset_ns = 80000,
+        .wire_order = { offsetof(struct led_color_t, green), offsetof(struct led_color_t, red), offsetof(struct led_color_t, blue) },
+    },
+    [RGB_LED_TYPE_APA106] = {
+        .name = "APA106", .t0h_ns = 350, .t0l_ns = 1360, .t1h_ns = 1360, .t1l_ns = 350,
+        .tolerance_ns = 150, .reset_ns = 50000,
+        .wire_order = { offsetof(struct led_color_t, red), offsetof(struct led_color_t, green), offsetof(struct led_color_t, blue) },
+    },
+};
+
+struct fake_rmt_channel_t {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    rmt_config_t config;
+    bool configured;
+    bool installed;
+    sample_to_rmt_t translator;
+    int64_t tx_end_us;
+    uint32_t frame_count;
+    struct fake_rmt_frame_t frames[FAKE_RMT_MAX_FRAMES];
+};
+
+static struct fake_rmt_channel_t fake_rmt_channels[RMT_CHANNEL_MAX];
+static pthread_once_t fake_rmt_once = PTHREAD_ONCE_INIT;
+static struct timespec fake_rmt_epoch;
+
+static void fake_rmt_init_once(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &fake_rmt_epoch);
+    for (int i = 0; i < RMT_CHANNEL_MAX; i++) {
+        pthread_mutex_init(&fake_rmt_channels[i].lock, NULL);
+        pthread_cond_init(&fake_rmt_channels[i].cond, NULL);
+    }
+}
+
+static int64_t fake_rmt_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - fake_rmt_epoch.tv_sec) * 1000000000 + (now.tv_nsec - fake_rmt_epoch.tv_nsec);
+}
+
+// Same time base as the tasks, so frames can be compared with esp_timer_get_time
+static int64_t fake_rmt_now_us(void)
+{
+    return esp_timer_get_time();
+}
+
+static void fake_rmt_sleep_until_us(int64_t wake_us)
+{
+    int64_t delay = wake_us - fake_rmt_now_us();
+    if (delay > 0) {
+        struct timespec ts = { .tv_sec = delay / 1000000, .tv_nsec = (delay % 1000000) * 1000 };
+        while (nanosleep(&ts, &ts) && errno == EINTR) {
+        }
+    }
+}
+
+static struct fake_rmt_channel_t *fake_rmt_get(rmt_channel_t channel)
+{
+    pthread_once(&fake_rmt_once, fake_rmt_init_once);
+    if (channel >= RMT_CHANNEL_MAX) {
+        return NULL;
+    }
+    return &fake_rmt_channels[channel];
+}
+
+esp_err_t rmt_config(const rmt_config_t *rmt_param)
+{
+    struct fake_rmt_channel_t *ch = rmt_param ? fake_rmt_get(rmt_param->channel) : NULL;
+    if (!ch || rmt_param->rmt_mode != RMT_MODE_TX || rmt_param->clk_div == 0 ||
+        rmt_param->mem_block_num == 0 || rmt_param->channel + rmt_param->mem_block_num > RMT_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&ch->lock);
+    ch->config = *rmt_param;
+    ch->configured = true;
+    pthread_mutex_unlock(&ch->lock);
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags)
+{
+    (void)rx_buf_size;
+    (void)intr_alloc_flags;
+    struct fake_rmt_channel_t *ch = fake_rmt_get(channel);
+    if (!ch || !ch->configured) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (ch->installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ch->installed = true;
+    return ESP_OK;
+}
+
+esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t fn)
+{
+    struct fake_rmt_channel_t *ch = fake_rmt_get(channel);
+    if (!ch || !ch->installed || !fn) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ch->translator = fn;
+    return ESP_OK;
+}
+
+uint32_t fake_rmt_tick_ns(rmt_channel_t channel)
+{
+    struct fake_rmt_channel_t *ch = fake_rmt_get(channel);
+    return (uint32_t)(1000000000ULL * ch->config.clk_div / FAKE_RMT_APB_HZ);
+}
+
+esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *src, size_t src_size, bool wait_tx_done)
+{
+    struct fake_rmt_channel_t *ch = fake_rmt_get(channel);
+    if (!ch || !ch->installed || !ch->translator || !src) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Like the driver, a new write waits for the previous one to leave the channel
+    fake_rmt_sleep_until_us(ch->tx_end_us);
+
+    uint32_t block = FAKE_RMT_BLOCK_ITEMS * ch->config.mem_block_num;
+    // The translator never returns more than it was asked for, a byte is at most 8 items
+    rmt_item32_t *items = malloc((src_size * 8 + block) * sizeof(rmt_item32_t));
+    if (!items) {
+        return ESP_FAIL;
+    }
+
+    struct fake_rmt_frame_t frame = { .items = items };
+    size_t done = 0;
+    size_t wanted = block;
+    int64_t t0 = fake_rmt_now_ns();
+    while (done < src_size) {
+        size_t translated = 0, item_num = 0;
+        ch->translator(src + done, items + frame.item_count, src_size - done, wanted, &translated, &item_num);
+        frame.translate_calls++;
+        if ((translated == 0 && item_num == 0) || item_num > wanted) {
+            break;
+        }
+        done += translated;
+        frame.item_count += item_num;
+        // After the first fill, the interrupt refills half the memory at a time
+        wanted = block / 2;
+    }
+    frame.translate_ns = fake_rmt_now_ns() - t0;
+
+    uint32_t tick_ns = fake_rmt_tick_ns(channel);
+    int64_t wire_ns = 0;
+    for (uint32_t i = 0; i < frame.item_count; i++) {
+        wire_ns += (int64_t)(items[i].duration0 + items[i].duration1) * tick_ns;
+    }
+    frame.start_us = fake_rmt_now_us();
+    frame.end_us = frame.start_us + (wire_ns + 999) / 1000;
+
+    pthread_mutex_lock(&ch->lock);
+    ch->tx_end_us = frame.end_us;
+    if (ch->frame_count < FAKE_RMT_MAX_FRAMES) {
+        ch->frames[ch->frame_count++] = frame;
+    } else {
+        free(items);
+    }
+    pthread_cond_broadcast(&ch->cond);
+    pthread_mutex_unlock(&ch->lock);
+
+    if (wait_tx_done) {
+        fake_rmt_sleep_until_us(frame.end_us);
+    }
+    return done == src_size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time)
+{
+    struct fake_rmt_channel_t *ch = fake_rmt_get(channel);
+    if (!ch || !ch->installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t end_us = ch->tx_end_us;
+    if (wait_time != portMAX_DELAY && end_us - fake_rmt_now_us() > (int64_t)wait_time * portTICK_PERIOD_MS * 1000) {
+        fake_rmt_sleep_until_us(fake_rmt_now_us() + (int64_t)wait_time * portTICK_PERIOD_MS * 1000);
+        return ESP_ERR_TIMEOUT;
+    }
+    fake_rmt_sleep_until_us(end_us);
+    return ESP_OK;
+}
+
+void fake_rmt_reset(rmt_channel_t channel)
+{
+    struct fake_rmt_channel_t *ch = fake_rmt_get(channel);
+    pthread_mutex_lock(&ch->lock);
+    for (uint32_t i = 0; i < ch->frame_count; i++) {
+        free(ch->frames[i].items);
+    }
+    ch->frame_count = 0;
+    pthread_mutex_unlock(&ch->lock);
+}
+
+uint32_t fake_rmt_frame_count(rmt_channel_t channel)
+{
+    struct fake_rmt_channel_t *ch = fake_rmt_get(channel);
+    pthread_mutex_lock(&ch->lock);
+    uint32_t count = ch->frame_count;
+    pthread_mutex_unlock(&ch->lock);
+    return count;
+}
+
+bool fake_rmt_wait_frames(rmt_channel_t channel, uint32_t count, uint32_t timeout_ms)
+{
+    struct fake_rmt_channel_t *ch = fake_rmt_get(channel);
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&ch->lock);
+    while (ch->frame_count < count) {
+        if (pthread_cond_timedwait(&ch->cond, &ch->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    bool ok = ch->frame_count >= count;
+    pthread_mutex_unlock(&ch->lock);
+
+    // Captured at the start of the transmit, let it finish on the wire
+    if (ok) {
+        rmt_wait_tx_done(channel, portMAX_DELAY);
+    }
+    return ok;
+}
+
+const struct fake_rmt_frame_t *fake_rmt_frame(rmt_channel_t channel, uint32_t index)
+{
+    struct fake_rmt_channel_t *ch = fake_rmt_get(channel);
+    pthread_mutex_lock(&ch->lock);
+    const struct fake_rmt_frame_t *frame = index < ch->frame_count ? &ch->frames[index] : NULL;
+    pthread_mutex_unlock(&ch->lock);
+    return frame;
+}
+
+static bool fake_rmt_in_tolerance(uint32_t ns, uint32_t nominal, uint32_t tolerance)
+{
+    return ns + tolerance >= nominal && ns <= nominal + tolerance;
+}
+
+static void fake_rmt_timing_init(struct fake_rmt_timing_t *timing)
+{
+    memset(timing, 0, sizeof(*timing));
+    for (int bit = 0; bit < 2; bit++) {
+        timing->min_high_ns[bit] = UINT32_MAX;
+        timing->min_low_ns[bit] = UINT32_MAX;
+    }
+    timing->first_bad_item = -1;
+    timing->min_gap_us = -1;
+}
+
+static void fake_rmt_decode_items(uint32_t tick_ns, const struct fake_rmt_chip_t *chip,
+                                  const struct fake_rmt_frame_t *frame, struct led_color_t *pixels,
+                                  uint32_t max_pixels, struct fake_rmt_timing_t *timing)
+{
+    uint8_t byte = 0;
+    for (uint32_t i = 0; i < frame->item_count; i++) {
+        const rmt_item32_t *item = &frame->items[i];
+        uint32_t high_ns = item->duration0 * tick_ns;
+        uint32_t low_ns = item->duration1 * tick_ns;
+        // Whichever nominal high time is closer decides the bit, the tolerance check follows
+        uint32_t d0 = high_ns > chip->t0h_ns ? high_ns - chip->t0h_ns : chip->t0h_ns - high_ns;
+        uint32_t d1 = high_ns > chip->t1h_ns ? high_ns - chip->t1h_ns : chip->t1h_ns - high_ns;
+        int bit = d1 < d0;
+
+        bool ok = item->level0 == 1 && item->level1 == 0;
+        if (bit) {
+            ok = ok && fake_rmt_in_tolerance(high_ns, chip->t1h_ns, chip->tolerance_ns) &&
+                 fake_rmt_in_tolerance(low_ns, chip->t1l_ns, chip->tolerance_ns);
+        } else {
+            ok = ok && fake_rmt_in_tolerance(high_ns, chip->t0h_ns, chip->tolerance_ns) &&
+                 fake_rmt_in_tolerance(low_ns, chip->t0l_ns, chip->tolerance_ns);
+        }
+        if (!ok) {
+            if (timing->first_bad_item < 0) {
+                timing->first_bad_item = i;
+            }
+            timing->bad_items++;
+        }
+        if (high_ns < timing->min_high_ns[bit]) timing->min_high_ns[bit] = high_ns;
+        if (high_ns > timing->max_high_ns[bit]) timing->max_high_ns[bit] = high_ns;
+        if (low_ns < timing->min_low_ns[bit]) timing->min_low_ns[bit] = low_ns;
+        if (low_ns > timing->max_low_ns[bit]) timing->max_low_ns[bit] = low_ns;
+
+        byte = (uint8_t)((byte << 1) | bit);
+        if ((i & 7) == 7) {
+            uint32_t wire_byte = i / 8;
+            uint32_t pixel = wire_byte / 3;
+            if (pixel < max_pixels) {
+                ((uint8_t *)&pixels[pixel])[chip->wire_order[wire_byte % 3]] = byte;
+            }
+        }
+    }
+}
+
+uint32_t fake_rmt_decode(rmt_channel_t channel, const struct fake_rmt_chip_t *chip,
+                         const struct fake_rmt_frame_t *frame, struct led_color_t *pixels,
+                         uint32_t max_pixels, struct fake_rmt_timing_t *timing)
+{
+    struct fake_rmt_timing_t local;
+    if (!timing) {
+        timing = &local;
+    }
+    fake_rmt_timing_init(timing);
+    fake_rmt_decode_items(fake_rmt_tick_ns(channel), chip, frame, pixels, max_pixels, timing);
+
+    uint32_t decoded = frame->item_count / 24;
+    return decoded < max_pixels ? decoded : max_pixels;
+}
+
+bool fake_rmt_check_timing(rmt_channel_t channel, const struct fake_rmt_chip_t *chip,
+                           struct fake_rmt_timing_t *timing)
+{
+    uint32_t tick_ns = fake_rmt_tick_ns(channel);
+    uint32_t count = fake_rmt_frame_count(channel);
+    bool gaps_ok = true;
+
+    fake_rmt_timing_init(timing);
+    for (uint32_t f = 0; f < count; f++) {
+        const struct fake_rmt_frame_t *frame = fake_rmt_frame(channel, f);
+        fake_rmt_decode_items(tick_ns, chip, frame, NULL, 0, timing);
+        if (f > 0) {
+            int64_t gap = frame->start_us - fake_rmt_frame(channel, f - 1)->end_us;
+            if (timing->min_gap_us < 0 || gap < timing->min_gap_us) {
+                timing->min_gap_us = gap;
+            }
+            if (gap * 1000 < chip->reset_ns) {
+                gaps_ok = false;
+            }
+        }
+    }
+    return gaps_ok && timing->bad_items == 0;
+}
+
+void fake_rmt_dump_timeline(FILE *out, rmt_channel_t channel, const struct fake_rmt_chip_t *chip)
+{
+    uint32_t count = fake_rmt_frame_count(channel);
+    for (uint32_t f = 0; f < count; f++) {
+        const struct fake_rmt_frame_t *frame = fake_rmt_frame(channel, f);
+        uint32_t max_pixels = frame->item_count / 24;
+        struct led_color_t *pixels = calloc(max_pixels ? max_pixels : 1, sizeof(struct led_color_t));
+        uint32_t n = fake_rmt_decode(channel, chip, frame, pixels, max_pixels, NULL);
+
+        fprintf(out, "%10.3f ms ch%d %-6s frame %4u:", frame->start_us / 1000.0, channel, chip->name, f);
+        for (uint32_t i = 0; i < n; i++) {
+            fprintf(out, " %02x%02x%02x", pixels[i].red, pixels[i].green, pixels[i].blue);
+        }
+        fprintf(out, "\n");
+        free(pixels);
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ * Fake RMT driver for the host led strip simulator.
+ *
+ * rmt_write_sample pulls the items from the registered translator the way the
+ * driver does (one memory block, then half blocks) and records every frame
+ * with its start and end on the wire. A transmit takes as long as the items
+ * would on the real line, and channels transmit independently, so parallel
+ * and serial output can be compared.
+ */
+
+#ifndef _FAKE_RMT_H_
+#define _FAKE_RMT_H_
+
+#include <stdio.h>
+#include "led_strip/led_strip.h"
+
+#define FAKE_RMT_MAX_FRAMES     (512)
+
+struct fake_rmt_frame_t {
+    int64_t start_us;           // esp_timer_get_time() time base
+    int64_t end_us;
+    uint32_t item_count;
+    rmt_item32_t *items;
+    uint32_t translate_calls;
+    int64_t translate_ns;       // Host time spent in the translator
+};
+
+/**
+ * Datasheet timing of a led chip. A bit is valid if both halves are within
+ * tolerance_ns of the nominal time.
+ */
+struct fake_rmt_chip_t {
+    const char *name;
+    uint32_t t0h_ns;
+    uint32_t t0l_ns;
+    uint32_t t1h_ns;
+    uint32_t t1l_ns;
+    uint32_t tolerance_ns;
+    uint32_t reset_ns;          // Minimum low time latching a frame
+    uint8_t wire_order[3];      // Offset in led_color_t of each byte on the wire
+};
+
+extern const struct fake_rmt_chip_t fake_rmt_chips[RGB_LED_TYPE_MAX];
+
+struct fake_rmt_timing_t {
+    uint32_t min_high_ns[2];    // Per bit value
+    uint32_t max_high_ns[2];
+    uint32_t min_low_ns[2];
+    uint32_t max_low_ns[2];
+    uint32_t bad_items;         // Items out of tolerance or with wrong levels
+    int32_t first_bad_item;
+    int64_t min_gap_us;         // Shortest idle time between frames, -1 with a single frame
+};
+
+/**
+ * Forgets the frames captured on channel
+ */
+void fake_rmt_reset(rmt_channel_t channel);
+
+uint32_t fake_rmt_frame_count(rmt_channel_t channel);
+
+/**
+ * Waits up to timeout_ms for channel to have captured count frames
+ */
+bool fake_rmt_wait_frames(rmt_channel_t channel, uint32_t count, uint32_t timeout_ms);
+
+/**
+ * The captured frame, valid until fake_rmt_reset
+ */
+const struct fake_rmt_frame_t *fake_rmt_frame(rmt_channel_t channel, uint32_t index);
+
+/**
+ * Nanoseconds per RMT tick of the configured channel
+ */
+uint32_t fake_rmt_tick_ns(rmt_channel_t channel);
+
+/**
+ * Decodes the items of a frame back to pixels, checking the timing of every
+ * bit against the chip. Returns the number of whole pixels decoded.
+ */
+uint32_t fake_rmt_decode(rmt_channel_t channel, const struct fake_rmt_chip_t *chip,
+                         const struct fake_rmt_frame_t *frame, struct led_color_t *pixels,
+                         uint32_t max_pixels, struct fake_rmt_timing_t *timing);
+
+/**
+ * Checks the reset gap between all captured frames of the channel.
+ * Returns true if every frame has valid timing.
+ */
+bool fake_rmt_check_timing(rmt_channel_t channel, const struct fake_rmt_chip_t *chip,
+                           struct fake_rmt_timing_t *timing);
+
+/**
+ * Writes one line per captured frame: time on the wire, then every pixel as rrggbb
+ */
+void fake_rmt_dump_timeline(FILE *out, rmt_channel_t channel, const struct fake_rmt_chip_t *chip);
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * FreeRTOS task API on pthreads, enough to run the led_strip and led_effect
+ * tasks on the host. Ticks follow the monotonic clock at portTICK_PERIOD_MS,
+ * esp_timer_get_time counts from the same start.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+struct host_task {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+static __thread struct host_task *host_current_task;
+static struct timespec host_epoch;
+static pthread_once_t host_epoch_once = PTHREAD_ONCE_INIT;
+
+static void host_epoch_init(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &host_epoch);
+}
+
+static int64_t host_elapsed_us(void)
+{
+    struct timespec now;
+    pthread_once(&host_epoch_once, host_epoch_init);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - host_epoch.tv_sec) * 1000000 + (now.tv_nsec - host_epoch.tv_nsec) / 1000;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return host_elapsed_us();
+}
+
+static void host_sleep_until_us(int64_t wake_us)
+{
+    int64_t delay = wake_us - host_elapsed_us();
+    if (delay > 0) {
+        struct timespec ts = { .tv_sec = delay / 1000000, .tv_nsec = (delay % 1000000) * 1000 };
+        while (nanosleep(&ts, &ts) && errno == EINTR) {
+        }
+    }
+}
+
+static void *host_task_entry(void *arg)
+{
+    struct host_task *task = (struct host_task *)arg;
+    host_current_task = task;
+    task->fn(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    (void)name;
+    (void)stack_depth;
+    (void)priority;
+
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    if (!task) {
+        return pdFALSE;
+    }
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    task->fn = fn;
+    task->arg = arg;
+    if (handle) {
+        *handle = task;
+    }
+    if (pthread_create(&task->thread, NULL, host_task_entry, task)) {
+        free(task);
+        return pdFALSE;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == host_current_task) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(task->thread);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(host_elapsed_us() / (portTICK_PERIOD_MS * 1000));
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    host_sleep_until_us(host_elapsed_us() + (int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment)
+{
+    *previous_wake += increment;
+    host_sleep_until_us((int64_t)*previous_wake * portTICK_PERIOD_MS * 1000);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    struct host_task *task = host_current_task;
+    uint32_t value;
+
+    pthread_mutex_lock(&task->lock);
+    if (ticks_to_wait == portMAX_DELAY) {
+        while (task->notify == 0) {
+            pthread_cond_wait(&task->cond, &task->lock);
+        }
+    } else {
+        struct timespec deadline;
+        int64_t wait_us = (int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += wait_us / 1000000;
+        deadline.tv_nsec += (wait_us % 1000000) * 1000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        while (task->notify == 0) {
+            if (pthread_cond_timedwait(&task->cond, &task->lock, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+    value = task->notify;
+    if (value) {
+        task->notify = clear_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
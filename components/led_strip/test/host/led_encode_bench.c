@@ -0,0 +1,128 @@
+/*
+ * Host bench for the led_strip RMT encoders.
+ *
+ * Checks the table encoder produces the same items as the bitwise encoder
+ * for every led type, and prints the encoding time of a frame for a few
+ * strip lengths.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "led_strip/led_strip_encode.h"
+
+#define BENCH_MIN_NS        (100 * 1000 * 1000LL)
+
+static const uint32_t lengths[] = { 8, 144, 300 };
+static const char *type_name[RGB_LED_TYPE_MAX] = { "WS2812", "SK6812", "APA106" };
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+typedef void (*encode_fn)(const struct led_strip_encoder_t *encoder, enum rgb_led_type_t type,
+                          const struct led_color_t *buf, rmt_item32_t *items, uint32_t length);
+
+static void run_bitwise(const struct led_strip_encoder_t *encoder, enum rgb_led_type_t type,
+                        const struct led_color_t *buf, rmt_item32_t *items, uint32_t length)
+{
+    led_strip_encode_bitwise(type, buf, items, length);
+}
+
+static void run_table(const struct led_strip_encoder_t *encoder, enum rgb_led_type_t type,
+                      const struct led_color_t *buf, rmt_item32_t *items, uint32_t length)
+{
+    led_strip_encode(encoder, buf, items, length);
+}
+
+/*
+ * Feed the items the way the RMT translator asks for them: one 64 item block,
+ * then half blocks of 32 items, i.e. 8 then 4 bytes at a time.
+ */
+static void run_translator(const struct led_strip_encoder_t *encoder, enum rgb_led_type_t type,
+                           const struct led_color_t *buf, rmt_item32_t *items, uint32_t length)
+{
+    uint32_t size = length * sizeof(struct led_color_t);
+    uint32_t offset = 0;
+    uint32_t wanted = 64;
+    while (offset < size) {
+        uint32_t count = wanted / 8;
+        if (count > size - offset) {
+            count = size - offset;
+        }
+        led_strip_encode_bytes(encoder, buf, offset, count, items + offset * 8);
+        offset += count;
+        wanted = 32;
+    }
+}
+
+static double time_frame(encode_fn fn, const struct led_strip_encoder_t *encoder, enum rgb_led_type_t type,
+                         const struct led_color_t *buf, rmt_item32_t *items, uint32_t length)
+{
+    long frames = 0;
+    int64_t start = now_ns(), elapsed;
+    do {
+        for (int i = 0; i < 64; i++) {
+            fn(encoder, type, buf, items, length);
+        }
+        frames += 64;
+        elapsed = now_ns() - start;
+    } while (elapsed < BENCH_MIN_NS);
+    return (double)elapsed / frames;
+}
+
+int main(void)
+{
+    int fail = 0;
+    struct led_strip_encoder_t *encoder = malloc(sizeof(struct led_strip_encoder_t));
+    srand(1);
+
+    for (int type = 0; type < RGB_LED_TYPE_MAX; type++) {
+        int64_t t0 = now_ns();
+        led_strip_encoder_init(encoder, type);
+        printf("%s: table init %.1f us\n", type_name[type], (now_ns() - t0) / 1000.0);
+
+        for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+            uint32_t length = lengths[l];
+            struct led_color_t *buf = malloc(length * sizeof(struct led_color_t));
+            rmt_item32_t *items_bit = malloc(length * LED_STRIP_NUM_RMT_ITEMS_PER_LED * sizeof(rmt_item32_t));
+            rmt_item32_t *items_lut = malloc(length * LED_STRIP_NUM_RMT_ITEMS_PER_LED * sizeof(rmt_item32_t));
+            rmt_item32_t *items_tr = malloc(length * LED_STRIP_NUM_RMT_ITEMS_PER_LED * sizeof(rmt_item32_t));
+            for (uint32_t i = 0; i < length; i++) {
+                buf[i].red = rand();
+                buf[i].green = rand();
+                buf[i].blue = rand();
+            }
+            // Make sure every byte value goes through the table at least once
+            for (uint32_t i = 0; i < length && i < 256; i++) {
+                buf[i].red = i;
+                buf[i].green = 255 - i;
+                buf[i].blue = i * 7;
+            }
+            led_strip_encode_bitwise(type, buf, items_bit, length);
+            led_strip_encode(encoder, buf, items_lut, length);
+            run_translator(encoder, type, buf, items_tr, length);
+            size_t items_size = length * LED_STRIP_NUM_RMT_ITEMS_PER_LED * sizeof(rmt_item32_t);
+            int same = !memcmp(items_bit, items_lut, items_size) && !memcmp(items_bit, items_tr, items_size);
+            fail |= !same;
+
+            double t_bit = time_frame(run_bitwise, encoder, type, buf, items_bit, length);
+            double t_lut = time_frame(run_table, encoder, type, buf, items_lut, length);
+            double t_tr = time_frame(run_translator, encoder, type, buf, items_tr, length);
+            printf("  %3u leds: output %s, bitwise %9.1f ns, table %9.1f ns (%.1fx), translator %9.1f ns\n",
+                   length, same ? "identical" : "DIFFERENT", t_bit, t_lut, t_bit / t_lut, t_tr);
+            free(buf);
+            free(items_bit);
+            free(items_lut);
+            free(items_tr);
+        }
+    }
+    free(encoder);
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
@@ -0,0 +1,410 @@
+/*
+ * Host led strip simulator.
+ *
+ * Runs led_strip.c, led_strip_encode.c and led_effect.c with their tasks on
+ * pthreads against the fake RMT driver, decodes what went out on the wire and
+ * checks it:
+ *   - pixels decode back to what was set, for every led type
+ *   - every bit is within the chip's datasheet tolerance, frames are
+ *     separated by at least the reset time
+ *   - a strip group transmits its channels in parallel
+ *   - the VU meter of i2s_stream_pcm and the effect engine light the strip,
+ *     the effect engine when the analyzed audio leaves the I2S DMA
+ * and benchmarks the effects. The translator time of every frame checked is
+ * printed with it.
+ *
+ *   led_strip_sim [-t timeline.txt]   also write the per frame pixel timeline
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "fake_rmt.h"
+#include "led_strip/led_effect.h"
+#include "i2s_stream_pcm.h"
+#include "esp_timer.h"
+
+#define SIM_FRAME_TIMEOUT_MS    (1000)
+#define SIM_BENCH_MIN_NS        (100 * 1000 * 1000LL)
+#define SIM_SAMPLE_RATE         (44100)
+#define SIM_AUDIO_FRAMES        (1024)
+#define SIM_DMA_DEPTH           (3 * 300)   // dma_buf_count * dma_buf_len of I2S_STREAM_CFG_DEFAULT
+
+static const uint32_t lengths[] = { 8, 144, 300 };
+static const char *mode_name[LED_EFFECT_MODE_MAX] = { "vu", "palette", "chase", "pulse" };
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_ms(uint32_t ms)
+{
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+struct sim_strip_t {
+    struct led_strip_t strip;
+    struct led_color_t *set;    // What the test wrote, to compare with the wire
+};
+
+static void sim_strip_alloc(struct sim_strip_t *sim, enum rgb_led_type_t type, rmt_channel_t channel, uint32_t length)
+{
+    struct led_strip_t strip = {
+        .rgb_led_type = type,
+        .led_strip_length = length,
+        .rmt_channel = channel,
+        .gpio = GPIO_NUM_4,
+        .led_strip_buf_1 = calloc(length, sizeof(struct led_color_t)),
+        .led_strip_buf_2 = calloc(length, sizeof(struct led_color_t)),
+    };
+    // The type and length are const members, copy the whole struct in
+    memcpy(&sim->strip, &strip, sizeof(strip));
+    sim->set = calloc(length, sizeof(struct led_color_t));
+}
+
+static void sim_strip_fill(struct sim_strip_t *sim)
+{
+    for (uint32_t i = 0; i < sim->strip.led_strip_length; i++) {
+        sim->set[i].red = rand();
+        sim->set[i].green = rand();
+        sim->set[i].blue = rand();
+        led_strip_set_pixel_color(&sim->strip, i, &sim->set[i]);
+    }
+}
+
+static bool sim_check_frame(struct sim_strip_t *sim, uint32_t index, const char *what)
+{
+    rmt_channel_t channel = sim->strip.rmt_channel;
+    const struct fake_rmt_chip_t *chip = &fake_rmt_chips[sim->strip.rgb_led_type];
+    const struct fake_rmt_frame_t *frame = fake_rmt_frame(channel, index);
+    if (!frame) {
+        printf("  %s %s: frame %u never sent\n", chip->name, what, index);
+        return false;
+    }
+
+    uint32_t length = sim->strip.led_strip_length;
+    struct led_color_t *wire = calloc(length, sizeof(struct led_color_t));
+    struct fake_rmt_timing_t timing;
+    uint32_t decoded = fake_rmt_decode(channel, chip, frame, wire, length, &timing);
+    bool same = decoded == length && !memcmp(wire, sim->set, length * sizeof(struct led_color_t));
+    free(wire);
+
+    printf("  %-6s %-10s %3u leds: pixels %s, %u bad bits, translator %u calls %.1f us, wire %.2f ms\n",
+           chip->name, what, length, same ? "match" : "DIFFER", timing.bad_items,
+           frame->translate_calls, frame->translate_ns / 1000.0, (frame->end_us - frame->start_us) / 1000.0);
+    return same && timing.bad_items == 0;
+}
+
+/*
+ * Every led type on its own channel: a frame decodes back to the pixels set,
+ * frames shown back to back are rate limited and keep the reset gap.
+ */
+static int test_led_types(void)
+{
+    // The strip tasks keep running after each test, the strips must outlive them
+    static struct sim_strip_t sims[RGB_LED_TYPE_MAX];
+    int fail = 0;
+
+    printf("Led types:\n");
+    for (int type = 0; type < RGB_LED_TYPE_MAX; type++) {
+        struct sim_strip_t *sim = &sims[type];
+        const struct fake_rmt_chip_t *chip = &fake_rmt_chips[type];
+        sim_strip_alloc(sim, type, (rmt_channel_t)type, 60);
+        if (!led_strip_init(&sim->strip)) {
+            printf("  %s: led_strip_init failed\n", chip->name);
+            fail = 1;
+            continue;
+        }
+
+        sim_strip_fill(sim);
+        led_strip_show(&sim->strip);
+        if (!fake_rmt_wait_frames(sim->strip.rmt_channel, 1, SIM_FRAME_TIMEOUT_MS) ||
+            !sim_check_frame(sim, 0, "single")) {
+            fail = 1;
+        }
+
+        // Shown faster than max_fps, some replace each other, the last one must go out
+        for (int f = 0; f < 5; f++) {
+            sim_strip_fill(sim);
+            led_strip_show(&sim->strip);
+        }
+        sleep_ms(100);
+        uint32_t sent = fake_rmt_frame_count(sim->strip.rmt_channel);
+        fail |= !sim_check_frame(sim, sent - 1, "burst last");
+
+        struct fake_rmt_timing_t timing;
+        bool timing_ok = fake_rmt_check_timing(sim->strip.rmt_channel, chip, &timing);
+        uint32_t frames_sent, frames_skipped;
+        led_strip_get_frame_stats(&sim->strip, &frames_sent, &frames_skipped);
+        printf("  %-6s timing %s: 0 high %u-%u ns low %u-%u ns, 1 high %u-%u ns low %u-%u ns "
+               "(+/-%u ns), min gap %lld us (reset %u us), %u sent %u skipped\n",
+               chip->name, timing_ok ? "ok" : "OUT OF SPEC",
+               timing.min_high_ns[0], timing.max_high_ns[0], timing.min_low_ns[0], timing.max_low_ns[0],
+               timing.min_high_ns[1], timing.max_high_ns[1], timing.min_low_ns[1], timing.max_low_ns[1],
+               chip->tolerance_ns, (long long)timing.min_gap_us, chip->reset_ns / 1000,
+               frames_sent, frames_skipped);
+        fail |= !timing_ok;
+    }
+    return fail;
+}
+
+/*
+ * Three long strips in one group must be on the wire at the same time
+ */
+static int test_group(void)
+{
+    enum { GROUP_STRIPS = 3 };
+    static struct sim_strip_t sims[GROUP_STRIPS];
+    static struct led_strip_t *strips[GROUP_STRIPS];
+    static struct led_strip_group_t group = { .strips = strips, .strip_count = GROUP_STRIPS };
+    int fail = 0;
+
+    printf("Group:\n");
+    for (int i = 0; i < GROUP_STRIPS; i++) {
+        sim_strip_alloc(&sims[i], (enum rgb_led_type_t)i, (rmt_channel_t)(RMT_CHANNEL_3 + i), 300);
+        strips[i] = &sims[i].strip;
+    }
+    if (!led_strip_group_init(&group)) {
+        printf("  led_strip_group_init failed\n");
+        return 1;
+    }
+
+    for (int i = 0; i < GROUP_STRIPS; i++) {
+        sim_strip_fill(&sims[i]);
+        led_strip_show(&sims[i].strip);
+    }
+
+    int64_t first_start = INT64_MAX, last_end = 0, serial_us = 0;
+    for (int i = 0; i < GROUP_STRIPS; i++) {
+        rmt_channel_t channel = sims[i].strip.rmt_channel;
+        if (!fake_rmt_wait_frames(channel, 1, SIM_FRAME_TIMEOUT_MS)) {
+            printf("  ch%d: no frame\n", channel);
+            return 1;
+        }
+        fail |= !sim_check_frame(&sims[i], 0, "group");
+        const struct fake_rmt_frame_t *frame = fake_rmt_frame(channel, 0);
+        first_start = frame->start_us < first_start ? frame->start_us : first_start;
+        last_end = frame->end_us > last_end ? frame->end_us : last_end;
+        serial_us += frame->end_us - frame->start_us;
+    }
+
+    // Parallel if the group took clearly less than the strips one after another
+    bool parallel = (last_end - first_start) * 3 < serial_us * 2;
+    printf("  %d strips on the wire in %.2f ms, %.2f ms one after another: %s\n", GROUP_STRIPS,
+           (last_end - first_start) / 1000.0, serial_us / 1000.0, parallel ? "parallel" : "SERIAL");
+    return fail || !parallel;
+}
+
+/*
+ * Stereo 16 bit buffer of a 110 Hz tone, loud at the start of every beat_frames
+ */
+static void sim_audio(int16_t *pcm, uint32_t frames, uint32_t *clock, uint32_t beat_frames)
+{
+    for (uint32_t i = 0; i < frames; i++, (*clock)++) {
+        uint32_t in_beat = *clock % beat_frames;
+        double envelope = in_beat < beat_frames / 4 ? 1.0 - (double)in_beat / (beat_frames / 4) : 0.05;
+        int16_t v = (int16_t)(20000 * envelope * sin(2 * M_PI * 110 * *clock / SIM_SAMPLE_RATE));
+        pcm[2 * i] = v;
+        pcm[2 * i + 1] = v;
+    }
+}
+
+/*
+ * The VU meter of i2s_stream_pcm, written to the strip the way i2s_stream does
+ * without the effect engine, must reach the wire unchanged.
+ */
+static int test_vu_mapping(void)
+{
+    static struct sim_strip_t sim;
+    i2s_pcm_t pcm = { .vu = { .simple = false, .terminal = false } };
+    int16_t audio[SIM_AUDIO_FRAMES * 2];
+    uint32_t clock = 0;
+    uint32_t beats = 0, checked = 0;
+    int fail = 0;
+
+    printf("VU meter:\n");
+    sim_strip_alloc(&sim, RGB_LED_TYPE_WS2812, RMT_CHANNEL_6, I2S_PCM_VU_LEDS);
+    if (!led_strip_init(&sim.strip)) {
+        return 1;
+    }
+    i2s_pcm_init(&pcm);
+
+    for (int buffer = 0; buffer < 40; buffer++) {
+        i2s_pcm_vu_frame_t frame;
+        sim_audio(audio, SIM_AUDIO_FRAMES, &clock, SIM_SAMPLE_RATE / 2);
+        i2s_pcm_vu_analyze(&pcm.vu, (const uint8_t *)audio, sizeof(audio), &frame);
+        beats += frame.beat;
+
+        memset(sim.set, 0, I2S_PCM_VU_LEDS * sizeof(struct led_color_t));
+        for (int i = 0; i < I2S_PCM_VU_LEDS; i++) {
+            if (frame.set_mask & (1 << i)) {
+                sim.set[i].red = frame.rgb[i][0];
+                sim.set[i].green = frame.rgb[i][1];
+                sim.set[i].blue = frame.rgb[i][2];
+                led_strip_set_pixel_rgb(&sim.strip, i, frame.rgb[i][0], frame.rgb[i][1], frame.rgb[i][2]);
+            }
+        }
+        uint32_t before = fake_rmt_frame_count(sim.strip.rmt_channel);
+        led_strip_show(&sim.strip);
+        if (frame.set_mask && fake_rmt_wait_frames(sim.strip.rmt_channel, before + 1, SIM_FRAME_TIMEOUT_MS)) {
+            const struct fake_rmt_frame_t *sent = fake_rmt_frame(sim.strip.rmt_channel, before);
+            struct led_color_t wire[I2S_PCM_VU_LEDS];
+            fake_rmt_decode(sim.strip.rmt_channel, &fake_rmt_chips[RGB_LED_TYPE_WS2812], sent, wire, I2S_PCM_VU_LEDS, NULL);
+            fail |= memcmp(wire, sim.set, sizeof(wire)) != 0;
+            checked++;
+        }
+    }
+    printf("  %u buffers lit the strip, %u beats, wire %s\n", checked, beats, fail ? "DIFFERS" : "matches");
+    return fail || checked == 0 || beats == 0;
+}
+
+/*
+ * The effect engine in its own task, fed by the VU analysis for half a second.
+ * The features are queued with the playout time i2s_stream computes, for a
+ * writer that keeps the DMA full, so the first beat must light the strip when
+ * its buffer is heard, not when it is analyzed.
+ */
+static int test_effect_engine(FILE *timeline)
+{
+    static struct sim_strip_t sim;
+    static struct led_effect_t effect = { .led_strip = &sim.strip, .mode = LED_EFFECT_PULSE, .brightness = 200 };
+    i2s_pcm_t pcm = { .vu = { .simple = false, .terminal = false } };
+    int16_t audio[SIM_AUDIO_FRAMES * 2];
+    uint32_t clock = 0;
+    const uint32_t run_ms = 500;
+    const int frame_bytes = 2 * sizeof(int16_t);
+    int64_t first_beat_us = -1, first_beat_delay_us = 0;
+
+    printf("Effect engine:\n");
+    sim_strip_alloc(&sim, RGB_LED_TYPE_WS2812, RMT_CHANNEL_7, 16);
+    if (!led_strip_init(&sim.strip) || !led_effect_init(&effect)) {
+        return 1;
+    }
+    i2s_pcm_init(&pcm);
+
+    // The DMA fills up at once when the stream starts, then the writer blocks
+    int64_t byte_pos = 0;
+    i2s_pcm_playout_us(&pcm.clock, esp_timer_get_time(), byte_pos, frame_bytes, SIM_SAMPLE_RATE, SIM_DMA_DEPTH);
+    byte_pos += SIM_DMA_DEPTH * frame_bytes;
+
+    // Audio buffers at their real rate
+    uint32_t buffer_ms = SIM_AUDIO_FRAMES * 1000 / SIM_SAMPLE_RATE;
+    for (uint32_t t = 0; t < run_ms; t += buffer_ms) {
+        i2s_pcm_vu_frame_t frame;
+        sim_audio(audio, SIM_AUDIO_FRAMES, &clock, SIM_SAMPLE_RATE / 4);
+        i2s_pcm_vu_analyze(&pcm.vu, (const uint8_t *)audio, sizeof(audio), &frame);
+        int64_t now_us = esp_timer_get_time();
+        int64_t playout_us = i2s_pcm_playout_us(&pcm.clock, now_us, byte_pos, frame_bytes,
+                                                SIM_SAMPLE_RATE, SIM_DMA_DEPTH);
+        if (frame.beat && first_beat_us < 0) {
+            first_beat_us = playout_us;
+            first_beat_delay_us = playout_us - now_us;
+        }
+        led_effect_queue_audio(&effect, frame.level, frame.beat, playout_us);
+        byte_pos += sizeof(audio);
+        sleep_ms(buffer_ms);
+    }
+
+    rmt_channel_t channel = sim.strip.rmt_channel;
+    const struct fake_rmt_chip_t *chip = &fake_rmt_chips[RGB_LED_TYPE_WS2812];
+    uint32_t frames = fake_rmt_frame_count(channel);
+    uint32_t lit = 0;
+    int64_t first_lit_us = -1;
+    for (uint32_t f = 0; f < frames; f++) {
+        struct led_color_t wire[16] = { { 0 } };
+        const struct fake_rmt_frame_t *sent = fake_rmt_frame(channel, f);
+        fake_rmt_decode(channel, chip, sent, wire, 16, NULL);
+        for (int i = 0; i < 16; i++) {
+            if (wire[i].red | wire[i].green | wire[i].blue) {
+                if (first_lit_us < 0) {
+                    first_lit_us = sent->start_us;
+                }
+                lit++;
+                break;
+            }
+        }
+    }
+
+    // Frames go out on the effect period, the beat lands on the closest one
+    int64_t period_us = 1000000 / LED_EFFECT_DEFAULT_FPS;
+    int64_t offset_us = first_lit_us - first_beat_us;
+    bool aligned = first_beat_us >= 0 && first_lit_us >= 0 &&
+                   offset_us >= -period_us / 2 - 1000 && offset_us <= period_us / 2 + 5000;
+    printf("  first beat heard %.1f ms after analysis, lit %+.1f ms from it: %s\n",
+           first_beat_delay_us / 1000.0, offset_us / 1000.0, aligned ? "aligned" : "NOT ALIGNED");
+    struct fake_rmt_timing_t timing;
+    bool timing_ok = fake_rmt_check_timing(channel, chip, &timing);
+    uint32_t expected = run_ms * LED_EFFECT_DEFAULT_FPS / 1000;
+    bool rate_ok = frames + 3 >= expected && frames <= expected + 3;
+    printf("  %u frames in %u ms (%u expected), %u lit, timing %s\n", frames, run_ms, expected, lit,
+           timing_ok ? "ok" : "OUT OF SPEC");
+
+    if (timeline) {
+        fake_rmt_dump_timeline(timeline, channel, chip);
+    }
+    return !timing_ok || !rate_ok || lit == 0 || !aligned || effect.audio_dropped;
+}
+
+static void bench_effects(void)
+{
+    printf("Effect render (gamma and brightness included):\n");
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        struct led_color_t buf_1[300], buf_2[300], out[300];
+        struct led_strip_t strip = {
+            .led_strip_length = lengths[l], .led_strip_buf_1 = buf_1, .led_strip_buf_2 = buf_2,
+        };
+        printf("  %3u leds:", lengths[l]);
+        for (int mode = 0; mode < LED_EFFECT_MODE_MAX; mode++) {
+            struct led_effect_t effect = { .led_strip = &strip, .mode = mode, .brightness = 200 };
+            effect.frame = calloc(lengths[l], sizeof(struct led_effect_pixel_t));
+            long frames = 0;
+            int64_t start = now_ns(), elapsed;
+            do {
+                for (int i = 0; i < 64; i++) {
+                    effect.level = (uint8_t)((frames + i) & 0x7F);
+                    effect.beats += ((frames + i) % 25) == 0;
+                    led_effect_render(&effect, out);
+                }
+                frames += 64;
+                elapsed = now_ns() - start;
+            } while (elapsed < SIM_BENCH_MIN_NS);
+            printf(" %s %8.1f ns", mode_name[mode], (double)elapsed / frames);
+            free(effect.frame);
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *timeline = NULL;
+    int fail = 0;
+
+    if (argc == 3 && !strcmp(argv[1], "-t")) {
+        timeline = fopen(argv[2], "w");
+        if (!timeline) {
+            perror(argv[2]);
+            return 2;
+        }
+    }
+    srand(1);
+
+    fail |= test_led_types();
+    fail |= test_group();
+    fail |= test_vu_mapping();
+    fail |= test_effect_engine(timeline);
+    bench_effects();
+
+    if (timeline) {
+        fclose(timeline);
+    }
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
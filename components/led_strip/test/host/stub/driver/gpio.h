@@ -0,0 +1,11 @@
+#ifndef _HOST_DRIVER_GPIO_H_
+#define _HOST_DRIVER_GPIO_H_
+
+typedef enum {
+    GPIO_NUM_0 = 0,
+    GPIO_NUM_4 = 4,
+    GPIO_NUM_33 = 33,
+    GPIO_NUM_MAX = 40,
+} gpio_num_t;
+
+#endif
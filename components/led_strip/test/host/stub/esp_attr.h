@@ -0,0 +1,6 @@
+#ifndef _HOST_ESP_ATTR_H_
+#define _HOST_ESP_ATTR_H_
+
+#define IRAM_ATTR
+
+#endif
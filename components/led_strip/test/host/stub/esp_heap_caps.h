@@ -0,0 +1,22 @@
+#ifndef _HOST_ESP_HEAP_CAPS_H_
+#define _HOST_ESP_HEAP_CAPS_H_
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT         (1 << 2)
+#define MALLOC_CAP_DMA          (1 << 3)
+#define MALLOC_CAP_INTERNAL     (1 << 11)
+#define MALLOC_CAP_SPIRAM       (1 << 10)
+
+static inline void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+static inline void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+#endif
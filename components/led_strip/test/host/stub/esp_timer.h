@@ -0,0 +1,11 @@
+#ifndef _HOST_ESP_TIMER_H_
+#define _HOST_ESP_TIMER_H_
+
+#include <stdint.h>
+
+/**
+ * Microseconds since start, shared by host_freertos.c and fake_rmt.c
+ */
+int64_t esp_timer_get_time(void);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef void *SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define configMAX_PRIORITIES    (25)
+#define portTICK_PERIOD_MS      (5)     // CONFIG_FREERTOS_HZ=200
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+
+#define pdFALSE                 (0)
+#define pdTRUE                  (1)
+#define pdPASS                  (pdTRUE)
+
+#endif
@@ -0,0 +1,433 @@
+/*
+ * Fake SPI display for the host tft build, see fake_display.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "fake_display.h"
+#include "driver/i2c.h"
+
+// Commands beyond the ones defined in tftspi.h
+#define CMD_RAMWR       0x2C
+#define CMD_RAMRD       0x2E
+#define CMD_COLMOD      0x3A
+
+static spi_dev_t fake_regs;
+static lldesc_t fake_dmadesc_tx[16];
+static spi_lobo_host_t fake_host = {
+    .hw_regs = { &fake_regs },
+    .dmadesc_tx = fake_dmadesc_tx,
+    .dma_chan = 1,
+    .max_transfer_sz = 2 * SPI_MAX_DMA_LEN,     // main.c asks for 6 KB, rounded up to whole descriptors
+};
+static spi_lobo_device_t fake_device = {
+    .cfg = {
+        .clock_speed_hz = DEFAULT_SPI_CLOCK,
+        .flags = LB_SPI_DEVICE_HALFDUPLEX,
+    },
+    .host = &fake_host,
+};
+
+static struct {
+    uint8_t cmd;
+    uint8_t params[8];
+    uint32_t param_count;
+    uint16_t xs, xe, ys, ye;
+    uint16_t x, y;              // RAM write/read pointer
+    uint8_t colmod;
+    uint8_t madctl;
+    uint8_t pixel[3];
+    uint32_t pixel_bytes;
+    uint16_t tfa, vsa, bfa;     // Vertical scroll definition
+    uint16_t vsp;               // Vertical scroll start
+    uint8_t scrolling;
+} ctrl;
+
+static color_t fake_ram[FAKE_DISPLAY_RAM_SIZE][FAKE_DISPLAY_RAM_SIZE];
+static uint32_t gpio_levels[40];
+static fake_display_stats_t stats;
+static char error_msg[128];
+static uint8_t in_sync;
+
+static void fake_error(const char *msg)
+{
+    if (stats.errors++ == 0) {
+        snprintf(error_msg, sizeof(error_msg), "%s (command 0x%02X, transfer %u)", msg, ctrl.cmd, stats.transfers);
+    }
+}
+
+static void ram_advance(void)
+{
+    if (++ctrl.x > ctrl.xe) {
+        ctrl.x = ctrl.xs;
+        if (++ctrl.y > ctrl.ye) {
+            ctrl.y = ctrl.ys;
+        }
+    }
+}
+
+static void ram_write(color_t color)
+{
+    if ((ctrl.x < FAKE_DISPLAY_RAM_SIZE) && (ctrl.y < FAKE_DISPLAY_RAM_SIZE)) {
+        fake_ram[ctrl.y][ctrl.x] = color;
+    }
+    stats.pixels++;
+    ram_advance();
+}
+
+static void ctrl_data(uint8_t data)
+{
+    if (ctrl.cmd == CMD_RAMWR) {
+        ctrl.pixel[ctrl.pixel_bytes++] = data;
+        if ((ctrl.colmod & 0x0F) == 0x05) {
+            if (ctrl.pixel_bytes == 2) {
+                // RGB565, the panel extends each component to 6 bits
+                uint16_t c = (ctrl.pixel[0] << 8) | ctrl.pixel[1];
+                uint8_t r = (c >> 11) & 0x1F;
+                uint8_t g = (c >> 5) & 0x3F;
+                uint8_t b = c & 0x1F;
+                ram_write((color_t){ (r << 3) | ((r >> 4) << 2), g << 2, (b << 3) | ((b >> 4) << 2) });
+                ctrl.pixel_bytes = 0;
+            }
+        }
+        else if (ctrl.pixel_bytes == 3) {
+            ram_write((color_t){ ctrl.pixel[0] & 0xFC, ctrl.pixel[1] & 0xFC, ctrl.pixel[2] & 0xFC });
+            ctrl.pixel_bytes = 0;
+        }
+        return;
+    }
+
+    if (ctrl.param_count < sizeof(ctrl.params)) ctrl.params[ctrl.param_count] = data;
+    ctrl.param_count++;
+
+    switch (ctrl.cmd) {
+        case TFT_CASET:
+            if (ctrl.param_count == 4) {
+                ctrl.xs = (ctrl.params[0] << 8) | ctrl.params[1];
+                ctrl.xe = (ctrl.params[2] << 8) | ctrl.params[3];
+            }
+            break;
+        case TFT_PASET:
+            if (ctrl.param_count == 4) {
+                ctrl.ys = (ctrl.params[0] << 8) | ctrl.params[1];
+                ctrl.ye = (ctrl.params[2] << 8) | ctrl.params[3];
+            }
+            break;
+        case CMD_COLMOD:
+            ctrl.colmod = data;
+            break;
+        case TFT_MADCTL:
+            ctrl.madctl = data;
+            break;
+        case TFT_VSCRDEF:
+            if (ctrl.param_count == 6) {
+                ctrl.tfa = (ctrl.params[0] << 8) | ctrl.params[1];
+                ctrl.vsa = (ctrl.params[2] << 8) | ctrl.params[3];
+                ctrl.bfa = (ctrl.params[4] << 8) | ctrl.params[5];
+                uint32_t lines = ctrl.tfa + ctrl.vsa + ctrl.bfa;
+                if ((lines != 320) && (lines != 480)) fake_error("scroll definition does not cover the frame memory");
+            }
+            break;
+        case TFT_VSCRSADD:
+            if (ctrl.param_count == 2) {
+                ctrl.vsp = (ctrl.params[0] << 8) | ctrl.params[1];
+                if ((ctrl.vsp < ctrl.tfa) || (ctrl.vsp >= ctrl.tfa + ctrl.vsa)) fake_error("scroll start outside the scroll area");
+                ctrl.scrolling = 1;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void ctrl_command(uint8_t cmd)
+{
+    if ((ctrl.cmd == CMD_RAMWR) && (ctrl.pixel_bytes)) fake_error("partial pixel at end of memory write");
+    ctrl.cmd = cmd;
+    ctrl.param_count = 0;
+    ctrl.pixel_bytes = 0;
+    stats.commands++;
+    if (cmd == TFT_CMD_NORON) ctrl.scrolling = 0;
+    if (cmd == TFT_CASET) stats.addr_windows++;
+    else if ((cmd == CMD_RAMWR) || (cmd == CMD_RAMRD)) {
+        if (cmd == CMD_RAMWR) stats.ram_writes++;
+        ctrl.x = ctrl.xs;
+        ctrl.y = ctrl.ys;
+    }
+}
+
+static void bus_bytes(const volatile uint8_t *data, uint32_t len)
+{
+    uint8_t dc = gpio_levels[PIN_NUM_DC];
+
+    for (uint32_t i = 0; i < len; i++) {
+        if (dc) ctrl_data(data[i]);
+        else ctrl_command(data[i]);
+    }
+    stats.bytes += len;
+    stats.wire_us += (len * 8.0 * 1000000.0) / fake_device.cfg.clock_speed_hz;
+}
+
+// Runs the transfer started by the last write of cmd.usr
+static void run_transfer(void)
+{
+    spi_dev_t *regs = &fake_regs;
+
+    stats.transfers++;
+    stats.wire_us += FAKE_SPI_TRANSFER_US;
+    if (!fake_device.cfg.selected) fake_error("transfer without chip select");
+
+    if (regs->user.usr_mosi) {
+        uint32_t len = (regs->mosi_dlen.usr_mosi_dbitlen + 1) / 8;
+
+        if (regs->dma_out_link.start) {
+            if (!fake_dmadesc_tx[0].owner) {
+                fake_error("transfer from a finished DMA link");
+            }
+            else {
+                uint32_t sent = 0;
+                stats.dma_transfers++;
+                for (lldesc_t *desc = &fake_dmadesc_tx[0]; desc; desc = desc->qe.stqe_next) {
+                    bus_bytes(desc->buf, desc->length);
+                    sent += desc->length;
+                    desc->owner = 0;
+                    if (desc->eof) break;
+                }
+                if (sent != len) fake_error("DMA length differs from transfer length");
+                return;
+            }
+        }
+        if (len > sizeof(regs->data_buf)) fake_error("transfer longer than the SPI buffer");
+        else bus_bytes((const volatile uint8_t *)regs->data_buf, len);
+    }
+}
+
+int fake_display_sync(void)
+{
+    if ((!in_sync) && (fake_regs.cmd.usr)) {
+        in_sync = 1;
+        run_transfer();
+        fake_regs.cmd.usr = 0;
+        in_sync = 0;
+    }
+    return 0;
+}
+
+// ==== spi_master_lobo ====
+
+esp_err_t spi_lobo_device_select(spi_lobo_device_handle_t handle, int force)
+{
+    if (handle == NULL) return ESP_ERR_INVALID_ARG;
+    fake_display_sync();
+    if ((handle->cfg.selected) && (!force)) return ESP_OK;
+    handle->cfg.selected = 1;
+    stats.selects++;
+    stats.wire_us += FAKE_SPI_SELECT_US;
+    return ESP_OK;
+}
+
+esp_err_t spi_lobo_device_deselect(spi_lobo_device_handle_t handle)
+{
+    if (handle == NULL) return ESP_ERR_INVALID_ARG;
+    fake_display_sync();
+    handle->cfg.selected = 0;
+    return ESP_OK;
+}
+
+esp_err_t spi_lobo_transfer_data(spi_lobo_device_handle_t handle, spi_lobo_transaction_t *trans)
+{
+    fake_display_sync();
+    if (!handle->cfg.selected) fake_error("transfer without chip select");
+    if (trans->length) fake_error("unexpected transmit in spi_lobo_transfer_data");
+
+    uint8_t *rx = trans->rx_buffer;
+    uint32_t len = trans->rxlength / 8;
+    if (len == 0) return ESP_OK;
+
+    stats.transfers++;
+    stats.bytes += len;
+    stats.wire_us += FAKE_SPI_TRANSFER_US + (len * 8.0 * 1000000.0) / handle->cfg.clock_speed_hz;
+    if (ctrl.cmd != CMD_RAMRD) {
+        fake_error("read without memory read command");
+        memset(rx, 0, len);
+        return ESP_OK;
+    }
+    // dummy byte, then 3 bytes per pixel in any color mode
+    rx[0] = 0;
+    for (uint32_t i = 1; i < len; i += 3) {
+        color_t c = { 0, 0, 0 };
+        if ((ctrl.x < FAKE_DISPLAY_RAM_SIZE) && (ctrl.y < FAKE_DISPLAY_RAM_SIZE)) c = fake_ram[ctrl.y][ctrl.x];
+        rx[i] = c.r;
+        if (i + 1 < len) rx[i + 1] = c.g;
+        if (i + 2 < len) rx[i + 2] = c.b;
+        ram_advance();
+    }
+    return ESP_OK;
+}
+
+uint32_t spi_lobo_get_speed(spi_lobo_device_handle_t handle)
+{
+    return handle->cfg.clock_speed_hz;
+}
+
+uint32_t spi_lobo_set_speed(spi_lobo_device_handle_t handle, uint32_t speed)
+{
+    fake_display_sync();
+    handle->cfg.clock_speed_hz = speed;
+    return speed;
+}
+
+void spi_lobo_setup_dma_desc_links(lldesc_t *dmadesc, int len, const uint8_t *data, bool isrx)
+{
+    int n = 0;
+    while (len) {
+        int dmachunklen = len;
+        if (dmachunklen > SPI_MAX_DMA_LEN) dmachunklen = SPI_MAX_DMA_LEN;
+        if (n >= (int)(sizeof(fake_dmadesc_tx) / sizeof(fake_dmadesc_tx[0]))) {
+            fake_error("too many DMA descriptors");
+            break;
+        }
+        dmadesc[n].size = dmachunklen;
+        dmadesc[n].length = dmachunklen;
+        dmadesc[n].buf = (uint8_t *)data;
+        dmadesc[n].eof = 0;
+        dmadesc[n].sosf = 0;
+        dmadesc[n].owner = 1;
+        dmadesc[n].qe.stqe_next = &dmadesc[n + 1];
+        len -= dmachunklen;
+        data += dmachunklen;
+        n++;
+    }
+    if (n) {
+        dmadesc[n - 1].eof = 1;
+        dmadesc[n - 1].qe.stqe_next = NULL;
+    }
+}
+
+void spi_lobo_dmaworkaround_idle(int dmachan)
+{
+    (void)dmachan;
+}
+
+void spi_lobo_dmaworkaround_transfer_active(int dmachan)
+{
+    (void)dmachan;
+}
+
+// ==== gpio, i2c, FreeRTOS ====
+
+void gpio_pad_select_gpio(uint8_t gpio_num)
+{
+    (void)gpio_num;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    // the level is sampled by the transfer in progress
+    fake_display_sync();
+    if ((gpio_num >= 0) && (gpio_num < 40)) gpio_levels[gpio_num] = level;
+    return ESP_OK;
+}
+
+esp_err_t get_i2c_pins(i2c_port_t port, i2c_config_t *i2c_config)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf) { return ESP_OK; }
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags) { return ESP_OK; }
+i2c_cmd_handle_t i2c_cmd_link_create(void) { return NULL; }
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle) { }
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle) { return ESP_OK; }
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle) { return ESP_OK; }
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, int ack_en) { return ESP_OK; }
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, int ack) { return ESP_OK; }
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, int ack) { return ESP_OK; }
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait) { return ESP_OK; }
+
+void vTaskDelay(TickType_t ticks)
+{
+    (void)ticks;
+}
+
+// ==== Fake display API ====
+
+void fake_display_init(void)
+{
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.colmod = 0x66;
+    ctrl.madctl = MADCTL_MX;
+    ctrl.vsa = 320;
+    fake_device.cfg.selected = 0;
+    disp_spi = &fake_device;
+    fake_display_fill((color_t){ 0, 0, 0 });
+    fake_display_reset_stats();
+}
+
+void fake_display_reset_stats(void)
+{
+    fake_display_sync();
+    memset(&stats, 0, sizeof(stats));
+    error_msg[0] = '\0';
+}
+
+void fake_display_get_stats(fake_display_stats_t *out)
+{
+    fake_display_sync();
+    *out = stats;
+}
+
+const char *fake_display_error(void)
+{
+    return stats.errors ? error_msg : NULL;
+}
+
+color_t fake_display_pixel(int x, int y)
+{
+    fake_display_sync();
+    if ((x < 0) || (y < 0) || (x >= FAKE_DISPLAY_RAM_SIZE) || (y >= FAKE_DISPLAY_RAM_SIZE)) return (color_t){ 0, 0, 0 };
+    return fake_ram[y][x];
+}
+
+color_t fake_display_visible(int x, int y)
+{
+    fake_display_sync();
+    if (ctrl.scrolling) {
+        // the scroll area is defined in frame memory lines, counted from the bottom with MY
+        int lines = ctrl.tfa + ctrl.vsa + ctrl.bfa;
+        int line = (ctrl.madctl & MADCTL_MY) ? lines - 1 - y : y;
+        if ((line >= ctrl.tfa) && (line < ctrl.tfa + ctrl.vsa)) {
+            line = ctrl.tfa + (((line - ctrl.tfa) + (ctrl.vsp - ctrl.tfa)) % ctrl.vsa);
+            y = (ctrl.madctl & MADCTL_MY) ? lines - 1 - line : line;
+        }
+    }
+    return fake_display_pixel(x, y);
+}
+
+void fake_display_fill(color_t color)
+{
+    color.r &= 0xFC;
+    color.g &= 0xFC;
+    color.b &= 0xFC;
+    for (int y = 0; y < FAKE_DISPLAY_RAM_SIZE; y++) {
+        for (int x = 0; x < FAKE_DISPLAY_RAM_SIZE; x++) {
+            fake_ram[y][x] = color;
+        }
+    }
+}
+
+uint8_t fake_display_colmod(void)
+{
+    return ctrl.colmod;
+}
@@ -0,0 +1,73 @@
+/*
+ * Fake SPI display for the host tft build.
+ *
+ * tftspi.c runs unchanged against the SPI registers and DMA descriptors
+ * declared in stub/spi_master_lobo.h. Every started transfer is decoded with
+ * the level of the DC pin into an ILI9341/ILI9488 command stream, which
+ * updates the address window and the display RAM. The counters give the
+ * number of chip selects, transfers and bytes a drawing operation costs on
+ * the real bus, and an estimate of its time on the wire.
+ */
+
+#ifndef _FAKE_DISPLAY_H_
+#define _FAKE_DISPLAY_H_
+
+#include <stdint.h>
+#include "tftspi.h"
+
+#define FAKE_DISPLAY_RAM_SIZE   480     // Display RAM is addressed up to 480 x 480
+
+// Bus time estimate: SPI clock plus a fixed setup cost per transfer and per chip select
+#define FAKE_SPI_TRANSFER_US    1.0
+#define FAKE_SPI_SELECT_US      3.0
+
+typedef struct {
+    uint32_t selects;           // Chip select activations
+    uint32_t transfers;         // Transfers started, register and DMA
+    uint32_t dma_transfers;
+    uint32_t commands;
+    uint32_t addr_windows;      // Column address set commands
+    uint32_t ram_writes;        // Memory write commands
+    uint64_t bytes;             // Bytes sent and received
+    uint64_t pixels;            // Pixels written to the display RAM
+    uint32_t errors;            // Protocol errors, see fake_display_error()
+    double wire_us;             // Estimated bus time
+} fake_display_stats_t;
+
+/**
+ * Connects 'disp_spi' to the fake display and clears the display RAM.
+ * The display starts in 18-bit color mode.
+ */
+void fake_display_init(void);
+
+void fake_display_reset_stats(void);
+
+void fake_display_get_stats(fake_display_stats_t *stats);
+
+/**
+ * Description of the first protocol error, NULL if there was none
+ */
+const char *fake_display_error(void);
+
+/**
+ * Pixel in the display RAM, with the 6-bit precision of the panel
+ */
+color_t fake_display_pixel(int x, int y);
+
+/**
+ * Pixel shown on the panel, the display RAM moved by vertical scrolling.
+ * Vertical scrolling is modelled for the portrait orientations only.
+ */
+color_t fake_display_visible(int x, int y);
+
+/**
+ * Sets the whole display RAM without bus traffic
+ */
+void fake_display_fill(color_t color);
+
+/**
+ * Current pixel format, the parameter of the last COLMOD command
+ */
+uint8_t fake_display_colmod(void);
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * Fake flash partition, see fake_flash.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fake_flash.h"
+#include "esp_partition.h"
+
+static esp_partition_t fake_part;
+static uint8_t *fake_base;
+static int fake_fd = -1;
+static fake_flash_stats_t stats;
+
+int fake_flash_init(const char *label, const char *image, uint32_t size)
+{
+    struct stat sb;
+
+    fake_flash_deinit();
+    fake_fd = open(image, O_RDWR | O_CREAT, 0644);
+    if (fake_fd < 0) return -1;
+    if ((fstat(fake_fd, &sb) != 0) || (ftruncate(fake_fd, size) != 0)) goto fail;
+    fake_base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fake_fd, 0);
+    if (fake_base == MAP_FAILED) goto fail;
+    if (sb.st_size == 0) memset(fake_base, 0xFF, size);
+    else if (sb.st_size < size) memset(fake_base + sb.st_size, 0xFF, size - sb.st_size);
+
+    memset(&fake_part, 0, sizeof(fake_part));
+    fake_part.type = ESP_PARTITION_TYPE_DATA;
+    fake_part.subtype = 0x40;
+    fake_part.address = 0x310000;
+    fake_part.size = size;
+    snprintf(fake_part.label, sizeof(fake_part.label), "%s", label);
+    memset(&stats, 0, sizeof(stats));
+    return 0;
+
+fail:
+    close(fake_fd);
+    fake_fd = -1;
+    fake_base = NULL;
+    return -1;
+}
+
+void fake_flash_deinit(void)
+{
+    if (fake_base) munmap(fake_base, fake_part.size);
+    if (fake_fd >= 0) close(fake_fd);
+    fake_base = NULL;
+    fake_fd = -1;
+}
+
+void fake_flash_get_stats(fake_flash_stats_t *out)
+{
+    *out = stats;
+}
+
+int fake_flash_mapped(const void *ptr)
+{
+    return fake_base && ((const uint8_t *)ptr >= fake_base) && ((const uint8_t *)ptr < fake_base + fake_part.size);
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    if ((fake_base == NULL) || (type != fake_part.type)) return NULL;
+    if ((subtype != ESP_PARTITION_SUBTYPE_ANY) && (subtype != fake_part.subtype)) return NULL;
+    if ((label != NULL) && strcmp(label, fake_part.label)) return NULL;
+    return &fake_part;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    const uint8_t *data = src;
+
+    if ((partition != &fake_part) || (dst_offset + size > fake_part.size)) {
+        stats.errors++;
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] & ~fake_base[dst_offset + i]) stats.errors++;
+        fake_base[dst_offset + i] &= data[i];
+    }
+    stats.writes++;
+    stats.bytes_written += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t start_addr, size_t size)
+{
+    if ((partition != &fake_part) || (start_addr % SPI_FLASH_SEC_SIZE) || (size % SPI_FLASH_SEC_SIZE) ||
+        (start_addr + size > fake_part.size)) {
+        stats.errors++;
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(fake_base + start_addr, 0xFF, size);
+    stats.erases += size / SPI_FLASH_SEC_SIZE;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, uint32_t offset, uint32_t size,
+                             spi_flash_mmap_memory_t memory, const void **out_ptr,
+                             spi_flash_mmap_handle_t *out_handle)
+{
+    // Mappings start at 64 KB pages of the flash
+    if ((partition != &fake_part) || ((partition->address + offset) & 0xFFFF) || (offset + size > fake_part.size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_ptr = fake_base + offset;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle)
+{
+    (void)handle;
+}
@@ -0,0 +1,39 @@
+/*
+ * Fake flash partition for the host tft build.
+ *
+ * The partition is an image file mapped with mmap, so what is written to it
+ * survives between runs like the flash does. Writes can only clear bits and
+ * erases work on whole sectors, as on the chip.
+ */
+
+#ifndef _FAKE_FLASH_H_
+#define _FAKE_FLASH_H_
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t erases;            // Sectors erased
+    uint32_t writes;
+    uint64_t bytes_written;
+    uint32_t errors;            // Writes setting bits or outside the partition, unaligned erases
+} fake_flash_stats_t;
+
+/**
+ * Creates the partition with the label, backed by the image file, erased
+ * if the file is new. Returns 0 on success.
+ */
+int fake_flash_init(const char *label, const char *image, uint32_t size);
+
+/**
+ * Unmaps the partition; esp_partition_find_first no longer finds it
+ */
+void fake_flash_deinit(void);
+
+void fake_flash_get_stats(fake_flash_stats_t *out);
+
+/**
+ * Returns 1 if ptr points into the mapped partition
+ */
+int fake_flash_mapped(const void *ptr);
+
+#endif
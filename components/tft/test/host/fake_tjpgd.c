@@ -0,0 +1,161 @@
+/*
+ * Stand-in for the TJpgDec decoder of the ESP32 ROM, see fake_tjpgd.h
+ */
+
+#include <string.h>
+
+#include "fake_tjpgd.h"
+#include "rom/tjpgd.h"
+
+#define FAKE_TJPGD_HEADER   12
+#define FAKE_TJPGD_INBUF    512     // JD_SZBUF of the ROM decoder
+
+static fake_tjpgd_stats_t stats;
+
+// Input buffer of the session, in the pool like the ROM decoder keeps it
+typedef struct {
+    BYTE data[FAKE_TJPGD_INBUF];
+    UINT len;
+    UINT pos;
+    BYTE mcu[16 * 16 * 3];
+    BYTE out[16 * 16 * 3];
+} fake_session_t;
+
+static UINT input(JDEC *jd, BYTE *buff, UINT nd)
+{
+    if (buff) stats.reads++;
+    else stats.skips++;
+    return jd->infunc(jd, buff, nd);
+}
+
+static void put16(uint8_t *p, int v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+uint32_t fake_tjpgd_encode(uint8_t *out, const color_t *pixels, int width, int height, int msx, int msy, int skip)
+{
+    int mw = msx * 8, mh = msy * 8;
+    int cols = (width + mw - 1) / mw, rows = (height + mh - 1) / mh;
+    uint32_t size = FAKE_TJPGD_HEADER + skip + (uint32_t)cols * rows * mw * mh * 3;
+
+    if (out == NULL) return size;
+
+    memcpy(out, "FJPG", 4);
+    put16(out + 4, width);
+    put16(out + 6, height);
+    out[8] = msx;
+    out[9] = msy;
+    put16(out + 10, skip);
+    memset(out + FAKE_TJPGD_HEADER, 0xFF, skip);
+    out += FAKE_TJPGD_HEADER + skip;
+    for (int my = 0; my < rows; my++) {
+        for (int mx = 0; mx < cols; mx++) {
+            for (int y = 0; y < mh; y++) {
+                for (int x = 0; x < mw; x++) {
+                    int px = mx * mw + x, py = my * mh + y;
+                    color_t c = { 0, 0, 0 };
+                    if ((px < width) && (py < height)) c = pixels[py * width + px];
+                    *out++ = c.r;
+                    *out++ = c.g;
+                    *out++ = c.b;
+                }
+            }
+        }
+    }
+    return size;
+}
+
+JRESULT jd_prepare(JDEC *jd, UINT (*infunc)(JDEC *, BYTE *, UINT), void *pool, UINT sz_pool, void *dev)
+{
+    BYTE hdr[FAKE_TJPGD_HEADER];
+
+    memset(jd, 0, sizeof(JDEC));
+    jd->infunc = infunc;
+    jd->device = dev;
+    jd->pool = pool;
+    stats.prepares++;
+    if (sz_pool < sizeof(fake_session_t)) return JDR_MEM1;
+    jd->sz_pool = sizeof(fake_session_t);
+    memset(pool, 0, sizeof(fake_session_t));
+
+    if (input(jd, hdr, FAKE_TJPGD_HEADER) != FAKE_TJPGD_HEADER) return JDR_INP;
+    if (memcmp(hdr, "FJPG", 4)) return JDR_FMT1;
+    jd->width = hdr[4] | (hdr[5] << 8);
+    jd->height = hdr[6] | (hdr[7] << 8);
+    jd->msx = hdr[8];
+    jd->msy = hdr[9];
+    if ((jd->msx < 1) || (jd->msx > 2) || (jd->msy < 1) || (jd->msy > 2)) return JDR_FMT3;
+
+    UINT skip = hdr[10] | (hdr[11] << 8);
+    if (skip && (input(jd, NULL, skip) != skip)) return JDR_INP;
+    return JDR_OK;
+}
+
+// Next 'n' bytes of image data from the input buffer, refilled in 512 byte requests
+static int next_data(JDEC *jd, BYTE *dst, UINT n)
+{
+    fake_session_t *s = (fake_session_t *)jd->pool;
+    while (n) {
+        if (s->pos == s->len) {
+            s->len = input(jd, s->data, FAKE_TJPGD_INBUF);
+            s->pos = 0;
+            if (s->len == 0) return -1;
+        }
+        UINT k = s->len - s->pos;
+        if (k > n) k = n;
+        memcpy(dst, s->data + s->pos, k);
+        s->pos += k;
+        dst += k;
+        n -= k;
+    }
+    return 0;
+}
+
+JRESULT jd_decomp(JDEC *jd, UINT (*outfunc)(JDEC *, void *, JRECT *), BYTE scale)
+{
+    fake_session_t *s = (fake_session_t *)jd->pool;
+    UINT mw = jd->msx * 8, mh = jd->msy * 8;
+
+    if (scale > 3) return JDR_PAR;
+    jd->scale = scale;
+
+    for (UINT y = 0; y < jd->height; y += mh) {
+        for (UINT x = 0; x < jd->width; x += mw) {
+            if (next_data(jd, s->mcu, mw * mh * 3)) return JDR_INP;
+
+            UINT rx = (x + mw <= jd->width) ? mw : jd->width - x;
+            UINT ry = (y + mh <= jd->height) ? mh : jd->height - y;
+            rx >>= scale;
+            ry >>= scale;
+            if (!rx || !ry) continue;
+
+            BYTE *d = s->out;
+            for (UINT j = 0; j < ry; j++) {
+                for (UINT i = 0; i < rx; i++) {
+                    memcpy(d, s->mcu + (((j << scale) * mw) + (i << scale)) * 3, 3);
+                    d += 3;
+                }
+            }
+            JRECT rect;
+            rect.left = x >> scale;
+            rect.right = rect.left + rx - 1;
+            rect.top = y >> scale;
+            rect.bottom = rect.top + ry - 1;
+            stats.blocks++;
+            if (!outfunc(jd, s->out, &rect)) return JDR_INTR;
+        }
+    }
+    return JDR_OK;
+}
+
+void fake_tjpgd_get_stats(fake_tjpgd_stats_t *out)
+{
+    *out = stats;
+}
+
+void fake_tjpgd_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,40 @@
+/*
+ * Stand-in for the TJpgDec decoder of the ESP32 ROM on the host.
+ *
+ * It reads an uncompressed image through the input function of the session
+ * the way the ROM decoder reads a JPEG file: the header first, segments it
+ * does not need skipped, then the data in 512 byte requests. The output
+ * function gets one block per MCU, left to right and top to bottom, clipped
+ * at the right and bottom of the image and scaled by 1/2^scale.
+ *
+ * Image layout, little endian:
+ *   "FJPG", width (2), height (2), MCU width and height in 8 pixel units (1 each),
+ *   skipped size (2), skipped bytes, then the RGB pixels of every MCU in
+ *   decoding order, MCUs over the image edge padded to their full size.
+ */
+
+#ifndef _FAKE_TJPGD_H_
+#define _FAKE_TJPGD_H_
+
+#include <stdint.h>
+#include "tftspi.h"
+
+typedef struct {
+    uint32_t prepares;
+    uint32_t reads;             // Calls to the input function asking for data
+    uint32_t skips;             // Calls to the input function skipping data
+    uint32_t blocks;            // Calls to the output function
+} fake_tjpgd_stats_t;
+
+/**
+ * Writes the image of 'width' x 'height' pixels to 'out' in the layout above,
+ * with 'skip' bytes for the decoder to skip. Returns the size, call with
+ * out=NULL to get it.
+ */
+uint32_t fake_tjpgd_encode(uint8_t *out, const color_t *pixels, int width, int height, int msx, int msy, int skip);
+
+void fake_tjpgd_get_stats(fake_tjpgd_stats_t *stats);
+
+void fake_tjpgd_reset_stats(void);
+
+#endif
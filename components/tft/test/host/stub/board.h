@@ -0,0 +1,11 @@
+#ifndef _HOST_BOARD_H_
+#define _HOST_BOARD_H_
+
+#include "board_pins_config.h"
+
+#define DISP_SPI_MOSI   13
+#define DISP_SPI_CLK    14
+#define DISP_SPI_CS     15
+#define ILI9341_DC      12
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _HOST_BOARD_PINS_CONFIG_H_
+#define _HOST_BOARD_PINS_CONFIG_H_
+
+#include "esp_err.h"
+#include "driver/i2c.h"
+
+esp_err_t get_i2c_pins(i2c_port_t port, i2c_config_t *i2c_config);
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef _HOST_ESP_ATTR_H_
+#define _HOST_ESP_ATTR_H_
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _HOST_ESP_SYSTEM_H_
+#define _HOST_ESP_SYSTEM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_attr.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void *QueueHandle_t;
+
+#define portTICK_PERIOD_MS      5
+#define portTICK_RATE_MS        portTICK_PERIOD_MS
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define pdTRUE                  1
+#define pdFALSE                 0
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _HOST_FREERTOS_SEMPHR_H_
+#define _HOST_FREERTOS_SEMPHR_H_
+
+#include "freertos/FreeRTOS.h"
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _HOST_FREERTOS_TASK_H_
+#define _HOST_FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+/* Single threaded host build: nothing to mask */
+#define taskDISABLE_INTERRUPTS()
+#define taskENABLE_INTERRUPTS()
+
+void vTaskDelay(TickType_t ticks);
+
+#endif
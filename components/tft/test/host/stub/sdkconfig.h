@@ -0,0 +1,8 @@
+#ifndef _HOST_SDKCONFIG_H_
+#define _HOST_SDKCONFIG_H_
+
+/* Olimex MOD-LCD2.8RTP, as in the project sdkconfig */
+#define CONFIG_EXAMPLE_DISPLAY_TYPE     4
+#define CONFIG_TFT_GLYPH_CACHE_SIZE     8192
+
+#endif
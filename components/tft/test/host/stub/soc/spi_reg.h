@@ -0,0 +1,9 @@
+#ifndef _HOST_SOC_SPI_REG_H_
+#define _HOST_SOC_SPI_REG_H_
+
+#define SPI_OUT_RST             (1 << 4)
+#define SPI_IN_RST              (1 << 3)
+#define SPI_AHBM_RST            (1 << 5)
+#define SPI_AHBM_FIFO_RST       (1 << 6)
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef _HOST_SPI_MASTER_LOBO_H_
+#define _HOST_SPI_MASTER_LOBO_H_
+
+/*
+ * spi_master_lobo API and the SPI registers used by tftspi.c. The registers
+ * belong to the fake display (fake_display.c): every access through
+ * 'host->hw' first completes the transfer started by the previous access,
+ * as the hardware would have done by then.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+#define SPI_MAX_DMA_LEN (4096-4)
+
+#define LB_SPI_DEVICE_HALFDUPLEX    (1<<4)
+
+typedef enum {
+    TFT_SPI_HOST=0,
+    TFT_HSPI_HOST=1,
+    TFT_VSPI_HOST=2
+} spi_lobo_host_device_t;
+
+typedef struct lldesc_s {
+    volatile uint32_t size  :12,
+                      length:12,
+                      offset: 5,
+                      sosf  : 1,
+                      eof   : 1,
+                      owner : 1;
+    volatile uint8_t *buf;
+    union {
+        volatile uint32_t empty;
+        struct {
+            struct lldesc_s *stqe_next;
+        } qe;
+    };
+} lldesc_t;
+
+typedef volatile struct {
+    union {
+        struct {
+            uint32_t reserved0: 18;
+            uint32_t usr:        1;
+            uint32_t reserved19:13;
+        };
+        uint32_t val;
+    } cmd;
+    union {
+        struct {
+            uint32_t reserved0:        24;
+            uint32_t usr_mosi_highpart: 1;
+            uint32_t reserved25:        2;
+            uint32_t usr_miso:          1;
+            uint32_t usr_mosi:          1;
+            uint32_t reserved29:        3;
+        };
+        uint32_t val;
+    } user;
+    union {
+        struct {
+            uint32_t usr_mosi_dbitlen:24;
+            uint32_t reserved24:       8;
+        };
+        uint32_t val;
+    } mosi_dlen;
+    union {
+        struct {
+            uint32_t usr_miso_dbitlen:24;
+            uint32_t reserved24:       8;
+        };
+        uint32_t val;
+    } miso_dlen;
+    union {
+        struct {
+            uint32_t reserved0:       9;
+            uint32_t out_data_burst_en:1;
+            uint32_t reserved10:     22;
+        };
+        uint32_t val;
+    } dma_conf;
+    union {
+        struct {
+            uint32_t addr:  20;
+            uint32_t reserved20: 8;
+            uint32_t stop:   1;
+            uint32_t start:  1;
+            uint32_t restart:1;
+            uint32_t reserved31: 1;
+        };
+        uint32_t val;
+    } dma_out_link;
+    union {
+        struct {
+            uint32_t addr:  20;
+            uint32_t reserved20: 8;
+            uint32_t stop:   1;
+            uint32_t start:  1;
+            uint32_t restart:1;
+            uint32_t reserved31: 1;
+        };
+        uint32_t val;
+    } dma_in_link;
+    uint32_t data_buf[16];
+} spi_dev_t;
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+} spi_lobo_bus_config_t;
+
+typedef struct spi_lobo_transaction_t spi_lobo_transaction_t;
+typedef void(*spi_lobo_transaction_cb_t)(spi_lobo_transaction_t *trans);
+
+typedef struct {
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+    uint8_t mode;
+    uint8_t duty_cycle_pos;
+    uint8_t cs_ena_pretrans;
+    uint8_t cs_ena_posttrans;
+    int clock_speed_hz;
+    int spics_io_num;
+    int spics_ext_io_num;
+    uint32_t flags;
+    spi_lobo_transaction_cb_t pre_cb;
+    spi_lobo_transaction_cb_t post_cb;
+    uint8_t selected;
+} spi_lobo_device_interface_config_t;
+
+struct spi_lobo_transaction_t {
+    uint32_t flags;
+    uint16_t command;
+    uint64_t address;
+    size_t length;
+    size_t rxlength;
+    void *user;
+    union {
+        const void *tx_buffer;
+        uint8_t tx_data[4];
+    };
+    union {
+        void *rx_buffer;
+        uint8_t rx_data[4];
+    };
+};
+
+typedef struct spi_lobo_device_t spi_lobo_device_t;
+
+typedef struct {
+    spi_dev_t *hw_regs[1];      // accessed as 'hw', see below
+    int cur_device;
+    lldesc_t *dmadesc_tx;
+    lldesc_t *dmadesc_rx;
+    int dma_chan;
+    int max_transfer_sz;
+} spi_lobo_host_t;
+
+struct spi_lobo_device_t {
+    spi_lobo_device_interface_config_t cfg;
+    spi_lobo_host_t *host;
+    spi_lobo_bus_config_t bus_config;
+    spi_lobo_host_device_t host_dev;
+};
+
+typedef spi_lobo_device_t* spi_lobo_device_handle_t;
+
+/* Completes the pending transfer; always returns 0 */
+int fake_display_sync(void);
+
+#define hw hw_regs[fake_display_sync()]
+
+esp_err_t spi_lobo_device_select(spi_lobo_device_handle_t handle, int force);
+esp_err_t spi_lobo_device_deselect(spi_lobo_device_handle_t handle);
+esp_err_t spi_lobo_transfer_data(spi_lobo_device_handle_t handle, spi_lobo_transaction_t *trans);
+uint32_t spi_lobo_get_speed(spi_lobo_device_handle_t handle);
+uint32_t spi_lobo_set_speed(spi_lobo_device_handle_t handle, uint32_t speed);
+void spi_lobo_setup_dma_desc_links(lldesc_t *dmadesc, int len, const uint8_t *data, bool isrx);
+void spi_lobo_dmaworkaround_idle(int dmachan);
+void spi_lobo_dmaworkaround_transfer_active(int dmachan);
+
+#endif
@@ -0,0 +1,1851 @@
+/*
+ * Host checks and benchmarks of the tft component on the fake SPI display.
+ *
+ * Checks compare what reaches the display RAM with a reference drawing;
+ * benchmarks report the bus cost of each operation as counted by the fake
+ * display, and the host CPU time.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "esp_heap_caps.h"
+#include "tft.h"
+#include "fake_display.h"
+#include "fake_flash.h"
+#include "fake_tjpgd.h"
+
+extern uint8_t tft_DefaultFont[];
+extern const unsigned char tft_Ubuntu16[], tft_Dejavu24[], tft_SmallFont[];
+
+static int failures;
+
+static double host_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        failures++;
+        printf("  FAIL: %s\n", what);
+    }
+}
+
+static void check_bus(const char *what)
+{
+    const char *err = fake_display_error();
+    if (err) {
+        failures++;
+        printf("  FAIL: %s: %s\n", what, err);
+    }
+}
+
+// Copy of the display RAM in the clip window
+static color_t *snapshot(void)
+{
+    int w = dispWin.x2 - dispWin.x1 + 1;
+    int h = dispWin.y2 - dispWin.y1 + 1;
+    color_t *buf = malloc(w * h * sizeof(color_t));
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            buf[y * w + x] = fake_display_pixel(dispWin.x1 + x, dispWin.y1 + y);
+        }
+    }
+    return buf;
+}
+
+static int diff_pixels(const color_t *a, const color_t *b)
+{
+    int n = (dispWin.x2 - dispWin.x1 + 1) * (dispWin.y2 - dispWin.y1 + 1);
+    int diff = 0;
+    for (int i = 0; i < n; i++) {
+        if (memcmp(&a[i], &b[i], sizeof(color_t))) diff++;
+    }
+    return diff;
+}
+
+static void display_reset(void)
+{
+    fake_display_init();
+    TFT_setColorBits(DISP_COLOR_BITS_24);
+    fake_display_reset_stats();
+    _width = DEFAULT_TFT_DISPLAY_HEIGHT;
+    _height = DEFAULT_TFT_DISPLAY_WIDTH;
+    TFT_resetclipwin();
+    font_rotate = 0;
+    font_transparent = 0;
+    font_forceFixed = 0;
+    font_buffered_char = 1;
+    text_wrap = 0;
+    gray_scale = 0;
+    _fg = TFT_YELLOW;
+    _bg = (color_t){ 64, 64, 64 };
+}
+
+// ==== Text ====================================================================
+
+static const char *station_names[] = {
+    "Radio 1", "Radio 1 Rock", "BG Radio", "Energy 90s", "Vitosha", "The Voice", "Magic FM",
+    "City", "BNR Horizont", "BNR Hristo Botev", "538 Global Dance Chart", "Veronica 00's Top 500",
+};
+#define STATION_COUNT (sizeof(station_names) / sizeof(station_names[0]))
+
+static const char *font_names[] = {
+    "default", "dejavu18", "dejavu24", "ubuntu16", "comic24", "minya24", "tooney32", "small", "def_small",
+};
+
+// Buffered text must draw the same pixels as the unbuffered pixel by pixel path
+static void check_text(void)
+{
+    static const char *texts[] = {
+        "Radio 1 Rock", "Veronica 00's Top 500 with a title too long for the line",
+        "Two\nlines", "Wrapped text that continues on the next line of the window", "Erase\rto end",
+    };
+
+    printf("Text rendering\n");
+    for (int font = DEFAULT_FONT; font <= DEF_SMALL_FONT; font++) {
+        for (int t = 0; t < (int)(sizeof(texts) / sizeof(texts[0])); t++) {
+            for (int wrap = 0; wrap < 2; wrap++) {
+                color_t *ref, *out;
+                char what[160];
+
+                display_reset();
+                TFT_setFont(font, NULL);
+                text_wrap = wrap;
+                TFT_setclipwin(10, 20, 200, 200);
+                font_buffered_char = 0;
+                TFT_print((char *)texts[t], 3, 2);
+                TFT_print((char *)texts[t], CENTER, 60);
+                ref = snapshot();
+
+                display_reset();
+                TFT_setFont(font, NULL);
+                text_wrap = wrap;
+                TFT_setclipwin(10, 20, 200, 200);
+                TFT_print((char *)texts[t], 3, 2);
+                TFT_print((char *)texts[t], CENTER, 60);
+                out = snapshot();
+
+                snprintf(what, sizeof(what), "font %s, '%s', wrap %d: %d pixels differ",
+                         font_names[font], texts[t], wrap, diff_pixels(ref, out));
+                check(diff_pixels(ref, out) == 0, what);
+                check_bus(what);
+                free(ref);
+                free(out);
+            }
+        }
+    }
+}
+
+typedef struct {
+    fake_display_stats_t bus;
+    double cpu_us;
+} text_cost_t;
+
+// One TFT_print per character, as text was sent before whole lines were buffered
+static void print_by_char(const char *st, int x, int y)
+{
+    char c[2] = { st[0], 0 };
+    TFT_print(c, x, y);
+    for (int i = 1; st[i]; i++) {
+        c[0] = st[i];
+        TFT_print(c, LASTX, LASTY);
+    }
+}
+
+static void text_cost(const char *st, int by_char, int repeat, text_cost_t *cost)
+{
+    double t0 = host_us();
+
+    fake_display_reset_stats();
+    for (int r = 0; r < repeat; r++) {
+        if (by_char) print_by_char(st, 4, 40);
+        else TFT_print((char *)st, 4, 40);
+    }
+    cost->cpu_us = (host_us() - t0) / repeat;
+    fake_display_get_stats(&cost->bus);
+    check_bus(st);
+}
+
+static void bench_text(void)
+{
+    const int repeat = 50;
+    glyphCacheStats_t cache;
+
+    printf("\nStation names, default font, per string (bus time at %d MHz)\n", DEFAULT_SPI_CLOCK / 1000000);
+    printf("  %-24s %22s %22s %8s\n", "", "per character", "per line", "");
+    printf("  %-24s %6s %7s %8s %6s %7s %8s %8s\n", "name", "xfers", "bytes", "bus us", "xfers", "bytes", "bus us", "cpu us");
+
+    display_reset();
+    TFT_setFont(DEFAULT_FONT, NULL);
+    double total_char = 0, total_line = 0;
+    for (int s = 0; s < (int)STATION_COUNT; s++) {
+        text_cost_t by_char, by_line;
+        text_cost(station_names[s], 1, repeat, &by_char);
+        text_cost(station_names[s], 0, repeat, &by_line);
+        total_char += by_char.bus.wire_us / repeat;
+        total_line += by_line.bus.wire_us / repeat;
+        printf("  %-24s %6u %7llu %8.1f %6u %7llu %8.1f %8.2f\n", station_names[s],
+               by_char.bus.transfers / repeat, (unsigned long long)by_char.bus.bytes / repeat, by_char.bus.wire_us / repeat,
+               by_line.bus.transfers / repeat, (unsigned long long)by_line.bus.bytes / repeat, by_line.bus.wire_us / repeat,
+               by_line.cpu_us);
+    }
+    printf("  station list: %.0f us per character, %.0f us per line\n", total_char, total_line);
+
+    TFT_getGlyphCacheStats(&cache);
+    printf("  glyph cache: %u hits, %u misses, %u evictions, %u bytes\n",
+           cache.hits, cache.misses, cache.evictions, cache.bytes);
+}
+
+// ==== Font store ==============================================================
+
+static char font_dir[32];
+static char font_files[3][48];
+static const unsigned char *font_sources[3] = { tft_Ubuntu16, tft_Dejavu24, tft_SmallFont };
+static const int font_ids[3] = { UBUNTU16_FONT, DEJAVU24_FONT, SMALL_FONT };
+
+// Size of the font data as compile_font_file() writes it, without the font ID
+static int font_data_size(const unsigned char *font)
+{
+    if (font[0]) return ((font[0] * font[1] * font[3]) / 8) + 4;
+
+    int size = 4;
+    while (font[size] != 0xFF) {
+        size += font[size + 2] ? ((((font[size + 2] * font[size + 3]) - 1) / 8) + 7) : 6;
+    }
+    return size + 1;
+}
+
+static void write_font_file(const char *path, const unsigned char *font, int corrupt)
+{
+    FILE *f = fopen(path, "w");
+    int size = font_data_size(font);
+    fwrite(font, 1, size - corrupt, f);
+    fwrite("RPH_font", 1, 8, f);
+    fclose(f);
+}
+
+static color_t *render_font(int font, const char *file)
+{
+    display_reset();
+    TFT_setFont(font, file);
+    TFT_setclipwin(0, 0, 239, 99);
+    TFT_print("Radio 1 Rock 538 Dance", 2, 2);
+    TFT_print("Veronica 00's Top 500", 2, 50);
+    return snapshot();
+}
+
+static int same_render(int font, const char *file, const color_t *ref)
+{
+    color_t *out = render_font(font, file);
+    int same = (diff_pixels(ref, out) == 0);
+    free(out);
+    return same;
+}
+
+static double font_switch_us(int repeat)
+{
+    double t0 = host_us();
+    for (int r = 0; r < repeat; r++) {
+        TFT_setFont(USER_FONT, font_files[r % 3]);
+    }
+    return (host_us() - t0) / repeat;
+}
+
+// Stored fonts must draw as the built in fonts they were made from, whether loaded to the heap or used in place
+static void check_font_store(void)
+{
+    char image[48], path[48];
+    color_t *ref[3];
+    fake_flash_stats_t fs0, fs1;
+
+    printf("\nFont store\n");
+    strcpy(font_dir, "/tmp/tft_fontsXXXXXX");
+    if (mkdtemp(font_dir) == NULL) {
+        check(0, "temporary font directory");
+        return;
+    }
+    for (int f = 0; f < 3; f++) {
+        snprintf(font_files[f], sizeof(font_files[f]), "%s/font%d.fon", font_dir, f);
+        write_font_file(font_files[f], font_sources[f], 0);
+        ref[f] = render_font(font_ids[f], NULL);
+    }
+
+    // no partition, loaded from the file every time
+    check(TFT_fontStoreAdd(font_files[0], 0) == -1, "no font store without the partition");
+    for (int f = 0; f < 3; f++) {
+        check(same_render(USER_FONT, font_files[f], ref[f]), "heap font draws as the built in font");
+    }
+    double heap_us = font_switch_us(3000);
+
+    snprintf(image, sizeof(image), "%s/fonts.img", font_dir);
+    check(fake_flash_init(TFT_FONT_STORE_LABEL, image, 16 * 1024) == 0, "fake flash");
+    for (int f = 0; f < 3; f++) {
+        check(TFT_fontStoreAdd(font_files[f], 0) == 0, "font added to the store");
+    }
+    fake_flash_get_stats(&fs0);
+    for (int f = 0; f < 3; f++) {
+        check(same_render(USER_FONT, font_files[f], ref[f]), "stored font draws as the built in font");
+        check(fake_flash_mapped(cfont.font), "stored font used in place");
+    }
+    double store_us = font_switch_us(3000);
+    fake_flash_get_stats(&fs1);
+    check(fs1.writes == fs0.writes, "selecting stored fonts writes nothing");
+
+    // a changed file is stored again
+    write_font_file(font_files[0], tft_Dejavu24, 0);
+    check(same_render(USER_FONT, font_files[0], ref[1]), "changed font file is stored again");
+    check(fake_flash_mapped(cfont.font), "changed font used in place");
+
+    // a bad file is checked once
+    snprintf(path, sizeof(path), "%s/bad.fon", font_dir);
+    write_font_file(path, tft_Ubuntu16, 5);
+    check(TFT_fontStoreAdd(path, 0) == 7, "bad font file rejected");
+    fake_flash_get_stats(&fs0);
+    check(TFT_fontStoreAdd(path, 0) == 7, "bad font file result kept");
+    TFT_setFont(USER_FONT, path);
+    check(cfont.font == tft_DefaultFont, "default font selected for a bad font file");
+    fake_flash_get_stats(&fs1);
+    check(fs1.writes == fs0.writes, "bad font file checked once");
+    snprintf(path, sizeof(path), "%s/none.fon", font_dir);
+    check(TFT_fontStoreAdd(path, 0) == 1, "missing font file");
+
+    // when full the store is erased and filled again
+    for (int n = 0; n < 20; n++) {
+        snprintf(path, sizeof(path), "%s/fill%d.fon", font_dir, n);
+        write_font_file(path, font_sources[n % 3], 0);
+        TFT_setFont(USER_FONT, path);
+        check(fake_flash_mapped(cfont.font), "font stored while the store fills up");
+        if (n < 19) unlink(path);
+    }
+    check(same_render(USER_FONT, path, ref[19 % 3]), "font stored after the store was erased");
+    unlink(path);
+    fake_flash_get_stats(&fs1);
+    check(fs1.erases >= 2 * 16 / 4, "store erased when full");
+    check(fs1.errors == 0, "flash written only where erased");
+    check_bus("font store");
+
+    printf("  switching between 3 fonts: %.2f us from files, %.2f us from the store (host)\n", heap_us, store_us);
+
+    fake_flash_deinit();
+    for (int f = 0; f < 3; f++) {
+        free(ref[f]);
+        unlink(font_files[f]);
+    }
+    unlink(image);
+    snprintf(path, sizeof(path), "%s/bad.fon", font_dir);
+    unlink(path);
+    rmdir(font_dir);
+}
+
+// ==== Anti-aliased fonts ======================================================
+
+// Write the proportional 1 bit font as an anti-aliased font, set pixels at full coverage
+static void write_aa_font_file(const char *path, const unsigned char *font, int bpp)
+{
+    int max = (1 << bpp) - 1;
+    int pos = 4;
+    FILE *f = fopen(path, "w");
+
+    fputc(0, f);
+    fputc(font[1], f);
+    fputc(bpp, f);
+    fputc(TFT_FONT_AA_ID, f);
+    while (font[pos] != 0xFF) {
+        int w = font[pos + 2], h = font[pos + 3];
+        fwrite(font + pos, 1, 6, f);
+        pos += 6;
+        if (w == 0) continue;
+
+        uint8_t data[(255 * 255 * 4 + 7) / 8] = { 0 };
+        for (int p = 0; p < w * h; p++) {
+            if (font[pos + (p >> 3)] & (0x80 >> (p & 7))) data[(p * bpp) >> 3] |= max << (8 - bpp - ((p * bpp) & 7));
+        }
+        fwrite(data, 1, (((w * h * bpp) - 1) / 8) + 1, f);
+        pos += (((w * h) - 1) / 8) + 1;
+    }
+    fputc(0xFF, f);
+    fwrite("RPH_font", 1, 8, f);
+    fclose(f);
+}
+
+// Font with a space and an 'A' of 16 x 2 pixels, pixel x of row y has the value (x + y) % (max + 1)
+static void write_ramp_font_file(const char *path, int bpp)
+{
+    int max = (1 << bpp) - 1;
+    uint8_t data[16] = { 0 };
+    uint8_t head[] = { 0, 2, bpp, TFT_FONT_AA_ID, ' ', 0, 0, 0, 0, 4, 'A', 0, 16, 2, 0, 16 };
+    FILE *f = fopen(path, "w");
+
+    for (int p = 0; p < 32; p++) {
+        data[(p * bpp) >> 3] |= (((p % 16) + (p / 16)) % (max + 1)) << (8 - bpp - ((p * bpp) & 7));
+    }
+    fwrite(head, 1, sizeof(head), f);
+    fwrite(data, 1, 32 * bpp / 8, f);
+    fputc(0xFF, f);
+    fwrite("RPH_font", 1, 8, f);
+    fclose(f);
+}
+
+static int blend(int bg, int fg, int v, int max)
+{
+    return ((int)floor(bg + ((fg - bg) * (double)v / max) + 0.5)) & 0xFC;
+}
+
+static void check_aa_fonts(void)
+{
+    static const color_t colors[][2] = {
+        { { 252, 252, 0 }, { 64, 64, 64 } }, { { 0, 0, 0 }, { 252, 252, 252 } }, { { 20, 200, 120 }, { 200, 8, 40 } },
+    };
+    char dir[32], path[48];
+
+    printf("\nAnti-aliased fonts\n");
+    strcpy(dir, "/tmp/tft_aaXXXXXX");
+    if (mkdtemp(dir) == NULL) {
+        check(0, "temporary font directory");
+        return;
+    }
+    snprintf(path, sizeof(path), "%s/aa.fon", dir);
+
+    // with only empty and full pixels they draw as the 1 bit font, in every path
+    for (int bpp = 2; bpp <= 4; bpp += 2) {
+        write_aa_font_file(path, tft_Dejavu24, bpp);
+        for (int mode = 0; mode < 4; mode++) {
+            char what[64];
+            color_t *ref, *out;
+            snprintf(what, sizeof(what), "%d bpp font, %s%s", bpp, (mode & 1) ? "unbuffered" : "buffered",
+                     (mode & 2) ? ", transparent" : "");
+
+            display_reset();
+            font_buffered_char = !(mode & 1);
+            font_transparent = (mode & 2) != 0;
+            TFT_setFont(DEJAVU24_FONT, NULL);
+            TFT_setclipwin(0, 0, 239, 99);
+            TFT_print("Radio 1 Rock 538 Dance", 2, 2);
+            TFT_print("Veronica 00's Top 500", 2, 50);
+            ref = snapshot();
+
+            display_reset();
+            font_buffered_char = !(mode & 1);
+            font_transparent = (mode & 2) != 0;
+            TFT_setFont(USER_FONT, path);
+            check(cfont.bpp == bpp, "anti-aliased font loaded");
+            TFT_setclipwin(0, 0, 239, 99);
+            TFT_print("Radio 1 Rock 538 Dance", 2, 2);
+            TFT_print("Veronica 00's Top 500", 2, 50);
+            out = snapshot();
+            check(diff_pixels(ref, out) == 0, what);
+            check_bus(what);
+            free(ref);
+            free(out);
+        }
+    }
+
+    // partial pixels are blended from the background to the foreground color
+    for (int bpp = 2; bpp <= 4; bpp += 2) {
+        int max = (1 << bpp) - 1;
+        write_ramp_font_file(path, bpp);
+        for (int c = 0; c < (int)(sizeof(colors) / sizeof(colors[0])); c++) {
+            for (int mode = 0; mode < 3; mode++) {
+                int bad = 0;
+                display_reset();
+                fake_display_fill((color_t){ 0, 0, 252 });
+                font_buffered_char = (mode == 0);
+                font_transparent = (mode == 2);
+                TFT_setFont(USER_FONT, path);
+                _fg = colors[c][0];
+                _bg = colors[c][1];
+                TFT_print("A", 10, 10);
+                for (int y = 0; y < 2; y++) {
+                    for (int x = 0; x < 16; x++) {
+                        int v = (x + y) % (max + 1);
+                        color_t px = fake_display_pixel(10 + x, 10 + y);
+                        color_t exp = { blend(_bg.r, _fg.r, v, max), blend(_bg.g, _fg.g, v, max), blend(_bg.b, _fg.b, v, max) };
+                        if (font_transparent) exp = (v > max / 2) ? (color_t){ _fg.r & 0xFC, _fg.g & 0xFC, _fg.b & 0xFC } : (color_t){ 0, 0, 252 };
+                        if (memcmp(&px, &exp, sizeof(color_t))) bad++;
+                    }
+                }
+                char what[64];
+                snprintf(what, sizeof(what), "%d bpp blend, colors %d, %s: %d pixels wrong", bpp, c,
+                         (mode == 0) ? "buffered" : (mode == 1) ? "unbuffered" : "transparent", bad);
+                check(bad == 0, what);
+                check_bus(what);
+            }
+        }
+    }
+
+    // rendering cost without the glyph cache, the same glyphs with 1 and 4 bits per pixel
+    write_aa_font_file(path, tft_Dejavu24, 4);
+    for (int aa = 0; aa < 2; aa++) {
+        const int repeat = 50;
+        double us = 0;
+        display_reset();
+        if (aa) TFT_setFont(USER_FONT, path);
+        else TFT_setFont(DEJAVU24_FONT, NULL);
+        for (int r = 0; r < repeat; r++) {
+            for (int s = 0; s < (int)STATION_COUNT; s++) {
+                TFT_clearGlyphCache();
+                double t0 = host_us();
+                TFT_print((char *)station_names[s], 4, 40);
+                us += host_us() - t0;
+            }
+        }
+        printf("  station names, dejavu24 glyphs, %d bpp: %.2f us per name rendered (host, with the fake display)\n", aa ? 4 : 1,
+               us / (repeat * STATION_COUNT));
+    }
+    check_bus("anti-aliased bench");
+
+    unlink(path);
+    rmdir(dir);
+}
+
+// ==== Marquee =================================================================
+
+#define MARQUEE_Y   40
+
+// Lines of the text as the marquee splits it, at spaces to fit the width
+static int split_lines(const char *st, int width, char lines[][64])
+{
+    char word[64], cand[130];
+    int n = 0;
+    lines[0][0] = '\0';
+    while (*st) {
+        int len = strcspn(st, " ");
+        snprintf(word, sizeof(word), "%.*s", len, st);
+        snprintf(cand, sizeof(cand), "%s%s%s", lines[n], lines[n][0] ? " " : "", word);
+        if (lines[n][0] && (TFT_getStringWidth(cand) > width)) {
+            lines[++n][0] = '\0';
+            snprintf(cand, sizeof(cand), "%s", word);
+        }
+        snprintf(lines[n], 64, "%.63s", cand);
+        st += len;
+        while (*st == ' ') st++;
+    }
+    return n + 1;
+}
+
+static void window_visible(color_t *buf, int h)
+{
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < _width; x++) {
+            buf[y * _width + x] = fake_display_visible(x, MARQUEE_Y + y);
+        }
+    }
+}
+
+static void check_marquee(void)
+{
+    static const char *title = "Veronica 00's Top 500 - The greatest hits of the decade";
+    char lines[8][64];
+    char what[96];
+
+    printf("\nMarquee\n");
+    for (int rot = PORTRAIT; rot <= PORTRAIT_FLIP; rot += 2) {
+        display_reset();
+        _tft_setRotation(rot);
+        TFT_resetclipwin();
+        TFT_setFont(DEJAVU24_FONT, NULL);
+        int h = TFT_getfontheight();
+        int nlines = split_lines(title, _width, lines);
+        color_t *ref = malloc(_width * h * sizeof(color_t) * nlines);
+        color_t *prev = malloc(_width * h * sizeof(color_t));
+        color_t *cur = malloc(_width * h * sizeof(color_t));
+
+        // each line as TFT_print draws it on a cleared window
+        for (int l = 0; l < nlines; l++) {
+            TFT_fillRect(0, MARQUEE_Y, _width, h, _bg);
+            TFT_print(lines[l], CENTER, MARQUEE_Y);
+            window_visible(ref + (l * _width * h), h);
+        }
+
+        // rows around the window must not move
+        TFT_fillRect(0, MARQUEE_Y - 10, _width, 10, TFT_RED);
+        TFT_fillRect(0, MARQUEE_Y + h, _width, 10, TFT_GREEN);
+
+        check(TFT_marqueeStart((char *)title, CENTER, MARQUEE_Y) == 0, "marquee started");
+        window_visible(cur, h);
+        check(memcmp(cur, ref, _width * h * sizeof(color_t)) == 0, "marquee shows the first line");
+
+        int bad_shift = 0, bad_line = 0, shown = 0, bad_fixed = 0;
+        for (int step = 1; step <= nlines * h; step++) {
+            memcpy(prev, cur, _width * h * sizeof(color_t));
+            int full = TFT_marqueeStep();
+            window_visible(cur, h);
+            if (memcmp(cur, prev + _width, _width * (h - 1) * sizeof(color_t))) bad_shift++;
+            if (full) {
+                int l = (step / h) % nlines;
+                shown++;
+                if (memcmp(cur, ref + (l * _width * h), _width * h * sizeof(color_t))) bad_line++;
+            }
+            color_t above = fake_display_visible(7, MARQUEE_Y - 1), below = fake_display_visible(7, MARQUEE_Y + h);
+            if ((above.r != 252) || (above.g != 0) || (below.g != 252) || (below.r != 0)) bad_fixed++;
+        }
+        snprintf(what, sizeof(what), "rotation %d: %d steps not scrolled by one row", rot, bad_shift);
+        check(bad_shift == 0, what);
+        snprintf(what, sizeof(what), "rotation %d: %d of %d lines wrong", rot, bad_line, shown);
+        check((bad_line == 0) && (shown == nlines), what);
+        snprintf(what, sizeof(what), "rotation %d: rows outside the window moved %d times", rot, bad_fixed);
+        check(bad_fixed == 0, what);
+
+        // a few rows into a line, stopping keeps the picture
+        for (int i = 0; i < 5; i++) {
+            TFT_marqueeStep();
+        }
+        window_visible(prev, h);
+        TFT_marqueeStop();
+        window_visible(cur, h);
+        check(memcmp(cur, prev, _width * h * sizeof(color_t)) == 0, "stopped marquee keeps the picture");
+        check(TFT_compare_colors(fake_display_pixel(3, MARQUEE_Y + 2), fake_display_visible(3, MARQUEE_Y + 2)) == 0,
+              "scrolling off after the marquee stops");
+        check_bus("marquee");
+
+        free(ref);
+        free(prev);
+        free(cur);
+    }
+
+    // a title fitting the window is only drawn
+    fake_display_reset_stats();
+    check(TFT_marqueeStart("Radio 1", CENTER, MARQUEE_Y) == 0, "short marquee started");
+    check(TFT_marqueeStep() == 1, "short marquee always shows the whole title");
+    TFT_marqueeStop();
+    check(TFT_compare_colors(fake_display_pixel(3, MARQUEE_Y + 2), fake_display_visible(3, MARQUEE_Y + 2)) == 0,
+          "short marquee does not scroll");
+    check_bus("short marquee");
+
+    // a new title replaces a scrolled one without drawing the old one again
+    fake_display_stats_t st;
+    TFT_marqueeStart("Veronica 00's Top 500 - The greatest hits of the decade", CENTER, MARQUEE_Y);
+    for (int i = 0; i < 5; i++) {
+        TFT_marqueeStep();
+    }
+    fake_display_reset_stats();
+    check(TFT_marqueeStart("Radio 1", CENTER, MARQUEE_Y) == 0, "marquee restarted");
+    fake_display_get_stats(&st);
+    check(st.pixels == (uint64_t)_width * TFT_getfontheight(), "restarted marquee draws the window once");
+    check(TFT_compare_colors(fake_display_pixel(3, MARQUEE_Y + 2), fake_display_visible(3, MARQUEE_Y + 2)) == 0,
+          "scrolling off after the marquee restarts");
+    TFT_marqueeStop();
+    check_bus("restarted marquee");
+
+    // bus cost of a step against redrawing the window
+    fake_display_stats_t scrolled, redrawn;
+    display_reset();
+    _tft_setRotation(PORTRAIT);
+    TFT_resetclipwin();
+    TFT_setFont(DEJAVU24_FONT, NULL);
+    int h = TFT_getfontheight();
+    TFT_marqueeStart((char *)title, CENTER, MARQUEE_Y);
+    fake_display_reset_stats();
+    for (int step = 0; step < 100; step++) {
+        TFT_marqueeStep();
+    }
+    fake_display_get_stats(&scrolled);
+    TFT_marqueeStop();
+    fake_display_reset_stats();
+    for (int step = 0; step < 100; step++) {
+        TFT_fillRect(0, MARQUEE_Y, _width, h, _bg);
+        TFT_print("Veronica 00's Top 500 -", CENTER, MARQUEE_Y);
+    }
+    fake_display_get_stats(&redrawn);
+    check_bus("marquee bench");
+    _tft_setRotation(LANDSCAPE);
+    printf("  per step, dejavu24: scrolled %u transfers %llu bytes %.0f us, redrawn %u transfers %llu bytes %.0f us\n",
+           scrolled.transfers / 100, (unsigned long long)scrolled.bytes / 100, scrolled.wire_us / 100,
+           redrawn.transfers / 100, (unsigned long long)redrawn.bytes / 100, redrawn.wire_us / 100);
+}
+
+// ==== Frame buffer ============================================================
+
+// Colors exact in RGB565, so the frame buffer and direct drawing give the same display RAM
+static void draw_scene(void)
+{
+    TFT_fillRect(0, 0, _width, 30, (color_t){ 64, 64, 64 });
+    TFT_drawRect(0, 0, _width, 30, TFT_CYAN);
+    TFT_setFont(DEJAVU18_FONT, NULL);
+    TFT_print("Energy 90s", CENTER, 6);
+    TFT_drawLine(10, 40, 300, 200, TFT_RED);
+    TFT_drawLine(300, 40, 10, 200, TFT_GREEN);
+    TFT_drawCircle(160, 120, 50, TFT_WHITE);
+    TFT_fillCircle(60, 160, 30, TFT_BLUE);
+    TFT_drawTriangle(200, 220, 310, 230, 250, 150, TFT_MAGENTA);
+    for (int i = 0; i < 20; i++) {
+        TFT_drawPixel(100 + i * 3, 220, TFT_YELLOW, 1);
+    }
+}
+
+// The volume bar of main.c, the whole bar or only its two parts
+static void draw_volume(int volume, int whole)
+{
+    int y = _height - 24;
+    if (whole) {
+        TFT_fillRect(1, y, _width - 2, 16, (color_t){ 64, 64, 64 });
+        TFT_fillRect(1, y, volume * 2, 16, TFT_YELLOW);
+    }
+    else {
+        if (volume > 0) TFT_fillRect(1, y, volume * 2, 16, TFT_YELLOW);
+        TFT_fillRect(1 + volume * 2, y, _width - 2 - volume * 2, 16, (color_t){ 64, 64, 64 });
+    }
+}
+
+static double volume_bytes(int whole, int use_fb)
+{
+    fake_display_stats_t bus;
+    tft_fb_stats_t fb;
+    int updates = 0;
+
+    display_reset();
+    if (use_fb) {
+        TFT_fbInit(MALLOC_CAP_SPIRAM);
+        TFT_fbFlush();
+    }
+    draw_volume(40, whole);
+    TFT_fbFlush();
+    fake_display_reset_stats();
+    TFT_fbResetStats();
+    for (int v = 41; v <= 60; v++, updates++) {
+        draw_volume(v, whole);
+        TFT_fbFlush();
+    }
+    for (int v = 59; v >= 40; v--, updates++) {
+        draw_volume(v, whole);
+        TFT_fbFlush();
+    }
+    fake_display_get_stats(&bus);
+    TFT_fbGetStats(&fb);
+    if (use_fb) {
+        check(bus.bytes == fb.bytes, "frame buffer counts the bytes sent");
+        TFT_fbDeinit();
+    }
+    check_bus("volume bar");
+    return (double)bus.bytes / updates;
+}
+
+static void check_framebuffer(void)
+{
+    tft_fb_stats_t fb;
+    char what[96];
+
+    printf("\nFrame buffer\n");
+
+    display_reset();
+    draw_scene();
+    color_t *ref = snapshot();
+
+    display_reset();
+    fake_display_fill((color_t){ 8, 8, 8 });
+    check(TFT_fbInit(MALLOC_CAP_SPIRAM) == 0, "frame buffer allocated");
+    int bytes = TFT_fbFlush();
+    check(bytes == 11 + (_width * _height * 3), "first flush sends the whole screen");
+    check(TFT_compare_colors(fake_display_pixel(5, 5), TFT_BLACK) == 0, "frame buffer starts black");
+
+    fake_display_reset_stats();
+    draw_scene();
+    fake_display_stats_t bus;
+    fake_display_get_stats(&bus);
+    check(bus.transfers == 0, "drawing goes to the frame buffer only");
+    TFT_fbFlush();
+    color_t *shown = snapshot();
+    int diff = diff_pixels(ref, shown);
+    snprintf(what, sizeof(what), "scene flushed from the frame buffer: %d pixels differ", diff);
+    check(diff == 0, what);
+    free(shown);
+    check(TFT_compare_colors(TFT_readPixel(160, 70), ref[70 * _width + 160]) == 0, "pixels read from the frame buffer");
+
+    TFT_print("Energy 90s", CENTER, 6);
+    TFT_drawRect(0, 0, _width, 30, TFT_CYAN);
+    TFT_drawCircle(160, 120, 50, TFT_WHITE);
+    check(TFT_fbFlush() == 0, "drawing the same again sends nothing");
+
+    // nearby changes are sent as one rectangle, distant ones apart
+    TFT_fillRect(20, 100, 10, 10, TFT_ORANGE);
+    TFT_fillRect(32, 100, 10, 10, TFT_ORANGE);
+    TFT_fbFlush();
+    TFT_fbGetStats(&fb);
+    check(fb.last_rects == 1, "nearby rectangles merged");
+    TFT_fillRect(20, 100, 10, 10, TFT_PURPLE);
+    TFT_fillRect(280, 20, 10, 10, TFT_PURPLE);
+    TFT_fbFlush();
+    TFT_fbGetStats(&fb);
+    check(fb.last_rects == 2, "distant rectangles sent apart");
+
+    // more scattered changes than rectangles kept
+    for (int i = 0; i < 60; i++) {
+        TFT_drawPixel((i * 37) % _width, (i * 53) % _height, TFT_WHITE, 1);
+    }
+    TFT_fbFlush();
+    TFT_fbGetStats(&fb);
+    snprintf(what, sizeof(what), "60 scattered pixels sent in %u rectangles", fb.last_rects);
+    check(fb.last_rects <= 16, what);
+    int bad = 0;
+    for (int i = 0; i < 60; i++) {
+        if (TFT_compare_colors(fake_display_pixel((i * 37) % _width, (i * 53) % _height), TFT_WHITE)) bad++;
+    }
+    check(bad == 0, "scattered pixels all shown");
+
+    // after a rotation change the frame buffer is sent again
+    _tft_setRotation(PORTRAIT);
+    check(TFT_fbFlush() == 11 + (_width * _height * 3), "whole screen sent after rotation");
+    _tft_setRotation(LANDSCAPE);
+    TFT_fbFlush();
+
+    TFT_fbDeinit();
+    fake_display_reset_stats();
+    TFT_fillRect(0, 0, 10, 10, TFT_RED);
+    fake_display_get_stats(&bus);
+    check((bus.transfers > 0) && (TFT_compare_colors(fake_display_pixel(5, 5), TFT_RED) == 0),
+          "drawing goes to the display again");
+    check_bus("frame buffer");
+    free(ref);
+
+    double whole_direct = volume_bytes(1, 0);
+    double parts_direct = volume_bytes(0, 0);
+    double whole_fb = volume_bytes(1, 1);
+    double parts_fb = volume_bytes(0, 1);
+    printf("  volume bar step, bytes sent: whole bar %.0f, two parts %.0f, frame buffer %.0f / %.0f\n",
+           whole_direct, parts_direct, whole_fb, parts_fb);
+    check(parts_fb < parts_direct / 10, "frame buffer sends only the changed columns");
+}
+
+// ==== Shapes ==================================================================
+
+#define SHAPE_COUNT 6
+static const char *shape_names[SHAPE_COUNT] = {
+    "lines", "triangles", "circles", "round rects", "ellipses", "filled",
+};
+
+// Pixels of the whole display RAM, FNV-1a
+static uint32_t display_hash(void)
+{
+    uint32_t h = 2166136261u;
+    for (int y = 0; y < _height; y++) {
+        for (int x = 0; x < _width; x++) {
+            color_t c = fake_display_pixel(x, y);
+            h = (h ^ c.r) * 16777619u;
+            h = (h ^ c.g) * 16777619u;
+            h = (h ^ c.b) * 16777619u;
+        }
+    }
+    return h;
+}
+
+static void draw_shapes(int shape)
+{
+    switch (shape) {
+        case 0:
+            // every direction, short and long
+            for (int a = 0; a < 360; a += 15) {
+                int dx = (int)lround(cos(a * M_PI / 180) * 110), dy = (int)lround(sin(a * M_PI / 180) * 110);
+                TFT_drawLine(160, 120, 160 + dx, 120 + dy, TFT_WHITE);
+                TFT_drawLine(40 + dx / 8, 40 + dy / 8, 40 - dx / 8, 40 - dy / 8, TFT_CYAN);
+            }
+            break;
+        case 1:
+            for (int i = 0; i < 8; i++) {
+                TFT_drawTriangle(10 + i * 30, 200, 40 + i * 35, 20 + i * 7, 300 - i * 20, 150 + i * 10, TFT_GREEN);
+            }
+            break;
+        case 2:
+            for (int r = 4; r < 150; r += 13) TFT_drawCircle(150, 110, r, TFT_YELLOW);
+            break;
+        case 3:
+            for (int i = 0; i < 6; i++) TFT_drawRoundRect(10 + i * 12, 10 + i * 10, 300 - i * 24, 220 - i * 20, 4 + i * 5, TFT_ORANGE);
+            break;
+        case 4:
+            for (int i = 0; i < 6; i++) {
+                TFT_drawEllipse(160, 120, 20 + i * 25, 110 - i * 18, TFT_MAGENTA, 15);
+                TFT_drawEllipse(60, 60, 50 - i * 7, 10 + i * 8, TFT_CYAN, 1 << (i & 3));
+            }
+            break;
+        default:
+            TFT_fillCircle(80, 80, 60, TFT_BLUE);
+            TFT_fillRoundRect(150, 20, 150, 100, 30, TFT_RED);
+            TFT_fillEllipse(200, 180, 100, 40, TFT_GREEN, 15);
+            TFT_fillEllipse(60, 190, 40, 30, TFT_PURPLE, TFT_ELLIPSE_UPPER_LEFT | TFT_ELLIPSE_LOWER_RIGHT);
+            break;
+    }
+}
+
+// Rasterization of the shapes before span batching, the whole screen and clipped
+static const uint32_t shape_hashes[SHAPE_COUNT][2] = {
+    { 0x62f9fd89, 0x1d02e911 }, { 0xe7cb9e09, 0x9866cbed }, { 0x80bc5ddd, 0x9084ffc5 },
+    { 0x4c54dda5, 0xbf490ce5 }, { 0x6dc3dc95, 0x05a5ef55 }, { 0x2cae03ad, 0x8361e271 },
+};
+
+static void check_shapes(void)
+{
+    char what[96];
+
+    printf("\nShapes\n");
+    printf("  %-12s %8s %10s %8s %9s\n", "", "selects", "transfers", "bytes", "bus ms");
+    for (int shape = 0; shape < SHAPE_COUNT; shape++) {
+        fake_display_stats_t bus;
+        uint32_t hash[2];
+
+        display_reset();
+        draw_shapes(shape);
+        fake_display_get_stats(&bus);
+        hash[0] = display_hash();
+
+        display_reset();
+        TFT_setclipwin(37, 23, 283, 211);
+        draw_shapes(shape);
+        hash[1] = display_hash();
+        check_bus(shape_names[shape]);
+
+        printf("  %-12s %8u %10u %8llu %9.2f  %08x %08x\n", shape_names[shape], bus.selects, bus.transfers,
+               (unsigned long long)bus.bytes, bus.wire_us / 1000, hash[0], hash[1]);
+        snprintf(what, sizeof(what), "%s drawn as before", shape_names[shape]);
+        check(hash[0] == shape_hashes[shape][0], what);
+        snprintf(what, sizeof(what), "%s clipped as before", shape_names[shape]);
+        check(hash[1] == shape_hashes[shape][1], what);
+    }
+    display_reset();
+}
+
+// ==== Arcs ====================================================================
+
+// The float arc of the library before the integer one, drawn pixel by pixel as the reference
+static void ref_fill_arc(int cx, int cy, int radius, int thickness, float start, float end, color_t color)
+{
+    float sslope = (cos(start / 360.0f * 2 * PI) * 360.0f) / (sin(start / 360.0f * 2 * PI) * 360.0f);
+    float eslope = (cos(end / 360.0f * 2 * PI) * 360.0f) / (sin(end / 360.0f * 2 * PI) * 360.0f);
+
+    if (end == 360) eslope = -1000000;
+
+    int ir2 = (radius - thickness) * (radius - thickness);
+    int or2 = radius * radius;
+
+    for (int x = -radius; x <= radius; x++) {
+        for (int y = -radius; y <= radius; y++) {
+            int x2 = x * x;
+            int y2 = y * y;
+            if ((x2 + y2 < or2 && x2 + y2 >= ir2) &&
+                ((y > 0 && start < 180 && x <= y * sslope) || (y < 0 && start > 180 && x >= y * sslope) ||
+                 (y < 0 && start <= 180) || (y == 0 && start <= 180 && x < 0) || (y == 0 && start == 0 && x > 0)) &&
+                ((y > 0 && end < 180 && x >= y * eslope) || (y < 0 && end > 180 && x <= y * eslope) ||
+                 (y > 0 && end >= 180) || (y == 0 && end >= 180 && x < 0) || (y == 0 && start == 0 && x > 0))) {
+                TFT_drawPixel(cx + x, cy + y, color, 1);
+            }
+        }
+    }
+}
+
+// Offset rounded down from the exact angle. The float code was one pixel short
+// where the result is a whole number, from the rounding of pi/180.
+static int ref_polar(int len, double deg, int use_sin)
+{
+    double v = len * (use_sin ? sin(deg * M_PI / 180) : cos(deg * M_PI / 180));
+    return (int)floor(v + 1e-9);
+}
+
+static void ref_polar_line(int cx, int cy, int from, int to, double deg, color_t color)
+{
+    TFT_drawLine(cx + ref_polar(from, deg, 0), cy + ref_polar(from, deg, 1),
+                 cx + ref_polar(to, deg, 0), cy + ref_polar(to, deg, 1), color);
+}
+
+static void ref_draw_arc(int cx, int cy, int r, int th, float start, float end, color_t color, color_t fillcolor)
+{
+    if (th < 1) th = 1;
+    if (th > r) th = r;
+
+    int f = TFT_compare_colors(fillcolor, color);
+    float astart = fmodf(start, 360) + _angleOffset;
+    float aend = fmodf(end, 360) + _angleOffset;
+    if (astart < 0) astart += (float)360;
+    if (aend < 0) aend += (float)360;
+    if (aend == 0) aend = (float)360;
+
+    if (astart > aend) {
+        ref_fill_arc(cx, cy, r, th, astart, 360, fillcolor);
+        ref_fill_arc(cx, cy, r, th, 0, aend, fillcolor);
+        if (f) {
+            ref_fill_arc(cx, cy, r, 1, astart, 360, color);
+            ref_fill_arc(cx, cy, r, 1, 0, aend, color);
+            ref_fill_arc(cx, cy, r - th, 1, astart, 360, color);
+            ref_fill_arc(cx, cy, r - th, 1, 0, aend, color);
+        }
+    }
+    else {
+        ref_fill_arc(cx, cy, r, th, astart, aend, fillcolor);
+        if (f) {
+            ref_fill_arc(cx, cy, r, 1, astart, aend, color);
+            ref_fill_arc(cx, cy, r - th, 1, astart, aend, color);
+        }
+    }
+    if (f) {
+        ref_polar_line(cx, cy, r - th, r - 1, astart, color);
+        ref_polar_line(cx, cy, r - th, r - 1, aend, color);
+    }
+}
+
+#define ARC_CX  160
+#define ARC_CY  120
+
+// Display RAM in the square around the arc
+static void arc_square(int r, color_t *buf)
+{
+    for (int y = -r - 1; y <= r + 1; y++) {
+        for (int x = -r - 1; x <= r + 1; x++) *buf++ = fake_display_pixel(ARC_CX + x, ARC_CY + y);
+    }
+}
+
+// Pixels of the arc differing from the reference drawing
+static int arc_diff(int r, int th, float start, float end, color_t color, color_t fill)
+{
+    int n = (2 * r + 3) * (2 * r + 3);
+    color_t *ref = malloc(n * sizeof(color_t));
+    color_t *arc = malloc(n * sizeof(color_t));
+    int diff = 0;
+
+    fake_display_fill(TFT_BLACK);
+    ref_draw_arc(ARC_CX, ARC_CY, r, th, start, end, color, fill);
+    arc_square(r, ref);
+    fake_display_fill(TFT_BLACK);
+    TFT_drawArc(ARC_CX, ARC_CY, r, th, start, end, color, fill);
+    arc_square(r, arc);
+    for (int i = 0; i < n; i++) {
+        if (memcmp(&ref[i], &arc[i], sizeof(color_t))) diff++;
+    }
+    free(ref);
+    free(arc);
+    return diff;
+}
+
+static void check_arcs(void)
+{
+    static const int radii[3] = { 12, 45, 100 };
+    static const int spans[4] = { 10, 90, 200, 350 };
+    static const float fractions[6] = { 0.5f, 12.3f, 77.77f, 133.1f, 199.5f, 271.25f };
+    int arcs = 0, bad_arcs = 0, bad_pixels = 0;
+    char what[96];
+
+    printf("\nArcs\n");
+    display_reset();
+    for (int ri = 0; ri < 3; ri++) {
+        int r = radii[ri];
+        int ths[3] = { 1, r / 6 + 1, r };
+        for (int ti = 0; ti < 3; ti++) {
+            // outlined only when there is room inside
+            color_t color = (ti == 1) ? TFT_WHITE : TFT_ORANGE;
+            for (int start = 0; start < 360; start += 5) {
+                for (int si = 0; si < 4; si++) {
+                    int diff = arc_diff(r, ths[ti], start, start + spans[si], color, TFT_ORANGE);
+                    arcs++;
+                    if (diff) {
+                        bad_arcs++;
+                        bad_pixels += diff;
+                        if (bad_arcs <= 5) printf("  r %d th %d %d..%d: %d pixels differ\n", r, ths[ti], start, start + spans[si], diff);
+                    }
+                }
+            }
+        }
+    }
+    snprintf(what, sizeof(what), "%d of %d arcs differ from the float arcs, %d pixels", bad_arcs, arcs, bad_pixels);
+    check(bad_arcs == 0, what);
+
+    bad_pixels = 0;
+    for (int i = 0; i < 6; i++) {
+        for (int j = 0; j < 6; j++) {
+            if (i != j) bad_pixels += arc_diff(45, 9, fractions[i], fractions[j], TFT_WHITE, TFT_ORANGE);
+        }
+    }
+    snprintf(what, sizeof(what), "arcs between fractional angles: %d pixels differ", bad_pixels);
+    check(bad_pixels == 0, what);
+
+    // needles of a gauge
+    bad_pixels = 0;
+    for (int a = 0; a < 360; a++) {
+        int n = (2 * 100 + 3) * (2 * 100 + 3);
+        color_t *ref = malloc(n * sizeof(color_t));
+        color_t *line = malloc(n * sizeof(color_t));
+        fake_display_fill(TFT_BLACK);
+        ref_polar_line(ARC_CX, ARC_CY, 20, 100, a + _angleOffset, TFT_RED);
+        arc_square(100, ref);
+        fake_display_fill(TFT_BLACK);
+        TFT_drawLineByAngle(ARC_CX, ARC_CY, 20, 80, a, TFT_RED);
+        arc_square(100, line);
+        for (int i = 0; i < n; i++) {
+            if (memcmp(&ref[i], &line[i], sizeof(color_t))) bad_pixels++;
+        }
+        free(ref);
+        free(line);
+    }
+    snprintf(what, sizeof(what), "lines by angle: %d pixels differ", bad_pixels);
+    check(bad_pixels == 0, what);
+    check_bus("arcs");
+    display_reset();
+}
+
+// A volume gauge: 270 degree ring filled up to the volume, the needle and an outlined arc
+static void bench_arcs(void)
+{
+    fake_display_stats_t bus;
+    double t0;
+
+    display_reset();
+    fake_display_reset_stats();
+    t0 = host_us();
+    for (int v = 0; v < 100; v++) {
+        TFT_drawArc(ARC_CX, ARC_CY, 80, 12, 225, 225 + v * 27 / 10 + 1, TFT_GREEN, TFT_GREEN);
+    }
+    double fill_us = (host_us() - t0) / 100;
+    fake_display_get_stats(&bus);
+    printf("  gauge ring r 80 th 12, per update: %u transfers %llu bytes %.2f ms bus, %.1f us cpu\n",
+           bus.transfers / 100, (unsigned long long)bus.bytes / 100, bus.wire_us / 100000, fill_us);
+
+    fake_display_reset_stats();
+    t0 = host_us();
+    for (int v = 0; v < 100; v++) {
+        TFT_drawArc(ARC_CX, ARC_CY, 100, 10, v, v + 90, TFT_WHITE, TFT_BLUE);
+    }
+    double outlined_us = (host_us() - t0) / 100;
+    fake_display_get_stats(&bus);
+    printf("  outlined arc r 100 th 10, 90 deg: %u transfers %llu bytes %.2f ms bus, %.1f us cpu\n",
+           bus.transfers / 100, (unsigned long long)bus.bytes / 100, bus.wire_us / 100000, outlined_us);
+
+    fake_display_reset_stats();
+    t0 = host_us();
+    for (int a = 0; a < 360; a++) TFT_drawLineByAngle(ARC_CX, ARC_CY, 10, 60, a, TFT_RED);
+    double needle_us = (host_us() - t0) / 360;
+    printf("  needle: %.2f us cpu\n", needle_us);
+    check_bus("arc bench");
+    display_reset();
+}
+
+// ==== Polygons ================================================================
+
+// The two part triangle fill of the library before the polygon filler, pixel by pixel
+static void ref_fill_triangle(int x0, int y0, int x1, int y1, int x2, int y2, color_t color)
+{
+    int t;
+    if (y0 > y1) { t = y0; y0 = y1; y1 = t; t = x0; x0 = x1; x1 = t; }
+    if (y1 > y2) { t = y2; y2 = y1; y1 = t; t = x2; x2 = x1; x1 = t; }
+    if (y0 > y1) { t = y0; y0 = y1; y1 = t; t = x0; x0 = x1; x1 = t; }
+
+    for (int y = y0; y <= y2; y++) {
+        int a, b;
+        if (y0 == y2) {
+            a = (x0 < x1) ? x0 : x1;
+            if (x2 < a) a = x2;
+            b = (x0 > x1) ? x0 : x1;
+            if (x2 > b) b = x2;
+        }
+        else {
+            if ((y < y1) || (y1 == y2)) a = x0 + (x1 - x0) * (y - y0) / (y1 - y0);
+            else a = x1 + (x2 - x1) * (y - y1) / (y2 - y1);
+            b = x0 + (x2 - x0) * (y - y0) / (y2 - y0);
+        }
+        if (a > b) { t = a; a = b; b = t; }
+        for (int x = a; x <= b; x++) TFT_drawPixel(x, y, color, 1);
+    }
+}
+
+// Vertex math of TFT_drawPolygon and TFT_drawStar, including the pi added by deg_to_rad
+static int ref_vertex(int c, double deg, double len, int use_sin)
+{
+    double a = (float)deg * 0.01745329252 + 3.14159265359;
+    return (int)(c + (use_sin ? sin(a) : cos(a)) * len);
+}
+
+// Polygons filled as a fan of triangles from the center, as before
+static void ref_draw_polygon(int cx, int cy, int sides, int diameter, color_t color, color_t fill, int rot, int th)
+{
+    int xs[MAX_POLIGON_SIDES], ys[MAX_POLIGON_SIDES];
+    int deg = rot - _angleOffset;
+    int rads = 360 / sides;
+
+    for (int n = 0; n < th || (n == 0 && TFT_compare_colors(fill, color)); n++) {
+        for (int i = 0; i < sides; i++) {
+            xs[i] = ref_vertex(cx, i * rads + deg, diameter - n, 1);
+            ys[i] = ref_vertex(cy, i * rads + deg, diameter - n, 0);
+        }
+        if ((n == 0) && TFT_compare_colors(fill, color)) {
+            for (int i = 0; i < sides; i++) {
+                int j = (i + 1) % sides;
+                ref_fill_triangle(cx, cy, xs[i], ys[i], xs[j], ys[j], fill);
+            }
+        }
+        if (n < th) {
+            for (int i = 0; i < sides; i++) {
+                int j = (i + 1) % sides;
+                TFT_drawLine(xs[i], ys[i], xs[j], ys[j], color);
+            }
+        }
+    }
+}
+
+static void ref_fill_star(int cx, int cy, int diameter, color_t color, float factor)
+{
+    for (int i = 0; i < 5; i++) {
+        int j = (i + 1) % 5;
+        int xo = ref_vertex(cx, i * 72 + 72, diameter, 1), yo = ref_vertex(cy, i * 72 + 72, diameter, 0);
+        int xi = ref_vertex(cx, i * 72 + 36, (float)diameter / factor, 1);
+        int yi = ref_vertex(cy, i * 72 + 36, (float)diameter / factor, 0);
+        int xj = ref_vertex(cx, j * 72 + 36, (float)diameter / factor, 1);
+        int yj = ref_vertex(cy, j * 72 + 36, (float)diameter / factor, 0);
+        ref_fill_triangle(cx, cy, xi, yi, xo, yo, color);
+        ref_fill_triangle(cx, cy, xo, yo, xj, yj, color);
+    }
+}
+
+static uint32_t rand_state = 12345;
+
+static int rand_range(int lo, int hi)
+{
+    rand_state = rand_state * 1103515245u + 12345u;
+    return lo + (int)((rand_state >> 8) % (uint32_t)(hi - lo + 1));
+}
+
+// Filled shape drawn by the library against the reference drawing on the whole screen
+static int shape_diff(int kind, const int *v)
+{
+    color_t *ref, *got;
+    int diff;
+
+    fake_display_fill(TFT_BLACK);
+    if (kind == 0) ref_fill_triangle(v[0], v[1], v[2], v[3], v[4], v[5], TFT_GREEN);
+    else if (kind == 1) ref_draw_polygon(v[0], v[1], v[2], v[3], TFT_WHITE, TFT_BLUE, v[4], v[5]);
+    else ref_fill_star(v[0], v[1], v[2], TFT_YELLOW, v[3] / 10.0f);
+    ref = snapshot();
+
+    fake_display_fill(TFT_BLACK);
+    if (kind == 0) TFT_fillTriangle(v[0], v[1], v[2], v[3], v[4], v[5], TFT_GREEN);
+    else if (kind == 1) TFT_drawPolygon(v[0], v[1], v[2], v[3], TFT_WHITE, TFT_BLUE, v[4], v[5]);
+    else TFT_drawStar(v[0], v[1], v[2], TFT_YELLOW, true, v[3] / 10.0f);
+    got = snapshot();
+
+    diff = diff_pixels(ref, got);
+    free(ref);
+    free(got);
+    return diff;
+}
+
+static void check_polygons(void)
+{
+    static const char *kinds[3] = { "triangles", "polygons", "stars" };
+    int count[3] = { 0 }, bad[3] = { 0 }, bad_pixels[3] = { 0 };
+    char what[96];
+
+    printf("\nPolygons\n");
+    display_reset();
+    for (int i = 0; i < 500; i++) {
+        int v[6];
+        for (int k = 0; k < 6; k++) v[k] = (k & 1) ? rand_range(0, 239) : rand_range(0, 319);
+        // flat tops, flat bottoms and single rows
+        if (i % 10 == 1) v[3] = v[1];
+        if (i % 10 == 2) v[5] = v[3];
+        if (i % 10 == 3) v[3] = v[5] = v[1];
+        if (i % 10 == 4) v[2] = v[0];
+        int diff = shape_diff(0, v);
+        count[0]++;
+        if (diff) bad[0]++, bad_pixels[0] += diff;
+    }
+    for (int sides = MIN_POLIGON_SIDES; sides <= MAX_POLIGON_SIDES; sides++) {
+        for (int rot = 0; rot < 120; rot += 23) {
+            int v[6] = { 160, 120, sides, 8 + (sides * 37 + rot) % 110, rot, (rot / 23) % 4 };
+            int diff = shape_diff(1, v);
+            count[1]++;
+            if (diff) bad[1]++, bad_pixels[1] += diff;
+        }
+    }
+    for (int d = 5; d < 115; d += 3) {
+        for (int f = 10; f <= 40; f += 5) {
+            int v[4] = { 160, 120, d, f };
+            int diff = shape_diff(2, v);
+            count[2]++;
+            if (diff) bad[2]++, bad_pixels[2] += diff;
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        snprintf(what, sizeof(what), "%d of %d %s differ from the triangle fills, %d pixels", bad[k], count[k], kinds[k],
+                 bad_pixels[k]);
+        check(bad[k] == 0, what);
+    }
+
+    // clipped to a window and partly outside of it
+    display_reset();
+    TFT_setclipwin(37, 23, 283, 211);
+    {
+        int v[6] = { -40, 60, 150, -30, 260, 230 };
+        color_t *ref, *got;
+        fake_display_fill(TFT_BLACK);
+        ref_fill_triangle(v[0], v[1], v[2], v[3], v[4], v[5], TFT_GREEN);
+        ref = snapshot();
+        fake_display_fill(TFT_BLACK);
+        TFT_fillTriangle(v[0], v[1], v[2], v[3], v[4], v[5], TFT_GREEN);
+        got = snapshot();
+        snprintf(what, sizeof(what), "clipped triangle: %d pixels differ", diff_pixels(ref, got));
+        check(diff_pixels(ref, got) == 0, what);
+        free(ref);
+        free(got);
+    }
+    check_bus("polygons");
+    display_reset();
+}
+
+static void bench_polygons(void)
+{
+    fake_display_stats_t bus;
+    double t0;
+
+    display_reset();
+    fake_display_reset_stats();
+    t0 = host_us();
+    for (int i = 0; i < 100; i++) TFT_fillTriangle(20 + i, 200, 160, 10 + i, 300 - i, 150, TFT_GREEN);
+    double tri_us = (host_us() - t0) / 100;
+    fake_display_get_stats(&bus);
+    printf("  triangle: %u transfers %llu bytes %.2f ms bus, %.1f us cpu\n", bus.transfers / 100,
+           (unsigned long long)bus.bytes / 100, bus.wire_us / 100000, tri_us);
+
+    fake_display_reset_stats();
+    t0 = host_us();
+    for (int i = 0; i < 100; i++) TFT_drawPolygon(160, 120, 8, 100, TFT_WHITE, TFT_BLUE, i, 0);
+    double poly_us = (host_us() - t0) / 100;
+    fake_display_get_stats(&bus);
+    printf("  octagon d 100: %u transfers %llu bytes %.2f ms bus, %.1f us cpu\n", bus.transfers / 100,
+           (unsigned long long)bus.bytes / 100, bus.wire_us / 100000, poly_us);
+
+    fake_display_reset_stats();
+    t0 = host_us();
+    for (int i = 0; i < 100; i++) TFT_drawStar(160, 120, 100, TFT_YELLOW, true, 2.5f);
+    double star_us = (host_us() - t0) / 100;
+    fake_display_get_stats(&bus);
+    printf("  star d 100: %u transfers %llu bytes %.2f ms bus, %.1f us cpu\n", bus.transfers / 100,
+           (unsigned long long)bus.bytes / 100, bus.wire_us / 100000, star_us);
+    check_bus("polygon bench");
+    display_reset();
+}
+
+// ==== JPEG ====================================================================
+
+#define JPG_W   320
+#define JPG_H   240
+
+static color_t jpg_pixel(int x, int y)
+{
+    return (color_t){ (uint8_t)(x * 7 + y), (uint8_t)((y * 3) ^ x), (uint8_t)((x * y) >> 2) };
+}
+
+static uint8_t *jpg_image(int msx, int msy, uint32_t *size)
+{
+    color_t *pixels = malloc(JPG_W * JPG_H * sizeof(color_t));
+    for (int y = 0; y < JPG_H; y++) {
+        for (int x = 0; x < JPG_W; x++) pixels[y * JPG_W + x] = jpg_pixel(x, y);
+    }
+    *size = fake_tjpgd_encode(NULL, pixels, JPG_W, JPG_H, msx, msy, 700);
+    uint8_t *img = malloc(*size);
+    fake_tjpgd_encode(img, pixels, JPG_W, JPG_H, msx, msy, 700);
+    free(pixels);
+    return img;
+}
+
+// Pixels of the display differing from the image scaled by 1/2^scale at x,y,
+// black outside of it and outside of the clip window
+static int jpg_diff(int x, int y, int scale)
+{
+    int diff = 0;
+    for (int py = 0; py < _height; py++) {
+        for (int px = 0; px < _width; px++) {
+            int ix = px - x, iy = py - y;
+            color_t want = TFT_BLACK;
+            if ((px >= dispWin.x1) && (px <= dispWin.x2) && (py >= dispWin.y1) && (py <= dispWin.y2) &&
+                (ix >= 0) && (iy >= 0) && (ix < (JPG_W >> scale)) && (iy < (JPG_H >> scale))) {
+                want = jpg_pixel(ix << scale, iy << scale);
+                want.r &= 0xFC;
+                want.g &= 0xFC;
+                want.b &= 0xFC;
+            }
+            color_t c = fake_display_pixel(px, py);
+            if (memcmp(&c, &want, sizeof(color_t))) diff++;
+        }
+    }
+    return diff;
+}
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t pos;
+    uint32_t calls;
+    int short_reads;
+} jpg_stream_t;
+
+// Returns what is asked, or a few hundred bytes at a time like a network connection
+static int jpg_stream_read(void *ctx, uint8_t *buf, int len)
+{
+    jpg_stream_t *st = (jpg_stream_t *)ctx;
+    int n = st->short_reads ? 1 + (st->calls * 97) % 1400 : len;
+    st->calls++;
+    if (n > len) n = len;
+    if (n > (int)(st->size - st->pos)) n = st->size - st->pos;
+    memcpy(buf, st->data + st->pos, n);
+    st->pos += n;
+    return n;
+}
+
+static void check_jpeg(void)
+{
+    static const int places[4][3] = { { 0, 0, 0 }, { -50, -30, 0 }, { 100, 40, 1 }, { 250, 190, 2 } };
+    uint32_t size;
+    uint8_t *img = jpg_image(2, 2, &size);
+    char path[48], what[96];
+    int diff;
+
+    printf("\nJPEG\n");
+    for (int i = 0; i < 4; i++) {
+        for (int clip = 0; clip < 2; clip++) {
+            display_reset();
+            if (clip) TFT_setclipwin(37, 23, 283, 211);
+            fake_display_fill(TFT_BLACK);
+            TFT_jpg_image(places[i][0], places[i][1], places[i][2], NULL, img, size);
+            diff = jpg_diff(places[i][0], places[i][1], places[i][2]);
+            snprintf(what, sizeof(what), "jpeg at %d,%d scale %d%s: %d pixels differ", places[i][0], places[i][1],
+                     places[i][2], clip ? " clipped" : "", diff);
+            check(diff == 0, what);
+        }
+    }
+
+    // 4:4:4 sampling and scale 3, where blocks are a single pixel
+    free(img);
+    img = jpg_image(1, 1, &size);
+    for (int scale = 0; scale < 4; scale++) {
+        display_reset();
+        fake_display_fill(TFT_BLACK);
+        TFT_jpg_image(0, 0, scale, NULL, img, size);
+        diff = jpg_diff(0, 0, scale);
+        snprintf(what, sizeof(what), "jpeg 8x8 blocks scale %d: %d pixels differ", scale, diff);
+        check(diff == 0, what);
+    }
+    free(img);
+    img = jpg_image(2, 1, &size);
+
+    // from a file, through the read-ahead buffer
+    strcpy(path, "/tmp/tft_jpegXXXXXX");
+    int fd = mkstemp(path);
+    check(fd >= 0 && write(fd, img, size) == (ssize_t)size, "jpeg file written");
+    close(fd);
+    display_reset();
+    fake_display_fill(TFT_BLACK);
+    TFT_setColorBits(DISP_COLOR_BITS_16);
+    TFT_jpg_image(CENTER, CENTER, 1, path, NULL, 0);
+    TFT_setColorBits(DISP_COLOR_BITS_24);
+    int bad = 0;
+    for (int y = 0; y < JPG_H / 2; y++) {
+        for (int x = 0; x < JPG_W / 2; x++) {
+            color_t c = fake_display_pixel(80 + x, 60 + y), p = jpg_pixel(x << 1, y << 1);
+            // 16-bit pixels read back as the panel extends them
+            if ((c.r >> 3 != p.r >> 3) || (c.g >> 2 != p.g >> 2) || (c.b >> 3 != p.b >> 3)) bad++;
+        }
+    }
+    snprintf(what, sizeof(what), "jpeg file in 16-bit color: %d pixels differ", bad);
+    check(bad == 0, what);
+    unlink(path);
+    TFT_jpg_image(0, 0, 0, path, NULL, 0);     // missing file
+
+    // from a stream returning short reads
+    jpg_stream_t st = { img, size, 0, 0, 1 };
+    display_reset();
+    fake_display_fill(TFT_BLACK);
+    TFT_jpg_stream(10, 20, 0, jpg_stream_read, &st);
+    diff = jpg_diff(10, 20, 0);
+    snprintf(what, sizeof(what), "jpeg stream: %d pixels differ", diff);
+    check(diff == 0, what);
+
+    // a stream ending early stops the decode
+    st = (jpg_stream_t){ img, size / 2, 0, 0, 1 };
+    fake_display_fill(TFT_BLACK);
+    TFT_jpg_stream(0, 0, 0, jpg_stream_read, &st);
+    color_t last = fake_display_pixel(JPG_W - 1, JPG_H - 1);
+    check(TFT_compare_colors(last, TFT_BLACK) == 0 && st.pos == st.size, "jpeg stream cut in half");
+    check_bus("jpeg");
+    free(img);
+    display_reset();
+}
+
+static void bench_jpeg(void)
+{
+    uint32_t size;
+    uint8_t *img = jpg_image(2, 2, &size);
+
+    for (int scale = 0; scale < 2; scale++) {
+        fake_display_stats_t bus;
+        fake_tjpgd_stats_t dec;
+
+        display_reset();
+        fake_tjpgd_reset_stats();
+        double t0 = host_us();
+        TFT_jpg_image(0, 0, scale, NULL, img, size);
+        double us = host_us() - t0;
+        fake_display_get_stats(&bus);
+        fake_tjpgd_get_stats(&dec);
+        printf("  %dx%d 4:2:0 scale %d: %u blocks, %u addr windows %u transfers %.2f ms bus, %.0f us cpu\n", JPG_W,
+               JPG_H, scale, dec.blocks, bus.addr_windows, bus.transfers, bus.wire_us / 1000, us);
+    }
+
+    // one call of the input function per decoder read without the read-ahead buffer
+    jpg_stream_t st = { img, size, 0, 0, 0 };
+    display_reset();
+    fake_tjpgd_reset_stats();
+    TFT_jpg_stream(0, 0, 0, jpg_stream_read, &st);
+    fake_tjpgd_stats_t dec;
+    fake_tjpgd_get_stats(&dec);
+    printf("  %u bytes of input: %u decoder reads, %u reads of the file or stream\n", size, dec.reads, st.calls);
+    check_bus("jpeg bench");
+    free(img);
+    display_reset();
+}
+
+// ==== BMP =====================================================================
+
+typedef struct {
+    uint8_t *data;
+    uint32_t size;
+    int width, height;
+    color_t *pixels;            // as the image holds them, top to bottom
+} bmp_test_t;
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) p[i] = v >> (i * 8);
+}
+
+// BMP of the test pattern: 24-bit, 16-bit RGB-555 or 16-bit RGB-565 with color masks
+static void bmp_make(bmp_test_t *bmp, int width, int height, int bpp, int is565, int top_down)
+{
+    int masks = (bpp == 16) && is565;
+    int hdr = 54 + (masks ? 12 : 0);
+    int stride = ((width * bpp / 8) + 3) & ~3;
+
+    bmp->width = width;
+    bmp->height = height;
+    bmp->size = hdr + stride * height;
+    bmp->data = calloc(1, bmp->size);
+    bmp->pixels = malloc(width * height * sizeof(color_t));
+
+    uint8_t *d = bmp->data;
+    d[0] = 'B';
+    d[1] = 'M';
+    put32(d + 2, bmp->size);
+    put32(d + 10, hdr);
+    put32(d + 14, 40);
+    put32(d + 18, width);
+    put32(d + 22, top_down ? -height : height);
+    d[26] = 1;
+    d[28] = bpp;
+    put32(d + 30, masks ? 3 : 0);
+    if (masks) {
+        put32(d + 54, 0xF800);
+        put32(d + 58, 0x07E0);
+        put32(d + 62, 0x001F);
+    }
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = d + hdr + stride * (top_down ? y : height - 1 - y);
+        for (int x = 0; x < width; x++) {
+            color_t c = jpg_pixel(x, y);
+            if (bpp == 24) {
+                row[x * 3] = c.b;
+                row[x * 3 + 1] = c.g;
+                row[x * 3 + 2] = c.r;
+            }
+            else {
+                int r = c.r >> 3, b = c.b >> 3, g = is565 ? c.g >> 2 : c.g >> 3;
+                uint16_t v = is565 ? (r << 11) | (g << 5) | b : (r << 10) | (g << 5) | b;
+                row[x * 2] = v & 0xFF;
+                row[x * 2 + 1] = v >> 8;
+                c.r = (r << 3) | (r >> 2);
+                c.g = is565 ? (g << 2) | (g >> 4) : (g << 3) | (g >> 2);
+                c.b = (b << 3) | (b >> 2);
+            }
+            bmp->pixels[y * width + x] = c;
+        }
+    }
+}
+
+// Pixels of the display differing from the image box filtered by scale+1 at x,y,
+// black outside of it and outside of the clip window
+static int bmp_diff(const bmp_test_t *bmp, int x, int y, int scale)
+{
+    int sp = scale + 1, diff = 0;
+    for (int py = 0; py < _height; py++) {
+        for (int px = 0; px < _width; px++) {
+            int ix = px - x, iy = py - y;
+            color_t want = TFT_BLACK;
+            if ((px >= dispWin.x1) && (px <= dispWin.x2) && (py >= dispWin.y1) && (py <= dispWin.y2) &&
+                (ix >= 0) && (iy >= 0) && (ix < bmp->width / sp) && (iy < bmp->height / sp)) {
+                int sum[3] = { 0, 0, 0 };
+                for (int j = 0; j < sp; j++) {
+                    for (int i = 0; i < sp; i++) {
+                        color_t c = bmp->pixels[(iy * sp + j) * bmp->width + ix * sp + i];
+                        sum[0] += c.r;
+                        sum[1] += c.g;
+                        sum[2] += c.b;
+                    }
+                }
+                want = (color_t){ (sum[0] / (sp * sp)) & 0xFC, (sum[1] / (sp * sp)) & 0xFC, (sum[2] / (sp * sp)) & 0xFC };
+            }
+            color_t c = fake_display_pixel(px, py);
+            if (memcmp(&c, &want, sizeof(color_t))) diff++;
+        }
+    }
+    return diff;
+}
+
+static void check_bmp(void)
+{
+    static const int places[4][2] = { { 0, 0 }, { -37, -21 }, { 100, 40 }, { 250, 190 } };
+    static const char *formats[4] = { "24-bit", "24-bit top down", "16-bit 555", "16-bit 565" };
+    char path[48], what[96];
+    int bad = 0, images = 0, err;
+
+    printf("\nBMP\n");
+    for (int f = 0; f < 4; f++) {
+        bmp_test_t bmp;
+        // odd width for the row padding
+        bmp_make(&bmp, 301, 227, (f < 2) ? 24 : 16, f == 3, f == 1);
+        for (int scale = 0; scale < 8; scale++) {
+            for (int i = 0; i < 4; i++) {
+                for (int clip = 0; clip < 2; clip++) {
+                    display_reset();
+                    if (clip) TFT_setclipwin(37, 23, 283, 211);
+                    fake_display_fill(TFT_BLACK);
+                    err = TFT_bmp_image(places[i][0], places[i][1], scale, NULL, bmp.data, bmp.size);
+                    int diff = bmp_diff(&bmp, places[i][0], places[i][1], scale);
+                    images++;
+                    if ((err == 0) && (diff == 0)) continue;
+                    if ((err == -11) && (bmp_diff(&bmp, 9999, 9999, scale) == 0)) continue;  // less than 8 lines visible
+                    if (bad++ < 5) printf("  %s at %d,%d scale %d%s: error %d, %d pixels differ\n", formats[f],
+                                          places[i][0], places[i][1], scale, clip ? " clipped" : "", err, diff);
+                }
+            }
+        }
+        free(bmp.data);
+        free(bmp.pixels);
+    }
+    snprintf(what, sizeof(what), "%d of %d bmp images differ from the box filtered image", bad, images);
+    check(bad == 0, what);
+
+    // from a file, through the read buffer
+    bmp_test_t bmp;
+    bmp_make(&bmp, 320, 240, 24, 0, 0);
+    strcpy(path, "/tmp/tft_bmpXXXXXX");
+    int fd = mkstemp(path);
+    check(fd >= 0 && write(fd, bmp.data, bmp.size) == (ssize_t)bmp.size, "bmp file written");
+    close(fd);
+    for (int scale = 0; scale < 4; scale++) {
+        display_reset();
+        fake_display_fill(TFT_BLACK);
+        err = TFT_bmp_image(CENTER, CENTER, scale, path, NULL, 0);
+        int sp = scale + 1;
+        int diff = bmp_diff(&bmp, (320 - 320 / sp) / 2, (240 - 240 / sp) / 2, scale);
+        snprintf(what, sizeof(what), "bmp file scale %d: error %d, %d pixels differ", scale, err, diff);
+        check(err == 0 && diff == 0, what);
+    }
+    unlink(path);
+    check(TFT_bmp_image(0, 0, 0, path, NULL, 0) == -1, "missing bmp file");
+
+    // a file cut short and a compressed one are refused
+    bmp.data[30] = 1;
+    check(TFT_bmp_image(0, 0, 0, NULL, bmp.data, bmp.size) == -9, "compressed bmp refused");
+    bmp.data[30] = 0;
+    put32(bmp.data + 2, bmp.size - 100);
+    check(TFT_bmp_image(0, 0, 0, NULL, bmp.data, bmp.size - 100) == -16, "short bmp refused");
+    check_bus("bmp");
+    free(bmp.data);
+    free(bmp.pixels);
+    display_reset();
+}
+
+static void bench_bmp(void)
+{
+    char path[48];
+    bmp_test_t bmp;
+
+    bmp_make(&bmp, 320, 240, 24, 0, 0);
+    strcpy(path, "/tmp/tft_bmpXXXXXX");
+    int fd = mkstemp(path);
+    if ((fd < 0) || (write(fd, bmp.data, bmp.size) != (ssize_t)bmp.size)) failures++;
+    close(fd);
+
+    for (int file = 0; file < 2; file++) {
+        for (int scale = 0; scale < 4; scale++) {
+            fake_display_stats_t bus;
+
+            display_reset();
+            double t0 = host_us();
+            for (int n = 0; n < 10; n++) {
+                if (file) TFT_bmp_image(0, 0, scale, path, NULL, 0);
+                else TFT_bmp_image(0, 0, scale, NULL, bmp.data, bmp.size);
+            }
+            double us = (host_us() - t0) / 10;
+            fake_display_get_stats(&bus);
+            printf("  320x240 24-bit from %s scale %d: %u addr windows %u transfers %.2f ms bus, %.0f us cpu\n",
+                   file ? "file  " : "memory", scale, bus.addr_windows / 10, bus.transfers / 10, bus.wire_us / 10000, us);
+        }
+    }
+    check_bus("bmp bench");
+    unlink(path);
+    free(bmp.data);
+    free(bmp.pixels);
+    display_reset();
+}
+
+// ==== Pixel format ============================================================
+
+typedef struct {
+    double bytes, wire_us, cpu_us;
+} pixel_cost_t;
+
+static void fill_cost(int repeat, pixel_cost_t *cost)
+{
+    fake_display_stats_t bus;
+    double t0 = host_us();
+
+    fake_display_reset_stats();
+    for (int r = 0; r < repeat; r++) {
+        TFT_fillScreen((r & 1) ? TFT_NAVY : TFT_DARKGREEN);
+    }
+    cost->cpu_us = (host_us() - t0) / repeat;
+    fake_display_get_stats(&bus);
+    cost->bytes = (double)bus.bytes / repeat;
+    cost->wire_us = bus.wire_us / repeat;
+    check_bus("fill");
+}
+
+static void station_list_cost(int repeat, pixel_cost_t *cost)
+{
+    fake_display_stats_t bus;
+    double t0 = host_us();
+
+    TFT_setFont(DEJAVU24_FONT, NULL);
+    fake_display_reset_stats();
+    for (int r = 0; r < repeat; r++) {
+        for (int s = 0; s < (int)STATION_COUNT; s++) {
+            TFT_print((char *)station_names[s], 4, 4 + (s % 8) * 28);
+        }
+    }
+    cost->cpu_us = (host_us() - t0) / repeat;
+    fake_display_get_stats(&bus);
+    cost->bytes = (double)bus.bytes / repeat;
+    cost->wire_us = bus.wire_us / repeat;
+    check_bus("station list");
+}
+
+static void check_pixel_format(void)
+{
+    char what[96];
+
+    printf("\nPixel format\n");
+
+    // the display of the board configured in sdkconfig (MOD-LCD2.8RTP) starts in 16-bit color
+    fake_display_init();
+    TFT_display_init();
+    check(tft_color_bits == DISP_COLOR_BITS_16, "display init defaults to 16-bit color");
+    check(fake_display_colmod() == DISP_COLOR_BITS_16, "display init sends COLMOD 0x55");
+    check_bus("display init");
+
+    display_reset();
+    draw_scene();
+    color_t *ref = snapshot();
+
+    display_reset();
+    check(TFT_setColorBits(DISP_COLOR_BITS_16) == 0, "16-bit pixel format set");
+    check(fake_display_colmod() == DISP_COLOR_BITS_16, "display gets COLMOD 0x55");
+    draw_scene();
+    color_t *shown = snapshot();
+    int diff = diff_pixels(ref, shown);
+    snprintf(what, sizeof(what), "scene drawn in 16-bit mode: %d pixels differ", diff);
+    check(diff == 0, what);
+    free(shown);
+    check(TFT_compare_colors(TFT_readPixel(160, 70), ref[70 * _width + 160]) == 0, "pixels read in 16-bit mode");
+
+    // the glyph line buffer is packed apart, text drawn twice looks the same
+    TFT_setFont(DEJAVU24_FONT, NULL);
+    TFT_print("Energy 90s", 4, 200);
+    color_t *once = snapshot();
+    TFT_print("Energy 90s", 4, 200);
+    shown = snapshot();
+    check(diff_pixels(once, shown) == 0, "text drawn again the same");
+    free(once);
+    free(shown);
+
+    // frame buffer flush in 16-bit mode
+    display_reset();
+    TFT_setColorBits(DISP_COLOR_BITS_16);
+    check(TFT_fbInit(MALLOC_CAP_SPIRAM) == 0, "frame buffer allocated");
+    check(TFT_fbFlush() == 11 + (_width * _height * 2), "whole screen sent with 2 bytes per pixel");
+    draw_scene();
+    TFT_fbFlush();
+    shown = snapshot();
+    diff = diff_pixels(ref, shown);
+    snprintf(what, sizeof(what), "scene flushed in 16-bit mode: %d pixels differ", diff);
+    check(diff == 0, what);
+    free(shown);
+    TFT_fbDeinit();
+    check_bus("16-bit pixels");
+
+    tft_disp_type = DISP_TYPE_ILI9488;
+    check(TFT_setColorBits(DISP_COLOR_BITS_16) != 0, "ILI9488 keeps 18-bit colors");
+    tft_disp_type = DEFAULT_DISP_TYPE;
+    check(TFT_setColorBits(0x77) != 0, "unknown pixel format refused");
+    check(fake_display_colmod() == DISP_COLOR_BITS_16, "pixel format not changed");
+    display_reset();
+    free(ref);
+}
+
+static void bench_pixel_format(void)
+{
+    pixel_cost_t fill[2], text[2];
+    const uint8_t bits[2] = { DISP_COLOR_BITS_24, DISP_COLOR_BITS_16 };
+    const char *names[2] = { "18-bit", "16-bit" };
+
+    printf("\nPixel format, bus time at %d MHz\n", DEFAULT_SPI_CLOCK / 1000000);
+    printf("  %-8s %10s %9s %8s %10s %9s %8s\n", "", "fill bytes", "bus ms", "cpu us", "list bytes", "bus ms", "cpu us");
+    for (int i = 0; i < 2; i++) {
+        display_reset();
+        TFT_setColorBits(bits[i]);
+        fill_cost(10, &fill[i]);
+        station_list_cost(10, &text[i]);
+        printf("  %-8s %10.0f %9.2f %8.1f %10.0f %9.2f %8.1f\n", names[i], fill[i].bytes, fill[i].wire_us / 1000,
+               fill[i].cpu_us, text[i].bytes, text[i].wire_us / 1000, text[i].cpu_us);
+    }
+    display_reset();
+    check(fill[1].wire_us < fill[0].wire_us * 0.7, "16-bit fill takes a third less bus time");
+    check(text[1].wire_us < text[0].wire_us * 0.8, "16-bit text takes less bus time");
+}
+
+int main(int argc, char **argv)
+{
+    check_text();
+    bench_text();
+    check_aa_fonts();
+    check_marquee();
+    check_framebuffer();
+    check_pixel_format();
+    bench_pixel_format();
+    check_shapes();
+    check_arcs();
+    bench_arcs();
+    check_polygons();
+    bench_polygons();
+    check_jpeg();
+    bench_jpeg();
+    check_bmp();
+    bench_bmp();
+    check_font_store();
+
+    if (failures) {
+        printf("\n%d checks FAILED\n", failures);
+        return 1;
+    }
+    printf("\nAll checks passed\n");
+    return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Converts a TrueType font to a tft proportional font.
+ *
+ *   tft_fontconv [-b bpp] [-f first] [-l last] font.ttf pixel_height name
+ *
+ * Renders the characters first..last (default 32..126) with FreeType at
+ * pixel_height and writes name.c, a font source in the format of the
+ * embedded fonts, with 1 bit per pixel or anti-aliased with 2 or 4 bits
+ * per pixel. compile_font_file() then compiles it to name.fon, which
+ * TFT_setFont(USER_FONT, ...) loads, and checks the result.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "tft.h"
+
+static int bpp = 4;
+
+typedef struct {
+    int code;
+    int top;                    // Rows above the baseline
+    int width;
+    int height;
+    int x_offset;
+    int x_delta;
+    uint8_t *data;              // Packed pixel values
+    int size;
+} glyph_t;
+
+static int glyph_convert(FT_Face face, int code, glyph_t *g)
+{
+    int max = (1 << bpp) - 1;
+
+    if (FT_Load_Char(face, code, FT_LOAD_RENDER | ((bpp == 1) ? FT_LOAD_TARGET_MONO : FT_LOAD_TARGET_NORMAL))) return -1;
+
+    FT_GlyphSlot slot = face->glyph;
+    FT_Bitmap *bm = &slot->bitmap;
+
+    g->code = code;
+    g->top = slot->bitmap_top;
+    g->width = bm->width;
+    g->height = bm->rows;
+    g->x_offset = slot->bitmap_left;
+    g->x_delta = (slot->advance.x + 32) >> 6;
+    g->size = (g->width && g->height) ? ((g->width * g->height * bpp) + 7) / 8 : 0;
+    if (g->size == 0) g->width = g->height = 0;
+    g->data = calloc(1, g->size + 1);
+
+    for (int y = 0, bit = 0; y < g->height; y++) {
+        const uint8_t *row = bm->buffer + (y * bm->pitch);
+        for (int x = 0; x < g->width; x++, bit += bpp) {
+            int v;
+            if (bm->pixel_mode == FT_PIXEL_MODE_MONO) v = ((row[x >> 3] >> (7 - (x & 7))) & 1) ? max : 0;
+            else v = ((row[x] * max) + 127) / 255;
+            g->data[bit >> 3] |= v << (8 - bpp - (bit & 7));
+        }
+    }
+    return 0;
+}
+
+static int write_source(const char *path, const char *name, FT_Face face, glyph_t *glyphs, int count, int height)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) return -1;
+
+    fprintf(f, "// %s %s, %d pixels high, %d bit%s per pixel\n", face->family_name, face->style_name, height,
+            bpp, (bpp > 1) ? "s, anti-aliased," : "");
+    fprintf(f, "// Converted with tft_fontconv\n\n");
+    fprintf(f, "// Header Format:\n");
+    fprintf(f, "// ------------------------------------------------\n");
+    fprintf(f, "// Character Width (Used as a marker to indicate use this format. i.e.: = 0x00)\n");
+    fprintf(f, "// Character Height\n");
+    if (bpp > 1) {
+        fprintf(f, "// Bits per pixel (2 or 4)\n");
+        fprintf(f, "// Anti-aliased font ID (TFT_FONT_AA_ID)\n\n");
+    }
+    else {
+        fprintf(f, "// First Character (Reserved. 0x00)\n");
+        fprintf(f, "// Number Of Characters (Reserved. 0x00)\n\n");
+    }
+    fprintf(f, "// Individual Character Format:\n");
+    fprintf(f, "// ----------------------------\n");
+    fprintf(f, "// Character Code\n// Adjusted Y Offset\n// Width\n// Height\n// xOffset\n");
+    fprintf(f, "// xDelta (the distance to move the cursor. Effective width of the character.)\n");
+    fprintf(f, "// Data[n]\n\n");
+
+    fprintf(f, "const unsigned char tft_%s[] =\n{\n", name);
+    fprintf(f, "0x00, 0x%02X, 0x%02X, 0x%02X,\n", height, (bpp > 1) ? bpp : 0, (bpp > 1) ? TFT_FONT_AA_ID : 0);
+
+    int ascent = 0;
+    for (int i = 0; i < count; i++) {
+        if (glyphs[i].height && (glyphs[i].top > ascent)) ascent = glyphs[i].top;
+    }
+    for (int i = 0; i < count; i++) {
+        glyph_t *g = &glyphs[i];
+        // xOffset is read back as -(0xFF - byte) when negative
+        int x_offset = (g->x_offset < 0) ? 0xFF + g->x_offset : g->x_offset;
+        int y_offset = g->height ? ascent - g->top : 0;
+
+        if ((g->code >= 0x20) && (g->code < 0x7F) && (g->code != '\\')) fprintf(f, "\n// '%c'\n", g->code);
+        else fprintf(f, "\n// %d\n", g->code);
+        fprintf(f, "0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X,", g->code, y_offset, g->width, g->height,
+                x_offset & 0xFF, g->x_delta);
+        for (int n = 0; n < g->size; n++) {
+            fprintf(f, "%s0x%02X,", (n % 16) ? " " : "\n", g->data[n]);
+        }
+        fprintf(f, "\n");
+    }
+    fprintf(f, "\n// Terminator\n0xFF\n};\n");
+    return fclose(f);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: tft_fontconv [-b bpp] [-f first] [-l last] font.ttf pixel_height name\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int first = 32, last = 126, opt;
+    FT_Library ft;
+    FT_Face face;
+
+    while ((opt = getopt(argc, argv, "b:f:l:")) != -1) {
+        switch (opt) {
+        case 'b': bpp = atoi(optarg); break;
+        case 'f': first = atoi(optarg); break;
+        case 'l': last = atoi(optarg); break;
+        default: usage();
+        }
+    }
+    if ((argc - optind != 3) || ((bpp != 1) && (bpp != 2) && (bpp != 4)) || (first < 1) || (last > 254) || (first > last)) {
+        usage();
+    }
+    const char *ttf = argv[optind];
+    int pixels = atoi(argv[optind + 1]);
+    const char *name = argv[optind + 2];
+
+    if (FT_Init_FreeType(&ft) || FT_New_Face(ft, ttf, 0, &face) || FT_Set_Pixel_Sizes(face, 0, pixels)) {
+        fprintf(stderr, "cannot load %s at %d pixels\n", ttf, pixels);
+        return 1;
+    }
+
+    glyph_t *glyphs = calloc(last - first + 1, sizeof(glyph_t));
+    int count = 0, ascent = 0, descent = 0;
+    for (int code = first; code <= last; code++) {
+        if (FT_Get_Char_Index(face, code) == 0) continue;
+        if (glyph_convert(face, code, &glyphs[count]) != 0) continue;
+        glyph_t *g = &glyphs[count++];
+        if (g->height == 0) continue;
+        if (g->top > ascent) ascent = g->top;
+        if ((g->height - g->top) > descent) descent = g->height - g->top;
+    }
+    if ((count == 0) || (ascent + descent > 255)) {
+        fprintf(stderr, "no characters converted\n");
+        return 1;
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s.c", name);
+    if (write_source(path, name, face, glyphs, count, ascent + descent) != 0) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    printf("%s: %d characters\n", path, count);
+
+    // compile to .fon and check it
+    return compile_font_file(path, 1) ? 1 : 0;
+}
@@ -17,6 +17,7 @@
 #include <math.h>
 #include "rom/tjpgd.h"
 #include "esp_heap_caps.h"
+#include "esp_partition.h"
 #include "tftspi.h"
 
 
@@ -98,6 +99,7 @@ Font cfont = {
 	.offset = 0,
 	.numchars = 95,
 	.bitmap = 1,
+	.bpp = 1,
 };
 
 uint8_t font_buffered_char = 1;
@@ -120,8 +122,36 @@ static dispWin_t dispWinTemp;
 static uint8_t *userfont = NULL;
 static int TFT_OFFSET = 0;
 static propFont	fontChar;
+static uint16_t fontCharOffset[256];	// glyph header offset of each character in the proportional font, 0 if missing
+
+// Colors of the glyph pixel values, blended from the background to the foreground color
+static color_t font_palette[16];
+static color_t font_palette_fg;
+static color_t font_palette_bg;
+static uint8_t font_palette_bpp = 0;
+
+// Reads the pixel values of a proportional font glyph, row after row
+typedef struct {
+	const uint8_t *data;
+	uint32_t bit;
+} glyphReader_t;
 static float _arcAngleMax = DEFAULT_ARC_ANGLE_MAX;
 
+typedef struct {
+	const uint8_t *font;	// font the glyph was rendered from, NULL if the entry is free
+	color_t fg;
+	color_t bg;
+	uint8_t c;
+	uint8_t fixed;			// 'font_forceFixed' when rendered
+	uint16_t len;			// number of pixels
+	uint32_t last_used;
+	color_t *buf;
+} glyphCacheEntry_t;
+
+static glyphCacheEntry_t glyph_cache[TFT_GLYPH_CACHE_ENTRIES];
+static glyphCacheStats_t glyph_cache_stats;
+static uint32_t glyph_cache_clock = 0;
+
 
 // =========================================================================
 // ** All drawings are clipped to 'dispWin' **
@@ -164,33 +194,60 @@ color_t TFT_readPixel(int16_t x, int16_t y) {
   return readPixel(x, y);
 }
 
+// Clip a vertical line to the display window; returns 0 if it is outside
+//---------------------------------------------------------------
+static int _clipVLine(int16_t x, int16_t *y, int16_t *h) {
+	if ((x < dispWin.x1) || (x > dispWin.x2) || (*y > dispWin.y2)) return 0;
+	if (*y < dispWin.y1) {
+		*h -= (dispWin.y1 - *y);
+		*y = dispWin.y1;
+	}
+	if (*h < 0) *h = 0;
+	if ((*y + *h) > (dispWin.y2+1)) *h = dispWin.y2 - *y + 1;
+	if (*h == 0) *h = 1;
+	return 1;
+}
+
+// Clip a horizontal line to the display window; returns 0 if it is outside
+//---------------------------------------------------------------
+static int _clipHLine(int16_t *x, int16_t y, int16_t *w) {
+	if ((y < dispWin.y1) || (*x > dispWin.x2) || (y > dispWin.y2)) return 0;
+	if (*x < dispWin.x1) {
+		*w -= (dispWin.x1 - *x);
+		*x = dispWin.x1;
+	}
+	if (*w < 0) *w = 0;
+	if ((*x + *w) > (dispWin.x2+1)) *w = dispWin.x2 - *x + 1;
+	if (*w == 0) *w = 1;
+	return 1;
+}
+
 //--------------------------------------------------------------------------
 static void _drawFastVLine(int16_t x, int16_t y, int16_t h, color_t color) {
-	// clipping
-	if ((x < dispWin.x1) || (x > dispWin.x2) || (y > dispWin.y2)) return;
-	if (y < dispWin.y1) {
-		h -= (dispWin.y1 - y);
-		y = dispWin.y1;
-	}
-	if (h < 0) h = 0;
-	if ((y + h) > (dispWin.y2+1)) h = dispWin.y2 - y + 1;
-	if (h == 0) h = 1;
-	TFT_pushColorRep(x, y, x, y+h-1, color, (uint32_t)h);
+	if (_clipVLine(x, &y, &h)) TFT_pushColorRep(x, y, x, y+h-1, color, (uint32_t)h);
 }
 
 //--------------------------------------------------------------------------
 static void _drawFastHLine(int16_t x, int16_t y, int16_t w, color_t color) {
-	// clipping
-	if ((y < dispWin.y1) || (x > dispWin.x2) || (y > dispWin.y2)) return;
-	if (x < dispWin.x1) {
-		w -= (dispWin.x1 - x);
-		x = dispWin.x1;
-	}
-	if (w < 0) w = 0;
-	if ((x + w) > (dispWin.x2+1)) w = dispWin.x2 - x + 1;
-	if (w == 0) w = 1;
+	if (_clipHLine(&x, y, &w)) TFT_pushColorRep(x, y, x+w-1, y, color, (uint32_t)w);
+}
+
+// ==== Spans of a primitive between TFT_spanBegin() and TFT_spanEnd(), clipped as above ====
+
+//------------------------------------------------------
+static void _spanPixel(int16_t x, int16_t y) {
+	if ((x < dispWin.x1) || (y < dispWin.y1) || (x > dispWin.x2) || (y > dispWin.y2)) return;
+	TFT_spanAdd(x, y, x, y);
+}
+
+//---------------------------------------------------------
+static void _spanVLine(int16_t x, int16_t y, int16_t h) {
+	if (_clipVLine(x, &y, &h)) TFT_spanAdd(x, y, x, y+h-1);
+}
 
-	TFT_pushColorRep(x, y, x+w-1, y, color, (uint32_t)w);
+//---------------------------------------------------------
+static void _spanHLine(int16_t x, int16_t y, int16_t w) {
+	if (_clipHLine(&x, y, &w)) TFT_spanAdd(x, y, x+w-1, y);
 }
 
 //======================================================================
@@ -205,17 +262,18 @@ void TFT_drawFastHLine(int16_t x, int16_t y, int16_t w, color_t color) {
 
 // Bresenham's algorithm - thx wikipedia - speed enhanced by Bodmer this uses
 // the eficient FastH/V Line draw routine for segments of 2 pixels or more
-//----------------------------------------------------------------------------------
-static void _drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, color_t color)
+// Adds the spans of the line to the ones being drawn
+//--------------------------------------------------------------------------
+static void _lineSpans(int16_t x0, int16_t y0, int16_t x1, int16_t y1)
 {
   if (x0 == x1) {
-	  if (y0 <= y1) _drawFastVLine(x0, y0, y1-y0, color);
-	  else _drawFastVLine(x0, y1, y0-y1, color);
+	  if (y0 <= y1) _spanVLine(x0, y0, y1-y0);
+	  else _spanVLine(x0, y1, y0-y1);
 	  return;
   }
   if (y0 == y1) {
-	  if (x0 <= x1) _drawFastHLine(x0, y0, x1-x0, color);
-	  else _drawFastHLine(x1, y0, x0-x1, color);
+	  if (x0 <= x1) _spanHLine(x0, y0, x1-x0);
+	  else _spanHLine(x1, y0, x0-x1);
 	  return;
   }
 
@@ -242,12 +300,12 @@ static void _drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, color_t co
       err -= dy;
       if (err < 0) {
         err += dx;
-        if (dlen == 1) _drawPixel(y0, xs, color, 1);
-        else _drawFastVLine(y0, xs, dlen, color);
+        if (dlen == 1) _spanPixel(y0, xs);
+        else _spanVLine(y0, xs, dlen);
         dlen = 0; y0 += ystep; xs = x0 + 1;
       }
     }
-    if (dlen) _drawFastVLine(y0, xs, dlen, color);
+    if (dlen) _spanVLine(y0, xs, dlen);
   }
   else
   {
@@ -256,15 +314,23 @@ static void _drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, color_t co
       err -= dy;
       if (err < 0) {
         err += dx;
-        if (dlen == 1) _drawPixel(xs, y0, color, 1);
-        else _drawFastHLine(xs, y0, dlen, color);
+        if (dlen == 1) _spanPixel(xs, y0);
+        else _spanHLine(xs, y0, dlen);
         dlen = 0; y0 += ystep; xs = x0 + 1;
       }
     }
-    if (dlen) _drawFastHLine(xs, y0, dlen, color);
+    if (dlen) _spanHLine(xs, y0, dlen);
   }
 }
 
+//----------------------------------------------------------------------------------
+static void _drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, color_t color)
+{
+	if (TFT_spanBegin(color)) return;
+	_lineSpans(x0, y0, x1, y1);
+	TFT_spanEnd();
+}
+
 //==============================================================================
 void TFT_drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, color_t color)
 {
@@ -329,8 +395,9 @@ void TFT_drawRect(uint16_t x1,uint16_t y1,uint16_t w,uint16_t h, color_t color)
 	_drawRect(x1+dispWin.x1, y1+dispWin.y1, w, h, color);
 }
 
+// Adds the spans of circle quarters, 'cornername' bits select them
 //-------------------------------------------------------------------------------------------------
-static void drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t cornername, color_t color)
+static void drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t cornername)
 {
 	int16_t f = 1 - r;
 	int16_t ddF_x = 1;
@@ -338,7 +405,6 @@ static void drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t cornerna
 	int16_t x = 0;
 	int16_t y = r;
 
-	disp_select();
 	while (x < y) {
 		if (f >= 0) {
 			y--;
@@ -349,28 +415,27 @@ static void drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t cornerna
 		ddF_x += 2;
 		f += ddF_x;
 		if (cornername & 0x4) {
-			_drawPixel(x0 + x, y0 + y, color, 0);
-			_drawPixel(x0 + y, y0 + x, color, 0);
+			_spanPixel(x0 + x, y0 + y);
+			_spanPixel(x0 + y, y0 + x);
 		}
 		if (cornername & 0x2) {
-			_drawPixel(x0 + x, y0 - y, color, 0);
-			_drawPixel(x0 + y, y0 - x, color, 0);
+			_spanPixel(x0 + x, y0 - y);
+			_spanPixel(x0 + y, y0 - x);
 		}
 		if (cornername & 0x8) {
-			_drawPixel(x0 - y, y0 + x, color, 0);
-			_drawPixel(x0 - x, y0 + y, color, 0);
+			_spanPixel(x0 - y, y0 + x);
+			_spanPixel(x0 - x, y0 + y);
 		}
 		if (cornername & 0x1) {
-			_drawPixel(x0 - y, y0 - x, color, 0);
-			_drawPixel(x0 - x, y0 - y, color, 0);
+			_spanPixel(x0 - y, y0 - x);
+			_spanPixel(x0 - x, y0 - y);
 		}
 	}
-	disp_deselect();
 }
 
-// Used to do circles and roundrects
+// Used to do circles and roundrects, adds the spans of the filled halves
 //----------------------------------------------------------------------------------------------------------------
-static void fillCircleHelper(int16_t x0, int16_t y0, int16_t r,	uint8_t cornername, int16_t delta, color_t color)
+static void fillCircleHelper(int16_t x0, int16_t y0, int16_t r,	uint8_t cornername, int16_t delta)
 {
 	int16_t f = 1 - r;
 	int16_t ddF_x = 1;
@@ -381,8 +446,8 @@ static void fillCircleHelper(int16_t x0, int16_t y0, int16_t r,	uint8_t cornerna
 
 	while (x < y) {
 		if (f >= 0) {
-			if (cornername & 0x1) _drawFastVLine(x0 + y, y0 - x, 2 * x + 1 + delta, color);
-			if (cornername & 0x2) _drawFastVLine(x0 - y, y0 - x, 2 * x + 1 + delta, color);
+			if (cornername & 0x1) _spanVLine(x0 + y, y0 - x, 2 * x + 1 + delta);
+			if (cornername & 0x2) _spanVLine(x0 - y, y0 - x, 2 * x + 1 + delta);
 			ylm = x0 - y;
 			y--;
 			ddF_y += 2;
@@ -393,8 +458,8 @@ static void fillCircleHelper(int16_t x0, int16_t y0, int16_t r,	uint8_t cornerna
 		f += ddF_x;
 
 		if ((x0 - x) > ylm) {
-			if (cornername & 0x1) _drawFastVLine(x0 + x, y0 - y, 2 * y + 1 + delta, color);
-			if (cornername & 0x2) _drawFastVLine(x0 - x, y0 - y, 2 * y + 1 + delta, color);
+			if (cornername & 0x1) _spanVLine(x0 + x, y0 - y, 2 * y + 1 + delta);
+			if (cornername & 0x2) _spanVLine(x0 - x, y0 - y, 2 * y + 1 + delta);
 		}
 	}
 }
@@ -406,17 +471,19 @@ void TFT_drawRoundRect(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t r,
 	x += dispWin.x1;
 	y += dispWin.y1;
 
+	if (TFT_spanBegin(color)) return;
 	// smarter version
-	_drawFastHLine(x + r, y, w - 2 * r, color);			// Top
-	_drawFastHLine(x + r, y + h - 1, w - 2 * r, color);	// Bottom
-	_drawFastVLine(x, y + r, h - 2 * r, color);			// Left
-	_drawFastVLine(x + w - 1, y + r, h - 2 * r, color);	// Right
+	_spanHLine(x + r, y, w - 2 * r);			// Top
+	_spanHLine(x + r, y + h - 1, w - 2 * r);	// Bottom
+	_spanVLine(x, y + r, h - 2 * r);			// Left
+	_spanVLine(x + w - 1, y + r, h - 2 * r);	// Right
 
 	// draw four corners
-	drawCircleHelper(x + r, y + r, r, 1, color);
-	drawCircleHelper(x + w - r - 1, y + r, r, 2, color);
-	drawCircleHelper(x + w - r - 1, y + h - r - 1, r, 4, color);
-	drawCircleHelper(x + r, y + h - r - 1, r, 8, color);
+	drawCircleHelper(x + r, y + r, r, 1);
+	drawCircleHelper(x + w - r - 1, y + r, r, 2);
+	drawCircleHelper(x + w - r - 1, y + h - r - 1, r, 4);
+	drawCircleHelper(x + r, y + h - r - 1, r, 8);
+	TFT_spanEnd();
 }
 
 // Fill a rounded rectangle
@@ -430,31 +497,104 @@ void TFT_fillRoundRect(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t r,
 	_fillRect(x + r, y, w - 2 * r, h, color);
 
 	// draw four corners
-	fillCircleHelper(x + w - r - 1, y + r, r, 1, h - 2 * r - 1, color);
-	fillCircleHelper(x + r, y + r, r, 2, h - 2 * r - 1, color);
+	if (TFT_spanBegin(color)) return;
+	fillCircleHelper(x + w - r - 1, y + r, r, 1, h - 2 * r - 1);
+	fillCircleHelper(x + r, y + r, r, 2, h - 2 * r - 1);
+	TFT_spanEnd();
+}
+
+
+
+
+// ==== Fixed point sine and cosine ============================================
+// Angles are in degrees with 16 fractional bits, values have 30 fractional bits
+
+#define TRIG_ONE		(1 << 30)
+#define TRIG_DEG_RAD	18740330	// pi/180, 30 fractional bits
+
+// sin() of whole degrees 0 ~ 90
+static const int32_t sin_table[91] = {
+	0, 18739379, 37473049, 56195305, 74900443, 93582766,
+	112236583, 130856211, 149435979, 167970228, 186453311, 204879599,
+	223243478, 241539355, 259761657, 277904834, 295963357, 313931728,
+	331804471, 349576144, 367241333, 384794656, 402230767, 419544355,
+	436730145, 453782903, 470697435, 487468587, 504091252, 520560366,
+	536870912, 553017922, 568996477, 584801711, 600428808, 615873009,
+	631129609, 646193961, 661061475, 675727625, 690187940, 704438018,
+	718473518, 732290163, 745883746, 759250125, 772385229, 785285058,
+	797945680, 810363241, 822533958, 834454122, 846120104, 857528349,
+	868675383, 879557810, 890172315, 900515665, 910584710, 920376381,
+	929887697, 939115760, 948057759, 956710970, 965072759, 973140576,
+	980911966, 988384560, 995556083, 1002424350, 1008987269, 1015242840,
+	1021189159, 1026824413, 1032146887, 1037154959, 1041847103, 1046221891,
+	1050277989, 1054014162, 1057429273, 1060522280, 1063292242, 1065738315,
+	1067859754, 1069655912, 1071126243, 1072270298, 1073087729, 1073578288,
+	1073741824,
+};
+
+// Angle in degrees to the fixed point angle
+//---------------------------------------
+static int32_t _fixAngle(float angle)
+{
+	return (int32_t)lround((double)angle * 65536.0);
 }
 
+//--------------------------------------------
+static int32_t _sinDeg(int32_t deg)
+{
+	deg %= 360;
+	if (deg < 0) deg += 360;
+	if (deg <= 90) return sin_table[deg];
+	if (deg <= 180) return sin_table[180 - deg];
+	if (deg <= 270) return -sin_table[deg - 180];
+	return -sin_table[360 - deg];
+}
+
+// sin(a+d) = sin(a)cos(d) + cos(a)sin(d), the fraction 'd' from its Taylor series
+//-----------------------------------------
+static int32_t sin_lookup(int32_t angle)
+{
+	int32_t deg = angle >> 16;
+	int64_t d = ((int64_t)(angle & 0xFFFF) * TRIG_DEG_RAD) >> 16;
+	if (d == 0) return _sinDeg(deg);
+
+	int64_t d2 = (d * d) >> 30;
+	int64_t sin_d = d - (((d2 * d) >> 30) / 6);
+	int64_t cos_d = TRIG_ONE - (d2 / 2) + (((d2 * d2) >> 30) / 24);
+	return (int32_t)((_sinDeg(deg) * cos_d + _sinDeg(deg + 90) * sin_d) >> 30);
+}
 
+//-----------------------------------------
+static int32_t cos_lookup(int32_t angle)
+{
+	return sin_lookup(angle + (90 << 16));
+}
 
+// Offset of the point 'len' pixels away along the fixed point sine or cosine, rounded down
+//--------------------------------------------------
+static inline int16_t _polarOffset(int len, int32_t trig)
+{
+	return (int16_t)(((int64_t)len * trig) >> 30);
+}
 
 //-----------------------------------------------------------------------------------------------
 static void _drawLineByAngle(int16_t x, int16_t y, int16_t angle, uint16_t length, color_t color)
 {
-	_drawLine(
-		x,
-		y,
-		x + length * cos((angle + _angleOffset) * DEG_TO_RAD),
-		y + length * sin((angle + _angleOffset) * DEG_TO_RAD), color);
+	int32_t a = _fixAngle(angle + _angleOffset);
+	_drawLine(x, y, x + _polarOffset(length, cos_lookup(a)), y + _polarOffset(length, sin_lookup(a)), color);
 }
 
 //---------------------------------------------------------------------------------------------------------------
 static void _DrawLineByAngle(int16_t x, int16_t y, int16_t angle, uint16_t start, uint16_t length, color_t color)
 {
+	int32_t a = _fixAngle(angle + _angleOffset);
+	int32_t c = cos_lookup(a);
+	int32_t s = sin_lookup(a);
 	_drawLine(
-		x + start * cos((angle + _angleOffset) * DEG_TO_RAD),
-		y + start * sin((angle + _angleOffset) * DEG_TO_RAD),
-		x + (start + length) * cos((angle + _angleOffset) * DEG_TO_RAD),
-		y + (start + length) * sin((angle + _angleOffset) * DEG_TO_RAD), color);
+		x + _polarOffset(start, c),
+		y + _polarOffset(start, s),
+		x + _polarOffset(start + length, c),
+		y + _polarOffset(start + length, s), color);
 }
 
 //===========================================================================================================
@@ -472,9 +612,11 @@ void TFT_drawLineByAngle(uint16_t x, uint16_t y, uint16_t start, uint16_t len, u
 //--------------------------------------------------------------------------------------------------------------------
 static void _drawTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, color_t color)
 {
-	_drawLine(x0, y0, x1, y1, color);
-	_drawLine(x1, y1, x2, y2, color);
-	_drawLine(x2, y2, x0, y0, color);
+	if (TFT_spanBegin(color)) return;
+	_lineSpans(x0, y0, x1, y1);
+	_lineSpans(x1, y1, x2, y2);
+	_lineSpans(x2, y2, x0, y0);
+	TFT_spanEnd();
 }
 
 //================================================================================================================
@@ -487,87 +629,115 @@ void TFT_drawTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16
 	x2 += dispWin.x1;
 	y2 += dispWin.y1;
 
-	_drawLine(x0, y0, x1, y1, color);
-	_drawLine(x1, y1, x2, y2, color);
-	_drawLine(x2, y2, x0, y0, color);
+	_drawTriangle(x0, y0, x1, y1, x2, y2, color);
 }
 
-// Fill a triangle
-//--------------------------------------------------------------------------------------------------------------------
-static void _fillTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, color_t color)
+// ==== Scanline polygon fill ====
+
+// Edge of a filled polygon, stepped down from its top vertex.
+// The slope is kept as whole pixels per row plus a remainder in 1/dy,
+// so the crossing on row ytop+k is exactly xtop + dx*k/dy, truncated.
+typedef struct {
+	int16_t ytop;		// first row of the edge
+	int16_t ybot;		// last row of the edge
+	int16_t x;			// crossing on the current row
+	int16_t dir;		// 1 or -1, sign of dx
+	int16_t step;		// |dx| / dy
+	int16_t rem;		// |dx| % dy
+	int16_t dy;
+	int16_t err;
+} poly_edge_t;
+
+// Spans of a convex polygon with n vertices (up to MAX_POLIGON_SIDES+1), one per row.
+// Edges include both end rows, so a triangle covers the same pixels as
+// the classic two part fill. Horizontal edges end on the vertices of
+// their neighbours and are left out of the edge table.
+//---------------------------------------------------------------------
+static void _polygonSpans(const int16_t *px, const int16_t *py, int n)
 {
-  int16_t a, b, y, last;
+	poly_edge_t et[MAX_POLIGON_SIDES+1];	// edge table, sorted by top row
+	poly_edge_t *aet[MAX_POLIGON_SIDES+1];	// active edges on the current row
+	int ne = 0, na = 0, next = 0;
+	int16_t ymin = py[0], ymax = py[0], xmin = px[0], xmax = px[0];
+
+	if (n > MAX_POLIGON_SIDES+1) n = MAX_POLIGON_SIDES+1;
+	for (int i = 0; i < n; i++) {
+		int j = (i+1 < n) ? i+1 : 0;
+		if (py[i] < ymin) ymin = py[i];
+		if (py[i] > ymax) ymax = py[i];
+		if (px[i] < xmin) xmin = px[i];
+		if (px[i] > xmax) xmax = px[i];
+		if (py[i] == py[j]) continue;
+
+		int t = (py[i] < py[j]) ? i : j;
+		int b = (t == i) ? j : i;
+		int dx = px[b] - px[t];
+		poly_edge_t e;
+		e.ytop = py[t];
+		e.ybot = py[b];
+		e.x = px[t];
+		e.dir = (dx < 0) ? -1 : 1;
+		if (dx < 0) dx = -dx;
+		e.dy = py[b] - py[t];
+		e.step = dx / e.dy;
+		e.rem = dx % e.dy;
+		e.err = 0;
+
+		int k = ne++;
+		while ((k > 0) && (et[k-1].ytop > e.ytop)) {
+			et[k] = et[k-1];
+			k--;
+		}
+		et[k] = e;
+	}
 
-  // Sort coordinates by Y order (y2 >= y1 >= y0)
-  if (y0 > y1) {
-    swap(y0, y1); swap(x0, x1);
-  }
-  if (y1 > y2) {
-    swap(y2, y1); swap(x2, x1);
-  }
-  if (y0 > y1) {
-    swap(y0, y1); swap(x0, x1);
-  }
+	if (ne == 0) {
+		// all vertices on one row
+		_spanHLine(xmin, ymin, xmax-xmin+1);
+		return;
+	}
+	if (ymax > dispWin.y2) ymax = dispWin.y2;
+
+	for (int y = ymin; y <= ymax; y++) {
+		while ((next < ne) && (et[next].ytop == y)) aet[na++] = &et[next++];
+
+		int16_t a = xmax, b = xmin;
+		int k = 0;
+		for (int i = 0; i < na; i++) {
+			poly_edge_t *e = aet[i];
+			if (e->x < a) a = e->x;
+			if (e->x > b) b = e->x;
+			if (e->ybot == y) continue;	// retire the edge after its last row
+			e->x += e->dir * e->step;
+			e->err += e->rem;
+			if (e->err >= e->dy) {
+				e->err -= e->dy;
+				e->x += e->dir;
+			}
+			aet[k++] = e;
+		}
+		na = k;
+		if (a <= b) _spanHLine(a, y, b-a+1);
+	}
+}
 
-  if(y0 == y2) { // Handle awkward all-on-same-line case as its own thing
-    a = b = x0;
-    if(x1 < a)      a = x1;
-    else if(x1 > b) b = x1;
-    if(x2 < a)      a = x2;
-    else if(x2 > b) b = x2;
-    _drawFastHLine(a, y0, b-a+1, color);
-    return;
-  }
+// Fill a convex polygon
+//------------------------------------------------------------------------------
+static void _fillPolygon(const int16_t *px, const int16_t *py, int n, color_t color)
+{
+	if (TFT_spanBegin(color)) return;
+	_polygonSpans(px, py, n);
+	TFT_spanEnd();
+}
 
-  int16_t
-    dx01 = x1 - x0,
-    dy01 = y1 - y0,
-    dx02 = x2 - x0,
-    dy02 = y2 - y0,
-    dx12 = x2 - x1,
-    dy12 = y2 - y1;
-  int32_t
-    sa   = 0,
-    sb   = 0;
-
-  // For upper part of triangle, find scanline crossings for segments
-  // 0-1 and 0-2.  If y1=y2 (flat-bottomed triangle), the scanline y1
-  // is included here (and second loop will be skipped, avoiding a /0
-  // error there), otherwise scanline y1 is skipped here and handled
-  // in the second loop...which also avoids a /0 error here if y0=y1
-  // (flat-topped triangle).
-  if(y1 == y2) last = y1;   // Include y1 scanline
-  else         last = y1-1; // Skip it
-
-  for(y=y0; y<=last; y++) {
-    a   = x0 + sa / dy01;
-    b   = x0 + sb / dy02;
-    sa += dx01;
-    sb += dx02;
-    /* longhand:
-    a = x0 + (x1 - x0) * (y - y0) / (y1 - y0);
-    b = x0 + (x2 - x0) * (y - y0) / (y2 - y0);
-    */
-    if(a > b) swap(a,b);
-    _drawFastHLine(a, y, b-a+1, color);
-  }
+// Fill a triangle
+//--------------------------------------------------------------------------------------------------------------------
+static void _fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, color_t color)
+{
+	int16_t px[3] = { x0, x1, x2 };
+	int16_t py[3] = { y0, y1, y2 };
 
-  // For lower part of triangle, find scanline crossings for segments
-  // 0-2 and 1-2.  This loop is skipped if y1=y2.
-  sa = dx12 * (y - y1);
-  sb = dx02 * (y - y0);
-  for(; y<=y2; y++) {
-    a   = x1 + sa / dy12;
-    b   = x0 + sb / dy02;
-    sa += dx12;
-    sb += dx02;
-    /* longhand:
-    a = x1 + (x2 - x1) * (y - y1) / (y2 - y1);
-    b = x0 + (x2 - x0) * (y - y0) / (y2 - y0);
-    */
-    if(a > b) swap(a,b);
-    _drawFastHLine(a, y, b-a+1, color);
-  }
+	_fillPolygon(px, py, 3, color);
 }
 
 //================================================================================================================
@@ -590,11 +760,11 @@ void TFT_drawCircle(int16_t x, int16_t y, int radius, color_t color) {
 	int x1 = 0;
 	int y1 = radius;
 
-	disp_select();
-	_drawPixel(x, y + radius, color, 0);
-	_drawPixel(x, y - radius, color, 0);
-	_drawPixel(x + radius, y, color, 0);
-	_drawPixel(x - radius, y, color, 0);
+	if (TFT_spanBegin(color)) return;
+	_spanPixel(x, y + radius);
+	_spanPixel(x, y - radius);
+	_spanPixel(x + radius, y);
+	_spanPixel(x - radius, y);
 	while(x1 < y1) {
 		if (f >= 0) {
 			y1--;
@@ -604,16 +774,16 @@ void TFT_drawCircle(int16_t x, int16_t y, int radius, color_t color) {
 		x1++;
 		ddF_x += 2;
 		f += ddF_x;
-		_drawPixel(x + x1, y + y1, color, 0);
-		_drawPixel(x - x1, y + y1, color, 0);
-		_drawPixel(x + x1, y - y1, color, 0);
-		_drawPixel(x - x1, y - y1, color, 0);
-		_drawPixel(x + y1, y + x1, color, 0);
-		_drawPixel(x - y1, y + x1, color, 0);
-		_drawPixel(x + y1, y - x1, color, 0);
-		_drawPixel(x - y1, y - x1, color, 0);
+		_spanPixel(x + x1, y + y1);
+		_spanPixel(x - x1, y + y1);
+		_spanPixel(x + x1, y - y1);
+		_spanPixel(x - x1, y - y1);
+		_spanPixel(x + y1, y + x1);
+		_spanPixel(x - y1, y + x1);
+		_spanPixel(x + y1, y - x1);
+		_spanPixel(x - y1, y - x1);
 	}
-  disp_deselect();
+	TFT_spanEnd();
 }
 
 //====================================================================
@@ -621,23 +791,23 @@ void TFT_fillCircle(int16_t x, int16_t y, int radius, color_t color) {
 	x += dispWin.x1;
 	y += dispWin.y1;
 
-	_drawFastVLine(x, y-radius, 2*radius+1, color);
-	fillCircleHelper(x, y, radius, 3, 0, color);
+	if (TFT_spanBegin(color)) return;
+	_spanVLine(x, y-radius, 2*radius+1);
+	fillCircleHelper(x, y, radius, 3, 0);
+	TFT_spanEnd();
 }
 
 //----------------------------------------------------------------------------------------------------------------
-static void _draw_ellipse_section(uint16_t x, uint16_t y, uint16_t x0, uint16_t y0, color_t color, uint8_t option)
+static void _draw_ellipse_section(uint16_t x, uint16_t y, uint16_t x0, uint16_t y0, uint8_t option)
 {
-	disp_select();
     // upper right
-    if ( option & TFT_ELLIPSE_UPPER_RIGHT ) _drawPixel(x0 + x, y0 - y, color, 0);
+    if ( option & TFT_ELLIPSE_UPPER_RIGHT ) _spanPixel(x0 + x, y0 - y);
     // upper left
-    if ( option & TFT_ELLIPSE_UPPER_LEFT ) _drawPixel(x0 - x, y0 - y, color, 0);
+    if ( option & TFT_ELLIPSE_UPPER_LEFT ) _spanPixel(x0 - x, y0 - y);
     // lower right
-    if ( option & TFT_ELLIPSE_LOWER_RIGHT ) _drawPixel(x0 + x, y0 + y, color, 0);
+    if ( option & TFT_ELLIPSE_LOWER_RIGHT ) _spanPixel(x0 + x, y0 + y);
     // lower left
-    if ( option & TFT_ELLIPSE_LOWER_LEFT ) _drawPixel(x0 - x, y0 + y, color, 0);
-	disp_deselect();
+    if ( option & TFT_ELLIPSE_LOWER_LEFT ) _spanPixel(x0 - x, y0 + y);
 }
 
 //=====================================================================================================
@@ -645,6 +815,7 @@ void TFT_drawEllipse(uint16_t x0, uint16_t y0, uint16_t rx, uint16_t ry, color_t
 {
 	x0 += dispWin.x1;
 	y0 += dispWin.y1;
+	if (TFT_spanBegin(color)) return;
 
 	uint16_t x, y;
 	int32_t xchg, ychg;
@@ -680,7 +851,7 @@ void TFT_drawEllipse(uint16_t x0, uint16_t y0, uint16_t rx, uint16_t ry, color_t
 	stopy = 0;
 
 	while( stopx >= stopy ) {
-		_draw_ellipse_section(x, y, x0, y0, color, option);
+		_draw_ellipse_section(x, y, x0, y0, option);
 		y++;
 		stopy += rxrx2;
 		err += ychg;
@@ -713,7 +884,7 @@ void TFT_drawEllipse(uint16_t x0, uint16_t y0, uint16_t rx, uint16_t ry, color_t
 	stopy *= ry;
 
 	while( stopx <= stopy ) {
-		_draw_ellipse_section(x, y, x0, y0, color, option);
+		_draw_ellipse_section(x, y, x0, y0, option);
 		x++;
 		stopx += ryry2;
 		err += xchg;
@@ -725,19 +896,20 @@ void TFT_drawEllipse(uint16_t x0, uint16_t y0, uint16_t rx, uint16_t ry, color_t
 			ychg += rxrx2;
 		}
 	}
+	TFT_spanEnd();
 }
 
 //-----------------------------------------------------------------------------------------------------------------------
-static void _draw_filled_ellipse_section(uint16_t x, uint16_t y, uint16_t x0, uint16_t y0, color_t color, uint8_t option)
+static void _draw_filled_ellipse_section(uint16_t x, uint16_t y, uint16_t x0, uint16_t y0, uint8_t option)
 {
     // upper right
-    if ( option & TFT_ELLIPSE_UPPER_RIGHT ) _drawFastVLine(x0+x, y0-y, y+1, color);
+    if ( option & TFT_ELLIPSE_UPPER_RIGHT ) _spanVLine(x0+x, y0-y, y+1);
     // upper left
-    if ( option & TFT_ELLIPSE_UPPER_LEFT ) _drawFastVLine(x0-x, y0-y, y+1, color);
+    if ( option & TFT_ELLIPSE_UPPER_LEFT ) _spanVLine(x0-x, y0-y, y+1);
     // lower right
-    if ( option & TFT_ELLIPSE_LOWER_RIGHT ) _drawFastVLine(x0+x, y0, y+1, color);
+    if ( option & TFT_ELLIPSE_LOWER_RIGHT ) _spanVLine(x0+x, y0, y+1);
     // lower left
-    if ( option & TFT_ELLIPSE_LOWER_LEFT ) _drawFastVLine(x0-x, y0, y+1, color);
+    if ( option & TFT_ELLIPSE_LOWER_LEFT ) _spanVLine(x0-x, y0, y+1);
 }
 
 //=====================================================================================================
@@ -745,6 +917,7 @@ void TFT_fillEllipse(uint16_t x0, uint16_t y0, uint16_t rx, uint16_t ry, color_t
 {
 	x0 += dispWin.x1;
 	y0 += dispWin.y1;
+	if (TFT_spanBegin(color)) return;
 
 	uint16_t x, y;
 	int32_t xchg, ychg;
@@ -780,7 +953,7 @@ void TFT_fillEllipse(uint16_t x0, uint16_t y0, uint16_t rx, uint16_t ry, color_t
 	stopy = 0;
 
 	while( stopx >= stopy ) {
-		_draw_filled_ellipse_section(x, y, x0, y0, color, option);
+		_draw_filled_ellipse_section(x, y, x0, y0, option);
 		y++;
 		stopy += rxrx2;
 		err += ychg;
@@ -813,7 +986,7 @@ void TFT_fillEllipse(uint16_t x0, uint16_t y0, uint16_t rx, uint16_t ry, color_t
 	stopy *= ry;
 
 	while( stopx <= stopy ) {
-		_draw_filled_ellipse_section(x, y, x0, y0, color, option);
+		_draw_filled_ellipse_section(x, y, x0, y0, option);
 		x++;
 		stopx += ryry2;
 		err += xchg;
@@ -825,51 +998,97 @@ void TFT_fillEllipse(uint16_t x0, uint16_t y0, uint16_t rx, uint16_t ry, color_t
 			ychg += rxrx2;
 		}
 	}
+	TFT_spanEnd();
 }
 
 
 // ==== ARC DRAWING ===================================================================
 
+// Least x with x*s >= y*c and greatest x with x*s <= y*c, s > 0
+//--------------------------------------------------------------
+static int _arcMinX(int y, int32_t c, int32_t s)
+{
+	int64_t n = (int64_t)y * c;
+	int64_t q = n / s;
+	if ((q * s) < n) q++;
+	return (int)q;
+}
+
+//--------------------------------------------------------------
+static int _arcMaxX(int y, int32_t c, int32_t s)
+{
+	int64_t n = (int64_t)y * c;
+	int64_t q = n / s;
+	if ((q * s) > n) q--;
+	return (int)q;
+}
+
+// Spans of the ring part x1 .. x2 of the row, limited to lo .. hi
+//---------------------------------------------------------------------------------------
+static void _arcRowSpan(int16_t cx, int16_t cy, int y, int x1, int x2, int lo, int hi)
+{
+	if (x1 < lo) x1 = lo;
+	if (x2 > hi) x2 = hi;
+	if (x1 <= x2) _spanHLine(cx + x1, cy + y, x2 - x1 + 1);
+}
+
+// Fill the pixels of the ring radius-thickness <= distance < radius between the
+// angles start and end (0 ~ 360, clockwise from the x axis) as horizontal spans.
+// The ring edges are followed row by row in integers, the angle limits are the
+// lines through the center at the start and end angle.
 //---------------------------------------------------------------------------------------------------------------------------------
 static void _fillArcOffsetted(uint16_t cx, uint16_t cy, uint16_t radius, uint16_t thickness, float start, float end, color_t color)
 {
-	//float sslope = (float)cos_lookup(start) / (float)sin_lookup(start);
-	//float eslope = (float)cos_lookup(end) / (float)sin_lookup(end);
-	float sslope = (cos(start/_arcAngleMax * 2 * PI) * _arcAngleMax) / (sin(start/_arcAngleMax * 2 * PI) * _arcAngleMax) ;
-	float eslope = (cos(end/_arcAngleMax * 2 * PI) * _arcAngleMax) / (sin(end/_arcAngleMax * 2 * PI) * _arcAngleMax);
-
-	if (end == 360) eslope = -1000000;
+	int32_t as = _fixAngle(start);
+	int32_t ae = _fixAngle(end);
+	int32_t sc = cos_lookup(as), ss = sin_lookup(as);
+	int32_t ec = cos_lookup(ae), es = sin_lookup(ae);
 
+	int r = radius;
 	int ir2 = (radius - thickness) * (radius - thickness);
 	int or2 = radius * radius;
-
-	disp_select();
-	for (int x = -radius; x <= radius; x++) {
-		for (int y = -radius; y <= radius; y++) {
-			int x2 = x * x;
-			int y2 = y * y;
-
-			if (
-				(x2 + y2 < or2 && x2 + y2 >= ir2) &&
-				(
-				(y > 0 && start < 180 && x <= y * sslope) ||
-				(y < 0 && start > 180 && x >= y * sslope) ||
-				(y < 0 && start <= 180) ||
-				(y == 0 && start <= 180 && x < 0) ||
-				(y == 0 && start == 0 && x > 0)
-				) &&
-				(
-				(y > 0 && end < 180 && x >= y * eslope) ||
-				(y < 0 && end > 180 && x <= y * eslope) ||
-				(y > 0 && end >= 180) ||
-				(y == 0 && end >= 180 && x < 0) ||
-				(y == 0 && start == 0 && x > 0)
-				)
-				)
-				_drawPixel(cx+x, cy+y, color, 0);
+	int xo = -1;	// greatest x inside the outer edge
+	int xi = 0;		// least x outside the inner edge
+
+	if (TFT_spanBegin(color)) return;
+	for (int y = -r; y <= r; y++) {
+		int y2 = y * y;
+		while ((xo >= 0) && ((xo * xo + y2) >= or2)) xo--;
+		while ((((xo + 1) * (xo + 1)) + y2) < or2) xo++;
+		while ((xi * xi + y2) < ir2) xi++;
+		while ((xi > 0) && ((((xi - 1) * (xi - 1)) + y2) >= ir2)) xi--;
+		if (xi > xo) continue;
+
+		int lo = -r, hi = r;
+		if (y == 0) {
+			// on the x axis only the left half (180 deg) and, from 0 deg, the right half
+			if ((start <= 180) && (end >= 180)) {
+				_arcRowSpan(cx, cy, y, -xo, -xi, lo, -1);
+			}
+			if (start == 0) _arcRowSpan(cx, cy, y, xi, xo, 1, hi);
+			continue;
+		}
+		// pixels on the start and end lines are in the arc, but a vertical start line
+		// leaves out its own column, as the float arcs did
+		if (y > 0) {
+			// lower half, 0 ~ 180 deg
+			if (start >= 180) continue;
+			if ((start > 0) && (ss > 0)) hi = (sc == 0) ? -1 : _arcMaxX(y, sc, ss);
+			if ((end < 180) && (es > 0)) lo = _arcMinX(y, ec, es);
+		}
+		else {
+			// upper half, 180 ~ 360 deg
+			if (end <= 180) continue;
+			if ((start > 180) && (ss < 0)) lo = (sc == 0) ? 1 : _arcMinX(y, -sc, -ss);
+			if ((end < 360) && (es < 0)) hi = _arcMaxX(y, -ec, -es);
+		}
+		if (xi == 0) _arcRowSpan(cx, cy, y, -xo, xo, lo, hi);
+		else {
+			_arcRowSpan(cx, cy, y, -xo, -xi, lo, hi);
+			_arcRowSpan(cx, cy, y, xi, xo, lo, hi);
 		}
 	}
-	disp_deselect();
+	TFT_spanEnd();
 }
 
 
@@ -913,10 +1132,14 @@ void TFT_drawArc(uint16_t cx, uint16_t cy, uint16_t r, uint16_t th, float start,
 		}
 	}
 	if (f) {
-		_drawLine(cx + (r-th) * cos(astart * DEG_TO_RAD), cy + (r-th) * sin(astart * DEG_TO_RAD),
-			cx + (r-1) * cos(astart * DEG_TO_RAD), cy + (r-1) * sin(astart * DEG_TO_RAD), color);
-		_drawLine(cx + (r-th) * cos(aend * DEG_TO_RAD), cy + (r-th) * sin(aend * DEG_TO_RAD),
-			cx + (r-1) * cos(aend * DEG_TO_RAD), cy + (r-1) * sin(aend * DEG_TO_RAD), color);
+		int32_t c = cos_lookup(_fixAngle(astart));
+		int32_t s = sin_lookup(_fixAngle(astart));
+		_drawLine(cx + _polarOffset(r-th, c), cy + _polarOffset(r-th, s),
+			cx + _polarOffset(r-1, c), cy + _polarOffset(r-1, s), color);
+		c = cos_lookup(_fixAngle(aend));
+		s = sin_lookup(_fixAngle(aend));
+		_drawLine(cx + _polarOffset(r-th, c), cy + _polarOffset(r-th, s),
+			cx + _polarOffset(r-1, c), cy + _polarOffset(r-1, s), color);
 	}
 }
 
@@ -932,7 +1155,7 @@ void TFT_drawPolygon(int cx, int cy, int sides, int diameter, color_t color, col
 	if (sides < MIN_POLIGON_SIDES) sides = MIN_POLIGON_SIDES;	// This ensures the minimum side number
 	if (sides > MAX_POLIGON_SIDES) sides = MAX_POLIGON_SIDES;	// This ensures the maximum side number
 
-	int Xpoints[sides], Ypoints[sides];							// Set the arrays based on the number of sides entered
+	int16_t Xpoints[sides], Ypoints[sides];						// Set the arrays based on the number of sides entered
 	int rads = 360 / sides;										// This equally spaces the points.
 
 	for (int idx = 0; idx < sides; idx++) {
@@ -941,12 +1164,7 @@ void TFT_drawPolygon(int cx, int cy, int sides, int diameter, color_t color, col
 	}
 
 	// Draw the polygon on the screen.
-	if (f) {
-		for(int idx = 0; idx < sides; idx++) {
-			if((idx+1) < sides) _fillTriangle(cx,cy,Xpoints[idx],Ypoints[idx],Xpoints[idx+1],Ypoints[idx+1], fill);
-			else _fillTriangle(cx,cy,Xpoints[idx],Ypoints[idx],Xpoints[0],Ypoints[0], fill);
-		}
-	}
+	if (f) _fillPolygon(Xpoints, Ypoints, sides, fill);
 
 	if (th) {
 		for (int n=0; n<th; n++) {
@@ -966,8 +1184,8 @@ void TFT_drawPolygon(int cx, int cy, int sides, int diameter, color_t color, col
 	}
 }
 
-/*
 // Similar to the Polygon function.
+// The filled star is five convex points (center, inner, outer, inner), drawn in one batch.
 //=====================================================================================
 void TFT_drawStar(int cx, int cy, int diameter, color_t color, bool fill, float factor)
 {
@@ -978,7 +1196,7 @@ void TFT_drawStar(int cx, int cy, int diameter, color_t color, bool fill, float
 	uint8_t sides = 5;
 	uint8_t rads = 360 / sides;
 
-	int Xpoints_O[sides], Ypoints_O[sides], Xpoints_I[sides], Ypoints_I[sides];//Xpoints_T[5], Ypoints_T[5];
+	int16_t Xpoints_O[sides], Ypoints_O[sides], Xpoints_I[sides], Ypoints_I[sides];
 
 	for(int idx = 0; idx < sides; idx++) {
 		// makes the outer points
@@ -990,33 +1208,112 @@ void TFT_drawStar(int cx, int cy, int diameter, color_t color, bool fill, float
 		Ypoints_I[idx] = cy + cos((float)(idx*rads + 36) * deg_to_rad) * ((float)(diameter)/factor);
 	}
 
+	if (TFT_spanBegin(color)) return;
 	for(int idx = 0; idx < sides; idx++) {
-		if((idx+1) < sides) {
-			if(fill) {// this part below should be self explanatory. It fills in the star.
-				_fillTriangle(cx,cy,Xpoints_I[idx],Ypoints_I[idx],Xpoints_O[idx],Ypoints_O[idx], color);
-				_fillTriangle(cx,cy,Xpoints_O[idx],Ypoints_O[idx],Xpoints_I[idx+1],Ypoints_I[idx+1], color);
-			}
-			else {
-				_drawLine(Xpoints_O[idx],Ypoints_O[idx],Xpoints_I[idx+1],Ypoints_I[idx+1], color);
-				_drawLine(Xpoints_I[idx],Ypoints_I[idx],Xpoints_O[idx],Ypoints_O[idx], color);
-			}
+		int next = ((idx+1) < sides) ? idx+1 : 0;
+		if (fill) {
+			int16_t px[4] = { cx, Xpoints_I[idx], Xpoints_O[idx], Xpoints_I[next] };
+			int16_t py[4] = { cy, Ypoints_I[idx], Ypoints_O[idx], Ypoints_I[next] };
+			_polygonSpans(px, py, 4);
 		}
 		else {
-			if(fill) {
-				_fillTriangle(cx,cy,Xpoints_I[0],Ypoints_I[0],Xpoints_O[idx],Ypoints_O[idx], color);
-				_fillTriangle(cx,cy,Xpoints_O[idx],Ypoints_O[idx],Xpoints_I[idx],Ypoints_I[idx], color);
-			}
-			else {
-				_drawLine(Xpoints_O[idx],Ypoints_O[idx],Xpoints_I[idx],Ypoints_I[idx], color);
-				_drawLine(Xpoints_I[0],Ypoints_I[0],Xpoints_O[idx],Ypoints_O[idx], color);
-			}
+			_lineSpans(Xpoints_I[idx],Ypoints_I[idx],Xpoints_O[idx],Ypoints_O[idx]);
+			_lineSpans(Xpoints_O[idx],Ypoints_O[idx],Xpoints_I[next],Ypoints_I[next]);
 		}
 	}
+	TFT_spanEnd();
 }
-*/
 
 // ================ Font and string functions ==================================
 
+// Bits per pixel of the font's glyphs
+//------------------------------------------
+static uint8_t fontBpp(const uint8_t *font)
+{
+	if ((font[0] == 0) && (font[3] == TFT_FONT_AA_ID) && ((font[2] == 2) || (font[2] == 4))) return font[2];
+	return 1;
+}
+
+// Bytes of packed pixel data of a proportional font glyph
+//-----------------------------------------------------------
+static int glyphDataSize(int width, int height, int bpp)
+{
+	return (((width * height * bpp) - 1) / 8) + 1;
+}
+
+// Check the font file data is a valid font, 'err_msg' receives the reason if not
+// Returns 0 if valid
+//-----------------------------------------------------------------------------------------
+static int check_font_data(const uint8_t *font, int fsize, int info, char *err_msg)
+{
+	if ((fsize < 30) || (memcmp(font+fsize-8, "RPH_font", 8) != 0)) {
+		sprintf(err_msg, "Font ID not found");
+		return 6;
+	}
+
+	// Check size
+	int size = 0;
+	int numchar = 0;
+	int width = font[0];
+	int height = font[1];
+	uint8_t first = 255;
+	uint8_t last = 0;
+	//int offst = 0;
+	int pminwidth = 255;
+	int pmaxwidth = 0;
+	int bpp = fontBpp(font);
+
+	if (width != 0) {
+		// Fixed font
+		numchar = font[3];
+		first = font[2];
+		last = first + numchar - 1;
+		size = ((width * height * numchar) / 8) + 4;
+	}
+	else {
+		// Proportional font
+		size = 4; // point at first char data
+		uint8_t charCode;
+		int charwidth;
+
+		do {
+		    charCode = font[size];
+		    charwidth = font[size+2];
+
+		    if (charCode != 0xFF) {
+		    	numchar++;
+		    	if (charwidth != 0) size += glyphDataSize(charwidth, font[size+3], bpp) + 6;
+		    	else size += 6;
+
+		    	if (info) {
+	    			if (charwidth > pmaxwidth) pmaxwidth = charwidth;
+	    			if (charwidth < pminwidth) pminwidth = charwidth;
+	    			if (charCode < first) first = charCode;
+	    			if (charCode > last) last = charCode;
+	    		}
+		    }
+		    else size++;
+		  } while ((size < (fsize-8)) && (charCode != 0xFF));
+	}
+
+	if (size != (fsize-8)) {
+		sprintf(err_msg, "Font size error: found %d expected %d)", size, (fsize-8));
+		return 7;
+	}
+
+	if (info) {
+		if (width != 0) {
+			printf("Fixed width font:\r\n  size: %d  width: %d  height: %d  characters: %d (%d~%d)\n",
+					size, width, height, numchar, first, last);
+		}
+		else {
+			printf("Proportional font:\r\n  size: %d  width: %d~%d  height: %d  characters: %d (%d~%d)  bits per pixel: %d\n",
+					size, pminwidth, pmaxwidth, height, numchar, first, last, bpp);
+		}
+	}
+	return 0;
+}
+
 //--------------------------------------------------------
 static int load_file_font(const char * fontfile, int info)
 {
@@ -1024,6 +1321,8 @@ static int load_file_font(const char * fontfile, int info)
 	char err_msg[256] = {'\0'};
 
 	if (userfont != NULL) {
+		// the next font may be loaded at the same address
+		TFT_clearGlyphCache();
 		free(userfont);
 		userfont = NULL;
 	}
@@ -1069,83 +1368,181 @@ static int load_file_font(const char * fontfile, int info)
 		goto exit;
 	}
 
-	userfont[read] = 0;
-	if (strstr((char *)(userfont+read-8), "RPH_font") == NULL) {
-		sprintf(err_msg, "Font ID not found");
-		err = 6;
-		goto exit;
-	}
+	err = check_font_data(userfont, read, info, err_msg);
 
-	// Check size
-	int size = 0;
-	int numchar = 0;
-	int width = userfont[0];
-	int height = userfont[1];
-	uint8_t first = 255;
-	uint8_t last = 0;
-	//int offst = 0;
-	int pminwidth = 255;
-	int pmaxwidth = 0;
-
-	if (width != 0) {
-		// Fixed font
-		numchar = userfont[3];
-		first = userfont[2];
-		last = first + numchar - 1;
-		size = ((width * height * numchar) / 8) + 4;
+exit:
+	if (err) {
+		if (userfont) {
+			free(userfont);
+			userfont = NULL;
+		}
+		if (info) printf("Error: %d [%s]\r\n", err, err_msg);
 	}
-	else {
-		// Proportional font
-		size = 4; // point at first char data
-		uint8_t charCode;
-		int charwidth;
+	return err;
+}
 
-		do {
-		    charCode = userfont[size];
-		    charwidth = userfont[size+2];
+// ================ Font store =================================================
 
-		    if (charCode != 0xFF) {
-		    	numchar++;
-		    	if (charwidth != 0) size += ((((charwidth * userfont[size+3])-1) / 8) + 7);
-		    	else size += 6;
+// The font store partition starts with a directory sector of 64-byte entries,
+// the first one identifying the store. Fonts and directory entries are only
+// ever appended; when the partition is full it is erased and filled again.
+#define FONT_STORE_MAGIC		0x46485052	// "RPHF"
+#define FONT_STORE_DIR_SIZE		SPI_FLASH_SEC_SIZE
+#define FONT_STORE_NAME_LEN		40
 
-		    	if (info) {
-	    			if (charwidth > pmaxwidth) pmaxwidth = charwidth;
-	    			if (charwidth < pminwidth) pminwidth = charwidth;
-	    			if (charCode < first) first = charCode;
-	    			if (charCode > last) last = charCode;
-	    		}
-		    }
-		    else size++;
-		  } while ((size < (read-8)) && (charCode != 0xFF));
+typedef struct {
+	uint32_t magic;			// FONT_STORE_MAGIC, 0xFFFFFFFF for a free entry
+	uint32_t offset;		// font data offset in the partition
+	uint32_t used;			// partition bytes taken by the font data
+	uint32_t size;			// font file size and modification time
+	uint32_t mtime;
+	int32_t err;			// check_font_data() result
+	char name[FONT_STORE_NAME_LEN];
+} fontStoreEntry_t;
+
+#define FONT_STORE_ENTRIES		(FONT_STORE_DIR_SIZE / sizeof(fontStoreEntry_t))
+
+static const esp_partition_t *font_store_part = NULL;
+static const uint8_t *font_store_map = NULL;
+static spi_flash_mmap_handle_t font_store_handle;
+
+//-----------------------------------
+static int font_store_format(void)
+{
+	fontStoreEntry_t header;
+
+	// the current font and cached glyphs may be in the store
+	if ((cfont.font >= font_store_map) && (cfont.font < (font_store_map + font_store_part->size))) {
+		TFT_setFont(DEFAULT_FONT, NULL);
 	}
+	TFT_clearGlyphCache();
 
-	if (size != (read-8)) {
-		sprintf(err_msg, "Font size error: found %d expected %d)", size, (read-8));
-		err = 7;
-		goto exit;
+	memset(&header, 0xFF, sizeof(header));
+	header.magic = FONT_STORE_MAGIC;
+	header.offset = FONT_STORE_DIR_SIZE;
+	if (esp_partition_erase_range(font_store_part, 0, font_store_part->size) != ESP_OK) return -1;
+	if (esp_partition_write(font_store_part, 0, &header, sizeof(header)) != ESP_OK) return -1;
+	return 0;
+}
+
+// Map the font store partition on first use
+// Returns 0 if the store can be used
+//---------------------------------
+static int font_store_open(void)
+{
+	if (font_store_map) return 0;
+
+	font_store_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, TFT_FONT_STORE_LABEL);
+	if ((font_store_part == NULL) ||
+		(esp_partition_mmap(font_store_part, 0, font_store_part->size, SPI_FLASH_MMAP_DATA,
+				(const void **)&font_store_map, &font_store_handle) != ESP_OK)) {
+		font_store_part = NULL;
+		font_store_map = NULL;
+		return -1;
+	}
+	if ((((const fontStoreEntry_t *)font_store_map)->magic != FONT_STORE_MAGIC) && (font_store_format() != 0)) {
+		spi_flash_munmap(font_store_handle);
+		font_store_part = NULL;
+		font_store_map = NULL;
+		return -1;
 	}
+	return 0;
+}
 
-	if (info) {
-		if (width != 0) {
-			printf("Fixed width font:\r\n  size: %d  width: %d  height: %d  characters: %d (%d~%d)\n",
-					size, width, height, numchar, first, last);
-		}
-		else {
-			printf("Proportional font:\r\n  size: %d  width: %d~%d  height: %d  characters: %d (%d~%d)\n",
-					size, pminwidth, pmaxwidth, height, numchar, first, last);
+// Copy the font file into the store at the first free location and add its entry
+// Returns the new entry or NULL if the store is full
+//----------------------------------------------------------------------------------
+static const fontStoreEntry_t *font_store_import(FILE *fhndl, const char *fontfile, struct stat *sb, int info)
+{
+	const fontStoreEntry_t *dir = (const fontStoreEntry_t *)font_store_map;
+	fontStoreEntry_t entry;
+	uint8_t buf[256];
+	int idx;
+
+	memset(&entry, 0xFF, sizeof(entry));
+	entry.magic = FONT_STORE_MAGIC;
+	entry.offset = FONT_STORE_DIR_SIZE;
+	for (idx = 1; (idx < FONT_STORE_ENTRIES) && (dir[idx].magic == FONT_STORE_MAGIC); idx++) {
+		if ((dir[idx].offset + dir[idx].used) > entry.offset) entry.offset = dir[idx].offset + dir[idx].used;
+	}
+	entry.used = (sb->st_size + 3) & ~3;
+	if ((idx == FONT_STORE_ENTRIES) || ((entry.offset + entry.used) > font_store_part->size)) return NULL;
+
+	entry.size = sb->st_size;
+	entry.mtime = sb->st_mtime;
+	strcpy(entry.name, fontfile);
+
+	// copy, then check the font where it will be used
+	uint32_t pos = 0;
+	entry.err = 0;
+	while (pos < entry.size) {
+		int read = fread(buf, 1, sizeof(buf), fhndl);
+		if ((read <= 0) || (esp_partition_write(font_store_part, entry.offset + pos, buf, read) != ESP_OK)) {
+			entry.err = 5;
+			break;
 		}
+		pos += read;
+	}
+	if (entry.err == 0) {
+		char err_msg[64];
+		entry.err = check_font_data(font_store_map + entry.offset, entry.size, info, err_msg);
+		if ((entry.err) && (info)) printf("Error: %d [%s]\r\n", entry.err, err_msg);
 	}
 
-exit:
-	if (err) {
-		if (userfont) {
-			free(userfont);
-			userfont = NULL;
+	if (esp_partition_write(font_store_part, idx * sizeof(fontStoreEntry_t), &entry, sizeof(entry)) != ESP_OK) return NULL;
+	return &dir[idx];
+}
+
+// Find the font file in the font store, adding it if it is not there or has changed
+// Returns -1 if the font store cannot be used, else the font check result
+//-------------------------------------------------------------------------------------------
+static int font_store_get(const char *fontfile, int info, const uint8_t **font)
+{
+	const fontStoreEntry_t *dir;
+	const fontStoreEntry_t *found = NULL;
+	struct stat sb;
+
+	if ((fontfile == NULL) || (strlen(fontfile) >= FONT_STORE_NAME_LEN)) return -1;
+	if (font_store_open() != 0) return -1;
+	if (stat(fontfile, &sb) != 0) return 1;
+
+	// the same file was added last if it was added more than once
+	dir = (const fontStoreEntry_t *)font_store_map;
+	for (int i = 1; (i < FONT_STORE_ENTRIES) && (dir[i].magic == FONT_STORE_MAGIC); i++) {
+		if (strcmp(dir[i].name, fontfile) == 0) found = &dir[i];
+	}
+	// read errors are not kept
+	if ((found) && ((found->size != sb.st_size) || (found->mtime != (uint32_t)sb.st_mtime) || (found->err == 5))) found = NULL;
+
+	if (found == NULL) {
+		FILE *fhndl = fopen(fontfile, "r");
+		if (!fhndl) return 1;
+		found = font_store_import(fhndl, fontfile, &sb, info);
+		if (found == NULL) {
+			// full, start again
+			rewind(fhndl);
+			if (font_store_format() == 0) found = font_store_import(fhndl, fontfile, &sb, info);
 		}
-		if (info) printf("Error: %d [%s]\r\n", err, err_msg);
+		fclose(fhndl);
+		if (found == NULL) return -1;
 	}
-	return err;
+
+	if (found->err == 0) *font = font_store_map + found->offset;
+	return found->err;
+}
+
+//==========================================================
+int TFT_fontStoreAdd(const char *fontfile, uint8_t info)
+{
+	const uint8_t *font;
+	return font_store_get(fontfile, info, &font);
+}
+
+//=============================
+int TFT_fontStoreErase(void)
+{
+	if (font_store_open() != 0) return -1;
+	return font_store_format();
 }
 
 //------------------------------------------------
@@ -1371,7 +1768,7 @@ void getFontCharacters(uint8_t *buf)
         tempPtr++;
 		if (cw != 0) {
 			// packed bits
-			tempPtr += (((cw * ch)-1) / 8) + 1;
+			tempPtr += glyphDataSize(cw, ch, cfont.bpp);
 		}
 		buf[n++] = cc;
 	    cc = cfont.font[tempPtr++];
@@ -1380,6 +1777,7 @@ void getFontCharacters(uint8_t *buf)
 }
 
 // Set max width & height of the proportional font
+// and build the character -> glyph offset table
 //-----------------------------
 static void getMaxWidthHeight()
 {
@@ -1388,10 +1786,13 @@ static void getMaxWidthHeight()
 
 	cfont.numchars = 0;
 	cfont.max_x_size = 0;
+	memset(fontCharOffset, 0, sizeof(fontCharOffset));
 
     cc = cfont.font[tempPtr++];
     while (cc != 0xFF)  {
     	cfont.numchars++;
+    	// first glyph wins, as with the sequential search
+    	if (fontCharOffset[cc] == 0) fontCharOffset[cc] = tempPtr-1;
         cy = cfont.font[tempPtr++];
         cw = cfont.font[tempPtr++];
         ch = cfont.font[tempPtr++];
@@ -1404,7 +1805,7 @@ static void getMaxWidthHeight()
 		if (cy > cfont.y_size) cfont.y_size = cy;
 		if (cw != 0) {
 			// packed bits
-			tempPtr += (((cw * ch)-1) / 8) + 1;
+			tempPtr += glyphDataSize(cw, ch, cfont.bpp);
 		}
 	    cc = cfont.font[tempPtr++];
 	}
@@ -1414,36 +1815,24 @@ static void getMaxWidthHeight()
 // Return the Glyph data for an individual character in the proportional font
 //------------------------------------
 static uint8_t getCharPtr(uint8_t c) {
-  uint16_t tempPtr = 4; // point at first char data
+  uint16_t tempPtr = fontCharOffset[c];
 
-  do {
-	fontChar.charCode = cfont.font[tempPtr++];
-    if (fontChar.charCode == 0xFF) return 0;
-
-    fontChar.adjYOffset = cfont.font[tempPtr++];
-    fontChar.width = cfont.font[tempPtr++];
-    fontChar.height = cfont.font[tempPtr++];
-    fontChar.xOffset = cfont.font[tempPtr++];
-    fontChar.xOffset = fontChar.xOffset < 0x80 ? fontChar.xOffset : -(0xFF - fontChar.xOffset);
-    fontChar.xDelta = cfont.font[tempPtr++];
-
-    if (c != fontChar.charCode && fontChar.charCode != 0xFF) {
-      if (fontChar.width != 0) {
-        // packed bits
-        tempPtr += (((fontChar.width * fontChar.height)-1) / 8) + 1;
-      }
-    }
-  } while ((c != fontChar.charCode) && (fontChar.charCode != 0xFF));
+  if (tempPtr == 0) return 0; // character not in font
 
+  fontChar.charCode = cfont.font[tempPtr++];
+  fontChar.adjYOffset = cfont.font[tempPtr++];
+  fontChar.width = cfont.font[tempPtr++];
+  fontChar.height = cfont.font[tempPtr++];
+  fontChar.xOffset = cfont.font[tempPtr++];
+  fontChar.xOffset = fontChar.xOffset < 0x80 ? fontChar.xOffset : -(0xFF - fontChar.xOffset);
+  fontChar.xDelta = cfont.font[tempPtr++];
   fontChar.dataPtr = tempPtr;
-  if (c == fontChar.charCode) {
-    if (font_forceFixed > 0) {
-      // fix width & offset for forced fixed width
-      fontChar.xDelta = cfont.max_x_size;
-      fontChar.xOffset = (fontChar.xDelta - fontChar.width) / 2;
-    }
+
+  if (font_forceFixed > 0) {
+    // fix width & offset for forced fixed width
+    fontChar.xDelta = cfont.max_x_size;
+    fontChar.xOffset = (fontChar.xDelta - fontChar.width) / 2;
   }
-  else return 0;
 
   return 1;
 }
@@ -1497,7 +1886,18 @@ void TFT_setFont(uint8_t font, const char *font_file)
   }
   else {
 	  if (font == USER_FONT) {
-		  if (load_file_font(font_file, 0) != 0) cfont.font = tft_DefaultFont;
+		  const uint8_t *stored;
+		  int err = font_store_get(font_file, 0, &stored);
+		  if (err == 0) {
+			  // used in place, the heap copy of a previous font is not needed
+			  if (userfont != NULL) {
+				  TFT_clearGlyphCache();
+				  free(userfont);
+				  userfont = NULL;
+			  }
+			  cfont.font = (uint8_t *)stored;
+		  }
+		  else if ((err > 0) || (load_file_font(font_file, 0) != 0)) cfont.font = tft_DefaultFont;
 		  else cfont.font = userfont;
 	  }
 	  else if (font == DEJAVU18_FONT) cfont.font = tft_Dejavu18;
@@ -1511,6 +1911,7 @@ void TFT_setFont(uint8_t font, const char *font_file)
 	  else cfont.font = tft_DefaultFont;
 
 	  cfont.bitmap = 1;
+	  cfont.bpp = fontBpp(cfont.font);
 	  cfont.x_size = cfont.font[0];
 	  cfont.y_size = cfont.font[1];
 	  if (cfont.x_size > 0) {
@@ -1526,6 +1927,96 @@ void TFT_setFont(uint8_t font, const char *font_file)
   }
 }
 
+// ================ Rendered glyph cache =======================================
+
+//---------------------------------------------------------
+static void glyph_cache_evict(glyphCacheEntry_t *entry)
+{
+	free(entry->buf);
+	glyph_cache_stats.bytes -= entry->len * 3;
+	glyph_cache_stats.evictions++;
+	entry->font = NULL;
+	entry->buf = NULL;
+}
+
+// Return the rendered glyph of character 'c' in the current font and colors
+// or NULL if it is not cached
+//----------------------------------------------
+static color_t *glyph_cache_find(uint8_t c, int len)
+{
+	// colors are converted in place when sending in gray scale mode
+	if ((TFT_GLYPH_CACHE_SIZE == 0) || (gray_scale)) return NULL;
+
+	for (int i = 0; i < TFT_GLYPH_CACHE_ENTRIES; i++) {
+		glyphCacheEntry_t *entry = &glyph_cache[i];
+		if ((entry->c == c) && (entry->font == cfont.font) && (entry->len == len) && (entry->fixed == font_forceFixed) &&
+				(memcmp(&entry->fg, &_fg, sizeof(color_t)) == 0) && (memcmp(&entry->bg, &_bg, sizeof(color_t)) == 0)) {
+			entry->last_used = ++glyph_cache_clock;
+			glyph_cache_stats.hits++;
+			return entry->buf;
+		}
+	}
+	glyph_cache_stats.misses++;
+	return NULL;
+}
+
+// Allocate a cache entry for the glyph of character 'c', evicting the least recently used glyphs.
+// Returns the buffer to render the glyph into, or NULL if it cannot be cached
+//-----------------------------------------------
+static color_t *glyph_cache_alloc(uint8_t c, int len)
+{
+	glyphCacheEntry_t *free_entry;
+	glyphCacheEntry_t *lru;
+	uint32_t size = len * 3;
+
+	if ((TFT_GLYPH_CACHE_SIZE == 0) || (gray_scale) || (size > TFT_GLYPH_CACHE_SIZE)) return NULL;
+
+	while (1) {
+		free_entry = NULL;
+		lru = NULL;
+		for (int i = 0; i < TFT_GLYPH_CACHE_ENTRIES; i++) {
+			glyphCacheEntry_t *entry = &glyph_cache[i];
+			if (entry->font == NULL) {
+				if (free_entry == NULL) free_entry = entry;
+			}
+			else if ((lru == NULL) || (entry->last_used < lru->last_used)) lru = entry;
+		}
+		if ((free_entry) && ((glyph_cache_stats.bytes + size) <= TFT_GLYPH_CACHE_SIZE)) break;
+		if (lru == NULL) return NULL;
+		glyph_cache_evict(lru);
+	}
+
+	free_entry->buf = heap_caps_malloc(size, MALLOC_CAP_DMA);
+	if (free_entry->buf == NULL) return NULL;
+
+	free_entry->font = cfont.font;
+	free_entry->fg = _fg;
+	free_entry->bg = _bg;
+	free_entry->c = c;
+	free_entry->fixed = font_forceFixed;
+	free_entry->len = len;
+	free_entry->last_used = ++glyph_cache_clock;
+	glyph_cache_stats.bytes += size;
+
+	return free_entry->buf;
+}
+
+//====================================================
+void TFT_getGlyphCacheStats(glyphCacheStats_t *stats)
+{
+	*stats = glyph_cache_stats;
+}
+
+//========================
+void TFT_clearGlyphCache()
+{
+	for (int i = 0; i < TFT_GLYPH_CACHE_ENTRIES; i++) {
+		if (glyph_cache[i].font) glyph_cache_evict(&glyph_cache[i]);
+	}
+	memset(&glyph_cache_stats, 0, sizeof(glyph_cache_stats));
+	glyph_cache_clock = 0;
+}
+
 // -----------------------------------------------------------------------------------------
 // Individual Proportional Font Character Format:
 // -----------------------------------------------------------------------------------------
@@ -1542,83 +2033,151 @@ void TFT_setFont(uint8_t font, const char *font_file)
 // Character visible pixels rectangle is (xOffset, yOffset) (xOffset+Width-1, yOffset+Height-1)
 //---------------------------------------------------------------------------------------------
 
-// print non-rotated proportional character
-// character is already in fontChar
-//----------------------------------------------
-static int printProportionalChar(int x, int y) {
-	uint8_t ch = 0;
-	int i, j, char_width;
+// Return the palette of the glyph pixel values for the current colors, blended in integer arithmetic.
+// It is computed again only when the colors or the bits per pixel change
+//----------------------------------------
+static const color_t *_fontPalette(void) {
+	if ((font_palette_bpp != cfont.bpp) || (memcmp(&font_palette_fg, &_fg, sizeof(color_t))) ||
+			(memcmp(&font_palette_bg, &_bg, sizeof(color_t)))) {
+		int max = (1 << cfont.bpp) - 1;
+		for (int v=0; v <= max; v++) {
+			font_palette[v].r = ((_bg.r * (max - v)) + (_fg.r * v) + (max / 2)) / max;
+			font_palette[v].g = ((_bg.g * (max - v)) + (_fg.g * v) + (max / 2)) / max;
+			font_palette[v].b = ((_bg.b * (max - v)) + (_fg.b * v) + (max / 2)) / max;
+		}
+		font_palette_fg = _fg;
+		font_palette_bg = _bg;
+		font_palette_bpp = cfont.bpp;
+	}
+	return font_palette;
+}
 
-	char_width = ((fontChar.width > fontChar.xDelta) ? fontChar.width : fontChar.xDelta);
+// Next pixel value of the glyph; 1, 2 or 4 bit values never cross a byte
+//-----------------------------------------------------------
+static inline uint8_t _glyphPixel(glyphReader_t *pix) {
+	uint8_t v = (pix->data[pix->bit >> 3] >> (8 - cfont.bpp - (pix->bit & 7))) & ((1 << cfont.bpp) - 1);
+	pix->bit += cfont.bpp;
+	return v;
+}
 
-	if ((font_buffered_char) && (!font_transparent)) {
-		int len, bufPos;
+// Render the character into 'buf' holding 'stride' pixels per line; the background must already be set.
+// Pixels outside the 'width' x cfont.y_size cell are clipped.
+// For proportional fonts the character must already be in fontChar
+//-----------------------------------------------------------------------
+static void _renderChar(uint8_t c, color_t *buf, int width, int stride) {
+	uint8_t ch = 0;
+	uint8_t mask = 0x80;
 
-		// === buffer Glyph data for faster sending ===
-		len = char_width * cfont.y_size;
-		color_t *color_line = heap_caps_malloc(len*3, MALLOC_CAP_DMA);
-		if (color_line) {
-			// fill with background color
-			for (int n = 0; n < len; n++) {
-				color_line[n] = _bg;
+	if (cfont.x_size == 0) {
+		const color_t *palette = _fontPalette();
+		glyphReader_t pix = { cfont.font + fontChar.dataPtr, 0 };
+		for (int j=0; j < fontChar.height; j++) {
+			int cy = j + fontChar.adjYOffset;
+			color_t *line = buf + (cy * stride);
+			for (int i=0; i < fontChar.width; i++) {
+				uint8_t v = _glyphPixel(&pix);
+				int cx = fontChar.xOffset + i;
+				if ((v) && (cx >= 0) && (cx < width) && (cy < cfont.y_size)) line[cx] = palette[v];
 			}
-			// set character pixels to foreground color
-			uint8_t mask = 0x80;
-			for (j=0; j < fontChar.height; j++) {
-				for (i=0; i < fontChar.width; i++) {
-					if (((i + (j*fontChar.width)) % 8) == 0) {
-						mask = 0x80;
-						ch = cfont.font[fontChar.dataPtr++];
-					}
-					if ((ch & mask) != 0) {
-						// visible pixel
-						bufPos = ((j + fontChar.adjYOffset) * char_width) + (fontChar.xOffset + i);  // bufY + bufX
-						color_line[bufPos] = _fg;
-						/*
-						bufY = (j + fontChar.adjYOffset) * char_width;
-						bufX = fontChar.xOffset + i;
-						if ((bufX < 0) || (bufX > char_width)) {
-							printf("[%c] X ERR: %d\r\n", fontChar.charCode, bufX);
-						}
-						bufPos = bufY + bufX;
-						if ((bufPos < len) && (bufPos > 0)) color_line[bufPos] = _fg;
-						else printf("[%c] ERR: %d > %d  W=%d  H=%d  bufX=%d  bufY=%d  X=%d  Y=%d\r\n",
-								fontChar.charCode, bufPos, len, char_width, cfont.y_size, bufX, bufY, fontChar.xOffset + i, j + fontChar.adjYOffset);
-						*/
-					}
+		}
+	}
+	else {
+		// fz = bytes per char row
+		int fz = cfont.x_size/8;
+		if (cfont.x_size % 8) fz++;
+		uint32_t temp = ((c-cfont.offset)*((fz)*cfont.y_size))+4;
+
+		for (int j=0; j < cfont.y_size; j++) {
+			for (int k=0; k < fz; k++) {
+				ch = cfont.font[temp+k];
+				mask = 0x80;
+				for (int i=0; (i < 8) && ((i+(k*8)) < width); i++) {
+					if ((ch & mask) != 0) buf[(j*stride) + (i+(k*8))] = _fg;
 					mask >>= 1;
 				}
 			}
-			// send to display in one transaction
-			disp_select();
-			send_data(x, y, x+char_width-1, y+cfont.y_size-1, len, color_line);
-			disp_deselect();
-			free(color_line);
+			temp += fz;
+		}
+	}
+}
+
+// Return the rendered glyph of the character from the glyph cache,
+// rendering it into the cache on a miss; NULL if it cannot be cached
+//---------------------------------------------------------
+static color_t *_cachedChar(uint8_t c, int char_width) {
+	int len = char_width * cfont.y_size;
+
+	color_t *glyph = glyph_cache_find(c, len);
+	if (glyph == NULL) {
+		glyph = glyph_cache_alloc(c, len);
+		if (glyph) {
+			for (int n = 0; n < len; n++) {
+				glyph[n] = _bg;
+			}
+			_renderChar(c, glyph, char_width, char_width);
+		}
+	}
+	return glyph;
+}
+
+// Render the character buffered, in one transaction
+// Returns 0 if there is not enough memory for the buffer
+//---------------------------------------------------------------------
+static int _printBufferedChar(uint8_t c, int x, int y, int char_width) {
+	int len = char_width * cfont.y_size;
+
+	color_t *color_line = _cachedChar(c, char_width);
+	uint8_t cached = (color_line != NULL);
+	if (!cached) {
+		color_line = heap_caps_malloc(len*3, MALLOC_CAP_DMA);
+		if (color_line == NULL) return 0;
+		// fill with background color
+		for (int n = 0; n < len; n++) {
+			color_line[n] = _bg;
+		}
+		// set character pixels to foreground color
+		_renderChar(c, color_line, char_width, char_width);
+	}
+
+	// send to display in one transaction
+	disp_select();
+	send_data(x, y, x+char_width-1, y+cfont.y_size-1, len, color_line);
+	disp_deselect();
+	if (!cached) free(color_line);
+
+	return 1;
+}
+
+// print non-rotated proportional character
+// character is already in fontChar
+//----------------------------------------------
+static int printProportionalChar(int x, int y) {
+	int i, j, char_width;
 
-			return char_width;
-		}
+	char_width = ((fontChar.width > fontChar.xDelta) ? fontChar.width : fontChar.xDelta);
+
+	if ((font_buffered_char) && (!font_transparent)) {
+		// === buffer Glyph data, with the gap column, for faster sending ===
+		if (_printBufferedChar(fontChar.charCode, x, y, char_width+1)) return char_width;
 	}
 
 	int cx, cy;
 
 	if (!font_transparent) _fillRect(x, y, char_width+1, cfont.y_size, _bg);
 
-	// draw Glyph
-	uint8_t mask = 0x80;
+	// draw Glyph; transparent anti-aliased glyphs are drawn with the pixels more than half covered
+	const color_t *palette = _fontPalette();
+	uint8_t threshold = (font_transparent) ? ((1 << cfont.bpp) - 1) / 2 : 0;
+	glyphReader_t pix = { cfont.font + fontChar.dataPtr, 0 };
 	disp_select();
 	for (j=0; j < fontChar.height; j++) {
 		for (i=0; i < fontChar.width; i++) {
-			if (((i + (j*fontChar.width)) % 8) == 0) {
-				mask = 0x80;
-				ch = cfont.font[fontChar.dataPtr++];
-			}
-
-			if ((ch & mask) !=0) {
+			uint8_t v = _glyphPixel(&pix);
+			if (v > threshold) {
 				cx = (uint16_t)(x+fontChar.xOffset+i);
 				cy = (uint16_t)(y+j+fontChar.adjYOffset);
-				_drawPixel(cx, cy, _fg, 0);
+				_drawPixel(cx, cy, (font_transparent) ? _fg : palette[v], 0);
 			}
-			mask >>= 1;
 		}
 	}
 	disp_deselect();
@@ -1630,7 +2189,7 @@ static int printProportionalChar(int x, int y) {
 //----------------------------------------------
 static void printChar(uint8_t c, int x, int y) {
 	uint8_t i, j, ch, fz, mask;
-	uint16_t k, temp, cx, cy, len;
+	uint16_t k, temp, cx, cy;
 
 	// fz = bytes per char row
 	fz = cfont.x_size/8;
@@ -1641,33 +2200,7 @@ static void printChar(uint8_t c, int x, int y) {
 
 	if ((font_buffered_char) && (!font_transparent)) {
 		// === buffer Glyph data for faster sending ===
-		len = cfont.x_size * cfont.y_size;
-		color_t *color_line = heap_caps_malloc(len*3, MALLOC_CAP_DMA);
-		if (color_line) {
-			// fill with background color
-			for (int n = 0; n < len; n++) {
-				color_line[n] = _bg;
-			}
-			// set character pixels to foreground color
-			for (j=0; j<cfont.y_size; j++) {
-				for (k=0; k < fz; k++) {
-					ch = cfont.font[temp+k];
-					mask=0x80;
-					for (i=0; i<8; i++) {
-						if ((ch & mask) !=0) color_line[(j*cfont.x_size) + (i+(k*8))] = _fg;
-						mask >>= 1;
-					}
-				}
-				temp += (fz);
-			}
-			// send to display in one transaction
-			disp_select();
-			send_data(x, y, x+cfont.x_size-1, y+cfont.y_size-1, len, color_line);
-			disp_deselect();
-			free(color_line);
-
-			return;
-		}
+		if (_printBufferedChar(c, x, y, cfont.x_size)) return;
 	}
 
 	if (!font_transparent) _fillRect(x, y, cfont.x_size, cfont.y_size, _bg);
@@ -1695,27 +2228,23 @@ static void printChar(uint8_t c, int x, int y) {
 // character is already in fontChar
 //---------------------------------------------------
 static int rotatePropChar(int x, int y, int offset) {
-  uint8_t ch = 0;
   double radian = font_rotate * DEG_TO_RAD;
   float cos_radian = cos(radian);
   float sin_radian = sin(radian);
 
-  uint8_t mask = 0x80;
+  const color_t *palette = _fontPalette();
+  uint8_t threshold = ((1 << cfont.bpp) - 1) / 2;
+  glyphReader_t pix = { cfont.font + fontChar.dataPtr, 0 };
   disp_select();
   for (int j=0; j < fontChar.height; j++) {
     for (int i=0; i < fontChar.width; i++) {
-      if (((i + (j*fontChar.width)) % 8) == 0) {
-        mask = 0x80;
-        ch = cfont.font[fontChar.dataPtr++];
-      }
+      uint8_t v = _glyphPixel(&pix);
 
       int newX = (int)(x + (((offset + i) * cos_radian) - ((j+fontChar.adjYOffset)*sin_radian)));
       int newY = (int)(y + (((j+fontChar.adjYOffset) * cos_radian) + ((offset + i) * sin_radian)));
 
-      if ((ch & mask) != 0) _drawPixel(newX,newY,_fg, 0);
-      else if (!font_transparent) _drawPixel(newX,newY,_bg, 0);
-
-      mask >>= 1;
+      if (!font_transparent) _drawPixel(newX,newY,palette[v], 0);
+      else if (v > threshold) _drawPixel(newX,newY,_fg, 0);
     }
   }
   disp_deselect();
@@ -1925,9 +2454,71 @@ static void _draw7seg(int16_t x, int16_t y, int8_t num, int16_t w, int16_t l, co
 }
 //==============================================================================
 
+typedef struct {
+	color_t *buf;
+	int x;				// position of the first column
+	int y;
+	int width;			// columns rendered
+	int max_width;		// columns the buffer can hold, the buffer line length
+} textLine_t;
+
+// Send the rendered run of characters in one transaction, clipped to the display window
+//--------------------------------------------
+static void _flushTextLine(textLine_t *line) {
+	int w = line->width;
+	int h = cfont.y_size;
+
+	if (w == 0) return;
+	line->width = 0;
+
+	if ((line->x + w) > (dispWin.x2+1)) w = dispWin.x2 + 1 - line->x;
+	if (w <= 0) return;
+
+	// close up the buffer lines
+	if (w < line->max_width) {
+		for (int j=1; j < h; j++) {
+			memmove(line->buf + (j*w), line->buf + (j*line->max_width), w * sizeof(color_t));
+		}
+	}
+	disp_select();
+	send_data(line->x, line->y, line->x+w-1, line->y+h-1, w*h, line->buf);
+	disp_deselect();
+}
+
+// Add the character cell, 'char_width' columns wide, to the run in the line buffer.
+// Returns 0 if the character does not fit in the buffer
+//--------------------------------------------------------------------------------------
+static int _bufferLineChar(textLine_t *line, uint8_t c, int x, int y, int char_width) {
+	if (char_width > line->max_width) return 0;
+	// continue the run only if the character is next to it
+	if ((line->width) && (((line->width + char_width) > line->max_width) || (y != line->y) || (x != (line->x + line->width)))) {
+		_flushTextLine(line);
+	}
+	if (line->width == 0) {
+		line->x = x;
+		line->y = y;
+	}
+
+	color_t *dst = line->buf + line->width;
+	color_t *glyph = _cachedChar(c, char_width);
+	for (int j=0; j < cfont.y_size; j++) {
+		color_t *row = dst + (j * line->max_width);
+		if (glyph) memcpy(row, glyph + (j * char_width), char_width * sizeof(color_t));
+		else {
+			for (int i=0; i < char_width; i++) {
+				row[i] = _bg;
+			}
+		}
+	}
+	if (glyph == NULL) _renderChar(c, dst, char_width, line->max_width);
+
+	line->width += char_width;
+	return 1;
+}
+
 //======================================
 void TFT_print(char *st, int x, int y) {
-	int stl, i, tmpw, tmph, fh;
+	int stl, i, tmpw, tmph, fh, strw;
 	uint8_t ch;
 
 	if (cfont.bitmap == 0) return; // wrong font selected
@@ -1948,6 +2539,7 @@ void TFT_print(char *st, int x, int y) {
 
 	// ** Calculate CENTER, RIGHT or BOTTOM position
 	tmpw = TFT_getStringWidth(st);	// string width in pixels
+	strw = tmpw;
 	fh = cfont.y_size;			// font height
 	if ((cfont.x_size != 0) && (cfont.bitmap == 2)) {
 		// 7-segment font
@@ -1983,6 +2575,15 @@ void TFT_print(char *st, int x, int y) {
 
 	int offset = TFT_OFFSET;
 
+	// Non rotated bitmap fonts are rendered a line at a time and sent in one transaction
+	textLine_t line = { .buf = NULL, .width = 0 };
+	if ((font_rotate == 0) && (!font_transparent) && (font_buffered_char) && (cfont.bitmap == 1)) {
+		line.max_width = (TFT_TEXT_LINE_BUF_SIZE / sizeof(color_t)) / cfont.y_size;
+		if (line.max_width > (strw + 1)) line.max_width = strw + 1;
+		if (line.max_width > (dispWin.x2 - dispWin.x1 + 2)) line.max_width = dispWin.x2 - dispWin.x1 + 2;
+		if (line.max_width > 0) line.buf = heap_caps_malloc(line.max_width * cfont.y_size * sizeof(color_t), MALLOC_CAP_DMA);
+	}
+
 	for (i=0; i<stl; i++) {
 		ch = st[i]; // get string character
 
@@ -2014,6 +2615,23 @@ void TFT_print(char *st, int x, int y) {
 			}
 
 			// Let's print the character
+			if (line.buf) {
+				if (cfont.x_size == 0) {
+					int char_width = ((fontChar.width > fontChar.xDelta) ? fontChar.width : fontChar.xDelta);
+					if (_bufferLineChar(&line, ch, TFT_X, TFT_Y, char_width + 1)) {
+						TFT_X += char_width + 1;
+						continue;
+					}
+				}
+				else {
+					if ((ch < cfont.offset) || ((ch-cfont.offset) > cfont.numchars)) ch = cfont.offset;
+					if (_bufferLineChar(&line, ch, TFT_X, TFT_Y, tmpw)) {
+						TFT_X += tmpw;
+						continue;
+					}
+				}
+				_flushTextLine(&line);
+			}
 			if (cfont.x_size == 0) {
 				// == proportional font
 				if (font_rotate == 0) TFT_X += printProportionalChar(TFT_X, TFT_Y) + 1;
@@ -2041,6 +2659,234 @@ void TFT_print(char *st, int x, int y) {
 			}
 		}
 	}
+
+	if (line.buf) {
+		_flushTextLine(&line);
+		free(line.buf);
+	}
+}
+
+
+// ================ Text marquee ===============================================
+
+typedef struct {
+	uint8_t *strip;			// glyph pixel values of all text lines, 'bpp' bits each, rows of 'width' pixels
+	int rows;				// rows in the strip
+	int x;					// window position and size
+	int y;
+	int width;
+	int height;
+	int pos;				// strip row shown at the top of the window
+	uint8_t bpp;
+	color_t palette[16];
+	color_t *row;			// rows to send, DMA capable
+} marquee_t;
+
+static marquee_t *marquee = NULL;
+
+// Width taken by the character in printed text, 0 if it is not in the font
+//---------------------------------------
+static int _textCharWidth(uint8_t ch) {
+	if (cfont.x_size) return cfont.x_size;
+	if (!getCharPtr(ch)) return 0;
+	return ((fontChar.width > fontChar.xDelta) ? fontChar.width : fontChar.xDelta) + 1;
+}
+
+// Number of characters of 'st' printed on the first line 'width' pixels wide, breaking at a space if possible.
+// 'lwidth' receives the printed width, 'skip' the number of characters to skip to the next line
+//-----------------------------------------------------------------------------------------
+static int _textLineLength(const char *st, int width, int *lwidth, int *skip) {
+	int limit = width + ((cfont.x_size) ? 0 : 1);	// the gap after the last character may be outside
+	int w = 0, n = 0, brk = 0;
+
+	while ((st[n]) && (st[n] != '\n')) {
+		int cw = _textCharWidth(st[n]);
+		if ((n > 0) && ((w + cw) > limit)) break;
+		if (st[n] == ' ') brk = n;
+		w += cw;
+		n++;
+	}
+	if ((st[n]) && (st[n] != '\n') && (st[n] != ' ') && (brk > 0)) n = brk;
+
+	w = 0;
+	for (int i = 0; i < n; i++) {
+		w += _textCharWidth(st[i]);
+	}
+	*lwidth = ((w > 0) && (cfont.x_size == 0)) ? w - 1 : w;
+
+	*skip = 0;
+	while (st[n + *skip] == ' ') (*skip)++;
+	if (st[n + *skip] == '\n') (*skip)++;
+	return n;
+}
+
+// Pack the pixel values of the rendered text rows into the strip,
+// the values are in the red component of the rendered colors
+//---------------------------------------------------------------------------------------------------
+static void _marqueePack(marquee_t *m, const color_t *buf, int first_row) {
+	for (int j = 0; j < m->height; j++) {
+		uint32_t bit = (uint32_t)(first_row + j) * m->width * m->bpp;
+		for (int i = 0; i < m->width; i++, bit += m->bpp) {
+			m->strip[bit >> 3] |= buf[(j * m->width) + i].r << (8 - m->bpp - (bit & 7));
+		}
+	}
+}
+
+// Colors of 'count' rows of the strip, from 'first' on, to 'buf'
+//--------------------------------------------------------------------------------
+static void _marqueeRows(marquee_t *m, int first, int count, color_t *buf) {
+	uint8_t mask = (1 << m->bpp) - 1;
+	for (int j = 0; j < count; j++) {
+		uint32_t bit = (uint32_t)((first + j) % m->rows) * m->width * m->bpp;
+		for (int i = 0; i < m->width; i++, bit += m->bpp) {
+			*buf++ = m->palette[(m->strip[bit >> 3] >> (8 - m->bpp - (bit & 7))) & mask];
+		}
+	}
+}
+
+// Send the window rows from strip row 'pos' on, unscrolled
+//-------------------------------------------
+static void _marqueeDraw(marquee_t *m) {
+	color_t *buf = heap_caps_malloc(m->width * m->height * sizeof(color_t), MALLOC_CAP_DMA);
+	int rows = (buf) ? m->height : 1;
+
+	if (buf == NULL) buf = m->row;
+	for (int j = 0; j < m->height; j += rows) {
+		_marqueeRows(m, m->pos + j, rows, buf);
+		disp_select();
+		send_data(m->x, m->y + j, m->x + m->width - 1, m->y + j + rows - 1, m->width * rows, buf);
+		disp_deselect();
+	}
+	if (buf != m->row) free(buf);
+}
+
+// Free the marquee and turn scrolling off, 'redraw' shows the same rows unscrolled
+//------------------------------------
+static void _marqueeFree(int redraw) {
+	marquee_t *m = marquee;
+
+	if (m == NULL) return;
+	marquee = NULL;
+	if (m->rows > m->height) {
+		TFT_resetScrollWindow();
+		if (redraw) _marqueeDraw(m);
+	}
+	free(m->strip);
+	free(m->row);
+	free(m);
+}
+
+//================================================
+int TFT_marqueeStart(char *st, int x, int y)
+{
+	int lwidth, skip, lines = 0;
+	const char *p;
+
+	// the new text is drawn over the old one
+	_marqueeFree(0);
+	if ((cfont.bitmap != 1) || (font_rotate != 0) || (st == NULL)) return -1;
+
+	marquee_t *m = calloc(1, sizeof(marquee_t));
+	if (m == NULL) return -1;
+	m->x = dispWin.x1;
+	m->y = y + dispWin.y1;
+	m->width = dispWin.x2 - dispWin.x1 + 1;
+	m->height = cfont.y_size;
+	m->bpp = (cfont.x_size) ? 1 : cfont.bpp;
+	if ((m->y + m->height - 1) > dispWin.y2) goto fail;
+
+	// split the text into lines fitting the window
+	for (p = st; *p; p += skip) {
+		int n = _textLineLength(p, m->width, &lwidth, &skip);
+		if ((n == 0) && (skip == 0)) break;
+		p += n;
+		lines++;
+	}
+	if (lines == 0) lines = 1;
+	m->rows = lines * (m->height + font_line_space);
+
+	m->strip = calloc(((m->rows * m->width * m->bpp) + 7) / 8, 1);
+	m->row = heap_caps_malloc(m->width * sizeof(color_t), MALLOC_CAP_DMA);
+	color_t *buf = malloc(m->width * m->height * sizeof(color_t));
+	if ((m->strip == NULL) || (m->row == NULL) || (buf == NULL)) {
+		free(buf);
+		goto fail;
+	}
+
+	// render the lines with the pixel values as colors
+	color_t fg = _fg;
+	color_t bg = _bg;
+	_fg = (color_t){ (1 << m->bpp) - 1, 0, 0 };
+	_bg = (color_t){ 0, 0, 0 };
+	p = st;
+	for (int l = 0; l < lines; l++) {
+		int n = _textLineLength(p, m->width, &lwidth, &skip);
+		int tx = x;
+		if (x == RIGHT) tx = m->width - lwidth;
+		else if (x == CENTER) tx = (m->width - lwidth) / 2;
+		if (tx < 0) tx = 0;
+
+		memset(buf, 0, m->width * m->height * sizeof(color_t));
+		for (int i = 0; i < n; i++) {
+			int cw = _textCharWidth(p[i]);
+			uint8_t ch = p[i];
+			if ((cw == 0) || ((tx + cw) > (m->width + 1))) continue;
+			if ((cfont.x_size) && ((ch < cfont.offset) || ((ch-cfont.offset) > cfont.numchars))) ch = cfont.offset;
+			_renderChar(ch, buf + tx, (tx + cw > m->width) ? m->width - tx : cw, m->width);
+			tx += cw;
+		}
+		_marqueePack(m, buf, l * (m->height + font_line_space));
+		p += n + skip;
+	}
+	_fg = fg;
+	_bg = bg;
+	free(buf);
+
+	int max = (1 << m->bpp) - 1;
+	for (int v = 0; v <= max; v++) {
+		m->palette[v].r = ((_bg.r * (max - v)) + (_fg.r * v) + (max / 2)) / max;
+		m->palette[v].g = ((_bg.g * (max - v)) + (_fg.g * v) + (max / 2)) / max;
+		m->palette[v].b = ((_bg.b * (max - v)) + (_fg.b * v) + (max / 2)) / max;
+	}
+
+	// a single line is only drawn
+	if ((m->rows > m->height) && (TFT_setScrollWindow(m->y, m->height) != 0)) goto fail;
+	marquee = m;
+	_marqueeDraw(m);
+	return 0;
+
+fail:
+	free(m->strip);
+	free(m->row);
+	free(m);
+	return -1;
+}
+
+//=====================
+int TFT_marqueeStep()
+{
+	marquee_t *m = marquee;
+
+	if (m == NULL) return -1;
+	if (m->rows <= m->height) return 1;
+
+	// the row scrolled out at the top comes back at the bottom with the next strip row
+	int ram_row = m->y + (m->pos % m->height);
+	m->pos = (m->pos + 1) % m->rows;
+	TFT_scrollWindow(m->pos % m->height);
+
+	_marqueeRows(m, m->pos + m->height - 1, 1, m->row);
+	disp_select();
+	send_data(m->x, ram_row, m->x + m->width - 1, ram_row, m->width, m->row);
+	disp_deselect();
+
+	return ((m->pos % (m->height + font_line_space)) == 0);
+}
+
+//====================
+void TFT_marqueeStop()
+{
+	_marqueeFree(1);
 }
 
 
@@ -2250,12 +3096,28 @@ typedef struct {
     uint8_t		*membuff;		// memory buffer containing the image
     uint32_t	bufsize;		// size of the memory buffer
     uint32_t	bufptr;			// memory buffer current position
+    imageRead_t	read;			// file or stream input function
+    void		*ctx;			// passed to the input function
+    uint8_t		*inbuf;			// read-ahead buffer of file and stream input
+    uint32_t	inlen;			// bytes in the read-ahead buffer
+    uint32_t	inpos;			// read-ahead buffer current position
     color_t		*linbuf[2];		// memory buffer used for display output
     uint8_t		linbuf_idx;
+    int			bx1, by1, bx2;	// display area collected in the current line buffer, bx2 < bx1 if empty
+    int			by2;
+    int			bstride;		// pixels per row in the current line buffer
 } JPGIODEV;
 
 
-// User defined call-back function to input JPEG data from file
+// Input function reading the file
+//--------------------------------------------------------
+static int _jpg_file_read(void *ctx, uint8_t *buf, int len)
+{
+	return fread(buf, 1, len, (FILE *)ctx);
+}
+
+// User defined call-back function to input JPEG data from file or stream
+// through the read-ahead buffer
 //---------------------
 static UINT tjd_input (
 	JDEC* jd,		// Decompression object
@@ -2263,18 +3125,25 @@ static UINT tjd_input (
 	UINT nd			// Number of bytes to read/skip from input stream
 )
 {
-	int rb = 0;
 	// Device identifier for the session (5th argument of jd_prepare function)
 	JPGIODEV *dev = (JPGIODEV*)jd->device;
-
-	if (buff) {	// Read nd bytes from the input strem
-		rb = fread(buff, 1, nd, dev->fhndl);
-		return rb;	// Returns actual number of bytes read
-	}
-	else {	// Remove nd bytes from the input stream
-		if (fseek(dev->fhndl, nd, SEEK_CUR) >= 0) return nd;
-		else return 0;
+	UINT done = 0;
+
+	while (done < nd) {
+		if (dev->inpos >= dev->inlen) {
+			int rb = dev->read(dev->ctx, dev->inbuf, JPG_INPUT_BUF_SIZE);
+			if (rb <= 0) break;	// end of stream
+			dev->inlen = rb;
+			dev->inpos = 0;
+		}
+		UINT n = dev->inlen - dev->inpos;
+		if (n > (nd - done)) n = nd - done;
+		// Read nd bytes from the input stream, or remove them if buff is NULL
+		if (buff) memcpy(buff + done, dev->inbuf + dev->inpos, n);
+		dev->inpos += n;
+		done += n;
 	}
+	return done;	// Returns actual number of bytes read
 }
 
 // User defined call-back function to input JPEG data from memory buffer
@@ -2303,7 +3172,31 @@ static UINT tjd_buf_input (
 	}
 }
 
+// Send the blocks collected in the current line buffer and switch to the other one.
+// The transfer is left running while the next blocks are decoded; the buffer
+// is not written again before the transfer of the other one is started.
+//-------------------------------------
+static void _jpg_flush(JPGIODEV *dev)
+{
+	if (dev->bx2 < dev->bx1) return;
+
+	int w = dev->bx2 - dev->bx1 + 1;
+	int h = dev->by2 - dev->by1 + 1;
+	color_t *buf = dev->linbuf[dev->linbuf_idx];
+
+	// rows are 'bstride' pixels apart while the width is not known
+	if (w < dev->bstride) {
+		for (int y = 1; y < h; y++) memmove(buf + (y * w), buf + (y * dev->bstride), w * sizeof(color_t));
+	}
+	wait_trans_finish(0);
+	send_data(dev->bx1, dev->by1, dev->bx2, dev->by2, w * h, buf);
+	dev->linbuf_idx = ((dev->linbuf_idx + 1) & 1);
+	dev->bx2 = dev->bx1 - 1;
+}
+
 // User defined call-back function to output RGB bitmap to display device
+// Blocks are collected left to right in a line buffer and sent when the block row
+// ends or the buffer is full, one address window for many blocks
 //----------------------
 static UINT tjd_output (
 	JDEC* jd,		// Decompression object of current session
@@ -2315,8 +3208,6 @@ static UINT tjd_output (
 	JPGIODEV *dev = (JPGIODEV*)jd->device;
 
 	// ** Put the rectangular into the display device **
-	int x;
-	int y;
 	int dleft, dtop, dright, dbottom;
 	BYTE *src = (BYTE*)bitmap;
 
@@ -2340,83 +3231,74 @@ static UINT tjd_output (
 	if ((dleft > dispWin.x2) || (dtop > dispWin.y2)) return 1;		// out of screen area, return
 	if ((dright < dispWin.x1) || (dbottom < dispWin.y1)) return 1;	// out of screen area, return
 
-	uint32_t len = ((dright-dleft+1) * (dbottom-dtop+1));	// calculate length of data
-
+	int w = dright - dleft + 1;
+	int h = dbottom - dtop + 1;
+	uint32_t len = w * h;	// calculate length of data
 
-	if ((len > 0) && (len <= JPG_IMAGE_LINE_BUF_SIZE)) {
-		uint8_t *dest = (uint8_t *)(dev->linbuf[dev->linbuf_idx]);
-
-		for (y = top; y <= bottom; y++) {
-			for (x = left; x <= right; x++) {
-				// Clip to display area
-				if ((x >= dleft) && (y >= dtop) && (x <= dright) && (y <= dbottom)) {
-					*dest++ = (*src++) & 0xFC;
-					*dest++ = (*src++) & 0xFC;
-					*dest++ = (*src++) & 0xFC;
-				}
-				else src += 3; // skip
-			}
-		}
-		wait_trans_finish(1);
-		send_data(dleft, dtop, dright, dbottom, len, dev->linbuf[dev->linbuf_idx]);
-		dev->linbuf_idx = ((dev->linbuf_idx + 1) & 1);
-	}
-	else {
+	if ((len == 0) || (len > JPG_IMAGE_LINE_BUF_SIZE)) {
+		_jpg_flush(dev);
 		wait_trans_finish(1);
 		printf("Data size error: %d jpg: (%d,%d,%d,%d) disp: (%d,%d,%d,%d)\r\n", len, left,top,right,bottom, dleft,dtop,dright,dbottom);
 		return 0;  // stop decompression
 	}
 
+	// Continue the collected blocks if this one is next to them and fits
+	if ((dev->bx2 >= dev->bx1) &&
+			((dtop != dev->by1) || (dbottom != dev->by2) || (dleft != (dev->bx2 + 1)) || ((dright - dev->bx1) >= dev->bstride))) {
+		_jpg_flush(dev);
+	}
+	if (dev->bx2 < dev->bx1) {
+		dev->bx1 = dleft;
+		dev->by1 = dtop;
+		dev->by2 = dbottom;
+		dev->bstride = JPG_IMAGE_LINE_BUF_SIZE / h;
+	}
+
+	int src_w = right - left + 1;
+	uint8_t *dest = (uint8_t *)(dev->linbuf[dev->linbuf_idx] + (dleft - dev->bx1));
+	src += (((dtop - top) * src_w) + (dleft - left)) * 3;
+	for (int y = 0; y < h; y++) {
+		uint8_t *d = dest + (y * dev->bstride * 3);
+		BYTE *s = src + (y * src_w * 3);
+		for (int i = 0; i < (w * 3); i++) d[i] = s[i] & 0xFC;
+	}
+	dev->bx2 = dright;
+
 	return 1;	// Continue to decompression
 }
 
-// tft.jpgimage(X, Y, scale, file_name, buf, size]
-// X & Y can be < 0 !
-//==================================================================================
-void TFT_jpg_image(int x, int y, uint8_t scale, char *fname, uint8_t *buf, int size)
+// Decode the image from the input set in 'dev' and send it to the display
+//-------------------------------------------------------------------------------
+static void _jpg_decode(JPGIODEV *dev, int x, int y, uint8_t scale)
 {
-	JPGIODEV dev;
-    struct stat sb;
 	char *work = NULL;		// Pointer to the working buffer (must be 4-byte aligned)
 	UINT sz_work = 3800;	// Size of the working buffer (must be power of 2)
 	JDEC jd;				// Decompression object (70 bytes)
 	JRESULT rc;
 
-	dev.linbuf[0] = NULL;
-	dev.linbuf[1] = NULL;
-    dev.linbuf_idx = 0;
-
-   	dev.fhndl = NULL;
-    if (fname == NULL) {
-    	// image from buffer
-        dev.membuff = buf;
-        dev.bufsize = size;
-        dev.bufptr = 0;
-    }
-    else {
-    	// image from file
-        dev.membuff = NULL;
-        dev.bufsize = 0;
-        dev.bufptr = 0;
-
-        if (stat(fname, &sb) != 0) {
-        	if (image_debug) printf("File error: %ss\r\n", strerror(errno));
-            goto exit;
-        }
-
-        dev.fhndl = fopen(fname, "r");
-        if (!dev.fhndl) {
-        	if (image_debug) printf("Error opening file: %s\r\n", strerror(errno));
-            goto exit;
-        }
-    }
+	dev->linbuf[0] = NULL;
+	dev->linbuf[1] = NULL;
+    dev->linbuf_idx = 0;
+    dev->bx1 = 0;
+    dev->bx2 = -1;
+    dev->inbuf = NULL;
+    dev->inlen = 0;
+    dev->inpos = 0;
 
 	if (scale > 3) scale = 3;
 
+	if (dev->read) {
+		dev->inbuf = malloc(JPG_INPUT_BUF_SIZE);
+		if (dev->inbuf == NULL) {
+			if (image_debug) printf("Error allocating input buffer\r\n");
+			return;
+		}
+	}
+
 	work = malloc(sz_work);
 	if (work) {
-		if (dev.membuff) rc = jd_prepare(&jd, tjd_buf_input, (void *)work, sz_work, &dev);
-		else rc = jd_prepare(&jd, tjd_input, (void *)work, sz_work, &dev);
+		if (dev->membuff) rc = jd_prepare(&jd, tjd_buf_input, (void *)work, sz_work, dev);
+		else rc = jd_prepare(&jd, tjd_input, (void *)work, sz_work, dev);
 		if (rc == JDR_OK) {
 			if (x == CENTER) x = ((dispWin.x2 - dispWin.x1 + 1 - (int)(jd.width >> scale)) / 2) + dispWin.x1;
 			else if (x == RIGHT) x = dispWin.x2 + 1 - (int)(jd.width >> scale);
@@ -2429,16 +3311,16 @@ void TFT_jpg_image(int x, int y, uint8_t scale, char *fname, uint8_t *buf, int s
 			if (x > (dispWin.x2-1)) x = dispWin.x2 - 1;
 			if (y > (dispWin.y2-1)) y = dispWin.y2-1;
 
-			dev.x = x;
-			dev.y = y;
+			dev->x = x;
+			dev->y = y;
 
-			dev.linbuf[0] = heap_caps_malloc(JPG_IMAGE_LINE_BUF_SIZE*3, MALLOC_CAP_DMA);
-			if (dev.linbuf[0] == NULL) {
+			dev->linbuf[0] = heap_caps_malloc(JPG_IMAGE_LINE_BUF_SIZE*3, MALLOC_CAP_DMA);
+			if (dev->linbuf[0] == NULL) {
 				if (image_debug) printf("Error allocating line buffer #0\r\n");
 				goto exit;
 			}
-			dev.linbuf[1] = heap_caps_malloc(JPG_IMAGE_LINE_BUF_SIZE*3, MALLOC_CAP_DMA);
-			if (dev.linbuf[1] == NULL) {
+			dev->linbuf[1] = heap_caps_malloc(JPG_IMAGE_LINE_BUF_SIZE*3, MALLOC_CAP_DMA);
+			if (dev->linbuf[1] == NULL) {
 				if (image_debug) printf("Error allocating line buffer #1\r\n");
 				goto exit;
 			}
@@ -2446,6 +3328,7 @@ void TFT_jpg_image(int x, int y, uint8_t scale, char *fname, uint8_t *buf, int s
 			// Start to decode the JPEG file
 			disp_select();
 			rc = jd_decomp(&jd, tjd_output, scale);
+			_jpg_flush(dev);
 			disp_deselect();
 
 			if (rc != JDR_OK) {
@@ -2463,33 +3346,202 @@ void TFT_jpg_image(int x, int y, uint8_t scale, char *fname, uint8_t *buf, int s
 
 exit:
 	if (work) free(work);  // free work buffer
-	if (dev.linbuf[0]) free(dev.linbuf[0]);
-	if (dev.linbuf[1]) free(dev.linbuf[1]);
+	if (dev->linbuf[0]) free(dev->linbuf[0]);
+	if (dev->linbuf[1]) free(dev->linbuf[1]);
+	if (dev->inbuf) free(dev->inbuf);
+}
+
+// tft.jpgimage(X, Y, scale, file_name, buf, size]
+// X & Y can be < 0 !
+//==================================================================================
+void TFT_jpg_image(int x, int y, uint8_t scale, char *fname, uint8_t *buf, int size)
+{
+	JPGIODEV dev;
+    struct stat sb;
+
+   	dev.fhndl = NULL;
+    dev.read = NULL;
+    dev.ctx = NULL;
+    if (fname == NULL) {
+    	// image from buffer
+        dev.membuff = buf;
+        dev.bufsize = size;
+        dev.bufptr = 0;
+    }
+    else {
+    	// image from file
+        dev.membuff = NULL;
+        dev.bufsize = 0;
+        dev.bufptr = 0;
+
+        if (stat(fname, &sb) != 0) {
+        	if (image_debug) printf("File error: %ss\r\n", strerror(errno));
+            return;
+        }
+
+        dev.fhndl = fopen(fname, "r");
+        if (!dev.fhndl) {
+        	if (image_debug) printf("Error opening file: %s\r\n", strerror(errno));
+            return;
+        }
+        dev.read = _jpg_file_read;
+        dev.ctx = dev.fhndl;
+    }
+
+	_jpg_decode(&dev, x, y, scale);
+
     if (dev.fhndl) fclose(dev.fhndl);  // close input file
 }
 
+//=============================================================================
+void TFT_jpg_stream(int x, int y, uint8_t scale, imageRead_t read, void *ctx)
+{
+	JPGIODEV dev;
+
+	if (read == NULL) return;
+	dev.fhndl = NULL;
+	dev.membuff = NULL;
+	dev.bufsize = 0;
+	dev.bufptr = 0;
+	dev.read = read;
+	dev.ctx = ctx;
+
+	_jpg_decode(&dev, x, y, scale);
+}
+
+// ================ BMP SUPPORT ================================================
+// Image input, rows in file order
+typedef struct {
+	FILE		*fhndl;			// file handler, NULL if the image is in memory
+	uint8_t		*membuff;		// memory buffer containing the image
+	uint8_t		*rdbuf;			// read buffer of file input, whole rows
+	int			data_pos;		// start of pixel data
+	int			row_len;		// bytes of pixels in a row
+	int			stride;			// bytes per row, padded to 4
+	int			rd_rows;		// rows fitting in the read buffer
+	int			first;			// first row in the read buffer
+	int			count;			// rows in the read buffer
+	int			next;			// row at the file position
+} BMPIODEV;
+
+// Pointer to the rows 'row' ~ 'row'+n-1, read ahead up to row 'end'-1 from a file
+//--------------------------------------------------------------------
+static uint8_t *_bmp_rows(BMPIODEV *dev, int row, int n, int end)
+{
+	if (dev->membuff) return dev->membuff + dev->data_pos + (row * dev->stride);
+
+	if ((row < dev->first) || ((row + n) > (dev->first + dev->count))) {
+		int count = dev->rd_rows;
+		if ((row + count) > end) count = end - row;
+		if (row != dev->next) {
+			if (fseek(dev->fhndl, dev->data_pos + (row * dev->stride), SEEK_SET) != 0) return NULL;
+		}
+		// the padding of the last row may be missing
+		int rd = fread(dev->rdbuf, 1, count * dev->stride, dev->fhndl);
+		if (rd < (((count - 1) * dev->stride) + dev->row_len)) return NULL;
+		dev->first = row;
+		dev->count = count;
+		dev->next = row + count;
+	}
+	return dev->rdbuf + ((row - dev->first) * dev->stride);
+}
+
+// RGB-888 of a BGR-888, RGB-565 or RGB-555 pixel
+//-----------------------------------------------------------------------------------------
+static inline void _bmp_pixel(const uint8_t *src, uint8_t bpp, uint8_t is565, uint8_t *rgb)
+{
+	if (bpp == 24) {
+		rgb[0] = src[2];
+		rgb[1] = src[1];
+		rgb[2] = src[0];
+	}
+	else {
+		uint16_t c = src[0] | (src[1] << 8);
+		uint8_t r, g, b = c & 0x1F;
+		if (is565) {
+			r = c >> 11;
+			g = (c >> 5) & 0x3F;
+			rgb[1] = (g << 2) | (g >> 4);
+		}
+		else {
+			r = (c >> 10) & 0x1F;
+			g = (c >> 5) & 0x1F;
+			rgb[1] = (g << 3) | (g >> 2);
+		}
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+}
+
+// One display line from the 'sp' image rows at 'src', each display pixel the average
+// of 'sp' x 'sp' image pixels. 'recip' is 2^24 / (sp*sp) rounded up: the average is exact
+// for the sums of up to 64 pixels and the product stays in 32 bits. 'sum' holds len*3 column sums.
+//----------------------------------------------------------------------------------------------------------------
+static void _bmp_line(uint8_t *dst, const uint8_t *src, int stride, int len, int sp, uint8_t bpp, uint8_t is565, uint32_t recip, uint16_t *sum)
+{
+	int pix = bpp / 8;
+	uint8_t rgb[3];
+
+	if (sp == 1) {
+		for (int n = 0; n < len; n++) {
+			_bmp_pixel(src, bpp, is565, dst);
+			dst[0] &= 0xFC;
+			dst[1] &= 0xFC;
+			dst[2] &= 0xFC;
+			src += pix;
+			dst += 3;
+		}
+		return;
+	}
+
+	memset(sum, 0, len * 3 * sizeof(uint16_t));
+	for (int line = 0; line < sp; line++) {
+		const uint8_t *s = src + (line * stride);
+		uint16_t *co = sum;
+		for (int n = 0; n < len; n++) {
+			if (bpp == 24) {
+				for (int col = 0; col < sp; col++) {
+					co[0] += s[2];
+					co[1] += s[1];
+					co[2] += s[0];
+					s += 3;
+				}
+			}
+			else {
+				for (int col = 0; col < sp; col++) {
+					_bmp_pixel(s, bpp, is565, rgb);
+					co[0] += rgb[0];
+					co[1] += rgb[1];
+					co[2] += rgb[2];
+					s += pix;
+				}
+			}
+			co += 3;
+		}
+	}
+	for (int n = 0; n < (len * 3); n++) dst[n] = ((sum[n] * recip) >> 24) & 0xFC;
+}
 
 //====================================================================================
 int TFT_bmp_image(int x, int y, uint8_t scale, char *fname, uint8_t *imgbuf, int size)
 {
-	FILE *fhndl = NULL;
+	BMPIODEV dev;
 	struct stat sb;
 	int i, err=0;
 	int img_xsize, img_ysize, img_xstart, img_xlen, img_ystart, img_ylen;
-	int img_pos, img_pix_pos, scan_lines, rd_len;
-	uint8_t tmpc;
+	int img_pos, hdr_size, bottom_up;
 	uint16_t wtemp;
-	uint32_t temp;
+	uint32_t temp, masks[3];
 	int disp_xstart, disp_xend, disp_ystart, disp_yend;
-	uint8_t buf[56];
+	uint8_t buf[66];
 	char err_buf[64];
 	uint8_t *line_buf[2] = {NULL,NULL};
 	uint8_t lb_idx = 0;
-	uint8_t *scale_buf = NULL;
-	uint8_t scale_pix;
-	uint16_t co[3] = {0,0,0};			// RGB sum
-	uint8_t npix;
+	uint16_t *sum_buf = NULL;
+	uint8_t scale_pix, bpp, is565 = 0;
+	int lines;			// display lines sent at once
 
+	memset(&dev, 0, sizeof(dev));
 	if (scale > 7) scale = 7;
 	scale_pix = scale+1;	// scale factor ( 1~8 )
 
@@ -2501,26 +3553,28 @@ int TFT_bmp_image(int x, int y, uint8_t scale, char *fname, uint8_t *imgbuf, int
     		goto exit;
     	}
     	size = sb.st_size;
-		fhndl = fopen(fname, "r");
-		if (!fhndl) {
+		dev.fhndl = fopen(fname, "r");
+		if (!dev.fhndl) {
 			sprintf(err_buf, "opening file");
 			err = -2;
 			goto exit;
 		}
 
-		i = fread(buf, 1, 54, fhndl);  // read header
+		i = fread(buf, 1, sizeof(buf), dev.fhndl);  // read header
+		if (i < 54) i = 0;
     }
     else {
     	// * Reading image from buffer
     	if ((imgbuf) && (size > 54)) {
-    		memcpy(buf, imgbuf, 54);
-    		i = 54;
+    		i = (size < sizeof(buf)) ? size : sizeof(buf);
+    		memcpy(buf, imgbuf, i);
     	}
     	else i = 0;
+    	dev.membuff = imgbuf;
     }
 
     sprintf(err_buf, "reading header");
-	if (i != 54) {err = -3;	goto exit;}
+	if (i < 54) {err = -3;	goto exit;}
 
 	// ** Check image header and get image properties
 	if ((buf[0] != 'B') || (buf[1] != 'M')) {err=-4; goto exit;} // accept only images with 'BM' id
@@ -2530,21 +3584,34 @@ int TFT_bmp_image(int x, int y, uint8_t scale, char *fname, uint8_t *imgbuf, int
 
 	memcpy(&img_pos, buf+10, 4);			// start of pixel data
 
-	memcpy(&temp, buf+14, 4);				// BMP header size
-	if (temp != 40) {err=-6; goto exit;}
+	memcpy(&hdr_size, buf+14, 4);			// BMP header size, info header or V4/V5 header
+	if ((hdr_size != 40) && (hdr_size != 108) && (hdr_size != 124)) {err=-6; goto exit;}
 
 	memcpy(&wtemp, buf+26, 2);				// the number of color planes
 	if (wtemp != 1) {err=-7; goto exit;}
 
 	memcpy(&wtemp, buf+28, 2);				// the number of bits per pixel
-	if (wtemp != 24) {err=-8; goto exit;}
+	if ((wtemp != 24) && (wtemp != 16)) {err=-8; goto exit;}
+	bpp = wtemp;
 
 	memcpy(&temp, buf+30, 4);				// the compression method being used
-	if (temp != 0) {err=-9; goto exit;}
+	if (temp == 3) {
+		// 16-bit with color masks following the info header, RGB-565 or RGB-555
+		memcpy(masks, buf+54, 12);
+		if ((bpp != 16) || (i < 66)) {err=-9; goto exit;}
+		if ((masks[0] == 0xF800) && (masks[1] == 0x07E0) && (masks[2] == 0x001F)) is565 = 1;
+		else if ((masks[0] != 0x7C00) || (masks[1] != 0x03E0) || (masks[2] != 0x001F)) {err=-9; goto exit;}
+	}
+	else if (temp != 0) {err=-9; goto exit;}	// uncompressed 16-bit is RGB-555
 
 	memcpy(&img_xsize, buf+18, 4);			// the bitmap width in pixels
-	memcpy(&img_ysize, buf+22, 4);			// the bitmap height in pixels
+	memcpy(&img_ysize, buf+22, 4);			// the bitmap height in pixels, negative if stored top to bottom
+	bottom_up = (img_ysize > 0);
+	if (img_ysize < 0) img_ysize = -img_ysize;
 
+	dev.data_pos = img_pos;
+	dev.row_len = img_xsize * (bpp / 8);
+	dev.stride = (dev.row_len + 3) & ~3;
 
 	// * scale image dimensions
 
@@ -2563,11 +3630,11 @@ int TFT_bmp_image(int x, int y, uint8_t scale, char *fname, uint8_t *imgbuf, int
 		goto exit;
 	}
 
-	// ** set display and image areas
+	// ** set display and image areas, in display pixels
 	if (x < dispWin.x1) {
 		disp_xstart = dispWin.x1;
-		img_xstart = -x;	// image pixel line X offset
-		img_xlen += x;
+		img_xstart = dispWin.x1 - x;	// image pixel line X offset
+		img_xlen -= img_xstart;
 	}
 	else {
 		disp_xstart = x;
@@ -2575,8 +3642,8 @@ int TFT_bmp_image(int x, int y, uint8_t scale, char *fname, uint8_t *imgbuf, int
 	}
 	if (y < dispWin.y1) {
 		disp_ystart = dispWin.y1;
-		img_ystart = -y;	// image pixel line Y offset
-		img_ylen += y;
+		img_ystart = dispWin.y1 - y;	// image pixel line Y offset
+		img_ylen -= img_ystart;
 	}
 	else {
 		disp_ystart = y;
@@ -2593,21 +3660,40 @@ int TFT_bmp_image(int x, int y, uint8_t scale, char *fname, uint8_t *imgbuf, int
 		img_ylen = disp_yend - disp_ystart + 1;
 	}
 
-	if ((img_xlen < 8) || (img_ylen < 8) || (img_xstart >= (img_xsize-2)) || ((img_ysize - img_ystart) < 2)) {
+	if ((img_xlen < 8) || (img_ylen < 8)) {
 		sprintf(err_buf, "image too small");
 		err = -11;
 		goto exit;
 	}
 
-	// ** Allocate memory for 2 lines of image pixels
-	line_buf[0] = heap_caps_malloc(img_xsize*3, MALLOC_CAP_DMA);
+	// ** Image rows used, in file order
+	int row_first, row_end;
+	if (bottom_up) {
+		row_first = img_ysize - ((img_ystart + img_ylen) * scale_pix);
+		row_end = img_ysize - (img_ystart * scale_pix);
+	}
+	else {
+		row_first = img_ystart * scale_pix;
+		row_end = (img_ystart + img_ylen) * scale_pix;
+	}
+	if ((img_pos + ((row_end - 1) * dev.stride) + dev.row_len) > size) {
+		sprintf(err_buf, "EOF reached: %d > %d", img_pos + (row_end * dev.stride), size);
+		err = -16;
+		goto exit;
+	}
+
+	// ** Allocate the display line buffers, one is filled while the other is sent
+	lines = BMP_IMAGE_BUF_SIZE / (img_xlen * 3);
+	if (lines < 1) lines = 1;
+	if (lines > img_ylen) lines = img_ylen;
+	line_buf[0] = heap_caps_malloc(lines * img_xlen * 3, MALLOC_CAP_DMA);
 	if (line_buf[0] == NULL) {
 	    sprintf(err_buf, "allocating line buffer #1");
 		err=-12;
 		goto exit;
 	}
 
-	line_buf[1] = heap_caps_malloc(img_xsize*3, MALLOC_CAP_DMA);
+	line_buf[1] = heap_caps_malloc(lines * img_xlen * 3, MALLOC_CAP_DMA);
 	if (line_buf[1] == NULL) {
 	    sprintf(err_buf, "allocating line buffer #2");
 		err=-13;
@@ -2615,140 +3701,97 @@ int TFT_bmp_image(int x, int y, uint8_t scale, char *fname, uint8_t *imgbuf, int
 	}
 
 	if (scale) {
-		// Allocate memory for scale buffer
-		rd_len = img_xlen * 3 * scale_pix;
-		scale_buf = malloc(rd_len*scale_pix);
-		if (scale_buf == NULL) {
+		// Allocate memory for the column sums
+		sum_buf = malloc(img_xlen * 3 * sizeof(uint16_t));
+		if (sum_buf == NULL) {
 			sprintf(err_buf, "allocating scale buffer");
 			err=-14;
 			goto exit;
 		}
 	}
-	else rd_len = img_xlen * 3;
-
-	// ** ***************************************************** **
-	// ** BMP images are stored in file from LAST to FIRST line **
-	// ** ***************************************************** **
-
-	/* Used variables:
-		img_xsize		horizontal image size in pixels
-		img_ysize		number of image lines
-		img_xlen 		image display horizontal scaled size in pixels
-		img_ylen		image display vertical scaled size in pixels
-		img_xstart		first pixel in line to be displayed
-		img_ystart		first image line to be displayed
-		img_xlen		number of pixels in image line to be displayed, starting with 'img_xstart'
-		img_ylen		number of lines in image to be displayed, starting with 'img_ystart'
-		rd_len			length of color data which are read from image line in bytes
-	 */
-
-	// Set position in image to the first color data (beginning of the LAST line)
-	img_pos += (img_ystart * (img_xsize*3));
-	if (fhndl) {
-		if (fseek(fhndl, img_pos, SEEK_SET) != 0) {
-			sprintf(err_buf, "file seek at %d", img_pos);
-			err = -15;
+
+	if (dev.fhndl) {
+		// Read as many whole rows at once as fit in the read buffer
+		dev.rd_rows = BMP_READ_BUF_SIZE / dev.stride;
+		if (dev.rd_rows < scale_pix) dev.rd_rows = scale_pix;
+		if (dev.rd_rows > (row_end - row_first)) dev.rd_rows = row_end - row_first;
+		dev.rdbuf = malloc(dev.rd_rows * dev.stride);
+		if (dev.rdbuf == NULL) {
+			sprintf(err_buf, "allocating read buffer");
+			err=-15;
 			goto exit;
 		}
+		dev.next = -1;
 	}
 
-	if (image_debug) printf("BMP: image size: (%d,%d) scale: %d disp size: (%d,%d) img xofs: %d img yofs: %d at: %d,%d; line buf: 2* %d scale buf: %d\r\n",
-			img_xsize, img_ysize, scale_pix, img_xlen, img_ylen, img_xstart, img_ystart, disp_xstart, disp_ystart, img_xsize*3, ((scale) ? (rd_len*scale_pix) : 0));
+	if (image_debug) printf("BMP: image size: (%d,%d) %d-bit scale: %d disp size: (%d,%d) img xofs: %d img yofs: %d at: %d,%d; line buf: 2* %d read buf: %d\r\n",
+			img_xsize, img_ysize, bpp, scale_pix, img_xlen, img_ylen, img_xstart, img_ystart, disp_xstart, disp_ystart,
+			lines * img_xlen * 3, dev.rd_rows * dev.stride);
+
+	// Reciprocal of the box area for the average
+	uint32_t recip = ((1 << 24) + (scale_pix * scale_pix) - 1) / (scale_pix * scale_pix);
+	int pix_ofs = img_xstart * scale_pix * (bpp / 8);
 
 	// * Select the display
 	disp_select();
 
-	while ((disp_yend >= disp_ystart) && ((img_pos + (img_xsize*3)) <= size)) {
-		if (img_pos > size) {
-			sprintf(err_buf, "EOF reached: %d > %d", img_pos, size);
-			err = -16;
-			goto exit1;
-		}
-		if (scale == 0) {
-			// Read the line of color data into color buffer
-			if (fhndl) {
-				i = fread(line_buf[lb_idx], 1, img_xsize*3, fhndl);  // read line from file
-				if (i != (img_xsize*3)) {
-					sprintf(err_buf, "file read at %d (%d<>%d)", img_pos, i, img_xsize*3);
-					err = -16;
-					goto exit1;
-				}
-			}
-			else memcpy(line_buf[lb_idx], imgbuf+img_pos, img_xsize*3);
-
-			if (img_xstart > 0)	memmove(line_buf[lb_idx], line_buf[lb_idx]+(img_xstart*3), rd_len);
-			// Convert colors BGR-888 (BMP) -> RGB-888 (DISPLAY) ===
-			for (i=0; i < rd_len; i += 3) {
-				tmpc = line_buf[lb_idx][i+2] & 0xfc;				// save R
-				line_buf[lb_idx][i+2] = line_buf[lb_idx][i] & 0xfc;	// B -> R
-				line_buf[lb_idx][i] = tmpc;							// R -> B
-				line_buf[lb_idx][i+1] &= 0xfc;						// G
-			}
-			img_pos += (img_xsize*3);
+	// ** BMP images are usually stored from the LAST to the FIRST line,
+	// ** the display lines are sent in file order, 'lines' at once
+	int disp_first = disp_ystart;	// display lines in the line buffer
+	int disp_last = disp_ystart;
+	for (int row = row_first; row < row_end; row += scale_pix) {
+		int disp_y;
+		if (bottom_up) disp_y = disp_ystart + ((row_end - row) / scale_pix) - 1;
+		else disp_y = disp_ystart + ((row - row_first) / scale_pix);
+
+		if (row == row_first) {
+			disp_first = (bottom_up) ? disp_y - lines + 1 : disp_y;
+			if (disp_first < disp_ystart) disp_first = disp_ystart;
+			disp_last = disp_first + lines - 1;
+			if (disp_last > disp_yend) disp_last = disp_yend;
 		}
-		else {
-			// scale image, read 'scale_pix' lines and find the average color
-			for (scan_lines=0; scan_lines<scale_pix; scan_lines++) {
-				if (img_pos > size) break;
-				if (fhndl) {
-					i = fread(line_buf[lb_idx], 1, img_xsize*3, fhndl);  // read line from file
-					if (i != (img_xsize*3)) {
-						sprintf(err_buf, "file read at %d (%d<>%d)", img_pos, i, img_xsize*3);
-						err = -17;
-						goto exit1;
-					}
-				}
-				else memcpy(line_buf[lb_idx], imgbuf+img_pos, img_xsize*3);
-				img_pos += (img_xsize*3);
 
-				// copy only data which are displayed to scale buffer
-				memcpy(scale_buf + (rd_len * scan_lines), line_buf[lb_idx]+img_xstart, rd_len);
+		uint8_t *src = _bmp_rows(&dev, row, scale_pix, row_end);
+		if (src == NULL) {
+			sprintf(err_buf, "file read at %d", img_pos + (row * dev.stride));
+			err = -17;
+			goto exit1;
+		}
+		_bmp_line(line_buf[lb_idx] + ((disp_y - disp_first) * img_xlen * 3), src + pix_ofs, dev.stride, img_xlen,
+				scale_pix, bpp, is565, recip, sum_buf);
+
+		if (disp_y == ((bottom_up) ? disp_first : disp_last)) {
+			wait_trans_finish(0);
+			send_data(disp_xstart, disp_first, disp_xend, disp_last, img_xlen * (disp_last - disp_first + 1), (color_t *)line_buf[lb_idx]);
+			lb_idx = (lb_idx + 1) & 1;  // change buffer
+
+			// next display lines
+			if (bottom_up) {
+				disp_last = disp_first - 1;
+				disp_first = disp_last - lines + 1;
+				if (disp_first < disp_ystart) disp_first = disp_ystart;
 			}
-
-			// Populate display line buffer
-			for (int n=0;n<(img_xlen*3);n += 3) {
-				memset(co, 0, sizeof(co));	// initialize color sum
-				npix = 0;					// initialize number of pixels in scale rectangle
-
-				// sum all pixels in scale rectangle
-				for (int sc_line=0; sc_line<scan_lines; sc_line++) {
-					// Get colors position in scale buffer
-					img_pix_pos = (rd_len * sc_line) + (n * scale_pix);
-
-					for (int sc_col=0; sc_col<scale_pix; sc_col++) {
-						co[0] += scale_buf[img_pix_pos];
-						co[1] += scale_buf[img_pix_pos + 1];
-						co[2] += scale_buf[img_pix_pos + 2];
-						npix++;
-					}
-				}
-				// Place the average in display buffer, convert BGR-888 (BMP) -> RGB-888 (DISPLAY)
-				line_buf[lb_idx][n+2] = (uint8_t)(co[0] / npix);	// B
-				line_buf[lb_idx][n+1] = (uint8_t)(co[1] / npix);	// G
-				line_buf[lb_idx][n] = (uint8_t)(co[2] / npix);		// R
+			else {
+				disp_first = disp_last + 1;
+				disp_last = disp_first + lines - 1;
+				if (disp_last > disp_yend) disp_last = disp_yend;
 			}
 		}
-
-		wait_trans_finish(1);
-		send_data(disp_xstart, disp_yend, disp_xend, disp_yend, img_xlen, (color_t *)line_buf[lb_idx]);
-		lb_idx = (lb_idx + 1) & 1;  // change buffer
-
-		disp_yend--;
 	}
 	err = 0;
 exit1:
 	disp_deselect();
 exit:
-	if (scale_buf) free(scale_buf);
+	if (sum_buf) free(sum_buf);
 	if (line_buf[0]) free(line_buf[0]);
 	if (line_buf[1]) free(line_buf[1]);
-	if (fhndl) fclose(fhndl);
+	if (dev.rdbuf) free(dev.rdbuf);
+	if (dev.fhndl) fclose(dev.fhndl);
 	if ((err) && (image_debug)) printf("Error: %d [%s]\r\n", err, err_buf);
 
 	return err;
 }
 
-
 // ============= Touch panel functions =========================================
 
 #if USE_TOUCH == TOUCH_TYPE_XPT2046
@@ -26,9 +26,22 @@ typedef struct {
     uint16_t	size;
 	uint8_t 	max_x_size;
     uint8_t     bitmap;
+	uint8_t		bpp;		// bits per pixel of proportional font glyphs, 2 or 4 for anti-aliased fonts
 	color_t     color;
 } Font;
 
+// Reads up to 'len' bytes of image data to 'buf'
+// Returns the number of bytes read, 0 or less at the end of the data
+typedef int (*imageRead_t)(void *ctx, uint8_t *buf, int len);
+
+// Rendered glyph cache counters
+typedef struct {
+	uint32_t	hits;
+	uint32_t	misses;
+	uint32_t	evictions;
+	uint32_t	bytes;		// DMA memory used by the cached glyphs
+} glyphCacheStats_t;
+
 
 //==========================================================================================
 // ==== Global variables ===================================================================
@@ -58,8 +71,32 @@ extern uint32_t tp_caly;			// touch screen Y calibration constant
 
 // Buffer is created during jpeg decode for sending data
 // Total size of the buffer is  2 * (JPG_IMAGE_LINE_BUF_SIZE * 3)
+// Decoded blocks of the same block row are collected in one buffer while the other is sent
 // The size must be multiple of 256 bytes !!
-#define JPG_IMAGE_LINE_BUF_SIZE 512
+#define JPG_IMAGE_LINE_BUF_SIZE 1024
+
+// Read-ahead buffer of jpeg file and stream input, in bytes
+#define JPG_INPUT_BUF_SIZE 4096
+
+// Size of each of the two DMA buffers of display lines sent during bmp decode, in bytes
+#define BMP_IMAGE_BUF_SIZE 4096
+
+// Read buffer of bmp file input, whole image rows, in bytes
+#define BMP_READ_BUF_SIZE 8192
+
+// Maximum size of the buffer used to send a line of text in one transaction, in bytes
+#define TFT_TEXT_LINE_BUF_SIZE 8192
+
+// Memory budget of the rendered glyph cache in bytes, 0 disables the cache
+#ifdef CONFIG_TFT_GLYPH_CACHE_SIZE
+#define TFT_GLYPH_CACHE_SIZE CONFIG_TFT_GLYPH_CACHE_SIZE
+#else
+#define TFT_GLYPH_CACHE_SIZE 8192
+#endif
+#define TFT_GLYPH_CACHE_ENTRIES 48
+
+// Label of the data partition holding the font store
+#define TFT_FONT_STORE_LABEL "fonts"
 
 // --- Constants for ellipse function ---
 #define TFT_ELLIPSE_UPPER_RIGHT 0x01
@@ -126,6 +163,10 @@ extern const color_t TFT_PINK;
 #define FONT_7SEG		9
 #define USER_FONT		10  // font will be read from file
 
+// Anti-aliased proportional fonts have 2 or 4 bits per pixel in the third header byte
+// and this ID in the fourth; their glyph pixels are packed like the 1 bit ones
+#define TFT_FONT_AA_ID	0x41
+
 
 
 // ===== PUBLIC FUNCTIONS =========================================================================
@@ -415,8 +456,19 @@ void TFT_drawArc(uint16_t cx, uint16_t cy, uint16_t r, uint16_t th, float start,
 void TFT_drawPolygon(int cx, int cy, int sides, int diameter, color_t color, color_t fill, int deg, uint8_t th);
 
 
+/*
+ * Draw five pointed star on screen
+ *
+ * Params:
+ *        cx: star center X position
+ *        cy: star center Y position
+ *  diameter: diameter of the circle through the outer points
+ *     color: star color
+ *      fill: fill the star if true, otherwise draw the outline
+ *    factor: ratio of the outer to the inner points diameter; 1.0 ~ 4.0
+*/
 //--------------------------------------------------------------------------------------
-//void TFT_drawStar(int cx, int cy, int diameter, color_t color, bool fill, float factor);
+void TFT_drawStar(int cx, int cy, int diameter, color_t color, bool fill, float factor);
 
 
 /*
@@ -434,6 +486,25 @@ void TFT_drawPolygon(int cx, int cy, int sides, int diameter, color_t color, col
 //----------------------------------------------------
 void TFT_setFont(uint8_t font, const char *font_file);
 
+/*
+ * Get the rendered glyph cache counters.
+ *
+ * Characters printed with buffered, non transparent fonts are kept
+ * rendered in DMA capable memory, keyed by font, character and colors,
+ * up to TFT_GLYPH_CACHE_SIZE bytes. The least recently used glyphs are evicted.
+ *
+ * Params:
+ *		stats: pointer to returned counters
+ */
+//-----------------------------------------------------
+void TFT_getGlyphCacheStats(glyphCacheStats_t *stats);
+
+/*
+ * Free all cached glyphs and reset the counters
+ */
+//------------------------
+void TFT_clearGlyphCache();
+
 /*
  * Returns current font height & width in pixels.
  *
@@ -482,6 +553,48 @@ int TFT_getfontheight();
 //-------------------------------------
 void TFT_print(char *st, int x, int y);
 
+/*
+ * Show text too long for one line by rolling it up through a one line window
+ * with the display's hardware vertical scrolling.
+ *
+ * The text is split at spaces into lines of the display window width and
+ * rendered once with the current font and colors. Each TFT_marqueeStep() moves
+ * the window up by one pixel row with a scroll register write and sends only the
+ * row coming in at the bottom, the whole text comes back after the last line.
+ * Lines are separated by 'font_line_space' rows.
+ * The scrolled rows span the full display width; anything drawn in them scrolls too.
+ * Only one marquee can run, in the portrait orientations, with non rotated bitmap fonts.
+ * Text which fits on one line is just printed.
+ *
+ * Params:
+ *	   st:	pointer to null terminated string, '\n' starts a new line
+ *		x:	horizontal position of each line in the window; CENTER or RIGHT can be used
+ *		y:	vertical position of the window in pixels
+ *
+ * Returns:
+ * 		0 on success
+ * 		-1 if the marquee cannot be shown
+ */
+//-------------------------------------------
+int TFT_marqueeStart(char *st, int x, int y);
+
+/*
+ * Scroll the marquee up by one pixel row
+ *
+ * Returns:
+ * 		1 if a text line is now fully shown, or the text fits on one line
+ * 		0 if not
+ * 		-1 if there is no marquee
+ */
+//---------------------
+int TFT_marqueeStep();
+
+/*
+ * Stop scrolling; the marquee window keeps showing the same rows
+ */
+//---------------------
+void TFT_marqueeStop();
+
 /*
  * Set atributes for 7 segment vector font
  * == 7 segment font must be the current font to this function to have effect ==
@@ -620,9 +733,27 @@ color_t HSBtoRGB(float _hue, float _sat, float _brightness);
 //-----------------------------------------------------------------------------------
 void TFT_jpg_image(int x, int y, uint8_t scale, char *fname, uint8_t *buf, int size);
 
+/*
+ * Decodes and displays JPG image read from a stream, as it arrives
+ * Same limits as TFT_jpg_image()
+ * Album art can be decoded straight from an HTTP response, with a 'read' function
+ * calling esp_http_client_read() on the open client.
+ *
+ * Params:
+ *       x: image left position; constants CENTER & RIGHT can be used; negative value is accepted
+ *       y: image top position;  constants CENTER & BOTTOM can be used; negative value is accepted
+ *   scale: image scale factor: 0~3; if scale>0, image is scaled by factor 1/(2^scale) (1/2, 1/4 or 1/8)
+ *    read: function called for more image data, may return less than asked
+ *     ctx: passed to 'read'
+ *
+ */
+//-----------------------------------------------------------------------------------
+void TFT_jpg_stream(int x, int y, uint8_t scale, imageRead_t read, void *ctx);
+
 /*
  * Decodes and displays BMP image
- * Only uncompressed RGB 24-bit with no color space information BMP images can be displayed
+ * Only uncompressed RGB 24-bit and 16-bit (RGB-555, or RGB-565 with color masks) BMP images can be displayed
+ * Scaled images are box filtered, every display pixel is the average of the image pixels it covers
  *
  * Params:
  *       x: image left position; constants CENTER & RIGHT can be used; negative value is accepted
@@ -671,6 +802,36 @@ int TFT_read_touch(int *x, int* y, uint8_t raw);
 //------------------------------------------------
 int compile_font_file(char *fontfile, uint8_t dbg);
 
+/*
+ * Add the font file to the font store, if it is not there with the same size and modification time.
+ *
+ * Font files selected with TFT_setFont(USER_FONT, ...) are copied once, checked,
+ * into the TFT_FONT_STORE_LABEL flash partition and used in place from the memory mapped flash.
+ * Selecting a stored font again needs no heap and reads no file; the check result is kept too.
+ * Without the partition fonts are loaded from the file into the heap on every selection.
+ *
+ * Params:
+ *		fontfile: pointer to font file name, less than 40 characters
+ *			info: if set to 1, prints font information when the font is checked
+ *
+ * Returns:
+ * 		0 on success
+ * 		-1 if there is no font store
+ * 		err no if the font file cannot be read (1, 5) or is not a valid font (6, 7)
+ */
+//--------------------------------------------------------
+int TFT_fontStoreAdd(const char *fontfile, uint8_t info);
+
+/*
+ * Erase all fonts from the font store
+ *
+ * Returns:
+ * 		0 on success
+ * 		-1 if there is no font store
+ */
+//---------------------------
+int TFT_fontStoreErase(void);
+
 /*
  * Get all font's characters to buffer
  */
@@ -33,6 +33,9 @@ int _height = DEFAULT_TFT_DISPLAY_HEIGHT;
 // Display type, DISP_TYPE_ILI9488 or DISP_TYPE_ILI9341
 uint8_t tft_disp_type = DEFAULT_DISP_TYPE;
 
+// Pixel format sent to the display, DISP_COLOR_BITS_24 or DISP_COLOR_BITS_16
+uint8_t tft_color_bits = DISP_COLOR_BITS_24;
+
 // Spi device handles for display and touch screen
 spi_lobo_device_handle_t disp_spi = NULL;
 spi_lobo_device_handle_t ts_spi = NULL;
@@ -40,8 +43,40 @@ spi_lobo_device_handle_t ts_spi = NULL;
 // ====================================================
 
 
-static color_t *trans_cline = NULL;
 static uint8_t _dma_sending = 0;
+static uint8_t _pixel_bytes = 3;	// bytes per pixel on the bus
+static uint8_t _madctl = 0;			// orientation last set
+static int _scroll_top = -1;		// scroll window in frame memory lines, -1 if not scrolling
+static int _scroll_height = 0;
+
+// ==== Frame buffer ====
+#define TFT_FB_MAX_RECTS	16		// changed rectangles remembered between flushes
+#define TFT_FB_RECT_PIXELS	32		// pixels taking as long to send as starting a rectangle
+
+typedef struct {
+	int16_t x1, y1, x2, y2;
+} fb_rect_t;
+
+static uint16_t *_fb = NULL;				// RGB565 screen, _width pixels per row
+static fb_rect_t _fb_rects[TFT_FB_MAX_RECTS];
+static int _fb_nrects = 0;
+static tft_fb_stats_t _fb_stats;
+
+// ==== Line buffers of packed pixels ====
+#define TFT_WIRE_BUF_SIZE	4092	// bytes in each, whole 16 and 18-bit pixels
+
+static uint8_t *_wire_buf[2] = {NULL, NULL};	// DMA buffers, one is filled while the other is sent
+static uint32_t _wire_size = 0;					// bytes in each of them
+static uint8_t _wire_cur = 0;					// the one to fill next
+
+// ==== Spans of the primitive being drawn, one color ====
+#define TFT_SPAN_QUEUE	16
+
+static fb_rect_t _span_queue[TFT_SPAN_QUEUE];	// rows, columns or pixels not sent yet, oldest first
+static int _span_count = 0;
+static uint8_t _span_active = 0;
+static color_t _span_color;
+static fb_rect_t _span_win;						// address window last sent, x1,y1 -1 if not known
 
 // RGB to GRAYSCALE constants
 // 0.2989  0.5870  0.1140
@@ -53,15 +88,12 @@ static uint8_t _dma_sending = 0;
 
 // ==== Functions =====================
 
+// 'free_line' is not used any more, the line buffers are kept
 //------------------------------------------------------
 esp_err_t IRAM_ATTR wait_trans_finish(uint8_t free_line)
 {
 	// Wait for SPI bus ready
 	while (disp_spi->host->hw->cmd.usr);
-	if ((free_line) && (trans_cline)) {
-		free(trans_cline);
-		trans_cline = NULL;
-	}
 	if (_dma_sending) {
 	    //Tell common code DMA workaround that our DMA channel is idle. If needed, the code will do a DMA reset.
 	    if (disp_spi->host->dma_chan) spi_lobo_dmaworkaround_idle(disp_spi->host->dma_chan);
@@ -173,17 +205,22 @@ void IRAM_ATTR disp_spi_transfer_cmd_data(int8_t cmd, uint8_t *data, uint32_t le
     if (bits > 0) _spi_transfer_start(disp_spi, bits, 0);
 }
 
-// Set the address window for display write & read commands, display must be selected
-//---------------------------------------------------------------------------------------------------
-static void IRAM_ATTR disp_spi_transfer_addrwin(uint16_t x1, uint16_t x2, uint16_t y1, uint16_t y2) {
-	uint32_t wd;
+// Parameter word of a column or page address command, as loaded to the SPI buffer
+//---------------------------------------------------------------
+static inline uint32_t IRAM_ATTR _addr_word(uint16_t s, uint16_t e)
+{
+	return (uint32_t)(s>>8) | ((uint32_t)(s&0xff) << 8) | ((uint32_t)(e>>8) << 16) | ((uint32_t)(e&0xff) << 24);
+}
 
-    taskDISABLE_INTERRUPTS();
+// Send CASET or PASET with its parameter word, display must be selected
+//--------------------------------------------------------
+static void IRAM_ATTR _addr_send(uint8_t cmd, uint32_t wd)
+{
 	// Wait for SPI bus ready
 	while (disp_spi->host->hw->cmd.usr);
     gpio_set_level(PIN_NUM_DC, 0);
 
-	disp_spi->host->hw->data_buf[0] = (uint32_t)TFT_CASET;
+	disp_spi->host->hw->data_buf[0] = (uint32_t)cmd;
 	disp_spi->host->hw->user.usr_mosi_highpart = 0;
 	disp_spi->host->hw->mosi_dlen.usr_mosi_dbitlen = 7;
 	disp_spi->host->hw->user.usr_mosi = 1;
@@ -192,35 +229,20 @@ static void IRAM_ATTR disp_spi_transfer_addrwin(uint16_t x1, uint16_t x2, uint16
 
 	disp_spi->host->hw->cmd.usr = 1; // Start transfer
 
-	wd = (uint32_t)(x1>>8);
-	wd |= (uint32_t)(x1&0xff) << 8;
-	wd |= (uint32_t)(x2>>8) << 16;
-	wd |= (uint32_t)(x2&0xff) << 24;
-
 	while (disp_spi->host->hw->cmd.usr); // wait transfer end
 	gpio_set_level(PIN_NUM_DC, 1);
 	disp_spi->host->hw->data_buf[0] = wd;
 	disp_spi->host->hw->mosi_dlen.usr_mosi_dbitlen = 31;
 	disp_spi->host->hw->cmd.usr = 1; // Start transfer
-
-    while (disp_spi->host->hw->cmd.usr);
-    gpio_set_level(PIN_NUM_DC, 0);
-    disp_spi->host->hw->data_buf[0] = (uint32_t)TFT_PASET;
-	disp_spi->host->hw->mosi_dlen.usr_mosi_dbitlen = 7;
-	disp_spi->host->hw->cmd.usr = 1; // Start transfer
-
-	wd = (uint32_t)(y1>>8);
-	wd |= (uint32_t)(y1&0xff) << 8;
-	wd |= (uint32_t)(y2>>8) << 16;
-	wd |= (uint32_t)(y2&0xff) << 24;
-
 	while (disp_spi->host->hw->cmd.usr);
-	gpio_set_level(PIN_NUM_DC, 1);
+}
 
-	disp_spi->host->hw->data_buf[0] = wd;
-	disp_spi->host->hw->mosi_dlen.usr_mosi_dbitlen = 31;
-	disp_spi->host->hw->cmd.usr = 1; // Start transfer
-	while (disp_spi->host->hw->cmd.usr);
+// Set the address window for display write & read commands, display must be selected
+//---------------------------------------------------------------------------------------------------
+static void IRAM_ATTR disp_spi_transfer_addrwin(uint16_t x1, uint16_t x2, uint16_t y1, uint16_t y2) {
+    taskDISABLE_INTERRUPTS();
+	_addr_send(TFT_CASET, _addr_word(x1, x2));
+	_addr_send(TFT_PASET, _addr_word(y1, y2));
     taskENABLE_INTERRUPTS();
 }
 
@@ -239,10 +261,127 @@ static color_t IRAM_ATTR color2gs(color_t color)
     return _color;
 }
 
+// ==== Frame buffer drawing ==========================================
+
+// RGB565 value of the color, as kept in the frame buffer and sent in 16-bit mode
+//----------------------------------------------------
+static inline uint16_t IRAM_ATTR _color565(color_t color)
+{
+	return ((color.r & 0xF8) << 8) | ((color.g & 0xFC) << 3) | (color.b >> 3);
+}
+
+// Color of the frame buffer pixel, the components extended to 8 bits as the panel does
+//----------------------------------------------------
+static inline color_t IRAM_ATTR _fb_pixel(uint16_t c)
+{
+	uint8_t r = c >> 11, g = (c >> 5) & 0x3F, b = c & 0x1F;
+	return (color_t){ (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) };
+}
+
+//--------------------------------------------
+static int _fb_area(const fb_rect_t *r)
+{
+	return (r->x2 - r->x1 + 1) * (r->y2 - r->y1 + 1);
+}
+
+//----------------------------------------------------------------
+static fb_rect_t _fb_union(const fb_rect_t *a, const fb_rect_t *b)
+{
+	fb_rect_t u;
+	u.x1 = (a->x1 < b->x1) ? a->x1 : b->x1;
+	u.y1 = (a->y1 < b->y1) ? a->y1 : b->y1;
+	u.x2 = (a->x2 > b->x2) ? a->x2 : b->x2;
+	u.y2 = (a->y2 > b->y2) ? a->y2 : b->y2;
+	return u;
+}
+
+// Pixels sent in vain if both rectangles are sent as one, less the cost of starting another rectangle.
+// Not more than 0 if they are better merged.
+//---------------------------------------------------------------
+static int _fb_merge_cost(const fb_rect_t *a, const fb_rect_t *b)
+{
+	fb_rect_t u = _fb_union(a, b);
+	int iw = ((a->x2 < b->x2) ? a->x2 : b->x2) - ((a->x1 > b->x1) ? a->x1 : b->x1) + 1;
+	int ih = ((a->y2 < b->y2) ? a->y2 : b->y2) - ((a->y1 > b->y1) ? a->y1 : b->y1) + 1;
+	int common = ((iw > 0) && (ih > 0)) ? iw * ih : 0;
+
+	return _fb_area(&u) - (_fb_area(a) + _fb_area(b) - common) - TFT_FB_RECT_PIXELS;
+}
+
+// Remember a changed rectangle, merged with the ones it is cheaper to send together with
+//-------------------------------------------------------
+static void _fb_mark(int x1, int y1, int x2, int y2)
+{
+	fb_rect_t r = { x1, y1, x2, y2 };
+	int i = 0;
+
+	while (i < _fb_nrects) {
+		if (_fb_merge_cost(&_fb_rects[i], &r) <= 0) {
+			// the merged rectangle may reach the ones already checked
+			r = _fb_union(&_fb_rects[i], &r);
+			_fb_rects[i] = _fb_rects[--_fb_nrects];
+			i = 0;
+		}
+		else i++;
+	}
+	if (_fb_nrects < TFT_FB_MAX_RECTS) {
+		_fb_rects[_fb_nrects++] = r;
+		return;
+	}
+	// no room, merge with the one costing least
+	int best = 0, best_cost = _fb_merge_cost(&_fb_rects[0], &r);
+	for (i = 1; i < _fb_nrects; i++) {
+		int cost = _fb_merge_cost(&_fb_rects[i], &r);
+		if (cost < best_cost) {
+			best = i;
+			best_cost = cost;
+		}
+	}
+	_fb_rects[best] = _fb_union(&_fb_rects[best], &r);
+}
+
+// Write 'len' colors to the frame buffer window (x1,y1),(x2,y2) the way the display
+// memory write does, from 'buf' or 'buf[0]' repeated if 'rep' is set.
+// Only the rectangle around the pixels that changed is marked for sending.
+//-----------------------------------------------------------------------------------------------
+static void IRAM_ATTR _fb_write(int x1, int y1, int x2, int y2, color_t *buf, uint32_t len, uint8_t rep)
+{
+	int cx1 = _width, cy1 = _height, cx2 = -1, cy2 = -1;
+	int x = x1, y = y1;
+	uint16_t c = _color565(buf[0]);
+
+	while (len) {
+		uint32_t n = x2 - x + 1;
+		if (n > len) n = len;
+		if ((y >= 0) && (y < _height)) {
+			uint16_t *row = _fb + (y * _width);
+			for (int i = 0; i < n; i++) {
+				if ((x + i < 0) || (x + i >= _width)) continue;
+				if (!rep) c = _color565(buf[i]);
+				if (row[x + i] == c) continue;
+				row[x + i] = c;
+				if ((x + i) < cx1) cx1 = x + i;
+				if ((x + i) > cx2) cx2 = x + i;
+				if (y < cy1) cy1 = y;
+				cy2 = y;
+			}
+		}
+		if (!rep) buf += n;
+		len -= n;
+		x = x1;
+		if (++y > y2) y = y1;
+	}
+	if (cx2 >= 0) _fb_mark(cx1, cy1, cx2, cy2);
+}
+
 // Set display pixel at given coordinates to given color
 //------------------------------------------------------------------------
 void IRAM_ATTR drawPixel(int16_t x, int16_t y, color_t color, uint8_t sel)
 {
+	if (_fb) {
+		_fb_write(x, y, x, y, &color, 1, 1);
+		return;
+	}
 	if (!(disp_spi->cfg.flags & LB_SPI_DEVICE_HALFDUPLEX)) return;
 
 	if (sel) {
@@ -264,15 +403,22 @@ void IRAM_ATTR drawPixel(int16_t x, int16_t y, color_t color, uint8_t sel)
 	disp_spi->host->hw->cmd.usr = 1;		// Start transfer
 	while (disp_spi->host->hw->cmd.usr);	// Wait for SPI bus ready
 
-	wd = (uint32_t)_color.r;
-	wd |= (uint32_t)_color.g << 8;
-	wd |= (uint32_t)_color.b << 16;
+	if (_pixel_bytes == 2) {
+		uint16_t c = _color565(_color);
+		wd = (uint32_t)(c >> 8);
+		wd |= (uint32_t)(c & 0xFF) << 8;
+	}
+	else {
+		wd = (uint32_t)_color.r;
+		wd |= (uint32_t)_color.g << 8;
+		wd |= (uint32_t)_color.b << 16;
+	}
 
     // Set DC to 1 (data mode);
 	gpio_set_level(PIN_NUM_DC, 1);
 
 	disp_spi->host->hw->data_buf[0] = wd;
-	disp_spi->host->hw->mosi_dlen.usr_mosi_dbitlen = 23;
+	disp_spi->host->hw->mosi_dlen.usr_mosi_dbitlen = (_pixel_bytes * 8) - 1;
 	disp_spi->host->hw->cmd.usr = 1;		// Start transfer
 	while (disp_spi->host->hw->cmd.usr);	// Wait for SPI bus ready
 
@@ -298,61 +444,97 @@ static void IRAM_ATTR _dma_send(uint8_t *data, uint32_t size)
 	disp_spi->host->hw->cmd.usr = 1;
 }
 
+// Pack 'len' colors to the pixel format of the bus, gray scale applied
+//-----------------------------------------------------------------------------
+static void IRAM_ATTR _pack_colors(uint8_t *dst, const color_t *src, uint32_t len)
+{
+	if (_pixel_bytes == 2) {
+		for (uint32_t i = 0; i < len; i++) {
+			uint16_t c = _color565((gray_scale) ? color2gs(src[i]) : src[i]);
+			*dst++ = c >> 8;
+			*dst++ = c & 0xFF;
+		}
+	}
+	else {
+		for (uint32_t i = 0; i < len; i++) {
+			color_t c = (gray_scale) ? color2gs(src[i]) : src[i];
+			*dst++ = c.r;
+			*dst++ = c.g;
+			*dst++ = c.b;
+		}
+	}
+}
+
+// Allocate the line buffers of packed pixels on first use
+// Returns 0 on success, -1 if there is not enough memory
+//---------------------
+static int _wire_alloc()
+{
+	if (_wire_buf[0]) return 0;
+
+	uint32_t size = TFT_WIRE_BUF_SIZE;
+	if ((disp_spi->host->max_transfer_sz > 0) && (size > disp_spi->host->max_transfer_sz)) {
+		size = disp_spi->host->max_transfer_sz - (disp_spi->host->max_transfer_sz % 6);
+	}
+	_wire_buf[0] = heap_caps_malloc(size, MALLOC_CAP_DMA);
+	_wire_buf[1] = heap_caps_malloc(size, MALLOC_CAP_DMA);
+	if ((_wire_buf[0] == NULL) || (_wire_buf[1] == NULL)) {
+		free(_wire_buf[0]);
+		free(_wire_buf[1]);
+		_wire_buf[0] = _wire_buf[1] = NULL;
+		return -1;
+	}
+	_wire_size = size;
+	return 0;
+}
+
+// Send the first 'size' bytes of the line buffer just filled, when the previous transfer ends.
+// The other buffer is filled next
+//---------------------------------------------
+static void IRAM_ATTR _wire_send(uint32_t size)
+{
+	wait_trans_finish(0);
+	_dma_send(_wire_buf[_wire_cur], size);
+	_wire_cur ^= 1;
+}
+
+// Send up to 64 bytes of pixels from the SPI buffer
 //---------------------------------------------------------------------------
 static void IRAM_ATTR _direct_send(color_t *color, uint32_t len, uint8_t rep)
 {
-	uint32_t cidx = 0;	// color buffer index
-	uint32_t wd = 0;
-	int idx = 0;
-	int bits = 0;
-	int wbits = 0;
+	uint8_t data[64+3];
+	uint32_t size = len * _pixel_bytes;
 
-    taskDISABLE_INTERRUPTS();
-	color_t _color = color[0];
-	if ((rep) && (gray_scale)) _color = color2gs(color[0]);
-
-	while (len) {
-		// ** Get color data from color buffer **
-		if (rep == 0) {
-			if (gray_scale) _color = color2gs(color[cidx]);
-			else _color = color[cidx];
-		}
+	if (rep) {
+		_pack_colors(data, color, 1);
+		for (uint32_t i = _pixel_bytes; i < size; i++) data[i] = data[i - _pixel_bytes];
+	}
+	else _pack_colors(data, color, len);
 
-		wd |= (uint32_t)_color.r << wbits;
-		wbits += 8;
-		if (wbits == 32) {
-			bits += wbits;
-			wbits = 0;
-			disp_spi->host->hw->data_buf[idx++] = wd;
-			wd = 0;
-		}
-		wd |= (uint32_t)_color.g << wbits;
-		wbits += 8;
-		if (wbits == 32) {
-			bits += wbits;
-			wbits = 0;
-			disp_spi->host->hw->data_buf[idx++] = wd;
-			wd = 0;
-		}
-		wd |= (uint32_t)_color.b << wbits;
-		wbits += 8;
-		if (wbits == 32) {
-			bits += wbits;
-			wbits = 0;
-			disp_spi->host->hw->data_buf[idx++] = wd;
-			wd = 0;
-		}
-    	len--;					// Decrement colors counter
-        if (rep == 0) cidx++;	// if not repeating color, increment color buffer index
-    }
-	if (bits) {
-		while (disp_spi->host->hw->cmd.usr);						// Wait for SPI bus ready
-		disp_spi->host->hw->mosi_dlen.usr_mosi_dbitlen = bits-1;	// set number of bits to be sent
-        disp_spi->host->hw->cmd.usr = 1;							// Start transfer
+    taskDISABLE_INTERRUPTS();
+	while (disp_spi->host->hw->cmd.usr);							// Wait for SPI bus ready
+	for (uint32_t i = 0; i < size; i += 4) {
+		disp_spi->host->hw->data_buf[i >> 2] = (uint32_t)data[i] | ((uint32_t)data[i+1] << 8) |
+				((uint32_t)data[i+2] << 16) | ((uint32_t)data[i+3] << 24);
 	}
+	disp_spi->host->hw->mosi_dlen.usr_mosi_dbitlen = (size * 8) - 1;	// set number of bits to be sent
+	disp_spi->host->hw->cmd.usr = 1;									// Start transfer
     taskENABLE_INTERRUPTS();
 }
 
+// Send RAM WRITE command and switch to data mode, the address window must be set
+//---------------------------------------------
+static void IRAM_ATTR _ram_write_start()
+{
+    gpio_set_level(PIN_NUM_DC, 0);
+    disp_spi->host->hw->data_buf[0] = (uint32_t)TFT_RAMWR;
+	disp_spi->host->hw->mosi_dlen.usr_mosi_dbitlen = 7;
+	disp_spi->host->hw->cmd.usr = 1;		// Start transfer
+	while (disp_spi->host->hw->cmd.usr);	// Wait for SPI bus ready
+
+	gpio_set_level(PIN_NUM_DC, 1);			// Set DC to 1 (data mode);
+}
+
 // ================================================================
 // === Main function to send data to display ======================
 // If  rep==true:  repeat sending color data to display 'len' times
@@ -365,22 +547,15 @@ static void IRAM_ATTR _TFT_pushColorRep(color_t *color, uint32_t len, uint8_t re
 	if (len == 0) return;
 	if (!(disp_spi->cfg.flags & LB_SPI_DEVICE_HALFDUPLEX)) return;
 
-	// Send RAM WRITE command
-    gpio_set_level(PIN_NUM_DC, 0);
-    disp_spi->host->hw->data_buf[0] = (uint32_t)TFT_RAMWR;
-	disp_spi->host->hw->mosi_dlen.usr_mosi_dbitlen = 7;
-	disp_spi->host->hw->cmd.usr = 1;		// Start transfer
-	while (disp_spi->host->hw->cmd.usr);	// Wait for SPI bus ready
-
-	gpio_set_level(PIN_NUM_DC, 1);								// Set DC to 1 (data mode);
+	_ram_write_start();
 
-	if ((len*24) <= 512) {
+	if ((len * _pixel_bytes) <= 64) {
 
 		_direct_send(color, len, rep);
 
 	}
-	else if (rep == 0)  {
-		// ==== use DMA transfer ====
+	else if ((rep == 0) && (_pixel_bytes == 3)) {
+		// ==== use DMA transfer from the color buffer ====
 		// ** Prepare data
 		if (gray_scale) {
 			for (int n=0; n<len; n++) {
@@ -388,47 +563,49 @@ static void IRAM_ATTR _TFT_pushColorRep(color_t *color, uint32_t len, uint8_t re
 			}
 	    }
 
-	    _dma_send((uint8_t *)color, len*3);
-	}
-	else {
-		// ==== Repeat color, more than 512 bits total ====
-
-		color_t _color;
-		uint32_t buf_colors;
-		int buf_bytes, to_send;
-
-		/*
-		to_send = len;
-		while (to_send > 0) {
+		// no more than the DMA descriptors of the bus take at once
+		uint8_t *data = (uint8_t *)color;
+		uint32_t max_size = (disp_spi->host->max_transfer_sz > 0) ? disp_spi->host->max_transfer_sz : len*3;
+		for (uint32_t to_send = len*3; to_send > 0; ) {
+			uint32_t size = (to_send > max_size) ? max_size : to_send;
 			wait_trans_finish(0);
-			_direct_send(color, ((to_send > 21) ? 21 : to_send), rep);
-			to_send -= 21;
+			_dma_send(data, size);
+			data += size;
+			to_send -= size;
 		}
-		*/
-
-		buf_colors = ((len > (_width*2)) ? (_width*2) : len);
-		buf_bytes = buf_colors * 3;
-
-		// Prepare color buffer of maximum 2 color lines
-		trans_cline = heap_caps_malloc(buf_bytes, MALLOC_CAP_DMA);
-		if (trans_cline == NULL) return;
-
-		// Prepare fill color
-		if (gray_scale) _color = color2gs(color[0]);
-		else _color = color[0];
-
-		// Fill color buffer with fill color
-		for (uint32_t i=0; i<buf_colors; i++) {
-			trans_cline[i] = _color;
+	}
+	else if (rep == 0) {
+		// ==== pack the colors once, to one line buffer while the other is sent ====
+		if (_wire_alloc()) return;
+
+		uint32_t buf_colors = _wire_size / _pixel_bytes;
+		while (len) {
+			uint32_t n = (len > buf_colors) ? buf_colors : len;
+			_pack_colors(_wire_buf[_wire_cur], color, n);
+			_wire_send(n * _pixel_bytes);
+			color += n;
+			len -= n;
 		}
-
-		// Send 'len' colors
-		to_send = len;
-		while (to_send > 0) {
+	}
+	else {
+		// ==== Repeat color, more than 64 bytes total ====
+		if (_wire_alloc()) return;
+
+		// Fill the line buffer with the packed fill color
+		uint8_t *buf = _wire_buf[_wire_cur];
+		uint32_t buf_colors = _wire_size / _pixel_bytes;
+		if (buf_colors > len) buf_colors = len;
+		_pack_colors(buf, color, 1);
+		for (uint32_t i = _pixel_bytes; i < (buf_colors * _pixel_bytes); i++) buf[i] = buf[i - _pixel_bytes];
+
+		// Send 'len' colors, the same buffer every time
+		for (uint32_t to_send = len; to_send > 0; ) {
+			uint32_t n = (to_send > buf_colors) ? buf_colors : to_send;
 			wait_trans_finish(0);
-			_dma_send((uint8_t *)trans_cline, ((to_send > buf_colors) ? buf_bytes : (to_send*3)));
-			to_send -= buf_colors;
+			_dma_send(buf, n * _pixel_bytes);
+			to_send -= n;
 		}
+		_wire_cur ^= 1;
 	}
 
 	if (wait) wait_trans_finish(1);
@@ -438,6 +615,10 @@ static void IRAM_ATTR _TFT_pushColorRep(color_t *color, uint32_t len, uint8_t re
 //-------------------------------------------------------------------------------------------
 void IRAM_ATTR TFT_pushColorRep(int x1, int y1, int x2, int y2, color_t color, uint32_t len)
 {
+	if (_fb) {
+		_fb_write(x1, y1, x2, y2, &color, len, 1);
+		return;
+	}
 	if (disp_select() != ESP_OK) return;
 
 	// ** Send address window **
@@ -453,11 +634,107 @@ void IRAM_ATTR TFT_pushColorRep(int x1, int y1, int x2, int y2, color_t color, u
 //-----------------------------------------------------------------------------------
 void IRAM_ATTR send_data(int x1, int y1, int x2, int y2, uint32_t len, color_t *buf)
 {
+	if (_fb) {
+		_fb_write(x1, y1, x2, y2, buf, len, 0);
+		return;
+	}
 	// ** Send address window **
 	disp_spi_transfer_addrwin(x1, x2, y1, y2);
 	_TFT_pushColorRep(buf, len, 0, 0);
 }
 
+// ==== Span batching ===========================================
+
+// Adds the span to a queued one if they touch on the same row or column.
+// Returns 1 if it is merged or already covered
+//-------------------------------------------------------------
+static int _span_merge(fb_rect_t *q, const fb_rect_t *r)
+{
+	if ((r->x1 >= q->x1) && (r->x2 <= q->x2) && (r->y1 >= q->y1) && (r->y2 <= q->y2)) return 1;
+
+	if ((q->y1 == q->y2) && (r->y1 == q->y1) && (r->y2 == q->y1) && (r->x1 <= (q->x2 + 1)) && (r->x2 >= (q->x1 - 1))) {
+		if (r->x1 < q->x1) q->x1 = r->x1;
+		if (r->x2 > q->x2) q->x2 = r->x2;
+		return 1;
+	}
+	if ((q->x1 == q->x2) && (r->x1 == q->x1) && (r->x2 == q->x1) && (r->y1 <= (q->y2 + 1)) && (r->y2 >= (q->y1 - 1))) {
+		if (r->y1 < q->y1) q->y1 = r->y1;
+		if (r->y2 > q->y2) q->y2 = r->y2;
+		return 1;
+	}
+	return 0;
+}
+
+// Send the oldest queued span.
+// The address window is sent only where it differs from the last one: a row needs
+// the exact columns, a column the exact column, and the start is enough for the rest
+//-----------------------------------
+static void IRAM_ATTR _span_send()
+{
+	fb_rect_t r = _span_queue[0];
+	uint32_t len = _fb_area(&r);
+
+	_span_count--;
+	memmove(&_span_queue[0], &_span_queue[1], _span_count * sizeof(fb_rect_t));
+
+	if (_fb) {
+		_fb_write(r.x1, r.y1, r.x2, r.y2, &_span_color, len, 1);
+		return;
+	}
+
+	wait_trans_finish(0);
+	if ((r.x1 != _span_win.x1) || ((len > 1) && (r.x2 != _span_win.x2))) {
+		_addr_send(TFT_CASET, _addr_word(r.x1, r.x2));
+		_span_win.x1 = r.x1;
+		_span_win.x2 = r.x2;
+	}
+	if ((r.y1 != _span_win.y1) || (r.y2 > _span_win.y2)) {
+		// rows down to the bottom, so later spans starting on the same row need no new PASET
+		_addr_send(TFT_PASET, _addr_word(r.y1, _height-1));
+		_span_win.y1 = r.y1;
+		_span_win.y2 = _height-1;
+	}
+	_TFT_pushColorRep(&_span_color, len, 1, 0);
+}
+
+//=======================================
+int IRAM_ATTR TFT_spanBegin(color_t color)
+{
+	if (_span_active) TFT_spanEnd();
+	if (_fb == NULL) {
+		if (!(disp_spi->cfg.flags & LB_SPI_DEVICE_HALFDUPLEX)) return -1;
+		if (disp_select() != ESP_OK) return -1;
+	}
+	_span_color = color;
+	_span_count = 0;
+	_span_win.x1 = _span_win.y1 = -1;
+	_span_active = 1;
+	return 0;
+}
+
+//===================================================
+void IRAM_ATTR TFT_spanAdd(int x1, int y1, int x2, int y2)
+{
+	if (!_span_active) return;
+
+	fb_rect_t r = { x1, y1, x2, y2 };
+	for (int i = _span_count-1; i >= 0; i--) {
+		if (_span_merge(&_span_queue[i], &r)) return;
+	}
+	if (_span_count == TFT_SPAN_QUEUE) _span_send();
+	_span_queue[_span_count++] = r;
+}
+
+//=========================
+void IRAM_ATTR TFT_spanEnd()
+{
+	if (!_span_active) return;
+
+	while (_span_count) _span_send();
+	_span_active = 0;
+	if (_fb == NULL) disp_deselect();
+}
+
 // Reads 'len' pixels/colors from the TFT's GRAM 'window'
 // 'buf' is an array of bytes with 1st byte reserved for reading 1 dummy byte
 // and the rest is actually an array of color_t values
@@ -470,6 +747,20 @@ int IRAM_ATTR read_data(int x1, int y1, int x2, int y2, int len, uint8_t *buf, u
     memset(&t, 0, sizeof(t));  //Zero out the transaction
 	memset(buf, 0, len*sizeof(color_t));
 
+	if (_fb) {
+		// the window in the frame buffer, after the dummy byte
+		color_t *color = (color_t *)(buf + 1);
+		int x = x1, y = y1;
+		for (int i = 0; i < len; i++) {
+			if ((x >= 0) && (y >= 0) && (x < _width) && (y < _height)) color[i] = _fb_pixel(_fb[(y * _width) + x]);
+			if (++x > x2) {
+				x = x1;
+				if (++y > y2) y = y1;
+			}
+		}
+		return ESP_OK;
+	}
+
 	if (set_sp) {
 		if (disp_deselect() != ESP_OK) return -1;
 		// Change spi clock if needed
@@ -483,6 +774,7 @@ int IRAM_ATTR read_data(int x1, int y1, int x2, int y2, int len, uint8_t *buf, u
 	disp_spi_transfer_addrwin(x1, x2, y1, y2);
 
     // ** GET pixels/colors **
+	// 3 bytes per pixel also in 16-bit mode, the display reads 18-bit colors
 	disp_spi_transfer_cmd(TFT_RAMRD);
 
     t.length=0;                //Send nothing
@@ -518,6 +810,110 @@ color_t IRAM_ATTR readPixel(int16_t x, int16_t y)
 	return color;
 }
 
+// ==== Frame buffer ===================================================
+
+// Send a rectangle of the frame buffer, display must be selected.
+// The pixels are packed to one line buffer while the other one is sent.
+// Returns the number of bytes sent
+//-----------------------------------------------------------
+static uint32_t IRAM_ATTR _fb_send_rect(const fb_rect_t *r)
+{
+	uint32_t len = _fb_area(r);
+	uint32_t buf_colors = _wire_size / _pixel_bytes;
+	int w = r->x2 - r->x1 + 1;
+	int x = 0;
+	const uint16_t *src = _fb + (r->y1 * _width) + r->x1;
+
+	wait_trans_finish(0);
+	disp_spi_transfer_addrwin(r->x1, r->x2, r->y1, r->y2);
+	_ram_write_start();
+
+	for (uint32_t to_send = len; to_send > 0; ) {
+		uint32_t n = (to_send > buf_colors) ? buf_colors : to_send;
+		uint8_t *line = _wire_buf[_wire_cur];
+
+		for (uint32_t i = 0; i < n; i++) {
+			if ((_pixel_bytes == 2) && (gray_scale == 0)) {
+				*line++ = src[x] >> 8;
+				*line++ = src[x] & 0xFF;
+			}
+			else {
+				color_t c = _fb_pixel(src[x]);
+				_pack_colors(line, &c, 1);
+				line += _pixel_bytes;
+			}
+			if (++x == w) {
+				x = 0;
+				src += _width;
+			}
+		}
+		_wire_send(n * _pixel_bytes);
+		to_send -= n;
+	}
+	// CASET, PASET and RAMWR with their parameters
+	return 11 + (len * _pixel_bytes);
+}
+
+//===========================
+int TFT_fbInit(uint32_t caps)
+{
+	if (_fb) return 0;
+	if (_wire_alloc()) return -1;
+
+	_fb = heap_caps_malloc(_width * _height * sizeof(uint16_t), caps);
+	if (_fb == NULL) return -1;
+	memset(_fb, 0, _width * _height * sizeof(uint16_t));
+	_fb_nrects = 0;
+	_fb_mark(0, 0, _width-1, _height-1);
+	memset(&_fb_stats, 0, sizeof(_fb_stats));
+	return 0;
+}
+
+//===================
+void TFT_fbDeinit()
+{
+	if (_fb == NULL) return;
+	TFT_fbFlush();
+	free(_fb);
+	_fb = NULL;
+	_fb_nrects = 0;
+}
+
+//=================
+int TFT_fbFlush()
+{
+	uint32_t bytes = 0;
+
+	if ((_fb == NULL) || (_fb_nrects == 0)) return 0;
+	if (disp_select() != ESP_OK) return 0;
+
+	for (int i = 0; i < _fb_nrects; i++) {
+		bytes += _fb_send_rect(&_fb_rects[i]);
+	}
+	disp_deselect();
+
+	_fb_stats.flushes++;
+	_fb_stats.rects += _fb_nrects;
+	_fb_stats.last_rects = _fb_nrects;
+	_fb_stats.last_bytes = bytes;
+	if (bytes > _fb_stats.max_bytes) _fb_stats.max_bytes = bytes;
+	_fb_stats.bytes += bytes;
+	_fb_nrects = 0;
+	return bytes;
+}
+
+//==============================================
+void TFT_fbGetStats(tft_fb_stats_t *stats)
+{
+	*stats = _fb_stats;
+}
+
+//=======================
+void TFT_fbResetStats()
+{
+	memset(&_fb_stats, 0, sizeof(_fb_stats));
+}
+
 // get 16-bit data from touch controller for specified type
 // ** Touch device must already be selected **
 //----------------------------------------
@@ -893,6 +1289,11 @@ void _tft_setRotation(uint8_t rot) {
 	uint8_t madctl = 0;
 	uint16_t tmp;
 
+	// the scroll window is in frame memory lines of the old orientation
+	TFT_resetScrollWindow();
+	// pending drawing is for the old orientation too
+	TFT_fbFlush();
+
     if ((rotation & 1)) {
         // in landscape modes must be width > height
         if (_width < _height) {
@@ -976,7 +1377,80 @@ void _tft_setRotation(uint8_t rot) {
 			disp_deselect();
 		}
 	}
+	_madctl = madctl;
 
+	if (_fb) {
+		// the frame buffer rows change, start again from a black screen
+		memset(_fb, 0, _width * _height * sizeof(uint16_t));
+		_fb_nrects = 0;
+		_fb_mark(0, 0, _width-1, _height-1);
+	}
+}
+
+// Vertical scrolling moves whole frame memory lines, which are display rows only
+// if rows and columns are not exchanged; with MADCTL_MY they are counted from the bottom
+//============================================
+int TFT_setScrollWindow(int y, int height) {
+	if ((_madctl & MADCTL_MV) || (y < 0) || (height < 1) || ((y + height) > _height)) return -1;
+
+	int top = (_madctl & MADCTL_MY) ? _height - y - height : y;
+	uint8_t vscrdef[6] = {
+		top >> 8, top & 0xFF,
+		height >> 8, height & 0xFF,
+		(_height - top - height) >> 8, (_height - top - height) & 0xFF
+	};
+	if (disp_select() != ESP_OK) return -1;
+	disp_spi_transfer_cmd_data(TFT_VSCRDEF, vscrdef, 6);
+	disp_deselect();
+
+	_scroll_top = top;
+	_scroll_height = height;
+	TFT_scrollWindow(0);
+	return 0;
+}
+
+//=================================
+void TFT_scrollWindow(int offset) {
+	if (_scroll_top < 0) return;
+
+	offset %= _scroll_height;
+	if (offset < 0) offset += _scroll_height;
+	if ((_madctl & MADCTL_MY) && (offset)) offset = _scroll_height - offset;
+
+	int start = _scroll_top + offset;
+	uint8_t vscrsadd[2] = { start >> 8, start & 0xFF };
+	if (disp_select() == ESP_OK) {
+		disp_spi_transfer_cmd_data(TFT_VSCRSADD, vscrsadd, 2);
+		disp_deselect();
+	}
+}
+
+//============================
+void TFT_resetScrollWindow() {
+	uint8_t vscrdef[6] = { 0, 0, _height >> 8, _height & 0xFF, 0, 0 };
+
+	if (_scroll_top < 0) return;
+	_scroll_top = -1;
+	if (disp_select() == ESP_OK) {
+		disp_spi_transfer_cmd_data(TFT_VSCRDEF, vscrdef, 6);
+		disp_spi_transfer_cmd(TFT_CMD_NORON);
+		disp_deselect();
+	}
+}
+
+//=========================================
+int TFT_setColorBits(uint8_t color_bits) {
+	if ((color_bits != DISP_COLOR_BITS_24) && (color_bits != DISP_COLOR_BITS_16)) return -1;
+	// ILI9488 has no 16-bit pixel format on the SPI interface
+	if ((color_bits == DISP_COLOR_BITS_16) && (tft_disp_type == DISP_TYPE_ILI9488)) return -1;
+
+	if (disp_select() != ESP_OK) return -1;
+	disp_spi_transfer_cmd_data(TFT_CMD_PIXFMT, &color_bits, 1);
+	disp_deselect();
+
+	tft_color_bits = color_bits;
+	_pixel_bytes = (color_bits == DISP_COLOR_BITS_16) ? 2 : 3;
+	return 0;
 }
 
 //=================
@@ -1061,6 +1535,8 @@ void TFT_display_init()
     ret = disp_deselect();
 	assert(ret==ESP_OK);
 
+	TFT_setColorBits(DEFAULT_COLOR_BITS);
+
 	// Clear screen
     _tft_setRotation(PORTRAIT);
 	TFT_pushColorRep(0, 0, _width-1, _height-1, (color_t){0,0,0}, (uint32_t)(_height*_width));
@@ -143,6 +143,7 @@
 #define DEFAULT_TFT_DISPLAY_WIDTH   240
 #define DEFAULT_TFT_DISPLAY_HEIGHT  320
 #define DISP_COLOR_BITS_24          0x66
+#define DEFAULT_COLOR_BITS          DISP_COLOR_BITS_16
 #define DEFAULT_GAMMA_CURVE         0
 #define DEFAULT_SPI_CLOCK           26000000
 #define TFT_INVERT_ROTATION         0
@@ -169,7 +170,6 @@
 // Configuration for other boards, set the correct values for the display used
 //----------------------------------------------------------------------------
 #define DISP_COLOR_BITS_24	0x66
-//#define DISP_COLOR_BITS_16	0x55  // Do not use!
 
 // #############################################
 // ### Set to 1 for some displays,           ###
@@ -228,6 +228,13 @@
 
 #endif  // CONFIG_EXAMPLE_ESP_WROVER_KIT
 
+// RGB565 pixels, 2 bytes instead of 3 on the bus; not on ILI9488
+#define DISP_COLOR_BITS_16	0x55
+
+#ifndef DEFAULT_COLOR_BITS
+#define DEFAULT_COLOR_BITS	DISP_COLOR_BITS_24
+#endif
+
 // ##############################################################
 // #### Global variables                                     ####
 // ##############################################################
@@ -245,6 +252,9 @@ extern int _height;
 // ==== Display type, DISP_TYPE_ILI9488 or DISP_TYPE_ILI9341 ====
 extern uint8_t tft_disp_type;
 
+// ==== Pixel format, DISP_COLOR_BITS_24 or DISP_COLOR_BITS_16 ==
+extern uint8_t tft_color_bits;
+
 // ==== Spi device handles for display and touch screen =========
 extern spi_lobo_device_handle_t disp_spi;
 extern spi_lobo_device_handle_t ts_spi;
@@ -259,6 +269,16 @@ typedef struct __attribute__((__packed__)) {
 	uint8_t b;
 } color_t ;
 
+// Frame buffer flush counters, see TFT_fbGetStats()
+typedef struct {
+	uint32_t flushes;		// flushes that sent anything
+	uint32_t rects;			// rectangles sent by all flushes
+	uint32_t last_rects;	// rectangles sent by the last flush
+	uint32_t last_bytes;	// bytes sent by the last flush, commands included
+	uint32_t max_bytes;		// most bytes sent by one flush
+	uint64_t bytes;			// bytes sent by all flushes
+} tft_fb_stats_t;
+
 // ==== Display commands constants ====
 #define TFT_INVOFF     0x20
 #define TFT_INVONN     0x21
@@ -266,6 +286,8 @@ typedef struct __attribute__((__packed__)) {
 #define TFT_DISPON     0x29
 #define TFT_MADCTL	   0x36
 #define TFT_PTLAR 	   0x30
+#define TFT_VSCRDEF	   0x33
+#define TFT_VSCRSADD   0x37
 #define TFT_ENTRYM 	   0xB7
 
 #define TFT_CMD_NOP			0x00
@@ -668,6 +690,15 @@ int read_data(int x1, int y1, int x2, int y2, int len, uint8_t *buf, uint8_t set
 color_t readPixel(int16_t x, int16_t y);
 int touch_get_data(uint8_t type);
 
+// Draw a primitive as spans of one color, all sent in one chip select.
+// TFT_spanAdd() takes a clipped row, column or pixel; touching spans on the same
+// row or column are joined before they are sent. TFT_spanEnd() sends the rest.
+// Returns 0 on success, -1 if the display can not be selected
+//=====================================
+int TFT_spanBegin(color_t color);
+void TFT_spanAdd(int x1, int y1, int x2, int y2);
+void TFT_spanEnd();
+
 
 // Deactivate display's CS line
 //========================
@@ -689,6 +720,54 @@ uint32_t find_rd_speed();
 //=================================
 void _tft_setRotation(uint8_t rot);
 
+// Hardware vertical scrolling of the display rows y .. y+height-1 (VSCRDEF).
+// Rows outside the window do not move; drawing inside it goes to the frame memory
+// as if it was not scrolled. Only in the portrait orientations.
+// Returns 0 on success, -1 if the window can not be scrolled
+//==========================================
+int TFT_setScrollWindow(int y, int height);
+
+// Show the scroll window moved up by 'offset' rows (VSCRSADD);
+// the rows moved out at the top come back at the bottom
+//================================
+void TFT_scrollWindow(int offset);
+
+// Stop scrolling, the display shows the frame memory as written
+//===========================
+void TFT_resetScrollWindow();
+
+// Set the pixel format on the bus, DISP_COLOR_BITS_24 (18-bit colors, 3 bytes per pixel)
+// or DISP_COLOR_BITS_16 (RGB565, 2 bytes per pixel). Colors are still given as color_t.
+// Returns 0 on success, -1 if the display does not support the format
+//=========================================
+int TFT_setColorBits(uint8_t color_bits);
+
+// Draw into an RGB565 frame buffer of the screen instead of the display.
+// 'caps' selects the memory, MALLOC_CAP_SPIRAM or MALLOC_CAP_INTERNAL.
+// All drawing functions write to the frame buffer and remember the changed
+// rectangles, TFT_fbFlush() sends them. The frame buffer starts black and is
+// sent whole by the first flush, also after a rotation change.
+// Returns 0 on success, -1 if there is not enough memory
+//===========================
+int TFT_fbInit(uint32_t caps);
+
+// Send the pending changes and draw to the display again
+//===================
+void TFT_fbDeinit();
+
+// Send the changed rectangles of the frame buffer to the display,
+// nearby ones merged, using DMA from two line buffers.
+// Returns the number of bytes sent, 0 if nothing changed or the frame buffer is not used
+//=================
+int TFT_fbFlush();
+
+// Flush counters since the frame buffer was initialized or the counters were cleared
+//==============================================
+void TFT_fbGetStats(tft_fb_stats_t *stats);
+
+//=======================
+void TFT_fbResetStats();
+
 // Initialize all pins used by display driver
 // ** MUST be executed before SPI interface initialization
 //=================
@@ -0,0 +1,105 @@
+/*
+ * Fused DSP chain for the radio output
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+*/
+
+#include <string.h>
+#include "esp_log.h"
+#include "i2s_stream.h"
+#include "esp_equalizer.h"
+#include "esp_alc.h"
+#include "dsp_chain.h"
+
+static const char *TAG = "DSP_CHAIN";
+
+typedef struct {
+    bool            enabled;
+    void            *eq_handle;
+    int             rate;
+    int             channels;
+    int             gain[DSP_CHAIN_EQ_BANDS * 2];
+    volatile bool   gain_dirty;
+    void            *alc_handle;
+    int             alc_volume;
+} dsp_chain_t;
+
+static dsp_chain_t dsp;
+
+static void dsp_chain_apply_gain(void)
+{
+    for (int i = 0; i < DSP_CHAIN_EQ_BANDS; i++) {
+        esp_equalizer_set_band_value(dsp.eq_handle, dsp.gain[i], i, 0);
+        if (dsp.channels == 2) {
+            esp_equalizer_set_band_value(dsp.eq_handle, dsp.gain[DSP_CHAIN_EQ_BANDS + i], i, 1);
+        }
+    }
+}
+
+static int dsp_chain_eq_process(uint8_t *buf, int len, audio_element_info_t *info, void *ctx)
+{
+    if (!dsp.enabled || info->bits != 16) {
+        return ESP_OK;
+    }
+    // Rebuild the filters when the decoder reports a new format
+    if (dsp.eq_handle == NULL || info->sample_rates != dsp.rate || info->channels != dsp.channels) {
+        if (dsp.eq_handle) {
+            esp_equalizer_uninit(dsp.eq_handle);
+        }
+        dsp.rate = info->sample_rates;
+        dsp.channels = info->channels;
+        dsp.eq_handle = esp_equalizer_init(dsp.channels, dsp.rate, DSP_CHAIN_EQ_BANDS, 0);
+        if (dsp.eq_handle == NULL) {
+            ESP_LOGE(TAG, "Equalizer init failed, rate %d, ch %d", dsp.rate, dsp.channels);
+            return ESP_FAIL;
+        }
+        dsp.gain_dirty = true;
+    }
+    if (dsp.gain_dirty) {
+        dsp.gain_dirty = false;
+        dsp_chain_apply_gain();
+    }
+    esp_equalizer_process(dsp.eq_handle, buf, len, dsp.rate, dsp.channels);
+    return ESP_OK;
+}
+
+static int dsp_chain_alc_process(uint8_t *buf, int len, audio_element_info_t *info, void *ctx)
+{
+    if (!dsp.enabled || info->bits != 16) {
+        return ESP_OK;
+    }
+    alc_volume_setup_process(buf, len, info->channels, dsp.alc_handle, dsp.alc_volume);
+    return ESP_OK;
+}
+
+esp_err_t dsp_chain_init(audio_element_handle_t i2s_stream, const int *eq_gain, int alc_volume)
+{
+    memcpy(dsp.gain, eq_gain, sizeof(dsp.gain));
+    dsp.gain_dirty = true;
+    dsp.alc_volume = alc_volume;
+    dsp.alc_handle = alc_volume_setup_open();
+    if (dsp.alc_handle == NULL) {
+        ESP_LOGE(TAG, "ALC open failed");
+        return ESP_FAIL;
+    }
+    // A callback left registered by a failed init stays a no-op, the caller falls back to elements
+    if (i2s_stream_add_process_cb(i2s_stream, dsp_chain_eq_process, NULL) != ESP_OK
+        || i2s_stream_add_process_cb(i2s_stream, dsp_chain_alc_process, NULL) != ESP_OK) {
+        ESP_LOGE(TAG, "Add process callback failed");
+        alc_volume_setup_close(dsp.alc_handle);
+        dsp.alc_handle = NULL;
+        return ESP_FAIL;
+    }
+    dsp.enabled = true;
+    return ESP_OK;
+}
+
+void dsp_chain_set_eq_gain(int band, int gain)
+{
+    if (band < 0 || band >= DSP_CHAIN_EQ_BANDS) {
+        return;
+    }
+    dsp.gain[band] = gain;
+    dsp.gain[DSP_CHAIN_EQ_BANDS + band] = gain;
+    dsp.gain_dirty = true;
+}
@@ -0,0 +1,43 @@
+/*
+ * Fused DSP chain for the radio output
+
+   Runs the equalizer and ALC as in-place callbacks inside the i2s_stream writer,
+   instead of as separate pipeline elements with their own task and ringbuffer.
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+*/
+
+#ifndef _DSP_CHAIN_H_
+#define _DSP_CHAIN_H_
+
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DSP_CHAIN_EQ_BANDS      (10)
+
+/**
+ * @brief      Register the equalizer and ALC callbacks on an i2s writer stream.
+ *             Must be called before the pipeline is run.
+ *
+ * @param      i2s_stream   The i2s element handle
+ * @param      eq_gain      Initial gains in dB, DSP_CHAIN_EQ_BANDS per channel for 2 channels
+ * @param      alc_volume   ALC volume in dB
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t dsp_chain_init(audio_element_handle_t i2s_stream, const int *eq_gain, int alc_volume);
+
+/**
+ * @brief      Set the gain of one equalizer band on both channels.
+ *             Takes effect at the start of the next buffer.
+ */
+void dsp_chain_set_eq_gain(int band, int gain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
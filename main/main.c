@@ -19,6 +19,7 @@
 #include "freertos/timers.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
+#include "esp_system.h"
 #include "nvs_flash.h"
 #include "sdkconfig.h"
 #include "audio_element.h"
@@ -41,12 +42,15 @@
 #include "periph_button.h"
 #include "equalizer.h"
 #include "audio_alc.h"
+#include "dsp_chain.h"
 
 
 #include "led_strip/led_strip.h"
+#include "led_strip/led_effect.h"
 
 #if CONFIG_EXAMPLE_DISPLAY_TYPE > 0
 #define SPI_BUS TFT_HSPI_HOST
+#include "esp_heap_caps.h"
 #include "tft.h"
 #include "tftspi.h"
 #endif
@@ -67,6 +71,10 @@
 #define PRESSET_RADIO 1
 #define VOLUME_MUTED 10
 #define ALC_VOLUME_SET (0)
+#define CODEC_VOLUME_STEP 10
+#define DSP_STATS_PERIOD_MS 10000
+#define MARQUEE_ROW_MS 40
+#define MARQUEE_DWELL_MS 2500
 TimerHandle_t xTimer;
 uint8_t busy = 0;
 static const char *TAG = "INTERNET_RADIO_EXAMPLE";
@@ -127,6 +135,18 @@ struct led_strip_t led_strip = {
     .led_strip_buf_2 = led_strip_buf_2,
     .led_strip_length = LED_STRIP_LENGTH
 };
+#ifdef CONFIG_LED_EFFECT_ENGINE
+struct led_effect_t led_effect = {
+    .led_strip = &led_strip,
+#if CONFIG_SIMPLE_VU == 1
+    .mode = LED_EFFECT_VU,
+#else
+    .mode = LED_EFFECT_PULSE,
+#endif
+    .fps = CONFIG_LED_EFFECT_FPS,
+    .brightness = CONFIG_LED_EFFECT_BRIGHTNESS,
+};
+#endif
 
 
 #define RADIO_COUNT (sizeof(radio)/sizeof(char*))/2
@@ -139,7 +159,8 @@ int radio_index=0;
 #ifdef FORMAT_MP3
      mp3_decoder,
 #endif     
-	 equalizer,alc_el, http_stream_reader;
+	 equalizer,alc_el,
+	 http_stream_reader;
 				
     audio_board_handle_t board_handle;
     audio_event_iface_handle_t evt;
@@ -147,9 +168,35 @@ int radio_index=0;
 
 
 static uint8_t curent_radio;
+/* false when the fused chain is off or failed to start, then the equalizer and alc run as elements */
+static bool dsp_fused;
+static int pipeline_elements;
 static uint8_t tune_request = 255;
+/* set by the touch timer, the bar is drawn by the event loop which owns the display */
+static volatile bool volume_changed;
 
 #if CONFIG_EXAMPLE_DISPLAY_TYPE > 0
+static TickType_t marquee_next;
+
+/*
+ * Steps are paced by the tick count, the event loop wakes up every 10 or 100 ms and on events.
+ * A line which comes fully into view is held for MARQUEE_DWELL_MS.
+ */
+static void marquee_update(void)
+{
+	TickType_t now = xTaskGetTickCount();
+	// after a long stall (tuning) start pacing again instead of rolling the backlog at once
+	if ((int32_t)(now - marquee_next) > MARQUEE_DWELL_MS / portTICK_PERIOD_MS) marquee_next = now;
+	while ((int32_t)(now - marquee_next) >= 0) {
+		int ret = TFT_marqueeStep();
+		if (ret < 0) {
+			marquee_next = now + MARQUEE_ROW_MS / portTICK_PERIOD_MS;
+			break;
+		}
+		marquee_next += (ret == 1 ? MARQUEE_DWELL_MS : MARQUEE_ROW_MS) / portTICK_PERIOD_MS;
+	}
+}
+
 static const char *file_fonts[3] = {"/spiffs/fonts/DotMatrix_M.fon", "/spiffs/fonts/Ubuntu.fon", "/spiffs/fonts/Grotesk24x48.fon"};
 #endif
 static void disp_volume(int volume){
@@ -160,10 +207,12 @@ static void disp_volume(int volume){
 	_bg = (color_t){ 64, 64, 64 };
 	if (_width < 240) TFT_setFont(DEF_SMALL_FONT, NULL);
 	else TFT_setFont(DEFAULT_FONT, NULL);
-	TFT_fillRect(1, _height-TFT_getfontheight()-8, _width-2 , TFT_getfontheight()+7, _bg);
-	TFT_fillRect(1, _height-TFT_getfontheight()-8, volume * 2, TFT_getfontheight()+7, TFT_YELLOW);
+	// the level and the rest of the bar, each pixel written once
+	if (volume > 0) TFT_fillRect(1, _height-TFT_getfontheight()-8, volume * 2, TFT_getfontheight()+7, TFT_YELLOW);
+	TFT_fillRect(1 + volume * 2, _height-TFT_getfontheight()-8, _width-2 - volume * 2, TFT_getfontheight()+7, _bg);
 	TFT_drawRect(0, _height-TFT_getfontheight()-9, _width-1, TFT_getfontheight()+8, TFT_CYAN);
 	//TFT_print("VOLUME", CENTER, 4);
+	TFT_fbFlush();
 #endif	
 	ESP_LOGI(TAG, "[ * ]  Volume bar set to %d",volume);
 }
@@ -183,7 +232,10 @@ static void disp_header(const char *info)
 	
 	disp_volume(player_volume);
 
-	TFT_print(info, CENTER, 4);
+	// long titles roll through the header, stepped from the event loop
+	TFT_setclipwin(1, 0, _width-2, TFT_getfontheight()+8);
+	if (TFT_marqueeStart((char *)info, CENTER, 4) != 0) TFT_print((char *)info, CENTER, 4);
+	marquee_next = xTaskGetTickCount() + MARQUEE_DWELL_MS / portTICK_PERIOD_MS;
 
 	for (int r = 0; r < RADIO_COUNT; r++)
 	{
@@ -196,9 +248,51 @@ static void disp_header(const char *info)
 	//_dispTime();
 
 	_bg = TFT_BLACK;
+	TFT_fbFlush();
 #endif	
 }	
 
+static void set_eq_band(int band, int gain)
+{
+	if (dsp_fused) dsp_chain_set_eq_gain(band, gain);
+	else equalizer_set_gain_info(equalizer, band, gain, 1);
+}
+
+/* With the fused chain the callbacks pick the format up from the i2s stream info */
+static esp_err_t set_dsp_info(audio_element_info_t *music_info)
+{
+	if (dsp_fused) return ESP_OK;
+	alc_volume_setup_set_channel(alc_el, music_info->channels);
+	alc_volume_setup_set_volume(alc_el, ALC_VOLUME_SET);
+	return equalizer_set_info(equalizer, music_info->sample_rates, music_info->channels);
+}
+
+/* Cost of the output chain, compare CONFIG_FUSED_DSP_CHAIN on and off */
+static void log_dsp_stats(void)
+{
+	i2s_stream_chain_stats_t stats = {0};
+	i2s_stream_get_chain_stats(i2s_stream_writer, &stats);
+	ESP_LOGI(TAG, "[ * ] DSP %s: %d element tasks, free heap %d, chain %u buffers, %llu us/buffer",
+			dsp_fused ? "fused" : "elements", pipeline_elements, esp_get_free_heap_size(),
+			stats.buffers, stats.buffers ? stats.time_us / stats.buffers : 0);
+}
+
+/*
+ * The codec is only written at CODEC_VOLUME_STEP boundaries, the steps in between
+ * are made up by the ramped digital gain in the i2s stream (ES8388: 0.5 dB per volume unit)
+ */
+static void set_player_volume(int volume)
+{
+	static int codec_volume = -1;
+	int coarse = ((volume + CODEC_VOLUME_STEP - 1) / CODEC_VOLUME_STEP) * CODEC_VOLUME_STEP;
+
+	i2s_stream_set_gain_db(i2s_stream_writer, (volume - coarse) * 0.5f);
+	if (coarse != codec_volume) {
+		audio_hal_set_volume(board_handle->audio_hal, coarse);
+		codec_volume = coarse;
+	}
+}
+
 int _http_stream_event_handle(http_stream_event_msg_t *msg)
 {
     if (msg->event_id == HTTP_STREAM_RESOLVE_ALL_TRACKS) {
@@ -251,9 +345,7 @@ void tune_radio(int radio_index){
                      music_info.sample_rates, music_info.bits, music_info.channels);
 			audio_element_setinfo(i2s_stream_writer, &music_info);
 			
-			      alc_volume_setup_set_channel(alc_el, music_info.channels);
-            alc_volume_setup_set_volume(alc_el, ALC_VOLUME_SET);
-              	equalizer_set_info(equalizer, music_info.sample_rates, music_info.channels); 
+			set_dsp_info(&music_info);
                          	
 			i2s_stream_set_clk(i2s_stream_writer, music_info.sample_rates, music_info.bits, music_info.channels);
 			vTaskDelay(500 / portTICK_RATE_MS);
@@ -283,8 +375,8 @@ void tune_radio(int radio_index){
 			if ((player_volume > 0) && (tx < 90)) player_volume--;
 			if ((player_volume < 100) && (tx > 110)) player_volume++;
 			
-			audio_hal_set_volume(board_handle->audio_hal, player_volume);
-			disp_volume(player_volume);
+			set_player_volume(player_volume);
+			volume_changed = true;
 		}
 		 else if (!busy) tune_request = ty / 18;
 		 
@@ -394,6 +486,10 @@ void app_main(void)
 	TFT_setFont(DEFAULT_FONT, NULL);
 	TFT_resetclipwin();
 	TFT_fillScreen(TFT_BLACK);
+#ifdef CONFIG_TFT_FRAMEBUFFER
+	// the frame buffer starts black like the screen
+	if (TFT_fbInit(MALLOC_CAP_SPIRAM) != 0) ESP_LOGW(TAG, "No memory for the frame buffer, drawing to the display");
+#endif
 		
 
 	
@@ -425,24 +521,28 @@ void app_main(void)
     http_stream_reader = http_stream_init(&http_cfg);
     
     
-	ESP_LOGI(TAG, "[2.11] Create equalizer");
-	equalizer_cfg_t eq_cfg = DEFAULT_EQUALIZER_CONFIG();
     int set_gain[] = { 8, 3, 1, -2, -8, -10, -8, -7, -6, -5,  8, 3, 1, -2, -8, -10, -8, -7, -6, -5};
     //{ -13, -13, -13, -13, -13, -13, -13, -13, -13, -13, -13, -13, -13, -13, -13, -13, -13, -13, -13, -13};
-    eq_cfg.set_gain = set_gain; // The size of gain array should be the multiplication of NUMBER_BAND and number channels of audio stream data. The minimum of gain is -13 dB.
-    equalizer = equalizer_init(&eq_cfg);
-    
-    
-	ESP_LOGI(TAG, "[2.12] Create alc");
-	alc_volume_setup_cfg_t alc_cfg = DEFAULT_ALC_VOLUME_SETUP_CONFIG();
-    alc_el = alc_volume_setup_init(&alc_cfg);
-    
-    
     ESP_LOGI(TAG, "[2.2] Create i2s stream to write data to codec chip");
     i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
     i2s_cfg.type = AUDIO_STREAM_WRITER;
     i2s_cfg.use_alc = false;
     i2s_stream_writer = i2s_stream_init(&i2s_cfg);
+#ifdef CONFIG_FUSED_DSP_CHAIN
+	ESP_LOGI(TAG, "[2.21] Add equalizer and alc to the i2s stream");
+	dsp_fused = dsp_chain_init(i2s_stream_writer, set_gain, ALC_VOLUME_SET) == ESP_OK;
+	if (!dsp_fused) ESP_LOGE(TAG, "[2.21] Fused DSP chain init failed, falling back to equalizer and alc elements");
+#endif
+	if (!dsp_fused) {
+		ESP_LOGI(TAG, "[2.11] Create equalizer");
+		equalizer_cfg_t eq_cfg = DEFAULT_EQUALIZER_CONFIG();
+		eq_cfg.set_gain = set_gain; // The size of gain array should be the multiplication of NUMBER_BAND and number channels of audio stream data. The minimum of gain is -13 dB.
+		equalizer = equalizer_init(&eq_cfg);
+
+		ESP_LOGI(TAG, "[2.12] Create alc");
+		alc_volume_setup_cfg_t alc_cfg = DEFAULT_ALC_VOLUME_SETUP_CONFIG();
+		alc_el = alc_volume_setup_init(&alc_cfg);
+	}
     
 #ifdef FORMAT_AAC
     ESP_LOGI(TAG, "[2.3] Create aac decoder to decode aac file");
@@ -452,12 +552,22 @@ void app_main(void)
     ESP_LOGI(TAG, "[2.4] Register all elements to audio pipeline");
     audio_pipeline_register(pipeline, http_stream_reader, "http");
     audio_pipeline_register(pipeline, aac_decoder,        "aac");
-    audio_pipeline_register(pipeline, equalizer, "equalizer");
-    audio_pipeline_register(pipeline, alc_el, "alc");
+    if (!dsp_fused) {
+        audio_pipeline_register(pipeline, equalizer, "equalizer");
+        audio_pipeline_register(pipeline, alc_el, "alc");
+    }
     audio_pipeline_register(pipeline, i2s_stream_writer,  "i2s");
 
-    ESP_LOGI(TAG, "[2.5] Link it together http_stream-->aac_decoder-->equalizer-->i2s_stream-->[codec_chip]");
-    audio_pipeline_link(pipeline, (const char *[]) {"http",  "aac", "equalizer","alc", "i2s"}, 5);
+    if (dsp_fused) {
+        ESP_LOGI(TAG, "[2.5] Link it together http_stream-->aac_decoder-->i2s_stream(equalizer, alc)-->[codec_chip]");
+        pipeline_elements = 3;
+        audio_pipeline_link(pipeline, (const char *[]) {"http",  "aac", "i2s"}, pipeline_elements);
+    } else {
+        ESP_LOGI(TAG, "[2.5] Link it together http_stream-->aac_decoder-->equalizer-->alc-->i2s_stream-->[codec_chip]");
+        pipeline_elements = 5;
+        audio_pipeline_link(pipeline, (const char *[]) {"http",  "aac", "equalizer","alc", "i2s"}, pipeline_elements);
+    }
+    ESP_LOGI(TAG, "[2.51] Free heap after pipeline setup: %d", esp_get_free_heap_size());
     
     //audio_pipeline_link(pipeline, (const char *[]) {"http",  "aac", "i2s"}, 3);
     
@@ -474,7 +584,8 @@ void app_main(void)
     audio_pipeline_register(pipeline, i2s_stream_writer,  "i2s");
 
     ESP_LOGI(TAG, "[2.5] Link it together http_stream-->mp3_decoder-->i2s_stream-->[codec_chip]");
-    audio_pipeline_link(pipeline, (const char *[]) {"http",  "mp3", "i2s"}, 3);
+    pipeline_elements = 3;
+    audio_pipeline_link(pipeline, (const char *[]) {"http",  "mp3", "i2s"}, pipeline_elements);
 #endif
     ESP_LOGI(TAG, "[2.6] Set up  uri (http as http_stream, aac as aac decoder, and default output is i2s)");
        
@@ -569,7 +680,6 @@ void app_main(void)
 
 	
 	
-	led_strip.access_semaphore = xSemaphoreCreateBinary();
 
     bool led_init_ok = led_strip_init(&led_strip);
     if (!led_init_ok) {
@@ -578,6 +688,11 @@ void app_main(void)
     }
     ESP_LOGI("blink", "led strip Init complete...");
     led_strip_clear(&led_strip);
+#ifdef CONFIG_LED_EFFECT_ENGINE
+    if (!led_effect_init(&led_effect)) {
+      ESP_LOGE("blink", "led effect init failed!");
+    }
+#endif
 	
 
   ESP_LOGI(TAG, "Starting audio pipeline...");
@@ -590,17 +705,29 @@ void app_main(void)
      audio_element_setinfo(aac_decoder, &music_info);	
   	
   	tune_radio(5);//538 Ibiza
+  	TickType_t dsp_stats_tick = xTaskGetTickCount();
 
 	
     while (1) {
 	       
-		led_strip_show(&led_strip);
         audio_event_iface_msg_t msg;
         gpio_set_level(get_green_led_gpio(), 0);
   
 
         
         esp_err_t ret = audio_event_iface_listen(evt, &msg, dee); // portMAX_DELAY);
+        if (xTaskGetTickCount() - dsp_stats_tick >= DSP_STATS_PERIOD_MS / portTICK_PERIOD_MS) {
+            dsp_stats_tick = xTaskGetTickCount();
+            log_dsp_stats();
+        }
+#if CONFIG_EXAMPLE_DISPLAY_TYPE > 0
+		if (volume_changed) {
+			volume_changed = false;
+			disp_volume(player_volume);
+		}
+		marquee_update();
+		TFT_fbFlush();
+#endif
 		
 
         if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT
@@ -611,12 +738,10 @@ void app_main(void)
             audio_element_getinfo(aac_decoder, &music_info);
                   
                 audio_element_setinfo(i2s_stream_writer, &music_info); 
-                alc_volume_setup_set_channel(alc_el, music_info.channels);
-				alc_volume_setup_set_volume(alc_el, ALC_VOLUME_SET);
             
              ESP_LOGI(TAG, "[ * ] Receive music info from aac decoder, sample_rates=%d, bits=%d, ch=%d",
                      music_info.sample_rates, music_info.bits, music_info.channels);
-               	if (equalizer_set_info(equalizer, music_info.sample_rates, music_info.channels) != ESP_OK) {
+               	if (set_dsp_info(&music_info) != ESP_OK) {
 				ESP_LOGE(TAG, "[ * ] Equalizer set error ");
                 continue;
             }
@@ -665,16 +790,16 @@ void app_main(void)
 		}
 			if (msg.cmd == PERIPH_BUTTON_PRESSED){ 
 				ESP_LOGI(TAG, "PERIPH_BUTTON_MODE_PRESSED");
-				equalizer_set_gain_info(equalizer,f31Hz,8,1);
-				equalizer_set_gain_info(equalizer,f62Hz,3,1); 
-		        equalizer_set_gain_info(equalizer,f125Hz,1,1);
-		        equalizer_set_gain_info(equalizer,f250Hz,-2,1);
-		        equalizer_set_gain_info(equalizer,f500Hz,-8,1);
-		        equalizer_set_gain_info(equalizer,f1kHz,-10,1);
-		        equalizer_set_gain_info(equalizer,f2kHz,-8,1);
-		        equalizer_set_gain_info(equalizer,f4kHz,-7,1);
-		        equalizer_set_gain_info(equalizer,f8kHz,-7,1);
-		        equalizer_set_gain_info(equalizer,f16kHz,-6,1);
+				set_eq_band(f31Hz,8);
+				set_eq_band(f62Hz,3); 
+		        set_eq_band(f125Hz,1);
+		        set_eq_band(f250Hz,-2);
+		        set_eq_band(f500Hz,-8);
+		        set_eq_band(f1kHz,-10);
+		        set_eq_band(f2kHz,-8);
+		        set_eq_band(f4kHz,-7);
+		        set_eq_band(f8kHz,-7);
+		        set_eq_band(f16kHz,-6);
 		          ESP_LOGI(TAG, "Loudness ON");
 		          gpio_set_level(get_green_led_gpio(), 1);
 		continue;		
@@ -696,16 +821,16 @@ void app_main(void)
 		}
               if (msg.cmd == PERIPH_BUTTON_PRESSED){ 
 				ESP_LOGI(TAG, "PERIPH_BUTTON_REC_PRESSED");
-				equalizer_set_gain_info(equalizer,0,-13,1); 
-		         equalizer_set_gain_info(equalizer,1,-13,1); 
-		         equalizer_set_gain_info(equalizer,2,-13,1);
-		         equalizer_set_gain_info(equalizer,3,-13,1);
-		             equalizer_set_gain_info(equalizer,4,-13,1); 
-		         equalizer_set_gain_info(equalizer,5,-13,1);
-		         equalizer_set_gain_info(equalizer,6,-13,1);
-		                equalizer_set_gain_info(equalizer,7,-13,1); 
-		         equalizer_set_gain_info(equalizer,8,-13,1);
-		         equalizer_set_gain_info(equalizer,9,-13,1);
+				set_eq_band(0,-13); 
+		         set_eq_band(1,-13); 
+		         set_eq_band(2,-13);
+		         set_eq_band(3,-13);
+		             set_eq_band(4,-13); 
+		         set_eq_band(5,-13);
+		         set_eq_band(6,-13);
+		                set_eq_band(7,-13); 
+		         set_eq_band(8,-13);
+		         set_eq_band(9,-13);
 				 ESP_LOGI(TAG, "Loudness OFF");
 				gpio_set_level(get_green_led_gpio(), 0);
 		}
@@ -753,7 +878,7 @@ void app_main(void)
                 }
                 disp_volume(player_volume);
                 //disp_header(radio[((radio_index<<1)|1)]);
-                audio_hal_set_volume(board_handle->audio_hal, player_volume);
+                set_player_volume(player_volume);
                 
                 ESP_LOGI(TAG, "[ * ] Volume set to %d %%", player_volume);
             } else if ((int) msg.data == get_input_voldown_id()) {
@@ -764,7 +889,7 @@ void app_main(void)
                 }
                 disp_volume(player_volume);
                  //disp_header(radio[((radio_index<<1)|1)]);
-                audio_hal_set_volume(board_handle->audio_hal, player_volume);
+                set_player_volume(player_volume);
                
                 ESP_LOGI(TAG, "[ * ] Volume set to %d %%", player_volume);
             }